@@ -5,6 +5,8 @@ namespace caffe {
 const int kMAX_HORIZONTAL_GAP = 50;
 const float kMIN_V_OVERLAPS = 0.7;
 const float kMIN_SIZE_SIM = 0.7;
+const float kTEXT_PROPOSALS_MIN_SCORE = 0.7;
+const float kTEXT_PROPOSALS_NMS_THRESH = 0.2;
 }  // namespace caffe
 
 #endif  // CFG_HPP_
\ No newline at end of file
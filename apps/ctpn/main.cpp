@@ -1,8 +1,10 @@
 #define SIMPLE_EXPORT
 #include <caffe/caffe.hpp>
+#include <caffe/util/nms_util.hpp>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
+#include "cfg.hpp"
 #include "graph.hpp"
 #include "ployfit.hpp"
 
@@ -76,23 +78,40 @@ int main(int argc, char* argv) {
   net->Forward();
   shared_ptr<Blob<float>> rois = net->blob_by_name("rois");
   shared_ptr<Blob<float>> scores = net->blob_by_name("scores");
-  float min_score = 0.7;
-  float* scores_data = scores->mutable_cpu_data();
-  float* rois_data = rois->mutable_cpu_data();
-  vector<vector<float>> text_proposals;
-  vector<float> vec_scores;
+  const float* scores_data = scores->cpu_data();
+  const float* rois_data = rois->cpu_data();
+  // Keep the confident proposals by decreasing score, then suppress the ones
+  // that overlap a better proposal.
+  vector<pair<float, int>> order;
   for (int i = 0; i < scores->shape()[0]; i++) {
-    if (scores_data[i] > min_score) {
-      vector<float> vec_roi;
-      vec_roi.push_back(rois_data[i * 4 + 0]);
-      vec_roi.push_back(rois_data[i * 4 + 1]);
-      vec_roi.push_back(rois_data[i * 4 + 2]);
-      vec_roi.push_back(rois_data[i * 4 + 3]);
-      clipBoxes(vec_roi, height, width);
-      text_proposals.push_back(vec_roi);
-      vec_scores.push_back(scores_data[i]);
+    if (scores_data[i] > kTEXT_PROPOSALS_MIN_SCORE) {
+      order.push_back(make_pair(scores_data[i], i));
     }
   }
+  std::stable_sort(order.begin(), order.end(),
+                   [](const pair<float, int>& a, const pair<float, int>& b) {
+                     return a.first > b.first;
+                   });
+  const int num_proposals = order.size();
+  vector<float> boxes(num_proposals * 4);
+  for (int i = 0; i < num_proposals; i++) {
+    vector<float> vec_roi(rois_data + order[i].second * 4,
+                          rois_data + order[i].second * 4 + 4);
+    clipBoxes(vec_roi, height, width);
+    std::copy(vec_roi.begin(), vec_roi.end(), boxes.begin() + i * 4);
+  }
+  vector<int> keep(num_proposals);
+  int num_keep = 0;
+  NMSSorted(boxes.data(), num_proposals, 4, keep.data(), &num_keep, 0,
+            kTEXT_PROPOSALS_NMS_THRESH, 0);
+  vector<vector<float>> text_proposals;
+  vector<float> vec_scores;
+  for (int i = 0; i < num_keep; i++) {
+    const int k = keep[i];
+    text_proposals.push_back(
+        vector<float>(boxes.begin() + k * 4, boxes.begin() + k * 4 + 4));
+    vec_scores.push_back(order[k].first);
+  }
 
   vector<int> im_size(2);
   im_size[0] = height;
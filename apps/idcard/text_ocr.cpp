@@ -52,7 +52,13 @@ bool TextOCR::Init(const string& model_file, const string& weight_file,
     Caffe::set_mode(Caffe::CPU);
   else
     Caffe::set_mode(Caffe::GPU);
-  net_.reset(new Net<float>(model_file, TEST));
+  // Line images differ in width; only the layers whose input shapes changed
+  // since the last image are reshaped.
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(model_file, &param);
+  param.mutable_state()->set_phase(TEST);
+  param.set_reshape_cache(true);
+  net_.reset(new Net<float>(param));
   net_->CopyTrainedLayersFrom(weight_file);
   labels_ = GetLabels(label_file);
   return true;
@@ -1,5 +1,7 @@
 #include "mtcnn.h"
 
+#include "caffe/util/nms_util.hpp"
+
 MTCNN::MTCNN(const std::string& proto_model_dir) {
 #ifndef USE_CUDA
   Caffe::set_mode(Caffe::CPU);
@@ -99,85 +101,26 @@ bool CompareBBox(const FaceInfo& a, const FaceInfo& b) {
   return a.bbox.score > b.bbox.score;
 }
 
-float IoU(const FaceInfo& a, const FaceInfo& b) {
-  FaceRect a_rect = a.bbox;
-  FaceRect b_rect = b.bbox;
-
-  float x = std::max<float>(static_cast<float>(a_rect.x1),
-                            static_cast<float>(b_rect.x1));
-  float y = std::max<float>(static_cast<float>(a_rect.y1),
-                            static_cast<float>(b_rect.y1));
-  float w = std::min<float>(static_cast<float>(a_rect.x2),
-                            static_cast<float>(b_rect.x2)) -
-            x + 1;
-  float h = std::min<float>(static_cast<float>(a_rect.y2),
-                            static_cast<float>(b_rect.y2)) -
-            y + 1;
-  if (w <= 0 || h <= 0) {
-    return 0.0;
-  }
-
-  float area1 = (a_rect.x2 - a_rect.x1 + 1) * (a_rect.y2 - a_rect.y1 + 1);
-  float area2 = (b_rect.x2 - b_rect.x1 + 1) * (b_rect.y2 - b_rect.y1 + 1);
-  float area_intersect = w * h;
-
-  return (area_intersect / (area1 + area2 - area_intersect));
-}
-
-float IoM(const FaceInfo& a, const FaceInfo& b) {
-  FaceRect a_rect = a.bbox;
-  FaceRect b_rect = b.bbox;
-
-  float x = std::max<float>(static_cast<float>(a_rect.x1),
-                            static_cast<float>(b_rect.x1));
-  float y = std::max<float>(static_cast<float>(a_rect.y1),
-                            static_cast<float>(b_rect.y1));
-  float w = std::min<float>(static_cast<float>(a_rect.x2),
-                            static_cast<float>(b_rect.x2)) -
-            x + 1;
-  float h = std::min<float>(static_cast<float>(a_rect.y2),
-                            static_cast<float>(b_rect.y2)) -
-            y + 1;
-  if (w <= 0 || h <= 0) {
-    return 0.0;
-  }
-
-  float area1 = (a_rect.x2 - a_rect.x1 + 1) * (a_rect.y2 - a_rect.y1 + 1);
-  float area2 = (b_rect.x2 - b_rect.x1 + 1) * (b_rect.y2 - b_rect.y1 + 1);
-  float area_intersect = w * h;
-
-  return static_cast<float>(area_intersect / std::max<float>(area1, area2));
-}
-
 void NMS(vector<FaceInfo>& face_infos, double thresh,
          vector<FaceInfo>& face_infos_nms, int method = 0) {
   std::sort(face_infos.begin(), face_infos.end(), CompareBBox);
 
-  vector<bool> merge_mask(face_infos.size(), false);
-  for (int i = 0; i < face_infos.size(); i++) {
-    if (merge_mask[i]) {
-      continue;
-    }
-
-    for (int j = i + 1; j < face_infos.size(); j++) {
-      if (merge_mask[j] || i == j) {
-        continue;
-      }
-
-      double iou = IoU(face_infos[i], face_infos[j]);
-      if (method == 1) {
-        iou = IoM(face_infos[i], face_infos[j]);
-      }
-      if (iou > thresh) {
-        merge_mask[j] = true;
-      }
-    }
+  const int num = face_infos.size();
+  vector<float> boxes(num * 4);
+  for (int i = 0; i < num; i++) {
+    const FaceRect& rect = face_infos[i].bbox;
+    boxes[i * 4 + 0] = rect.x1;
+    boxes[i * 4 + 1] = rect.y1;
+    boxes[i * 4 + 2] = rect.x2;
+    boxes[i * 4 + 3] = rect.y2;
   }
+  vector<int> keep(num);
+  int num_keep = 0;
+  NMSSorted(boxes.data(), num, 4, keep.data(), &num_keep, 0,
+            static_cast<float>(thresh), 0, method == 1 ? NMS_IOM : NMS_IOU);
 
-  for (int i = 0; i < face_infos.size(); i++) {
-    if (!merge_mask[i]) {
-      face_infos_nms.push_back(face_infos[i]);
-    }
+  for (int i = 0; i < num_keep; i++) {
+    face_infos_nms.push_back(face_infos[keep[i]]);
   }
 }
 
@@ -30,7 +30,7 @@ bool CheckFileExist(const char* szFile) {
 #endif
 }
 
-Classifier::Classifier() {}
+Classifier::Classifier() : model_mode_(Caffe::CPU) {}
 
 bool Classifier::Init(const string& model_path, bool gpu_mode) {
   const string trained_file = model_path + "/model.caffemodel";
@@ -45,10 +45,11 @@ bool Classifier::Init(const string& model_path, bool gpu_mode) {
     Caffe::set_mode(Caffe::CPU);
   else
     Caffe::set_mode(Caffe::GPU);
+  model_mode_ = Caffe::mode();
 
   /* Load the network. */
-  net_.reset(new Net<float>(model_file, TEST));
-  net_->CopyTrainedLayersFrom(trained_file);
+  model_.reset(new InferenceModel<float>(model_file, trained_file));
+  net_ = model_->NewSession();
   // net_->set_debug_info(true);
 
   CHECK_EQ(net_->num_inputs(), 1) << "Network should have exactly one input.";
@@ -93,10 +94,11 @@ bool Classifier::Init(const string& trained_file, const string& model_file,
     Caffe::set_mode(Caffe::CPU);
   else
     Caffe::set_mode(Caffe::GPU);
+  model_mode_ = Caffe::mode();
 
   /* Load the network. */
-  net_.reset(new Net<float>(model_file, TEST));
-  net_->CopyTrainedLayersFrom(trained_file);
+  model_.reset(new InferenceModel<float>(model_file, trained_file));
+  net_ = model_->NewSession();
 
   CHECK_EQ(net_->num_inputs(), 1) << "Network should have exactly one input.";
   CHECK_EQ(net_->num_outputs(), 1) << "Network should have exactly one output.";
@@ -134,6 +136,22 @@ bool Classifier::Init(const string& trained_file, const string& model_file,
   return true;
 }
 
+bool Classifier::Init(const Classifier& other) {
+  CHECK(other.model_) << "Classifier to share is not initialized.";
+  /* Caffe mode is per thread. */
+  Caffe::set_mode(other.model_mode_);
+
+  model_ = other.model_;
+  net_ = model_->NewSession();
+  model_mode_ = other.model_mode_;
+  num_channels_ = other.num_channels_;
+  input_geometry_ = other.input_geometry_;
+  mean_ = other.mean_;
+  channel_mean_ = other.channel_mean_;
+  labels_ = other.labels_;
+  return true;
+}
+
 int Classifier::FindMaxChannelLayer() {
   const vector<shared_ptr<Blob<float> > >& blobs = net_->blobs();
   int maxchannels = 0;
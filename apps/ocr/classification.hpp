@@ -20,6 +20,9 @@ class Classifier {
   bool Init(const string& model_path, bool gpu_mode = true);
   bool Init(const string& trained_file, const string& model_file,
             const string& mean_file, const string& label_file, bool gpu_mode);
+  // Share the weights, mean and labels of an initialized Classifier, so that
+  // each thread can run its own Classifier over a single copy of the weights.
+  bool Init(const Classifier& other);
   void Release() { delete this; }
 
   bool IsCPUMode();
@@ -75,7 +78,9 @@ class Classifier {
   void PrepareBatchInputs(const vector<cv::Mat>& imgs);
 
  private:
+  std::shared_ptr<InferenceModel<float> > model_;
   std::shared_ptr<Net<float> > net_;
+  Caffe::Brew model_mode_;
   cv::Size input_geometry_;
   int num_channels_;
   cv::Mat mean_;
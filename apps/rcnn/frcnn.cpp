@@ -1,5 +1,6 @@
 #include "frcnn.h"
 #include "caffe/util/frcnn_utils.hpp"
+#include "caffe/util/math_functions.hpp"
 #include "opencv2/highgui.hpp"
 #include "opencv2/imgproc.hpp"
 #include <memory>
@@ -9,13 +10,24 @@ namespace frcnn {
 	using std::shared_ptr;
 
 bool FasterRCNN::Init(const string& model_file, const string& weights_file) {
-  net_ = shared_ptr<Net<float>>(new Net<float>(model_file, caffe::TEST));
+  // Every image has its own size; pad it to a bucket so that images of close
+  // sizes reuse the shapes of the layers instead of reshaping the net.
+  const int kReshapeBucket = 32;
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(model_file, &param);
+  param.mutable_state()->set_phase(caffe::TEST);
+  param.set_reshape_cache(true);
+  if (!param.has_reshape_bucket()) {
+    param.set_reshape_bucket(kReshapeBucket);
+  }
+  net_ = shared_ptr<Net<float>>(new Net<float>(param));
   net_->CopyTrainedLayersFrom(weights_file);
   return true;
 }
 
-void FasterRCNN::Detect(const cv::Mat& im, vector<FrcnnBox>& detect_boxes,
-                        bool vis_result) {
+// Subtract the mean from im and resize it to the test scale in image;
+// returns the scale.
+float FasterRCNN::Preprocess(const cv::Mat& im, cv::Mat& image) {
   const int kTestMaxSize = 640;
   const int kTestTagetSize = 600;
 
@@ -32,39 +44,95 @@ void FasterRCNN::Detect(const cv::Mat& im, vector<FrcnnBox>& detect_boxes,
     im_scale = float(kTestMaxSize) / float(im_size_max);
   }
 
-  cv::Mat image;
   cv::resize(img_org, image, Size(), im_scale, im_scale, cv::INTER_LINEAR);
+  return im_scale;
+}
+
+void FasterRCNN::Detect(const cv::Mat& im, vector<FrcnnBox>& detect_boxes,
+                        bool vis_result) {
+  vector<vector<FrcnnBox>> batch_boxes;
+  Detect(vector<cv::Mat>(1, im), batch_boxes, vis_result);
+  detect_boxes.insert(detect_boxes.end(), batch_boxes[0].begin(),
+                      batch_boxes[0].end());
+}
 
-  int height = int(image.rows);
-  int width = int(image.cols);
+void FasterRCNN::Detect(const vector<cv::Mat>& images,
+                        vector<vector<FrcnnBox>>& detect_boxes,
+                        bool vis_result) {
+  const int num_images = images.size();
+  vector<cv::Mat> resized(num_images);
+  vector<float> im_scales(num_images);
+  int height = 0;
+  int width = 0;
+  for (int n = 0; n < num_images; ++n) {
+    im_scales[n] = Preprocess(images[n], resized[n]);
+    height = std::max(height, resized[n].rows);
+    width = std::max(width, resized[n].cols);
+  }
 
   shared_ptr<Blob<float>> blob_data = net_->blob_by_name("data");
-  blob_data->Reshape(1, 3, height, width);
+  vector<int> data_shape(4);
+  data_shape[0] = num_images;
+  data_shape[1] = 3;
+  data_shape[2] = height;
+  data_shape[3] = width;
+  blob_data->Reshape(net_->BucketShape(data_shape));
+  // Every image sits in the top left corner of its item; im_info keeps its
+  // real size, so its proposals are clipped to it.
+  const int data_height = blob_data->height();
+  const int data_width = blob_data->width();
   float* blob_data_ptr = blob_data->mutable_cpu_data();
-  printf("%d %d %f\n", width, height, im_scale);
-
-  for (int h = 0; h < height; ++h) {
-    for (int w = 0; w < width; ++w) {
-      blob_data_ptr[(0 * height + h) * width + w] =
-          float(image.at<cv::Vec3f>(cv::Point(w, h))[0]);
-      blob_data_ptr[(1 * height + h) * width + w] =
-          float(image.at<cv::Vec3f>(cv::Point(w, h))[1]);
-      blob_data_ptr[(2 * height + h) * width + w] =
-          float(image.at<cv::Vec3f>(cv::Point(w, h))[2]);
+  caffe::caffe_set(blob_data->count(), 0.f, blob_data_ptr);
+
+  shared_ptr<Blob<float>> blob_im_info = net_->blob_by_name("im_info");
+  blob_im_info->Reshape(num_images, 3, 1, 1);
+  float* blob_im_info_ptr = blob_im_info->mutable_cpu_data();
+  for (int n = 0; n < num_images; ++n) {
+    const cv::Mat& image = resized[n];
+    printf("%d %d %f\n", image.cols, image.rows, im_scales[n]);
+    float* item = blob_data_ptr + n * 3 * data_height * data_width;
+    for (int h = 0; h < image.rows; ++h) {
+      for (int w = 0; w < image.cols; ++w) {
+        item[(0 * data_height + h) * data_width + w] =
+            float(image.at<cv::Vec3f>(cv::Point(w, h))[0]);
+        item[(1 * data_height + h) * data_width + w] =
+            float(image.at<cv::Vec3f>(cv::Point(w, h))[1]);
+        item[(2 * data_height + h) * data_width + w] =
+            float(image.at<cv::Vec3f>(cv::Point(w, h))[2]);
+      }
     }
+    blob_im_info_ptr[n * 3 + 0] = image.rows;
+    blob_im_info_ptr[n * 3 + 1] = image.cols;
+    blob_im_info_ptr[n * 3 + 2] = im_scales[n];
   }
 
-  float* blob_im_info_ptr = net_->blob_by_name("im_info")->mutable_cpu_data();
-  blob_im_info_ptr[0] = height;
-  blob_im_info_ptr[1] = width;
-  blob_im_info_ptr[2] = im_scale;
-
   net_->Forward();
 
+  // The rois of an image follow those of the previous images, and so do
+  // their rows of bbox_pred and cls_prob.
   const float* bbox_pred = net_->blob_by_name("bbox_pred")->cpu_data();
-
-  int num = net_->blob_by_name("rois")->num();
+  const float* cls_prob = net_->blob_by_name("cls_prob")->cpu_data();
+  const int num_rois = net_->blob_by_name("rois")->num();
   const float* rois = net_->blob_by_name("rois")->cpu_data();
+  detect_boxes.assign(num_images, vector<FrcnnBox>());
+  int begin = 0;
+  for (int n = 0; n < num_images; ++n) {
+    int end = begin;
+    while (end < num_rois && int(rois[end * 5]) == n) {
+      ++end;
+    }
+    PostProcess(images[n], im_scales[n], end - begin, rois + begin * 5,
+                bbox_pred + begin * 4 * class_num_,
+                cls_prob + begin * class_num_, detect_boxes[n], vis_result);
+    begin = end;
+  }
+}
+
+void FasterRCNN::PostProcess(const cv::Mat& im, float im_scale, int num,
+                             const float* rois, const float* bbox_pred,
+                             const float* cls_prob,
+                             vector<FrcnnBox>& detect_boxes,
+                             bool vis_result) {
   float* rois_box = new float[4 * num];
   for (int n = 0; n < num; ++n) {
     for (int c = 0; c < 4; ++c) {
@@ -72,7 +140,6 @@ void FasterRCNN::Detect(const cv::Mat& im, vector<FrcnnBox>& detect_boxes,
     }
   }
 
-  const float* cls_prob = net_->blob_by_name("cls_prob")->cpu_data();
   float* pred = new float[num * 5 * class_num_];
   BBoxTransformInv(num, bbox_pred, cls_prob, rois_box, pred, im.rows, im.cols,
                    class_num_);
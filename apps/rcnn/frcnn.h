@@ -29,12 +29,22 @@ class FasterRCNN {
   bool Init(const std::string& model_file, const std::string& weights_file);
   void Detect(const cv::Mat& image, vector<FrcnnBox>& detect_boxes,
               bool vis_result = false);
+  // Detect in all the images with a single forward; detect_boxes[n] gets
+  // the boxes of images[n].
+  void Detect(const vector<cv::Mat>& images,
+              vector<vector<FrcnnBox>>& detect_boxes, bool vis_result = false);
   void Detect(const string& image_name);
 
   void VisResult(cv::Mat& show_image, const vector<vector<float>>& pred_boxes,
                  const vector<float>& confidence);
 
  private:
+  float Preprocess(const cv::Mat& im, cv::Mat& image);
+  void PostProcess(const cv::Mat& im, float im_scale, int num,
+                   const float* rois, const float* bbox_pred,
+                   const float* cls_prob, vector<FrcnnBox>& detect_boxes,
+                   bool vis_result);
+
   shared_ptr<Net<float>> net_;
   int class_num_;
   float nms_thresh_;
@@ -12,7 +12,11 @@ using namespace frcnn;
 using namespace caffe;
 int main(int argc, char* argv[]) {
   //::caffe::InitLogging(argv[0]);
-  cv::Mat image = cv::imread(argv[1]);
+  // Every image on the command line goes through a single batched forward.
+  vector<cv::Mat> images;
+  for (int i = 1; i < argc; ++i) {
+    images.push_back(cv::imread(argv[i]));
+  }
   string model_file =
       "/home/wencc/Myplace/caffe_latte/apps/rcnn/model/"
       "vgg16_faster_rcnn_face.prototxt";
@@ -25,7 +29,7 @@ int main(int argc, char* argv[]) {
   Caffe::set_mode(Caffe::CPU);
   FasterRCNN det;
   det.Init(model_file, weights_file);
-  vector<FrcnnBox> box;
-  det.Detect(image, box, 5);
+  vector<vector<FrcnnBox>> boxes;
+  det.Detect(images, boxes, images.size() == 1);
   return 0;
 }
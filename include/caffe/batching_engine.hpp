@@ -0,0 +1,106 @@
+#ifndef CAFFE_BATCHING_ENGINE_HPP_
+#define CAFFE_BATCHING_ENGINE_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/inference_model.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Coalesces single-sample inference requests into batches run by the
+ *        sessions of an InferenceModel.
+ *
+ * Requests queue up until max_batch_size of them with the same shape are
+ * waiting, or the oldest has waited max_delay_us. A worker then reshapes the
+ * input of its session to the batch, runs one Forward and hands every request
+ * its slice of each output. The net must have a single input, and every
+ * output must have the batch as its first axis.
+ */
+template <typename Dtype>
+class CAFFE_API BatchingEngine {
+ public:
+  typedef vector<shared_ptr<Blob<Dtype> > > Outputs;
+
+  /// @brief Latency and throughput since construction or ResetStats.
+  struct Stats {
+    int num_requests;
+    int num_batches;
+    double mean_batch_size;
+    /// Completed requests per second, from the first request submitted to
+    /// the last one completed.
+    double throughput;
+    /// From Submit to completion, in milliseconds.
+    double mean_latency;
+    double p50_latency;
+    double p95_latency;
+    double p99_latency;
+    double max_latency;
+  };
+
+  BatchingEngine(const shared_ptr<InferenceModel<Dtype> >& model,
+                 const BatchingParameter& param);
+  /// @brief Complete the queued requests and stop the workers.
+  ~BatchingEngine();
+
+  /**
+   * @brief Queue one sample, whose first axis must be 1; the future holds
+   *        the outputs of the net for it, each with a first axis of 1.
+   */
+  std::future<Outputs> Submit(const Blob<Dtype>& sample);
+  /// @brief Submit a sample and wait for its outputs.
+  Outputs Run(const Blob<Dtype>& sample) { return Submit(sample).get(); }
+
+  Stats stats() const;
+  void ResetStats();
+
+ protected:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Request {
+    vector<int> shape;
+    vector<Dtype> data;
+    std::promise<Outputs> outputs;
+    Clock::time_point submitted;
+  };
+
+  void WorkerEntry(const int worker_id);
+  /// @brief Wait for the next batch; false once stopped and drained.
+  bool NextBatch(vector<shared_ptr<Request> >* batch);
+  void RunBatch(Net<Dtype>* session,
+                const vector<shared_ptr<Request> >& batch);
+
+  shared_ptr<InferenceModel<Dtype> > model_;
+  BatchingParameter param_;
+  Caffe::Brew mode_;
+  int device_;
+  vector<shared_ptr<Net<Dtype> > > sessions_;
+  vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<shared_ptr<Request> > queue_;
+  bool stop_;
+
+  mutable std::mutex stats_mutex_;
+  vector<double> latencies_;
+  int num_batches_;
+  bool started_;
+  Clock::time_point first_submitted_;
+  Clock::time_point last_completed_;
+
+  DISABLE_COPY_AND_ASSIGN(BatchingEngine);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_BATCHING_ENGINE_HPP_
@@ -228,9 +228,26 @@ class CAFFE_API  Blob {
   Dtype* mutable_cpu_diff();
   Dtype* mutable_gpu_diff();
   void Update();
+  /// @brief Load the blob; 16-bit half_data stays in 16 bits in a
+  ///        Blob<float>, as with StoreDataAsHalf.
   void FromProto(const BlobProto& proto, bool reshape = true);
+  /// @brief Save the blob; data held in 16 bits is saved as half_data.
   void ToProto(BlobProto* proto, bool write_diff = false) const;
 
+  /**
+   * @brief Hold the data in 16 bits in format, which halves its host memory,
+   *        e.g. for the weights of an inference net; see
+   *        SyncedMemory::to_half. Only Blob<float> supports this.
+   *
+   * Kernels that read half_data() widen it as they go. The first cpu_data()
+   * or gpu_data() widens the whole blob again.
+   */
+  void StoreDataAsHalf(HalfFormat format);
+  /// @brief The data in 16 bits, or NULL if it is not held so.
+  inline const uint16_t* half_data() const {
+    return data_ ? data_->half_data() : NULL;
+  }
+
   /// @brief Compute the sum of absolute values (L1 norm) of the data.
   Dtype asum_data() const;
   /// @brief Compute the sum of absolute values (L1 norm) of the diff.
@@ -263,6 +280,30 @@ class CAFFE_API  Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Set the data_ shared_ptr to an externally managed SyncedMemory
+   *        holding at least count() elements, e.g. a buffer handed out by the
+   *        Net memory planner.
+   *
+   * The Blob keeps using this memory until a Reshape grows it beyond its
+   * current count, at which point it allocates its own memory again.
+   */
+  void ShareDataMemory(const shared_ptr<SyncedMemory>& data);
+  /**
+   * @brief Make data_ a view of count() elements of the data of Blob other,
+   *        starting at element offset, so writes to this Blob land directly
+   *        in other.
+   *
+   * As with ShareDataMemory, a Reshape that grows the Blob gives it its own
+   * memory again.
+   */
+  void ShareDataView(const Blob& other, int offset);
+  /// @brief Make diff_ a view into the diff of other; see ShareDataView.
+  void ShareDiffView(const Blob& other, int offset);
+  /// @brief Whether data_ is a view into the data of other at offset.
+  bool DataIsViewOf(const Blob& other, int offset) const;
+  /// @brief Whether diff_ is a view into the diff of other at offset.
+  bool DiffIsViewOf(const Blob& other, int offset) const;
 
   bool ShapeEquals(const BlobProto& other);
 
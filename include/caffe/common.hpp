@@ -162,6 +162,11 @@ class CAFFE_API Caffe {
   inline static bool multiprocess() { return Get().multiprocess_; }
   inline static void set_multiprocess(bool val) { Get().multiprocess_ = val; }
   inline static bool root_solver() { return Get().solver_rank_ == 0; }
+  // Threads the CPU layers of this thread may use (intra-op parallelism):
+  // the value given to set_num_threads, or else the num_threads flag.
+  // Zero means one per core.
+  static int num_threads();
+  inline static void set_num_threads(int val) { Get().num_threads_ = val; }
 
  protected:
 #ifdef USE_CUDA
@@ -176,6 +181,8 @@ class CAFFE_API Caffe {
   int solver_count_;
   int solver_rank_;
   bool multiprocess_;
+  // Negative until set_num_threads is called.
+  int num_threads_;
 
  private:
   // The private constructor to avoid duplicate instantiation.
@@ -0,0 +1,57 @@
+#ifndef CAFFE_INFERENCE_MODEL_HPP_
+#define CAFFE_INFERENCE_MODEL_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A trained model loaded once as a read-only parameter store, from
+ *        which any number of inference sessions can be created.
+ *
+ * Each session is a forward_only Net with its own layers and activation
+ * buffers whose parameter blobs reference the weights of the store, so N
+ * concurrent sessions cost one copy of the weights plus N sets of
+ * activations. Sessions are not thread-safe themselves: use one session per
+ * thread, and set the Caffe mode (and device) in each thread, as that state
+ * is thread-local. NewSession may be called from any thread.
+ *
+ * The weights must not be modified while sessions are running.
+ */
+template <typename Dtype>
+class CAFFE_API InferenceModel {
+ public:
+  /// @brief Load a model from a prototxt and its trained .caffemodel.
+  InferenceModel(const string& param_file, const string& trained_file,
+                 const int level = 0, const vector<string>* stages = NULL);
+  /**
+   * @brief Load a model from a NetParameter and its trained .caffemodel;
+   *        trained_file may be empty if param already carries the blobs.
+   */
+  InferenceModel(const NetParameter& param, const string& trained_file);
+
+  /// @brief Create a new session referencing the weights of this model.
+  shared_ptr<Net<Dtype> > NewSession() const;
+
+  /// @brief The net holding the weights; sessions have the same layers.
+  inline const Net<Dtype>& net() const { return *net_; }
+
+ protected:
+  void Init(const NetParameter& param, const string& trained_file);
+
+  /// The net owning the weights; it is never run.
+  shared_ptr<Net<Dtype> > net_;
+  /// The parameters sessions are created from, without any blobs.
+  NetParameter session_param_;
+
+  DISABLE_COPY_AND_ASSIGN(InferenceModel);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INFERENCE_MODEL_HPP_
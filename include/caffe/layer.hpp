@@ -120,6 +120,13 @@ class Layer {
   inline Dtype Forward(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
+  /**
+   * @brief Forward without the Reshape, for a layer already reshaped to
+   *        bottom blobs of the current shapes.
+   */
+  inline Dtype ForwardReshaped(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
   /**
    * @brief Given the top blob error gradients, compute the bottom blob error
    *        gradients.
@@ -263,6 +270,27 @@ class Layer {
     return true;
   }
 
+  /**
+   * @brief Return whether the top shapes and internal buffers set by Reshape
+   *        depend only on the bottom shapes and the layer parameters.
+   *
+   * With reshape_cache set, the net skips the Reshape of such layers while
+   * their bottom shapes are unchanged; all other layers are reshaped before
+   * every Forward. Override to return true only when Reshape reads nothing
+   * else, such as bottom data.
+   */
+  virtual inline bool ReshapeDependsOnlyOnShapes() const { return false; }
+
+  /**
+   * @brief Keep the weights in the layout of the CPU GEMM they feed, for nets
+   *        that run many forward passes with the same weights.
+   *
+   * Layers that multiply their weights with caffe_cpu_blocked_gemm override
+   * this to pack them once; later changes to the weights are picked up on
+   * the next Forward.
+   */
+  virtual void PrepackWeights() {}
+
   /**
    * @brief Specifies whether the layer should compute gradients w.r.t. a
    *        parameter at a particular index given by param_id.
@@ -406,8 +434,14 @@ class Layer {
 template <typename Dtype>
 inline Dtype Layer<Dtype>::Forward(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  Dtype loss = 0;
   Reshape(bottom, top);
+  return ForwardReshaped(bottom, top);
+}
+
+template <typename Dtype>
+inline Dtype Layer<Dtype>::ForwardReshaped(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  Dtype loss = 0;
   switch (Caffe::mode()) {
   case Caffe::CPU:
     Forward_cpu(bottom, top);
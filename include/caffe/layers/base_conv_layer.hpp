@@ -6,7 +6,12 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocked_gemm.hpp"
+#include "caffe/util/fused_activation.hpp"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/quantization.hpp"
+
+CAFFE_DECLARE_int(conv_col_buffer_kb);
 
 namespace caffe {
 
@@ -18,23 +23,37 @@ template <typename Dtype>
 class BaseConvolutionLayer : public Layer<Dtype> {
  public:
   explicit BaseConvolutionLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), fused_activation_(param), quantized_gemm_(param),
+        packed_memory_(NULL), packed_version_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                           const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
                        const vector<Blob<Dtype>*>& top);
+  virtual void PrepackWeights();
 
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline bool EqualNumBottomTopBlobs() const { return true; }
+  virtual inline bool ReshapeDependsOnlyOnShapes() const { return true; }
 
  protected:
   // Helper functions that abstract away the column buffer and gemm arguments.
   // The last argument in forward_cpu_gemm is so that we can skip the im2col if
-  // we just called weight_cpu_gemm with the same input.
+  // we just called weight_cpu_gemm with the same input. forward_cpu_bias also
+  // applies the fused activation, if any; bias is NULL without bias_term.
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights, Dtype* output,
                         bool skip_im2col = false);
+  // Forward of all num_ images of a convolution, the (image, column tile)
+  // pairs shared out between up to col_tile_workers_ threads.
+  void forward_cpu_gemm_images(const Dtype* input, const Dtype* weights,
+                               Dtype* output);
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
+  // Forward of all num_ images of a pointwise (1x1, unpadded) convolution.
+  // The images are gathered side by side into one column buffer, so that
+  // one GEMM covers several of them; strided inputs are subsampled in the
+  // same pass instead of going through im2col.
+  void forward_cpu_pointwise(const Dtype* input, const Dtype* weights,
+                             Dtype* output);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
                          Dtype* output);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype* weights);
@@ -87,19 +106,30 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int weight_offset_;
   int num_output_;
   bool bias_term_;
+  /// @brief The activation applied together with the bias, if any.
+  FusedActivation<Dtype> fused_activation_;
+  /// @brief The INT8 engine, with a quantization_param of precision INT8.
+  QuantizedGemm<Dtype> quantized_gemm_;
   bool is_1x1_;
+  /// @brief 2D, 1x1 kernel and no padding, at any stride.
+  bool is_pointwise_;
   bool force_nd_im2col_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
-  inline void conv_im2col_cpu(const Dtype* data, Dtype* col_buff) {
+  // The CPU ones cover the rows [row_begin, row_end) of the column buffer,
+  // which are all of them in N-D; conv_col2im_rows_cpu adds to data.
+  inline void conv_im2col_rows_cpu(const Dtype* data, int row_begin,
+                                   int row_end, Dtype* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
-      im2col_cpu(data, conv_in_channels_, conv_input_shape_.cpu_data()[1],
-                 conv_input_shape_.cpu_data()[2], kernel_shape_.cpu_data()[0],
-                 kernel_shape_.cpu_data()[1], pad_.cpu_data()[0],
-                 pad_.cpu_data()[1], stride_.cpu_data()[0],
-                 stride_.cpu_data()[1], dilation_.cpu_data()[0],
-                 dilation_.cpu_data()[1], col_buff);
+      im2col_rows_cpu(data, conv_in_channels_,
+                      conv_input_shape_.cpu_data()[1],
+                      conv_input_shape_.cpu_data()[2],
+                      kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+                      pad_.cpu_data()[0], pad_.cpu_data()[1],
+                      stride_.cpu_data()[0], stride_.cpu_data()[1],
+                      dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+                      row_begin, row_end, col_buff);
     } else {
       im2col_nd_cpu(data, num_spatial_axes_, conv_input_shape_.cpu_data(),
                     col_buffer_shape_.data(), kernel_shape_.cpu_data(),
@@ -107,14 +137,17 @@ class BaseConvolutionLayer : public Layer<Dtype> {
                     col_buff);
     }
   }
-  inline void conv_col2im_cpu(const Dtype* col_buff, Dtype* data) {
+  inline void conv_col2im_rows_cpu(const Dtype* col_buff, int row_begin,
+                                   int row_end, Dtype* data) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
-      col2im_cpu(col_buff, conv_in_channels_, conv_input_shape_.cpu_data()[1],
-                 conv_input_shape_.cpu_data()[2], kernel_shape_.cpu_data()[0],
-                 kernel_shape_.cpu_data()[1], pad_.cpu_data()[0],
-                 pad_.cpu_data()[1], stride_.cpu_data()[0],
-                 stride_.cpu_data()[1], dilation_.cpu_data()[0],
-                 dilation_.cpu_data()[1], data);
+      col2im_rows_cpu(col_buff, conv_in_channels_,
+                      conv_input_shape_.cpu_data()[1],
+                      conv_input_shape_.cpu_data()[2],
+                      kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+                      pad_.cpu_data()[0], pad_.cpu_data()[1],
+                      stride_.cpu_data()[0], stride_.cpu_data()[1],
+                      dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+                      row_begin, row_end, data);
     } else {
       col2im_nd_cpu(col_buff, num_spatial_axes_, conv_input_shape_.cpu_data(),
                     col_buffer_shape_.data(), kernel_shape_.cpu_data(),
@@ -155,6 +188,15 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   }
 #endif
 
+ protected:
+  // Size the column tiles and their worker buffers for the current
+  // kernel_dim_, conv_out_spatial_dim_ and num_; Reshape calls it.
+  void reshape_col_tiles();
+  // Copy the columns of tile out of the conv_out_spatial_dim_ wide rows of
+  // an output into the rows of data_tile, and back.
+  void gather_output_tile(int tile, const Dtype* data, Dtype* data_tile);
+  void scatter_output_tile(int tile, const Dtype* data_tile, Dtype* data);
+
   int num_kernels_im2col_;
   int num_kernels_col2im_;
   int conv_out_channels_;
@@ -164,8 +206,47 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int col_offset_;
   int output_offset_;
 
+  /// The whole column buffer of an image, for the GPU only.
   Blob<Dtype> col_buffer_;
   Blob<Dtype> bias_multiplier_;
+  /// The CPU goes through the column buffer in col_tiles_ tiles of
+  /// col_tile_rows_ rows of the output (of the input for deconvolution), at
+  /// most col_tile_dim_ columns, sized to stay in the L2 cache. Each worker
+  /// has its tile in col_tile_buffer_, and with several tiles, its part of
+  /// the output in output_tile_buffer_; together they stay within the
+  /// conv_col_buffer_kb flag.
+  int col_tile_rows_;
+  int col_tiles_;
+  int col_tile_dim_;
+  int col_tile_workers_;
+  Blob<Dtype> col_tile_buffer_;
+  Blob<Dtype> output_tile_buffer_;
+
+ private:
+  /// The images per GEMM of forward_cpu_pointwise.
+  int pointwise_batch_;
+  Blob<Dtype> pointwise_col_buffer_;
+  Blob<Dtype> pointwise_output_buffer_;
+
+  // output = weights of group g times the columns col_buff, in INT8 with a
+  // quantization_param, else from the packed weights when PrepackWeights was
+  // called and weights are blobs_[0]. NULL weights are blobs_[0] held in 16
+  // bits (see Blob::StoreDataAsHalf).
+  void forward_cpu_weight_gemm(int g, int columns, const Dtype* weights,
+                               const Dtype* col_buff, Dtype* output);
+  // Repack packed_weights_ if the weights changed since; forward_cpu_gemm
+  // calls it before going parallel.
+  void update_packed_weights(const Dtype* weights);
+  // Forward of the column tile tile of an image through the worker buffers
+  // col_buff and output_tile; im2col is skipped with skip_im2col.
+  void forward_cpu_gemm_tile(const Dtype* input, const Dtype* weights,
+                             int tile, bool skip_im2col, Dtype* col_buff,
+                             Dtype* output_tile, Dtype* output);
+  /// The weights of each group as the left GEMM operand, once packed.
+  vector<shared_ptr<PackedMatrix<Dtype> > > packed_weights_;
+  /// The weights packed_weights_ was packed from.
+  const SyncedMemory* packed_memory_;
+  size_t packed_version_;
 };
 
 }  // namespace caffe
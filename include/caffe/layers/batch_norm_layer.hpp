@@ -30,6 +30,9 @@ namespace caffe {
  * with `bias_term: true` after each `BatchNormLayer` to handle both the bias
  * and scaling factor.
  *
+ * With layout NHWC the channels are the last axis; that layout only supports
+ * Forward with the global statistics.
+ *
  * [1] S. Ioffe and C. Szegedy, "Batch Normalization: Accelerating Deep Network
  *     Training by Reducing Internal Covariate Shift." arXiv preprint
  *     arXiv:1502.03167 (2015).
@@ -46,6 +49,7 @@ class BatchNormLayer : public Layer<Dtype> {
                        const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "BatchNorm"; }
+  virtual inline bool ReshapeDependsOnlyOnShapes() const { return true; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
@@ -60,9 +64,13 @@ class BatchNormLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
                             const vector<bool>& propagate_down,
                             const vector<Blob<Dtype>*>& bottom);
+  /// @brief Forward_cpu with the global statistics over channels-last blobs.
+  void ForwardChannelsLast(const vector<Blob<Dtype>*>& bottom,
+                           const vector<Blob<Dtype>*>& top);
 
   Blob<Dtype> mean_, variance_, temp_, x_norm_;
   bool use_global_stats_;
+  bool channels_last_;
   Dtype moving_average_fraction_;
   int channels_;
   Dtype eps_;
@@ -0,0 +1,89 @@
+#ifndef CAFFE_CHANNELS_LAST_CONV_LAYER_HPP_
+#define CAFFE_CHANNELS_LAST_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief ConvolutionLayer over (num, height, width, channels) blobs, for CPU
+ *        inference; the layer of Convolution and ConvolutionDepthwise layers
+ *        with layout NHWC.
+ *
+ * Each output pixel is a row of the top, so a convolution is an implicit
+ * GEMM: the rows of kernel window patches of a tile of output pixels, built
+ * from whole channel runs of the input, times the filters. Unpadded 1x1
+ * convolutions are a single GEMM of the input rows, and depthwise ones
+ * accumulate the taps over contiguous channels instead.
+ *
+ * The filters keep their (num_output, channels / group, kernel_h, kernel_w)
+ * shape and are reordered on the first Forward and again only when the
+ * weights change. Backward is not supported.
+ */
+template <typename Dtype>
+class ChannelsLastConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit ChannelsLastConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param),
+        depthwise_layer_(param.type() == "ConvolutionDepthwise"),
+        weight_version_(0), weight_memory_(NULL) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const {
+    return depthwise_layer_ ? "ConvolutionDepthwise" : "Convolution";
+  }
+  virtual inline int ExactNumBottomBlobs() const { return 1; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// @brief The filters in channels-last order, reordered if stale.
+  const Dtype* ChannelsLastWeights();
+  /// @brief Convolve the output pixels [begin, end) of the batch, one group
+  ///        at a time, through a patches buffer of a row of kernel_h x
+  ///        kernel_w x channels / group per pixel and a group_top buffer of
+  ///        num_output_ / group_ per pixel.
+  void ForwardPatches(const Dtype* bottom_data, const Dtype* weights,
+      int begin, int end, Dtype* patches, Dtype* group_top, Dtype* top_data);
+  /// @brief Convolve the output rows [begin, end) of the batch depthwise.
+  void ForwardDepthwise(const Dtype* bottom_data, const Dtype* weights,
+      int begin, int end, Dtype* top_data);
+
+  /// Created as a ConvolutionDepthwise layer, which has one filter per
+  /// input channel whatever its num_output and group.
+  const bool depthwise_layer_;
+  /// Whether every group has one input and one output channel.
+  bool depthwise_;
+  /// Shape-only (num, channels, height, width) stand-ins for bottom and top,
+  /// through which ConvolutionLayer sets up its geometry.
+  Blob<Dtype> nchw_bottom_;
+  Blob<Dtype> nchw_top_;
+  /// The filters as (num_output, kernel_h, kernel_w, channels / group), or
+  /// (kernel_h, kernel_w, channels) when depthwise; left empty for 1x1
+  /// filters, which need no reordering.
+  Blob<Dtype> channels_last_weights_;
+  /// The weights channels_last_weights_ was computed from.
+  size_t weight_version_;
+  const SyncedMemory* weight_memory_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_CHANNELS_LAST_CONV_LAYER_HPP_
@@ -12,6 +12,12 @@ namespace caffe {
 /**
  * @brief Takes at least two Blob%s and concatenates them along either the num
  *        or channel dimension, outputting the result.
+ *
+ * In the TEST phase, when nothing precedes the concat axis in memory (e.g.
+ * channels with a batch of one), each input that owns its memory is turned
+ * into a view of its part of the output after the first copy, so its producer
+ * writes straight into the output and later forward passes copy nothing.
+ * Other inputs, and all gradients, are copied.
  */
 template <typename Dtype>
 class ConcatLayer : public Layer<Dtype> {
@@ -23,6 +29,7 @@ class ConcatLayer : public Layer<Dtype> {
                        const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "Concat"; }
+  virtual inline bool ReshapeDependsOnlyOnShapes() const { return true; }
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
@@ -77,6 +84,19 @@ class ConcatLayer : public Layer<Dtype> {
                             const vector<bool>& propagate_down,
                             const vector<Blob<Dtype>*>& bottom);
 
+  /// @brief Whether bottom views into top may be used; see the class
+  ///        description.
+  inline bool use_views() const {
+    return this->phase_ == TEST && num_concats_ == 1;
+  }
+  /// @brief Move the data of bottoms that are views of top, but not at their
+  ///        place for the current shapes, into their own memory.
+  void DetachStaleViews(const vector<Blob<Dtype>*>& bottom,
+                        const vector<Blob<Dtype>*>& top);
+  /// @brief Turn the bottoms that own their memory into views of top.
+  void ShareBottomViews(const vector<Blob<Dtype>*>& bottom,
+                        const vector<Blob<Dtype>*>& top);
+
   int count_;
   int num_concats_;
   int concat_input_size_;
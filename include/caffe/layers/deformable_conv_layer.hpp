@@ -76,12 +76,14 @@ class DeformableConvolutionLayer : public BaseConvolutionLayer<Dtype> {
   // reverse_dimensions should return true iff we are implementing deconv, so
   // that conv helpers know which dimensions are which.
 
+  // The CPU goes through the columns of an image a tile of output rows at a
+  // time, as BaseConvolutionLayer does; Forward_cpu runs the (image, tile)
+  // pairs in parallel.
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-                           const vector<Blob<Dtype>*>& top){};
-
+                           const vector<Blob<Dtype>*>& top);
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
                             const vector<bool>& propagate_down,
-                            const vector<Blob<Dtype>*>& bottom){};
+                            const vector<Blob<Dtype>*>& bottom);
 
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
                            const vector<Blob<Dtype>*>& top);
@@ -92,19 +94,50 @@ class DeformableConvolutionLayer : public BaseConvolutionLayer<Dtype> {
   virtual void compute_output_shape();
 
  private:
-  int num_kernels_im2col_;
-  int num_kernels_col2im_;
-  int conv_out_channels_;
-  int conv_in_channels_;
-  int conv_out_spatial_dim_;
-  int kernel_dim_;
-  int col_offset_;
-  int output_offset_;
+  // The output rows [*row_begin, *row_end) of column tile tile.
+  void col_tile_rows(int tile, int* row_begin, int* row_end);
+  // wrap the deformable im2col/col2im of the output rows [row_begin, row_end)
+  // so we don't have to remember the (long) argument lists
+  inline void deformable_im2col_rows(const Dtype* data, const Dtype* offset,
+                                     int row_begin, int row_end,
+                                     Dtype* col_buff) {
+    deformable_im2col_rows_cpu(data, offset, this->conv_in_channels_,
+        this->conv_input_shape_.cpu_data()[1],
+        this->conv_input_shape_.cpu_data()[2],
+        this->kernel_shape_.cpu_data()[0], this->kernel_shape_.cpu_data()[1],
+        this->pad_.cpu_data()[0], this->pad_.cpu_data()[1],
+        this->stride_.cpu_data()[0], this->stride_.cpu_data()[1],
+        this->dilation_.cpu_data()[0], this->dilation_.cpu_data()[1],
+        deformable_group_, row_begin, row_end, col_buff);
+  }
+  inline void deformable_col2im_rows(const Dtype* col_buff,
+                                     const Dtype* offset, int row_begin,
+                                     int row_end, Dtype* data) {
+    deformable_col2im_rows_cpu(col_buff, offset, this->conv_in_channels_,
+        this->conv_input_shape_.cpu_data()[1],
+        this->conv_input_shape_.cpu_data()[2],
+        this->kernel_shape_.cpu_data()[0], this->kernel_shape_.cpu_data()[1],
+        this->pad_.cpu_data()[0], this->pad_.cpu_data()[1],
+        this->stride_.cpu_data()[0], this->stride_.cpu_data()[1],
+        this->dilation_.cpu_data()[0], this->dilation_.cpu_data()[1],
+        deformable_group_, row_begin, row_end, data);
+  }
+  inline void deformable_col2im_coord_rows(const Dtype* col_buff,
+                                           const Dtype* data,
+                                           const Dtype* offset, int row_begin,
+                                           int row_end, Dtype* offset_diff) {
+    deformable_col2im_coord_rows_cpu(col_buff, data, offset,
+        this->conv_in_channels_, this->conv_input_shape_.cpu_data()[1],
+        this->conv_input_shape_.cpu_data()[2],
+        this->kernel_shape_.cpu_data()[0], this->kernel_shape_.cpu_data()[1],
+        this->pad_.cpu_data()[0], this->pad_.cpu_data()[1],
+        this->stride_.cpu_data()[0], this->stride_.cpu_data()[1],
+        this->dilation_.cpu_data()[0], this->dilation_.cpu_data()[1],
+        deformable_group_, row_begin, row_end, offset_diff);
+  }
+
   int input_offset_dim_;
   int deformable_group_;
-
-  Blob<Dtype> col_buffer_;
-  Blob<Dtype> bias_multiplier_;
 };
 
 }  // namespace caffe
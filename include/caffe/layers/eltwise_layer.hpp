@@ -25,6 +25,7 @@ class EltwiseLayer : public Layer<Dtype> {
                        const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "Eltwise"; }
+  virtual inline bool ReshapeDependsOnlyOnShapes() const { return true; }
   virtual inline int MinBottomBlobs() const { return 2; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
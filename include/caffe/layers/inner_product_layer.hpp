@@ -6,12 +6,16 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocked_gemm.hpp"
+#include "caffe/util/fused_activation.hpp"
+#include "caffe/util/quantization.hpp"
 
 namespace caffe {
 
 /**
  * @brief Also known as a "fully-connected" layer, computes an inner product
- *        with a set of learned weights, and (optionally) adds biases.
+ *        with a set of learned weights, and (optionally) adds biases and
+ *        applies a fused activation.
  *
  * TODO(dox): thorough documentation for Forward, Backward, and proto params.
  */
@@ -19,13 +23,17 @@ template <typename Dtype>
 class InnerProductLayer : public Layer<Dtype> {
  public:
   explicit InnerProductLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), fused_activation_(param), quantized_gemm_(param),
+        packed_memory_(NULL), packed_version_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                           const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
                        const vector<Blob<Dtype>*>& top);
 
+  virtual void PrepackWeights();
+
   virtual inline const char* type() const { return "InnerProduct"; }
+  virtual inline bool ReshapeDependsOnlyOnShapes() const { return true; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
@@ -47,6 +55,14 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
   bool transpose_;  ///< if true, assume transposed weights
+  FusedActivation<Dtype> fused_activation_;
+  /// The INT8 engine, with a quantization_param of precision INT8.
+  QuantizedGemm<Dtype> quantized_gemm_;
+  /// The weights as the right GEMM operand, once PrepackWeights was called.
+  shared_ptr<PackedMatrix<Dtype> > packed_weights_;
+  /// The weights packed_weights_ was packed from.
+  const SyncedMemory* packed_memory_;
+  size_t packed_version_;
 };
 
 }  // namespace caffe
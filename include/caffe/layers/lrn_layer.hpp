@@ -29,6 +29,7 @@ class LRNLayer : public Layer<Dtype> {
                        const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "LRN"; }
+  virtual inline bool ReshapeDependsOnlyOnShapes() const { return true; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
@@ -12,6 +12,9 @@ namespace caffe {
 /**
  * @brief Pools the input image by taking the max, average, etc. within regions.
  *
+ * With layout NHWC the blobs are (num, height, width, channels); MAX and AVE
+ * pooling support it, without a mask top and for Forward only.
+ *
  * TODO(dox): thorough documentation for Forward, Backward, and proto params.
  */
 template <typename Dtype>
@@ -24,6 +27,7 @@ class PoolingLayer : public Layer<Dtype> {
                        const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "Pooling"; }
+  virtual inline bool ReshapeDependsOnlyOnShapes() const { return true; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
   // MAX POOL layers can output an extra top blob for the mask;
@@ -46,6 +50,9 @@ class PoolingLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
                             const vector<bool>& propagate_down,
                             const vector<Blob<Dtype>*>& bottom);
+  /// @brief Forward_cpu over (num, height, width, channels) blobs.
+  void ForwardChannelsLast(const vector<Blob<Dtype>*>& bottom,
+                           const vector<Blob<Dtype>*>& top);
 
   int kernel_h_, kernel_w_;
   int stride_h_, stride_w_;
@@ -55,6 +62,7 @@ class PoolingLayer : public Layer<Dtype> {
   int pooled_height_, pooled_width_;
   bool global_pooling_;
   bool ceil_mode_;
+  bool channels_last_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
 };
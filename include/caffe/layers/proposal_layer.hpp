@@ -16,6 +16,8 @@ namespace caffe {
   bottom: 'rpn_bbox_pred'
   bottom: 'im_info'
   top: 'rpn_rois'
+  Each image of the batch has its own row of im_info, and its rois follow
+  those of the previous images, with its batch index.
   **************************************************/
   template <typename Dtype>
   class ProposalLayer : public Layer<Dtype> {
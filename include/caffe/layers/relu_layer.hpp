@@ -27,6 +27,7 @@ class ReLULayer : public NeuronLayer<Dtype> {
   explicit ReLULayer(const LayerParameter& param) : NeuronLayer<Dtype>(param) {}
 
   virtual inline const char* type() const { return "ReLU"; }
+  virtual inline bool ReshapeDependsOnlyOnShapes() const { return true; }
 
  protected:
   /**
@@ -7,6 +7,7 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/roi_align.hpp"
 
 namespace caffe {
 
@@ -46,6 +47,8 @@ class ROIAlignLayer : public Layer<Dtype> {
   Dtype spatial_scale_;
   Blob<int> max_idx_;
   Blob<int> max_idy_;
+  /// The samples of each ROI of the last Forward_cpu, for Backward_cpu.
+  vector<ROIAlignBins<Dtype> > roi_bins_;
 };
 
 }  // namespace caffe
@@ -32,6 +32,7 @@ class ScaleLayer : public Layer<Dtype> {
                        const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "Scale"; }
+  virtual inline bool ReshapeDependsOnlyOnShapes() const { return true; }
   // Scale
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int MaxBottomBlobs() const { return 2; }
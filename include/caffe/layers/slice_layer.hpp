@@ -13,6 +13,10 @@ namespace caffe {
  * @brief Takes a Blob and slices it along either the num or channel dimension,
  *        outputting multiple sliced Blob results.
  *
+ * In the TEST phase, when nothing precedes the slice axis in memory (e.g.
+ * channels with a batch of one), the outputs are views into the input rather
+ * than copies of it. Gradients are always copied.
+ *
  * TODO(dox): thorough documentation for Forward, Backward, and proto params.
  */
 template <typename Dtype>
@@ -40,6 +44,15 @@ class SliceLayer : public Layer<Dtype> {
                             const vector<bool>& propagate_down,
                             const vector<Blob<Dtype>*>& bottom);
 
+  /// @brief Give tops that are views of bottom, but not at their place for
+  ///        the current shapes, their own memory again.
+  void DetachStaleViews(const vector<Blob<Dtype>*>& bottom,
+                        const vector<Blob<Dtype>*>& top);
+  /// @brief Turn the tops into views of bottom when the slice axis is
+  ///        outermost; see the class description.
+  void ShareTopViews(const vector<Blob<Dtype>*>& bottom,
+                     const vector<Blob<Dtype>*>& top);
+
   int count_;
   int num_slices_;
   int slice_size_;
@@ -25,6 +25,7 @@ class TanHLayer : public NeuronLayer<Dtype> {
   explicit TanHLayer(const LayerParameter& param) : NeuronLayer<Dtype>(param) {}
 
   virtual inline const char* type() const { return "TanH"; }
+  virtual inline bool ReshapeDependsOnlyOnShapes() const { return true; }
 
  protected:
   /**
@@ -42,6 +42,11 @@ class TransposeLayer : public Layer<Dtype> {
   Blob<int> forward_map_;
   Blob<int> backward_map_;
   Blob<int> buf_;
+  /// Whether the transpose is one of outer_ (rows_ x cols_) matrices.
+  bool batched_;
+  int outer_;
+  int rows_;
+  int cols_;
 };
 
 }  // namespace caffe
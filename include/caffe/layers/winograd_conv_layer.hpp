@@ -0,0 +1,71 @@
+#ifndef CAFFE_WINOGRAD_CONV_LAYER_HPP_
+#define CAFFE_WINOGRAD_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Winograd implementation of ConvolutionLayer for CPU inference.
+ *
+ * 3x3, stride 1, undilated 2D convolutions are computed as F(m x m, 3 x 3)
+ * with m = winograd_tile (2 or 4): every (m + 2) x (m + 2) input tile is
+ * transformed, each of the (m + 2)^2 transform elements is a GEMM of the
+ * transformed filters with the transformed tiles of a whole chunk of tiles,
+ * and the products are transformed back to m x m outputs. F(4x4, 3x3) takes
+ * 4x fewer multiplications than direct convolution, F(2x2, 3x3) 2.25x.
+ *
+ * The transformed filters are computed on the first Forward and again only
+ * when the weights change. Other convolutions, Backward and GPU mode use
+ * the ConvolutionLayer implementation.
+ */
+template <typename Dtype>
+class WinogradConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit WinogradConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), weight_version_(0),
+        weight_memory_(NULL) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  /// @brief Transform the filters into transformed_weights_, if stale.
+  void TransformWeights();
+  /// @brief Transform the input tiles [tile_begin, tile_end) of the batch.
+  void TransformInput(const Dtype* input, int group, int tile_begin,
+      int tile_end);
+  /// @brief Transform the products of those tiles back into the output.
+  void TransformOutput(int group, int tile_begin, int tile_end,
+      Dtype* output);
+
+  bool use_winograd_;
+  int tile_;
+  int alpha_;
+  int tiles_h_;
+  int tiles_w_;
+  int tile_chunk_;
+  /// (alpha^2, num_output, channels / group) transformed filters.
+  Blob<Dtype> transformed_weights_;
+  /// (alpha^2, channels / group, tile_chunk) transformed input tiles.
+  Blob<Dtype> transformed_input_;
+  /// (alpha^2, num_output / group, tile_chunk) products.
+  Blob<Dtype> transformed_output_;
+  /// The weights transformed_weights_ was computed from.
+  size_t weight_version_;
+  const SyncedMemory* weight_memory_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_WINOGRAD_CONV_LAYER_HPP_
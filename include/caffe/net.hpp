@@ -26,10 +26,19 @@ class CAFFE_API Net {
   explicit Net(const NetParameter& param);
   explicit Net(const string& param_file, Phase phase, const int level = 0,
                const vector<string>* stages = NULL);
+  /**
+   * @brief Build a net whose layer parameter blobs reference those of the
+   *        same layers of weight_source instead of being allocated.
+   *
+   * param must list the layers of weight_source in the same order, as the
+   * sessions of an InferenceModel do. The weights are shared before the
+   * layers are set up, so they are never filled or copied.
+   */
+  Net(const NetParameter& param, const Net* weight_source);
   virtual ~Net() {}
 
   /// @brief Initialize a network with a NetParameter.
-  void Init(const NetParameter& param);
+  void Init(const NetParameter& param, const Net* weight_source = NULL);
 
   /**
    * @brief Run Forward and return the result.
@@ -79,9 +88,19 @@ class CAFFE_API Net {
    * @brief Reshape all layers from bottom to top.
    *
    * This is useful to propagate changes to layer sizes without running
-   * a forward pass, e.g. to compute output feature size.
+   * a forward pass, e.g. to compute output feature size. When the net was
+   * built with optimize_memory, the shared blob buffers are re-planned for
+   * the new shapes.
    */
   void Reshape();
+  /**
+   * @brief Round the spatial axes (2 and up) of an input shape up to a
+   *        multiple of reshape_bucket; the shape is unchanged when it is 0.
+   *
+   * Reshape an input to the bucket, fill the sample in its top left corner
+   * and pad the rest, so that nearby input sizes hit the reshape cache.
+   */
+  vector<int> BucketShape(const vector<int>& shape) const;
 
   Dtype ForwardBackward() {
     Dtype loss;
@@ -99,6 +118,13 @@ class CAFFE_API Net {
    * called manually.
    */
   void ShareWeights();
+  /**
+   * @brief Lets every layer keep its weights packed for the CPU GEMM (see
+   *        Layer::PrepackWeights), for nets only used for inference.
+   *
+   * Note: this is called by Net::Init when prepack_weights is set.
+   */
+  void PrepackWeights();
 
   /**
    * @brief For an already initialized net, implicitly copies (i.e., using no
@@ -136,6 +162,8 @@ class CAFFE_API Net {
   }
   /// @brief returns the phase: TRAIN or TEST
   inline Phase phase() const { return phase_; }
+  /// @brief returns whether the net was built to only run forward
+  inline bool forward_only() const { return forward_only_; }
   /**
    * @brief returns the bottom vecs for each layer -- usually you won't
    *        need this unless you do per-layer checks such as gradients.
@@ -264,10 +292,51 @@ class CAFFE_API Net {
   int AppendBottom(const NetParameter& param, const int layer_id,
                    const int bottom_id, set<string>* available_blobs,
                    map<string, int>* blob_name_to_idx);
+  /// @brief Share the weights of layer layer_id of source with the layer of
+  ///        the same index of this net, before it is set up.
+  void ShareSourceWeights(const Net& source, const int layer_id);
   /// @brief Append a new parameter blob to the net.
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /**
+   * @brief Let blobs whose lifetimes do not overlap share data buffers.
+   *
+   * Lifetimes are computed from the layer order; blobs that alias the same
+   * SyncedMemory (in-place layers, Split, Flatten, Reshape, ...) are planned
+   * as one unit. Net::Reshape plans again after any reshape, and Forward
+   * after a pass in which a blob outgrew its buffer.
+   */
+  void PlanMemory();
+  /**
+   * @brief Reshape a layer, unless the reshape cache shows its bottoms have
+   *        the shapes it was last reshaped for; returns whether it reshaped.
+   */
+  bool ReshapeLayer(int layer_id);
+  /**
+   * @brief Find the Split layers whose backward the consumers of their tops
+   *        can perform themselves.
+   *
+   * Each consumer adds the gradient in its top diff into the diff of the
+   * split input right after its own backward, while that gradient is still
+   * in cache; the last consumer (in layer order) runs first and overwrites
+   * the input diff instead. Splits with a top that is a net output, is
+   * rewritten in place, or feeds another Split keep their own backward.
+   * Nothing is elided unless elide is set.
+   */
+  void PlanSplitBackward(const bool elide);
+  /// @brief Whether a backward pass from start to end leaves the Split at
+  ///        split_id to its consumers: only when it covers all of them and
+  ///        the split itself, so partial ranges sum the tops as Split does.
+  inline bool SplitElided(const int split_id, const int start,
+                          const int end) const {
+    return split_first_consumer_[split_id] >= 0 && split_id >= end &&
+           split_first_consumer_[split_id] <= start;
+  }
+  /// @brief Add the gradients layer_id wrote for splits elided from start to
+  ///        end into their inputs.
+  void AccumulateSplitDiffs(const int layer_id, const int start,
+                            const int end);
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -279,6 +348,8 @@ class CAFFE_API Net {
   string name_;
   /// @brief The phase: TRAIN or TEST
   Phase phase_;
+  /// @brief Whether the net never runs backward
+  bool forward_only_;
   /// @brief Individual layers in the net
   vector<shared_ptr<Layer<Dtype> > > layers_;
   vector<string> layer_names_;
@@ -332,6 +403,25 @@ class CAFFE_API Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Whether intermediate blobs share data buffers (see PlanMemory).
+  bool optimize_memory_;
+  /// Blobs excluded from buffer sharing by the user.
+  set<string> memory_keep_blobs_;
+  /// The buffers shared by intermediate blobs.
+  vector<shared_ptr<SyncedMemory> > memory_pool_;
+  /// The buffer each blob was planned into, NULL for blobs left out.
+  vector<SyncedMemory*> planned_memory_;
+  /// Whether layers whose bottom shapes are unchanged skip Reshape.
+  bool reshape_cache_;
+  /// The bottom shapes each layer was last reshaped for.
+  vector<vector<vector<int> > > reshaped_bottom_shapes_;
+  unsigned int reshape_bucket_;
+  /// For each Split layer whose backward is elided, the consumer that
+  /// overwrites the split input diff; -1 for all other layers.
+  vector<int> split_first_consumer_;
+  /// For each layer, the (bottom_id, split layer_id) pairs whose gradient it
+  /// contributes to an elided split.
+  vector<vector<pair<int, int> > > split_diff_adds_;
   // Callbacks
   vector<Callback*> before_forward_;
   vector<Callback*> after_forward_;
@@ -2,12 +2,17 @@
 #define CAFFE_SYNCEDMEM_HPP_
 
 #include <cstdlib>
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 #ifdef USE_MKL
   #include "mkl.h"
 #endif
 
 #include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/host_allocator.hpp"
 
 namespace caffe {
 
@@ -16,7 +21,10 @@ namespace caffe {
 // The improvement in performance seems negligible in the single GPU case,
 // but might be more significant for parallel training. Most importantly,
 // it improved stability for large models on many GPUs.
-inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda) {
+// Otherwise it comes from the caching HostAllocator, unless that is disabled.
+inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda,
+                            bool* use_pool) {
+  *use_pool = false;
 #ifdef USE_CUDA
   if (Caffe::mode() == Caffe::GPU) {
     CUDA_CHECK(cudaMallocHost(ptr, size));
@@ -24,22 +32,32 @@ inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda) {
     return;
   }
 #endif
+  *use_cuda = false;
+  if (HostAllocator::enabled()) {
+    *ptr = HostAllocator::Allocate(size);
+    *use_pool = true;
+    return;
+  }
 #ifdef USE_MKL
   *ptr = mkl_malloc(size ? size:1, 64);
 #else
   *ptr = malloc(size);
 #endif
-  *use_cuda = false;
   CHECK(*ptr) << "host allocation of size " << size << " failed";
 }
 
-inline void CaffeFreeHost(void* ptr, bool use_cuda) {
+inline void CaffeFreeHost(void* ptr, size_t size, bool use_cuda,
+                          bool use_pool) {
 #ifdef USE_CUDA
   if (use_cuda) {
     CUDA_CHECK(cudaFreeHost(ptr));
     return;
   }
 #endif
+  if (use_pool) {
+    HostAllocator::Deallocate(ptr, size);
+    return;
+  }
 #ifdef USE_MKL
   mkl_free(ptr);
 #else
@@ -52,12 +70,22 @@ inline void CaffeFreeHost(void* ptr, bool use_cuda) {
  * @brief Manages memory allocation and synchronization between the host (CPU)
  *        and device (GPU).
  *
+ * A SyncedMemory may also be a view of size bytes at a byte offset into a
+ * parent SyncedMemory. A view owns no memory: it keeps its parent alive and
+ * forwards every access and synchronization to it.
+ *
+ * Float contents may also be held on the host as 16-bit values only (see
+ * to_half), which are widened back to floats on the first access that needs
+ * them.
+ *
  * TODO(dox): more thorough description.
  */
 class SyncedMemory {
  public:
   SyncedMemory();
   explicit SyncedMemory(size_t size);
+  SyncedMemory(const shared_ptr<SyncedMemory>& parent, size_t offset,
+               size_t size);
   ~SyncedMemory();
   const void* cpu_data();
   void set_cpu_data(void* data);
@@ -66,8 +94,35 @@ class SyncedMemory {
   void* mutable_cpu_data();
   void* mutable_gpu_data();
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
-  SyncedHead head() { return head_; }
+  SyncedHead head() { return parent_ ? parent_->head() : head_; }
   size_t size() { return size_; }
+  /// @brief The SyncedMemory this is a view of, or NULL.
+  inline const shared_ptr<SyncedMemory>& parent() const { return parent_; }
+  /// @brief The byte offset of this view into its parent.
+  inline size_t offset() const { return offset_; }
+  inline bool is_view() const { return parent_.get() != NULL; }
+  /// @brief Counts the mutable accesses and set_*_data calls, so that state
+  ///        derived from the contents can tell when it is stale.
+  size_t version() const { return parent_ ? parent_->version() : version_; }
+
+  /**
+   * @brief Hold the contents, taken as size() / 4 floats, as 16-bit values in
+   *        format, and free their host memory.
+   *
+   * Code that reads half_data() uses the 16-bit values as they are; any
+   * other access widens them to floats again, keeping both until the next
+   * mutable access. The GPU copy, if any, is stale afterwards.
+   */
+  void to_half(HalfFormat format);
+  /// @brief Set the contents to count 16-bit values, followed by zeros, and
+  ///        hold them as to_half does.
+  void set_half_data(const uint16_t* data, size_t count, HalfFormat format);
+  /// @brief The contents as 16-bit values in half_format(), or NULL if they
+  ///        are not held so.
+  const uint16_t* half_data() const {
+    return half_data_.empty() ? NULL : half_data_.data();
+  }
+  HalfFormat half_format() const { return half_format_; }
 
 #ifdef USE_CUDA
   void async_gpu_push(const cudaStream_t& stream);
@@ -78,14 +133,28 @@ class SyncedMemory {
 
   void to_cpu();
   void to_gpu();
+  // Allocate the host floats of contents held only in 16 bits.
+  void widen_half();
+  void clear_half();
   void* cpu_ptr_;
   void* gpu_ptr_;
   size_t size_;
   SyncedHead head_;
   bool own_cpu_data_;
   bool cpu_malloc_use_cuda_;
+  bool cpu_malloc_use_pool_;
   bool own_gpu_data_;
   int device_;
+  shared_ptr<SyncedMemory> parent_;
+  size_t offset_;
+  size_t version_;
+  std::vector<uint16_t> half_data_;
+  HalfFormat half_format_;
+  // Whether the contents are held in 16 bits only, with no host floats yet.
+  // Cleared with a release store once widen_half has published cpu_ptr_.
+  std::atomic<bool> half_pending_;
+  // Inference sessions that share weights may widen them concurrently.
+  std::mutex half_mutex_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
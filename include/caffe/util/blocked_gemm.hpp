@@ -0,0 +1,103 @@
+#ifndef CAFFE_UTIL_BLOCKED_GEMM_HPP_
+#define CAFFE_UTIL_BLOCKED_GEMM_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/mkl_alternate.hpp"
+
+CAFFE_DECLARE_bool(blocked_gemm);
+
+namespace caffe {
+
+/**
+ * @brief A GEMM operand stored in the layout of caffe_cpu_blocked_gemm.
+ *
+ * The blocked GEMM copies its operands into panels of a few rows of A or
+ * columns of B before multiplying them. A matrix that is multiplied many
+ * times, like the weights of an inference net, can be packed once and then
+ * used without any copy.
+ */
+template <typename Dtype>
+class PackedMatrix {
+ public:
+  PackedMatrix() : left_(false), rows_(0), cols_(0) {}
+
+  /// @brief Pack op(A), the M x K left operand of C = op(A) op(B).
+  void PackA(const CBLAS_TRANSPOSE TransA, const int M, const int K,
+             const Dtype* A);
+  /// @brief Pack op(B), the K x N right operand of C = op(A) op(B).
+  void PackB(const CBLAS_TRANSPOSE TransB, const int K, const int N,
+             const Dtype* B);
+  /// @brief PackA from 16-bit values in format.
+  void PackA(const CBLAS_TRANSPOSE TransA, const int M, const int K,
+             const uint16_t* A, const HalfFormat format);
+  /// @brief PackB from 16-bit values in format.
+  void PackB(const CBLAS_TRANSPOSE TransB, const int K, const int N,
+             const uint16_t* B, const HalfFormat format);
+
+  inline bool left() const { return left_; }
+  /// The dimensions of op(A) or op(B).
+  inline int rows() const { return rows_; }
+  inline int cols() const { return cols_; }
+  inline const Dtype* data() const { return data_.data(); }
+
+ private:
+  bool left_;
+  int rows_;
+  int cols_;
+  std::vector<Dtype> data_;
+
+  DISABLE_COPY_AND_ASSIGN(PackedMatrix);
+};
+
+/**
+ * @brief C = alpha op(A) op(B) + beta C with Caffe's own cache blocked GEMM,
+ *        with the arguments of caffe_cpu_gemm.
+ *
+ * Single precision runs AVX-512 or AVX2 micro-kernels, as cpu_isa() allows.
+ * The columns of C are split over Caffe::num_threads() threads. Setting the
+ * blocked_gemm flag routes caffe_cpu_gemm<float> here instead of to BLAS.
+ */
+template <typename Dtype>
+void caffe_cpu_blocked_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const Dtype* B, const Dtype beta,
+    Dtype* C);
+
+/**
+ * @brief The same with A given as 16-bit values in format (see half.hpp),
+ *        e.g. weights held by Blob::StoreDataAsHalf.
+ *
+ * Each block of A is widened as it is packed, so A is read from memory in
+ * 16 bits and never widened whole.
+ */
+template <typename Dtype>
+void caffe_cpu_blocked_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const uint16_t* A, const HalfFormat format,
+    const Dtype* B, const Dtype beta, Dtype* C);
+
+/// @brief The same with B given as 16-bit values in format.
+template <typename Dtype>
+void caffe_cpu_blocked_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const uint16_t* B,
+    const HalfFormat format, const Dtype beta, Dtype* C);
+
+/// @brief The same with A packed by PackA; M and K are those of A.
+template <typename Dtype>
+void caffe_cpu_blocked_gemm(const PackedMatrix<Dtype>& A,
+    const CBLAS_TRANSPOSE TransB, const int N, const Dtype alpha,
+    const Dtype* B, const Dtype beta, Dtype* C);
+
+/// @brief The same with B packed by PackB; K and N are those of B.
+template <typename Dtype>
+void caffe_cpu_blocked_gemm(const CBLAS_TRANSPOSE TransA, const int M,
+    const Dtype alpha, const Dtype* A, const PackedMatrix<Dtype>& B,
+    const Dtype beta, Dtype* C);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_BLOCKED_GEMM_HPP_
@@ -0,0 +1,40 @@
+#ifndef CAFFE_UTIL_CPU_INFO_HPP_
+#define CAFFE_UTIL_CPU_INFO_HPP_
+
+#include "caffe/common.hpp"
+
+// Kernels for wider instruction sets than the build targets are compiled
+// with per-function target attributes and selected at run time with
+// cpu_isa(), so a single binary runs everywhere.
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_X86_DISPATCH
+#define CAFFE_TARGET_SSE2 __attribute__((target("sse2")))
+#define CAFFE_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define CAFFE_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma,f16c")))
+#endif
+
+namespace caffe {
+
+/// Instruction sets with dedicated kernels, from narrowest to widest.
+enum CpuIsa {
+  CPU_ISA_SCALAR = 0,
+  CPU_ISA_SSE2 = 1,
+  // AVX2 together with FMA3 and F16C.
+  CPU_ISA_AVX2 = 2,
+  // AVX-512 Foundation, besides the above.
+  CPU_ISA_AVX512 = 3
+};
+
+/// @brief The widest instruction set kernels may use on this CPU.
+CAFFE_API CpuIsa cpu_isa();
+
+/// @brief Cap cpu_isa(), e.g. to test or benchmark the narrower kernels.
+CAFFE_API void set_max_cpu_isa(CpuIsa isa);
+
+/// @brief The name of an instruction set, for logging.
+CAFFE_API const char* cpu_isa_name(CpuIsa isa);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CPU_INFO_HPP_
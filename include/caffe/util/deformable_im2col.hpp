@@ -3,6 +3,47 @@
 
 namespace caffe {
 
+/**
+ * @brief deformable_im2col of the output rows [row_begin, row_end) only:
+ *        data_col gets (channels * kernel_h * kernel_w) rows of
+ *        (row_end - row_begin) * output_w columns, in the layout of
+ *        im2col_rows_cpu. data_offset holds the offsets of the whole output,
+ *        (deformable_group * kernel_h * kernel_w * 2) planes of (h, w) pairs.
+ */
+template <typename Dtype>
+void deformable_im2col_rows_cpu(const Dtype* data_im, const Dtype* data_offset,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int deformable_group, const int row_begin,
+    const int row_end, Dtype* data_col);
+
+/**
+ * @brief Add the gradient of the columns of the output rows
+ *        [row_begin, row_end) of deformable_im2col_rows_cpu into grad_im,
+ *        which is not zeroed first.
+ */
+template <typename Dtype>
+void deformable_col2im_rows_cpu(const Dtype* data_col,
+    const Dtype* data_offset, const int channels, const int height,
+    const int width, const int kernel_h, const int kernel_w, const int pad_h,
+    const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int deformable_group,
+    const int row_begin, const int row_end, Dtype* grad_im);
+
+/**
+ * @brief Set the offsets of the output rows [row_begin, row_end) in
+ *        grad_offset, laid out as data_offset, to the gradient of the columns
+ *        data_col of deformable_im2col_rows_cpu.
+ */
+template <typename Dtype>
+void deformable_col2im_coord_rows_cpu(const Dtype* data_col,
+    const Dtype* data_im, const Dtype* data_offset, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int deformable_group,
+    const int row_begin, const int row_end, Dtype* grad_offset);
+
 template <typename Dtype>
 void deformable_im2col_gpu(const Dtype* data_im, const Dtype* data_offset, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
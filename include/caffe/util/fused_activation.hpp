@@ -0,0 +1,67 @@
+#ifndef CAFFE_UTIL_FUSED_ACTIVATION_HPP_
+#define CAFFE_UTIL_FUSED_ACTIVATION_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief The bias + activation epilogue of a Convolution, Deconvolution or
+ *        InnerProduct layer with a fused_activation_param.
+ *
+ * Adding the bias and applying the activation in one pass saves a full
+ * read/write of the output compared to a separate activation layer.  The
+ * activation settings are read from the relu_param, relux_param,
+ * prelu_param, elu_param or selu_param of the same layer.
+ */
+template <typename Dtype>
+class FusedActivation {
+ public:
+  explicit FusedActivation(const LayerParameter& param);
+
+  inline FusedActivationParameter_Type type() const { return type_; }
+  inline bool enabled() const {
+    return type_ != FusedActivationParameter_Type_NONE;
+  }
+  /// @brief Whether the activation has a learned slope blob (PReLU).
+  inline bool has_slope() const {
+    return type_ == FusedActivationParameter_Type_PRELU;
+  }
+  /// @brief Whether the PReLU slope is a single value for all channels.
+  inline bool channel_shared() const { return channel_shared_; }
+  /// @brief The shape of the slope blob for an output with this many channels.
+  inline vector<int> slope_shape(const int channels) const {
+    return vector<int>(!channel_shared_, channels);
+  }
+  /// @brief Initializes the slope blob as PReLULayer does.
+  void FillSlope(Blob<Dtype>* slope) const;
+
+  /**
+   * @brief Computes data = activation(data + bias) in place, where data is
+   *        num x channels x dim and bias (may be NULL) and slope (PReLU
+   *        only) are per channel.
+   */
+  void Forward_cpu(const int num, const int channels, const int dim,
+      const Dtype* bias, const Dtype* slope, Dtype* data) const;
+#ifdef USE_CUDA
+  void Forward_gpu(const int num, const int channels, const int dim,
+      const Dtype* bias, const Dtype* slope, Dtype* data) const;
+#endif
+
+ private:
+  FusedActivationParameter_Type type_;
+  Dtype negative_slope_;
+  Dtype maximal_value_;
+  Dtype alpha_;
+  Dtype lambda_;
+  bool channel_shared_;
+  FillerParameter slope_filler_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FUSED_ACTIVATION_HPP_
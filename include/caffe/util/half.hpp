@@ -0,0 +1,39 @@
+#ifndef CAFFE_UTIL_HALF_HPP_
+#define CAFFE_UTIL_HALF_HPP_
+
+#include <stdint.h>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * 16-bit floating point storage. Values are only stored in 16 bits and are
+ * widened to float for any arithmetic. The numbering matches
+ * BlobProto::HalfFormat.
+ */
+enum HalfFormat {
+  // IEEE 754 binary16: 5 exponent and 10 mantissa bits, |x| <= 65504.
+  HALF_FLOAT16 = 0,
+  // The upper 16 bits of a float: the float range with 7 mantissa bits.
+  HALF_BFLOAT16 = 1
+};
+
+/// @brief x rounded to the nearest 16-bit value, ties to even; values past
+///        the FLOAT16 range become infinities.
+CAFFE_API uint16_t float_to_half(float x, HalfFormat format);
+/// @brief The float value of a 16-bit value, which is exact.
+CAFFE_API float half_to_float(uint16_t x, HalfFormat format);
+
+/// @brief The elementwise float_to_half, with F16C or AVX2 where cpu_isa()
+///        allows.
+CAFFE_API void caffe_cpu_float_to_half(const int n, const float* x,
+    uint16_t* y, HalfFormat format);
+/// @brief The elementwise half_to_float, with F16C or AVX2 where cpu_isa()
+///        allows.
+CAFFE_API void caffe_cpu_half_to_float(const int n, const uint16_t* x,
+    float* y, HalfFormat format);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HALF_HPP_
@@ -0,0 +1,67 @@
+#ifndef CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+#define CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+
+#include <cstddef>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A caching allocator for host memory.
+ *
+ * Requests are rounded up to a size class (64 bytes, then four classes per
+ * power of two) and served 64-byte aligned. Freed blocks are kept for reuse,
+ * first in a cache private to the freeing thread, then in a cache shared by
+ * all threads; blocks beyond the cache limits are returned to the system.
+ * Blocks larger than kMaxCachedBlock are never cached.
+ */
+class CAFFE_API HostAllocator {
+ public:
+  struct Stats {
+    /// Bytes handed out and not yet freed, counted by size class.
+    size_t bytes_live;
+    /// The largest bytes_live since the last ResetPeak.
+    size_t peak_bytes_live;
+    /// Bytes held in the caches for reuse.
+    size_t bytes_cached;
+    size_t num_allocs;
+    /// Allocations served from a cache.
+    size_t num_hits;
+    double hit_rate;
+  };
+
+  static const size_t kAlignment = 64;
+  static const size_t kMaxCachedBlock = size_t(1) << 28;
+
+  /// @brief Allocate at least size bytes, aligned to kAlignment.
+  static void* Allocate(size_t size);
+  /// @brief Free a block from Allocate; size must be the size requested.
+  static void Deallocate(void* ptr, size_t size);
+
+  /**
+   * @brief Whether CaffeMallocHost allocates through the cache (the
+   *        default) or straight from the system allocator.
+   *
+   * Blocks keep being freed the way they were allocated, so this may be
+   * switched at any time.
+   */
+  static bool enabled();
+  static void set_enabled(bool enabled);
+
+  /// @brief Cap the bytes kept in the cache shared by all threads.
+  static void set_cache_limit(size_t bytes);
+  /// @brief Return the cached blocks of the shared cache and of the calling
+  ///        thread to the system.
+  static void Trim();
+
+  static Stats stats();
+  static void ResetPeak();
+
+ private:
+  HostAllocator() {}
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HOST_ALLOCATOR_HPP_
@@ -16,6 +16,18 @@ void im2col_cpu(const Dtype* data_im, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     Dtype* data_col);
 
+/**
+ * @brief im2col_cpu of the output rows [row_begin, row_end) only: data_col
+ *        gets (channels * kernel_h * kernel_w) rows of
+ *        (row_end - row_begin) * output_w columns.
+ */
+template <typename Dtype>
+void im2col_rows_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int row_begin, const int row_end, Dtype* data_col);
+
 template <typename Dtype>
 void col2im_nd_cpu(const Dtype* data_col, const int num_spatial_axes,
     const int* im_shape, const int* col_shape,
@@ -29,6 +41,18 @@ void col2im_cpu(const Dtype* data_col, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     Dtype* data_im);
 
+/**
+ * @brief Add the columns of the output rows [row_begin, row_end), laid out
+ *        as im2col_rows_cpu makes them, into data_im. Unlike col2im_cpu,
+ *        data_im is not zeroed first.
+ */
+template <typename Dtype>
+void col2im_rows_cpu(const Dtype* data_col, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int row_begin, const int row_end, Dtype* data_im);
+
 template <typename Dtype>
 void im2col_nd_gpu(const Dtype* data_im, const int num_spatial_axes,
     const int col_size, const int* im_shape, const int* col_shape,
@@ -0,0 +1,68 @@
+#ifndef CAFFE_UTIL_INFERENCE_OPTIMIZER_HPP_
+#define CAFFE_UTIL_INFERENCE_OPTIMIZER_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/half.hpp"
+#include "caffe/util/quantization.hpp"
+
+namespace caffe {
+
+// Copy the blobs of every layer of trained_param into the layer of the same
+// name in param, e.g. to merge a .caffemodel into its deploy prototxt before
+// rewriting the net.  Layers of param without a trained counterpart are left
+// untouched.
+void CopyTrainedLayerBlobs(const NetParameter& trained_param,
+    NetParameter* param);
+
+// Copy NetParameters with every chain of BatchNorm, Scale and Bias layers
+// that directly follows a Convolution, ConvolutionDepthwise or InnerProduct
+// layer folded into that layer's weights and bias.  The folded layers are
+// removed and the producer takes over the top of the last of them.  Only
+// layers that carry their trained blobs are folded, and only when the
+// intermediate outputs are not read by any other layer.  Returns the number
+// of layers removed.
+int FoldBatchNormLayers(const NetParameter& param, NetParameter* param_folded);
+
+// Copy NetParameters with every ReLU, ReLUX, PReLU, ELU or SeLu layer that
+// directly follows a Convolution, Deconvolution or InnerProduct layer fused
+// into that layer as its fused_activation_param, so the activation is applied
+// together with the bias.  As above, the activation layer is removed and its
+// top taken over.  A PReLU layer is only fused when it and the producer carry
+// their trained blobs; its slopes become the producer's last blob.  The
+// fused net only supports Forward.  Returns the number of layers removed.
+int FuseActivationLayers(const NetParameter& param,
+    NetParameter* param_fused);
+
+// Copy NetParameters with every Convolution and InnerProduct layer whose
+// input has a range in ranges (see UpdateBlobRanges) switched to the INT8
+// engine over that range.  Convolutions with another engine than CAFFE and
+// InnerProduct layers with transposed weights stay in floating point.
+// Returns the number of layers quantized.
+int QuantizeLayers(const NetParameter& param, const BlobRanges& ranges,
+    NetParameter* param_quantized);
+
+// Copy NetParameters with the trained weights of every Convolution and
+// InnerProduct layer stored as 16-bit half_data in format, which halves their
+// size on disk and, as Blob<float> keeps them in 16 bits, in memory.  These
+// are the layers whose CPU GEMM reads 16-bit weights; convolutions with
+// another engine than CAFFE and INT8 layers keep float weights, as do
+// weights beyond the FLOAT16 range.  Run it after the passes above, which
+// read float blobs.  Returns the number of blobs stored.
+int StoreWeightsAsHalf(const NetParameter& param, const HalfFormat format,
+    NetParameter* param_half);
+
+// Copy NetParameters with the image layers that have a channels-last CPU
+// implementation switched to NHWC blobs: 2-D Convolution, ConvolutionDepthwise
+// and MAX or AVE Pooling layers, and, when all their inputs are NHWC already,
+// BatchNorm (with global statistics), Scale, Bias, Concat, ShuffleChannel,
+// Eltwise and pointwise activation layers.  NHWC blobs are named after their
+// NCHW counterparts with an "_nhwc" suffix, and Transpose layers convert the
+// blobs at the boundaries of the NHWC regions, including the net outputs,
+// which keep their names and layout.  The converted net only supports
+// Forward.  Returns the number of layers converted.
+int ConvertToChannelsLast(const NetParameter& param,
+    NetParameter* param_nhwc);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_INFERENCE_OPTIMIZER_HPP_
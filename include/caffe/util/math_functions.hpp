@@ -100,6 +100,13 @@ void caffe_log(const int n, const Dtype* a, Dtype* y);
 template <typename Dtype>
 void caffe_abs(const int n, const Dtype* a, Dtype* y);
 
+// y[i] = 1 / (1 + exp(-a[i]))
+template <typename Dtype>
+void caffe_sigmoid(const int n, const Dtype* a, Dtype* y);
+
+template <typename Dtype>
+void caffe_tanh(const int n, const Dtype* a, Dtype* y);
+
 template <typename Dtype>
 Dtype caffe_cpu_dot(const int n, const Dtype* x, const Dtype* y);
 
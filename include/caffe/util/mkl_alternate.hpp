@@ -17,6 +17,8 @@ extern "C" {
 
 #include <math.h>
 
+#include "caffe/util/simd_math.hpp"
+
 // Functions that caffe uses but are not present if MKL is not linked.
 
 // A simple way to define the vsl unary functions. The operation should
@@ -36,15 +38,34 @@ extern "C" {
     v##name<double>(n, a, y); \
   }
 
+// The same, with the single precision version computed by a SIMD kernel of
+// caffe/util/simd_math.hpp.
+#define DEFINE_VSL_UNARY_FUNC_SIMD(name, operation, simd_func) \
+  template<typename Dtype> \
+  void v##name(const int n, const Dtype* a, Dtype* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
+    for (int i = 0; i < n; ++i) { operation; } \
+  } \
+  inline void vs##name( \
+    const int n, const float* a, float* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
+    caffe::simd_func(n, a, y); \
+  } \
+  inline void vd##name( \
+      const int n, const double* a, double* y) { \
+    v##name<double>(n, a, y); \
+  }
+
 DEFINE_VSL_UNARY_FUNC(Sqr, y[i] = a[i] * a[i])
-DEFINE_VSL_UNARY_FUNC(Sqrt, y[i] = sqrt(a[i]))
-DEFINE_VSL_UNARY_FUNC(Exp, y[i] = exp(a[i]))
-DEFINE_VSL_UNARY_FUNC(Ln, y[i] = log(a[i]))
+DEFINE_VSL_UNARY_FUNC_SIMD(Sqrt, y[i] = sqrt(a[i]), simd_sqrt)
+DEFINE_VSL_UNARY_FUNC_SIMD(Exp, y[i] = exp(a[i]), simd_exp)
+DEFINE_VSL_UNARY_FUNC_SIMD(Ln, y[i] = log(a[i]), simd_log)
 DEFINE_VSL_UNARY_FUNC(Abs, y[i] = fabs(a[i]))
 
 // A simple way to define the vsl unary functions with singular parameter b.
-// The operation should be in the form e.g. y[i] = pow(a[i], b)
-#define DEFINE_VSL_UNARY_FUNC_WITH_PARAM(name, operation) \
+// The operation should be in the form e.g. y[i] = pow(a[i], b), and the
+// single precision version is computed by simd_func.
+#define DEFINE_VSL_UNARY_FUNC_WITH_PARAM(name, operation, simd_func) \
   template<typename Dtype> \
   void v##name(const int n, const Dtype* a, const Dtype b, Dtype* y) { \
     CHECK_GT(n, 0); CHECK(a); CHECK(y); \
@@ -52,14 +73,15 @@ DEFINE_VSL_UNARY_FUNC(Abs, y[i] = fabs(a[i]))
   } \
   inline void vs##name( \
     const int n, const float* a, const float b, float* y) { \
-    v##name<float>(n, a, b, y); \
+    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
+    caffe::simd_func(n, a, b, y); \
   } \
   inline void vd##name( \
       const int n, const double* a, const float b, double* y) { \
     v##name<double>(n, a, b, y); \
   }
 
-DEFINE_VSL_UNARY_FUNC_WITH_PARAM(Powx, y[i] = pow(a[i], b))
+DEFINE_VSL_UNARY_FUNC_WITH_PARAM(Powx, y[i] = pow(a[i], b), simd_powx)
 
 // A simple way to define the vsl binary functions. The operation should
 // be in the form e.g. y[i] = a[i] + b[i]
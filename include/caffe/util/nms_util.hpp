@@ -2,13 +2,43 @@
 #define _CAFFE_UTIL_NMS_UTIL_HPP_
 
 namespace caffe {
+
+/// How NMS measures the overlap of two boxes: the intersection over their
+/// union, or over the larger of the two (as MTCNN merges faces).
+enum NMSOverlap { NMS_IOU = 0, NMS_IOM = 1 };
+
+/// The overlap of boxes (x1, y1, x2, y2) whose corners are inclusive pixel
+/// coordinates; boxes that do not meet overlap by 0.
 template <typename Dtype>
 Dtype IoU(const Dtype* A, const Dtype* B);
 
+template <typename Dtype>
+Dtype IoM(const Dtype* A, const Dtype* B);
+
+/**
+ * @brief Greedy non-maximum suppression of boxes sorted by decreasing score.
+ *
+ * Box i is (x1, y1, x2, y2) at boxes + i * box_step. A box is kept unless a
+ * kept box before it overlaps it by more than nms_thresh; base_index + i of
+ * the first max_num_out kept boxes (all of them if max_num_out <= 0) go to
+ * index_out, and their number to num_out.
+ *
+ * The boxes are taken a block of rows at a time: the overlaps of the rows
+ * with all the later boxes are computed as bitmasks in parallel, 64
+ * candidates per word with SIMD where the CPU has it, and then resolved in
+ * order, so the work stops with the block that keeps the last box.
+ */
+template <typename Dtype>
+void NMSSorted(const Dtype* boxes, const int num_boxes, const int box_step,
+               int* index_out, int* num_out, const int base_index,
+               const Dtype nms_thresh, const int max_num_out,
+               const NMSOverlap overlap = NMS_IOU);
+
+/// NMSSorted of proposals (x1, y1, x2, y2, score) by IoU.
 template <typename Dtype>
 void NMS(const Dtype* boxes, const int num_boxes, int* index_out, int* num_out,
          const int base_index, const Dtype nms_thresh, const int max_num_out);
 
 }  // namespace caffe
 
-#endif  //_CAFFE_UTIL_NMS_UTIL_HPP_
\ No newline at end of file
+#endif  //_CAFFE_UTIL_NMS_UTIL_HPP_
@@ -0,0 +1,97 @@
+#ifndef CAFFE_UTIL_QUANTIZATION_HPP_
+#define CAFFE_UTIL_QUANTIZATION_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+template <typename Dtype> class Net;
+
+/**
+ * @brief C = A B^T for int8 A (M x K) and uint8 B (N x K), both row-major
+ *        with rows lda and ldb apart, into int32 C (M x N).
+ *
+ * Products are summed exactly in 32 bits. The columns of C are split over
+ * Caffe::num_threads() threads, and AVX2 is used when cpu_isa() allows.
+ */
+void caffe_cpu_int8_gemm(const int M, const int N, const int K,
+    const int8_t* A, const int lda, const uint8_t* B, const int ldb,
+    int32_t* C);
+
+/**
+ * @brief The INT8 engine of a Convolution or InnerProduct layer whose
+ *        quantization_param has precision INT8.
+ *
+ * The weights are quantized to int8 with one symmetric scale per output
+ * channel, the first time they are used and whenever they change. The input
+ * is quantized to uint8 over the calibrated [input_min, input_max] range,
+ * multiplied with an int8 x uint8 -> int32 GEMM, and the products are scaled
+ * back to Dtype. Quantization thus happens at the layer boundary, and the
+ * blobs between layers stay in floating point.
+ */
+template <typename Dtype>
+class QuantizedGemm {
+ public:
+  explicit QuantizedGemm(const LayerParameter& param);
+
+  inline bool enabled() const { return enabled_; }
+
+  /**
+   * @brief output = W input for the M rows of weights from row_begin on,
+   *        where weights holds one row of K = weights.count(1) values per
+   *        output channel.
+   *
+   * input is K x N and output M x N; with transposed, input is N x K and
+   * output N x M instead, as for an InnerProduct layer.
+   */
+  void Forward_cpu(const Blob<Dtype>& weights, const int row_begin,
+      const int M, const int N, const Dtype* input, const bool transposed,
+      Dtype* output);
+
+ private:
+  void QuantizeWeights(const Blob<Dtype>& weights);
+  void QuantizeInput(const int N, const int K, const Dtype* input,
+      const bool transposed);
+
+  bool enabled_;
+  float input_scale_;
+  int input_zero_point_;
+  /// K rounded up to the rows of the quantized operands.
+  int padded_k_;
+  vector<int8_t> weights_;
+  vector<float> weight_scales_;
+  /// The sum of each row of weights_, to remove the input zero point.
+  vector<int32_t> weight_sums_;
+  /// The weights weights_ was quantized from.
+  const SyncedMemory* weight_memory_;
+  size_t weight_version_;
+  vector<uint8_t> input_;
+  vector<int32_t> output_;
+};
+
+/// The minimum and maximum value of each blob, by blob name.
+typedef std::map<string, std::pair<float, float> > BlobRanges;
+
+/**
+ * @brief Widen the ranges of every blob of net to include the values of its
+ *        last forward pass, for calibrating INT8 inference.
+ *
+ * Blobs hold the values of their last writer, so the net should not share
+ * blob memory (optimize_memory); layers computed in place are fine, as the
+ * layers after them read the same values.
+ */
+template <typename Dtype>
+void UpdateBlobRanges(const Net<Dtype>& net, BlobRanges* ranges);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_QUANTIZATION_HPP_
@@ -0,0 +1,99 @@
+#ifndef CAFFE_UTIL_ROI_ALIGN_HPP_
+#define CAFFE_UTIL_ROI_ALIGN_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A sample of an ROIAlign bin along one axis: its position and the
+ *        pixels floor(position) and ceil(position) with their bilinear
+ *        weights. A pixel outside the feature map has index 0 and weight 0.
+ */
+template <typename Dtype>
+struct ROIAlignTap {
+  Dtype position;
+  int lo;
+  int hi;
+  Dtype lo_weight;
+  Dtype hi_weight;
+};
+
+/**
+ * @brief The bilinear samples of the pooled bins of an ROI, computed once
+ *        per ROI and shared by all its channels on the CPU.
+ *
+ * The samples follow the CUDA kernels of ROIAlignLayer and
+ * ROIMaskAlignLayer: bin p of [roi_start, roi_end] is clipped to the
+ * feature map and sampled every pixel from its start, and a bin pools the
+ * largest of its samples. Both pixels of a sample at a whole position get
+ * full weight, as in those kernels. The samples of bin (ph, pw) are the h
+ * taps [h_bins[ph], h_bins[ph + 1]) times the w taps
+ * [w_bins[pw], w_bins[pw + 1]).
+ */
+template <typename Dtype>
+class ROIAlignBins {
+ public:
+  ROIAlignBins() : masked_(false) {}
+
+  void Init(Dtype roi_start_h, Dtype roi_end_h, Dtype roi_start_w,
+            Dtype roi_end_w, int pooled_height, int pooled_width,
+            int height, int width);
+  /// @brief Samples inside [start_h, end_h] x [start_w, end_w] pool as 0.
+  void SetMask(Dtype start_h, Dtype end_h, Dtype start_w, Dtype end_w);
+
+  /// @brief The largest sample of bin (ph, pw) of a channel, and the
+  ///        truncated position of that sample, or 0 and -1 for an empty bin.
+  Dtype Max(int ph, int pw, const Dtype* data, int width, int* argmax_x,
+            int* argmax_y) const;
+  /// @brief Add diff, the gradient of bin (ph, pw) that Max returned
+  ///        argmax_x and argmax_y for, to the pixels of that sample.
+  void Backward(int ph, int pw, int argmax_x, int argmax_y, Dtype diff,
+                int width, Dtype* bottom_diff) const;
+
+ private:
+  inline bool Masked(const ROIAlignTap<Dtype>& y,
+                     const ROIAlignTap<Dtype>& x) const {
+    return masked_ && x.position >= mask_start_w_ &&
+           x.position <= mask_end_w_ && y.position >= mask_start_h_ &&
+           y.position <= mask_end_h_;
+  }
+
+  vector<ROIAlignTap<Dtype> > h_taps_;
+  vector<ROIAlignTap<Dtype> > w_taps_;
+  vector<int> h_bins_;
+  vector<int> w_bins_;
+  bool masked_;
+  Dtype mask_start_h_;
+  Dtype mask_end_h_;
+  Dtype mask_start_w_;
+  Dtype mask_end_w_;
+};
+
+/**
+ * @brief Pool channels x bins[n] of the image of each ROI n of bottom_rois,
+ *        rows of (batch index, x1, y1, x2, y2), into top_data, in parallel
+ *        over ROIs and channels.
+ */
+template <typename Dtype>
+void roi_align_forward_cpu(const vector<ROIAlignBins<Dtype> >& bins,
+    const Dtype* bottom_data, const Dtype* bottom_rois, const int channels,
+    const int height, const int width, const int pooled_height,
+    const int pooled_width, Dtype* top_data, int* argmax_x, int* argmax_y);
+
+/**
+ * @brief Add the gradient of roi_align_forward_cpu to bottom_diff, in
+ *        parallel over channels.
+ */
+template <typename Dtype>
+void roi_align_backward_cpu(const vector<ROIAlignBins<Dtype> >& bins,
+    const Dtype* top_diff, const int* argmax_x, const int* argmax_y,
+    const Dtype* bottom_rois, const int channels, const int height,
+    const int width, const int pooled_height, const int pooled_width,
+    Dtype* bottom_diff);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ROI_ALIGN_HPP_
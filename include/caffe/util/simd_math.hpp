@@ -0,0 +1,34 @@
+#ifndef CAFFE_UTIL_SIMD_MATH_HPP_
+#define CAFFE_UTIL_SIMD_MATH_HPP_
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * Elementwise single precision transcendentals, evaluated with Cephes-style
+ * polynomials on AVX2 or SSE2 (whichever cpu_isa() allows). Inputs outside
+ * the range of a polynomial (overflow, denormals, negative logarithms, NaN,
+ * ...) are passed to the libm function instead, so results only differ from
+ * libm by rounding. Maximum errors over normal results, in units in the last
+ * place, are given with each function. y may alias a.
+ */
+
+/// @brief y = exp(a); 1 ulp.
+CAFFE_API void simd_exp(int n, const float* a, float* y);
+/// @brief y = log(a); 1 ulp.
+CAFFE_API void simd_log(int n, const float* a, float* y);
+/// @brief y = pow(a, b); for a > 0 the error grows as (2 + 2 |b log(a)|)
+///        ulp. Squares, square roots and reciprocals are correctly rounded,
+///        and b = -0.5 is within 1 ulp.
+CAFFE_API void simd_powx(int n, const float* a, float b, float* y);
+/// @brief y = sqrt(a); correctly rounded.
+CAFFE_API void simd_sqrt(int n, const float* a, float* y);
+/// @brief y = tanh(a); 3 ulp.
+CAFFE_API void simd_tanh(int n, const float* a, float* y);
+/// @brief y = 1 / (1 + exp(-a)); 3 ulp.
+CAFFE_API void simd_sigmoid(int n, const float* a, float* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SIMD_MATH_HPP_
@@ -0,0 +1,86 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief The intra-op thread pool shared by the CPU kernels.
+ *
+ * Run() splits one operation into tasks and executes them on the calling
+ * thread and on pool workers; it returns when all tasks are done. Workers
+ * are created on demand and live until the process exits. Several threads
+ * may call Run() at the same time, e.g. one per inference session; a Run()
+ * issued from inside a task executes serially on the calling worker.
+ */
+class CAFFE_API ThreadPool {
+ public:
+  /// @brief The process-wide pool.
+  static ThreadPool& Global();
+
+  /**
+   * @brief Call task(i) for every i in [0, num_tasks), on up to num_tasks
+   *        threads including the caller. An exception thrown by a task is
+   *        rethrown here once all tasks have finished.
+   */
+  void Run(int num_tasks, const std::function<void(int)>& task);
+
+  /// @brief The number of worker threads created so far.
+  int num_workers();
+  /// @brief Whether the calling thread is executing a task of some Run().
+  static bool in_task();
+
+ private:
+  struct Job;
+
+  ThreadPool() {}
+  void AddWorkers(int num_workers);
+  void WorkerLoop();
+  static void Execute(Job* job);
+
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::deque<Job*> jobs_;
+  std::vector<std::thread> workers_;
+
+  DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+/// Work, in inner loop iterations, below which a task does not pay for its
+/// scheduling; loops derive their parallel_for grain from it.
+const int kMinParallelWork = 1 << 15;
+
+/// @brief The number of tasks parallel_for splits n elements into.
+CAFFE_API int parallel_for_tasks(int n, int grain);
+
+/**
+ * @brief Call fn(begin, end) on disjoint ranges covering [0, n), using up
+ *        to Caffe::num_threads() threads and ranges of at least grain
+ *        elements. Small loops run inline on the calling thread.
+ */
+template <typename F>
+inline void parallel_for(int n, int grain, const F& fn) {
+  const int num_tasks = n > grain ? parallel_for_tasks(n, grain) : 1;
+  if (num_tasks <= 1) {
+    if (n > 0) {
+      fn(0, n);
+    }
+    return;
+  }
+  ThreadPool::Global().Run(num_tasks, [&](int task) {
+    fn(static_cast<int>(static_cast<int64_t>(n) * task / num_tasks),
+       static_cast<int>(static_cast<int64_t>(n) * (task + 1) / num_tasks));
+  });
+}
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/batching_engine.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+BatchingEngine<Dtype>::BatchingEngine(
+    const shared_ptr<InferenceModel<Dtype> >& model,
+    const BatchingParameter& param)
+    : model_(model), param_(param), mode_(Caffe::mode()), device_(-1),
+      stop_(false), num_batches_(0), started_(false) {
+  CHECK(model_);
+  CHECK_GT(param_.max_batch_size(), 0);
+  CHECK_GT(param_.num_workers(), 0);
+  CHECK_EQ(model_->net().num_inputs(), 1)
+      << "BatchingEngine needs a net with exactly one input.";
+#ifdef USE_CUDA
+  if (mode_ == Caffe::GPU) {
+    CUDA_CHECK(cudaGetDevice(&device_));
+  }
+#endif
+  for (int i = 0; i < param_.num_workers(); ++i) {
+    sessions_.push_back(model_->NewSession());
+  }
+  for (int i = 0; i < param_.num_workers(); ++i) {
+    workers_.push_back(
+        std::thread(&BatchingEngine<Dtype>::WorkerEntry, this, i));
+  }
+}
+
+template <typename Dtype>
+BatchingEngine<Dtype>::~BatchingEngine() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  for (int i = 0; i < workers_.size(); ++i) {
+    workers_[i].join();
+  }
+}
+
+template <typename Dtype>
+std::future<typename BatchingEngine<Dtype>::Outputs>
+BatchingEngine<Dtype>::Submit(const Blob<Dtype>& sample) {
+  CHECK_GE(sample.num_axes(), 1);
+  CHECK_EQ(sample.shape(0), 1) << "Submit takes one sample at a time.";
+  shared_ptr<Request> request(new Request());
+  request->shape = sample.shape();
+  request->data.assign(sample.cpu_data(), sample.cpu_data() + sample.count());
+  request->submitted = Clock::now();
+  std::future<Outputs> outputs = request->outputs.get_future();
+  {
+    std::unique_lock<std::mutex> lock(stats_mutex_);
+    if (!started_) {
+      started_ = true;
+      first_submitted_ = request->submitted;
+    }
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    CHECK(!stop_) << "Submit called on a stopped BatchingEngine.";
+    queue_.push_back(request);
+  }
+  cond_.notify_all();
+  return outputs;
+}
+
+template <typename Dtype>
+void BatchingEngine<Dtype>::WorkerEntry(const int worker_id) {
+  // Caffe state is per thread.
+  Caffe::set_mode(mode_);
+  if (device_ >= 0) {
+    Caffe::SetDevice(device_);
+  }
+  vector<shared_ptr<Request> > batch;
+  while (NextBatch(&batch)) {
+    RunBatch(sessions_[worker_id].get(), batch);
+  }
+}
+
+template <typename Dtype>
+bool BatchingEngine<Dtype>::NextBatch(vector<shared_ptr<Request> >* batch) {
+  batch->clear();
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+  if (queue_.empty()) {
+    return false;
+  }
+  // Requests are batched in arrival order, up to the first of another shape.
+  const int max_batch_size = param_.max_batch_size();
+  int batch_size = 0;
+  while (true) {
+    if (queue_.empty()) {
+      // Another worker took the batch we were waiting for.
+      cond_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return false;
+      }
+    }
+    batch_size = 1;
+    while (batch_size < queue_.size() && batch_size < max_batch_size &&
+           queue_[batch_size]->shape == queue_.front()->shape) {
+      ++batch_size;
+    }
+    const Clock::time_point deadline = queue_.front()->submitted +
+        std::chrono::microseconds(param_.max_delay_us());
+    const bool full = batch_size == max_batch_size ||
+        batch_size < queue_.size();
+    if (full || stop_ || Clock::now() >= deadline) {
+      break;
+    }
+    cond_.wait_until(lock, deadline);
+  }
+  batch->assign(queue_.begin(), queue_.begin() + batch_size);
+  queue_.erase(queue_.begin(), queue_.begin() + batch_size);
+  return true;
+}
+
+template <typename Dtype>
+void BatchingEngine<Dtype>::RunBatch(Net<Dtype>* session,
+    const vector<shared_ptr<Request> >& batch) {
+  const int batch_size = batch.size();
+  Blob<Dtype>* input = session->input_blobs()[0];
+  vector<int> shape = batch[0]->shape;
+  shape[0] = batch_size;
+  if (input->shape() != shape) {
+    input->Reshape(shape);
+    session->Reshape();
+  }
+  const int sample_count = input->count(1);
+  Dtype* input_data = input->mutable_cpu_data();
+  for (int i = 0; i < batch_size; ++i) {
+    caffe_copy(sample_count, batch[i]->data.data(),
+               input_data + i * sample_count);
+  }
+  const vector<Blob<Dtype>*>& net_outputs = session->Forward();
+  vector<Outputs> outputs(batch_size);
+  for (int j = 0; j < net_outputs.size(); ++j) {
+    const Blob<Dtype>* output = net_outputs[j];
+    CHECK_GE(output->num_axes(), 1);
+    CHECK_EQ(output->shape(0), batch_size) << "Output " << j
+        << " of the net does not have the batch as its first axis.";
+    vector<int> output_shape = output->shape();
+    output_shape[0] = 1;
+    const int output_count = output->count(1);
+    for (int i = 0; i < batch_size; ++i) {
+      shared_ptr<Blob<Dtype> > slice(new Blob<Dtype>(output_shape));
+      caffe_copy(output_count, output->cpu_data() + i * output_count,
+                 slice->mutable_cpu_data());
+      outputs[i].push_back(slice);
+    }
+  }
+  const Clock::time_point completed = Clock::now();
+  {
+    std::unique_lock<std::mutex> lock(stats_mutex_);
+    for (int i = 0; i < batch_size; ++i) {
+      latencies_.push_back(std::chrono::duration<double, std::milli>(
+          completed - batch[i]->submitted).count());
+    }
+    ++num_batches_;
+    last_completed_ = completed;
+  }
+  for (int i = 0; i < batch_size; ++i) {
+    batch[i]->outputs.set_value(outputs[i]);
+  }
+}
+
+template <typename Dtype>
+typename BatchingEngine<Dtype>::Stats BatchingEngine<Dtype>::stats() const {
+  std::unique_lock<std::mutex> lock(stats_mutex_);
+  Stats stats = Stats();
+  stats.num_requests = latencies_.size();
+  stats.num_batches = num_batches_;
+  if (latencies_.empty()) {
+    return stats;
+  }
+  stats.mean_batch_size = double(stats.num_requests) / num_batches_;
+  const double seconds = std::chrono::duration<double>(
+      last_completed_ - first_submitted_).count();
+  stats.throughput = seconds > 0 ? stats.num_requests / seconds : 0;
+  vector<double> sorted(latencies_);
+  std::sort(sorted.begin(), sorted.end());
+  double sum = 0;
+  for (int i = 0; i < sorted.size(); ++i) {
+    sum += sorted[i];
+  }
+  stats.mean_latency = sum / sorted.size();
+  stats.p50_latency = sorted[(sorted.size() - 1) * 50 / 100];
+  stats.p95_latency = sorted[(sorted.size() - 1) * 95 / 100];
+  stats.p99_latency = sorted[(sorted.size() - 1) * 99 / 100];
+  stats.max_latency = sorted.back();
+  return stats;
+}
+
+template <typename Dtype>
+void BatchingEngine<Dtype>::ResetStats() {
+  std::unique_lock<std::mutex> lock(stats_mutex_);
+  latencies_.clear();
+  num_batches_ = 0;
+  started_ = false;
+}
+
+INSTANTIATE_CLASS(BatchingEngine);
+
+}  // namespace caffe
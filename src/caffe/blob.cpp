@@ -91,7 +91,7 @@ void Blob<Dtype>::set_cpu_data(Dtype* data) {
   CHECK(data);
   // Make sure CPU and GPU sizes remain equal
   size_t size = count_ * sizeof(Dtype);
-  if (data_->size() != size) {
+  if (data_->size() != size || data_->is_view()) {
     data_.reset(new SyncedMemory(size));
     diff_.reset(new SyncedMemory(size));
   }
@@ -109,7 +109,7 @@ void Blob<Dtype>::set_gpu_data(Dtype* data) {
   CHECK(data);
   // Make sure CPU and GPU sizes remain equal
   size_t size = count_ * sizeof(Dtype);
-  if (data_->size() != size) {
+  if (data_->size() != size || data_->is_view()) {
     data_.reset(new SyncedMemory(size));
     diff_.reset(new SyncedMemory(size));
   }
@@ -164,6 +164,45 @@ void Blob<Dtype>::ShareDiff(const Blob& other) {
   diff_ = other.diff();
 }
 
+template <typename Dtype>
+void Blob<Dtype>::ShareDataMemory(const shared_ptr<SyncedMemory>& data) {
+  CHECK(data);
+  CHECK_GE(data->size(), count_ * sizeof(Dtype));
+  data_ = data;
+  // Any growth must reallocate rather than write past the shared buffer.
+  capacity_ = count_;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ShareDataView(const Blob& other, int offset) {
+  CHECK_GE(offset, 0);
+  CHECK_LE(offset + count_, other.count());
+  data_.reset(new SyncedMemory(other.data(), offset * sizeof(Dtype),
+                               count_ * sizeof(Dtype)));
+  capacity_ = count_;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ShareDiffView(const Blob& other, int offset) {
+  CHECK_GE(offset, 0);
+  CHECK_LE(offset + count_, other.count());
+  diff_.reset(new SyncedMemory(other.diff(), offset * sizeof(Dtype),
+                               count_ * sizeof(Dtype)));
+  capacity_ = count_;
+}
+
+template <typename Dtype>
+bool Blob<Dtype>::DataIsViewOf(const Blob& other, int offset) const {
+  return data_ && data_->parent() == other.data() &&
+      data_->offset() == offset * sizeof(Dtype);
+}
+
+template <typename Dtype>
+bool Blob<Dtype>::DiffIsViewOf(const Blob& other, int offset) const {
+  return diff_ && diff_->parent() == other.diff() &&
+      diff_->offset() == offset * sizeof(Dtype);
+}
+
 // The "update" method is used for parameter blobs in a Net, which are stored
 // as Blob<float> or Blob<double> -- hence we do not define it for
 // Blob<int> or Blob<unsigned int>.
@@ -491,6 +530,22 @@ void Blob<Dtype>::CopyFrom(const Blob& source, bool copy_diff, bool reshape) {
   }
 }
 
+// Blob<float> keeps 16-bit values as they are; other types widen them.
+template <typename Dtype>
+void CopyHalfData(const uint16_t* half, int count, HalfFormat format,
+                  Blob<Dtype>* blob) {
+  Dtype* data = blob->mutable_cpu_data();
+  for (int i = 0; i < count; ++i) {
+    data[i] = half_to_float(half[i], format);
+  }
+}
+
+template <>
+void CopyHalfData(const uint16_t* half, int count, HalfFormat format,
+                  Blob<float>* blob) {
+  blob->data()->set_half_data(half, count, format);
+}
+
 template <typename Dtype>
 void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
   if (reshape) {
@@ -515,14 +570,19 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
     CHECK(ShapeEquals(proto)) << "shape mismatch (reshape not set)";
   }
   // copy data
-  Dtype* data_vec = mutable_cpu_data();
-  if (proto.double_data_size() > 0) {
+  if (!proto.half_data().empty()) {
+    CHECK_EQ(count_ * sizeof(uint16_t), proto.half_data().size());
+    CopyHalfData(reinterpret_cast<const uint16_t*>(proto.half_data().data()),
+                 count_, static_cast<HalfFormat>(proto.half_format()), this);
+  } else if (proto.double_data_size() > 0) {
     CHECK_EQ(count_, proto.double_data_size());
+    Dtype* data_vec = mutable_cpu_data();
     for (int i = 0; i < count_; ++i) {
       data_vec[i] = proto.double_data(i);
     }
   } else {
     CHECK_EQ(count_, proto.data_size());
+    Dtype* data_vec = mutable_cpu_data();
     for (int i = 0; i < count_; ++i) {
       data_vec[i] = proto.data(i);
     }
@@ -542,6 +602,17 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
   }
 }
 
+template <typename Dtype>
+void Blob<Dtype>::StoreDataAsHalf(HalfFormat format) {
+  NOT_IMPLEMENTED;
+}
+
+template <>
+void Blob<float>::StoreDataAsHalf(HalfFormat format) {
+  CHECK(data_);
+  data_->to_half(format);
+}
+
 template <>
 void Blob<double>::ToProto(BlobProto* proto, bool write_diff) const {
   proto->clear_shape();
@@ -550,6 +621,7 @@ void Blob<double>::ToProto(BlobProto* proto, bool write_diff) const {
   }
   proto->clear_double_data();
   proto->clear_double_diff();
+  proto->clear_half_data();
   const double* data_vec = cpu_data();
   for (int i = 0; i < count_; ++i) {
     proto->add_double_data(data_vec[i]);
@@ -570,9 +642,16 @@ void Blob<float>::ToProto(BlobProto* proto, bool write_diff) const {
   }
   proto->clear_data();
   proto->clear_diff();
-  const float* data_vec = cpu_data();
-  for (int i = 0; i < count_; ++i) {
-    proto->add_data(data_vec[i]);
+  proto->clear_half_data();
+  if (half_data()) {
+    proto->set_half_data(half_data(), count_ * sizeof(uint16_t));
+    proto->set_half_format(
+        static_cast<BlobProto_HalfFormat>(data_->half_format()));
+  } else {
+    const float* data_vec = cpu_data();
+    for (int i = 0; i < count_; ++i) {
+      proto->add_data(data_vec[i]);
+    }
   }
   if (write_diff) {
     const float* diff_vec = cpu_diff();
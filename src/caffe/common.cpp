@@ -1,10 +1,15 @@
 #include <caffe/logging.hpp>
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <ctime>
+#include <thread>
 #include "caffe/common.hpp"
 #include "caffe/util/rng.hpp"
 
+CAFFE_DEFINE_int(num_threads, 1,
+    "Threads used by the CPU layers of each net; 0 uses one per core.");
+
 namespace caffe {
 
 // Make sure each thread can have different values.
@@ -17,6 +22,17 @@ Caffe& Caffe::Get() {
   return *(thread_instance_.get());
 }
 
+int Caffe::num_threads() {
+  const int num_threads =
+      Get().num_threads_ >= 0 ? Get().num_threads_ : FLAGS_num_threads;
+  if (num_threads > 0) {
+    return num_threads;
+  }
+  static const int num_cores =
+      std::max<int>(std::thread::hardware_concurrency(), 1);
+  return num_cores;
+}
+
 // random seeding
 int64_t cluster_seedgen(void) {
   std::random_device rd;
@@ -44,7 +60,8 @@ Caffe::Caffe()
       mode_(Caffe::CPU),
       solver_count_(1),
       solver_rank_(0),
-      multiprocess_(false) {}
+      multiprocess_(false),
+      num_threads_(-1) {}
 
 Caffe::~Caffe() {}
 
@@ -97,7 +114,8 @@ Caffe::Caffe()
       mode_(Caffe::CPU),
       solver_count_(1),
       solver_rank_(0),
-      multiprocess_(false) {
+      multiprocess_(false),
+      num_threads_(-1) {
   // Try to create a cublas handler, and report an error if failed (but we will
   // keep the program running as one might just want to run CPU code).
   if (cublasCreate(&cublas_handle_) != CUBLAS_STATUS_SUCCESS) {
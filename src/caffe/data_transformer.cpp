@@ -3,6 +3,7 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #endif  // USE_OPENCV
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -10,6 +11,7 @@
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -296,13 +298,16 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
   CHECK(cv_cropped_img.data);
 
   Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  int top_index;
+  // Rows are converted in parallel.
+  const int grain = std::max(1, kMinParallelWork / (width * img_channels));
   if (data_mean_.width() == img_width && data_mean_.height() == img_height) {
-    for (int h = 0; h < height; ++h) {
+    parallel_for(height, grain, [&](int h_begin, int h_end) {
+    for (int h = h_begin; h < h_end; ++h) {
       const uchar* ptr = cv_cropped_img.ptr<uchar>(h);
       int img_index = 0;
       for (int w = 0; w < width; ++w) {
         for (int c = 0; c < img_channels; ++c) {
+          int top_index;
           if (do_mirror) {
             top_index = (c * height + h) * width + (width - 1 - w);
           } else {
@@ -324,12 +329,15 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
         }
       }
     }
+    });
   } else {
-    for (int h = 0; h < height; ++h) {
+    parallel_for(height, grain, [&](int h_begin, int h_end) {
+    for (int h = h_begin; h < h_end; ++h) {
       const uchar* ptr = cv_cropped_img.ptr<uchar>(h);
       int img_index = 0;
       for (int w = 0; w < width; ++w) {
         for (int c = 0; c < img_channels; ++c) {
+          int top_index;
           if (do_mirror) {
             top_index = (c * height + h) * width + (width - 1 - w);
           } else {
@@ -350,6 +358,7 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
         }
       }
     }
+    });
   }
 }
 #endif  // USE_OPENCV
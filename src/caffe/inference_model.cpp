@@ -0,0 +1,81 @@
+#include <string>
+#include <vector>
+
+#include "caffe/inference_model.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+InferenceModel<Dtype>::InferenceModel(const string& param_file,
+    const string& trained_file, const int level,
+    const vector<string>* stages) {
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(param_file, &param);
+  param.mutable_state()->set_phase(TEST);
+  if (stages != NULL) {
+    for (int i = 0; i < stages->size(); i++) {
+      param.mutable_state()->add_stage((*stages)[i]);
+    }
+  }
+  param.mutable_state()->set_level(level);
+  Init(param, trained_file);
+}
+
+template <typename Dtype>
+InferenceModel<Dtype>::InferenceModel(const NetParameter& param,
+    const string& trained_file) {
+  Init(param, trained_file);
+}
+
+template <typename Dtype>
+void InferenceModel<Dtype>::Init(const NetParameter& param,
+    const string& trained_file) {
+  NetParameter store_param(param);
+  store_param.set_forward_only(true);
+  store_param.set_force_backward(false);
+  // Sessions inherit this through session_param_, so each packs the shared
+  // weights once for its CPU forward passes.
+  store_param.set_prepack_weights(true);
+  net_.reset(new Net<Dtype>(store_param));
+  if (!trained_file.empty()) {
+    net_->CopyTrainedLayersFrom(trained_file);
+  }
+  // Bring the weights to where sessions will read them now, so that
+  // concurrent sessions never race to synchronize them. On the CPU, weights
+  // held in 16 bits stay so; widening them takes a lock. Copying them to the
+  // GPU does not, so they are widened and copied here too.
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net_->layers();
+  for (int i = 0; i < layers.size(); ++i) {
+    for (int j = 0; j < layers[i]->blobs().size(); ++j) {
+      if (Caffe::mode() == Caffe::GPU) {
+        layers[i]->blobs()[j]->gpu_data();
+      } else if (!layers[i]->blobs()[j]->half_data()) {
+        layers[i]->blobs()[j]->cpu_data();
+      }
+    }
+  }
+  // Sessions are built from the layers as the store net set them up, after
+  // filtering, split insertion and fusion; those steps are not repeated.
+  session_param_.CopyFrom(store_param);
+  session_param_.clear_layer();
+  session_param_.clear_layers();
+  session_param_.clear_input();
+  session_param_.clear_input_shape();
+  session_param_.clear_input_dim();
+  session_param_.set_fuse_activations(false);
+  for (int i = 0; i < layers.size(); ++i) {
+    LayerParameter* layer_param = session_param_.add_layer();
+    layer_param->CopyFrom(layers[i]->layer_param());
+    layer_param->clear_blobs();
+  }
+}
+
+template <typename Dtype>
+shared_ptr<Net<Dtype> > InferenceModel<Dtype>::NewSession() const {
+  return shared_ptr<Net<Dtype> >(new Net<Dtype>(session_param_, net_.get()));
+}
+
+INSTANTIATE_CLASS(InferenceModel);
+
+}  // namespace caffe
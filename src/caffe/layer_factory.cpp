@@ -4,6 +4,8 @@
 
 #include "caffe/layer.hpp"
 #include "caffe/layer_factory.hpp"
+#include "caffe/layers/channels_last_conv_layer.hpp"
+#include "caffe/layers/conv_dw_layer.hpp"
 #include "caffe/layers/conv_layer.hpp"
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/layers/pooling_layer.hpp"
@@ -11,6 +13,7 @@
 #include "caffe/layers/sigmoid_layer.hpp"
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/layers/tanh_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 
 #ifdef USE_CUDNN
@@ -29,6 +32,10 @@ namespace caffe {
 // Get convolution layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetConvolutionLayer(const LayerParameter& param) {
+  if (param.layout() == NHWC) {
+    return shared_ptr<Layer<Dtype> >(
+        new ChannelsLastConvolutionLayer<Dtype>(param));
+  }
   ConvolutionParameter conv_param = param.convolution_param();
   ConvolutionParameter_Engine engine = conv_param.engine();
 #ifdef USE_CUDNN
@@ -38,23 +45,33 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(const LayerParameter& param) {
       use_dilation = true;
     }
   }
+  // CuDNN has no fused activation epilogue.
+  const bool use_fused_activation = param.fused_activation_param().type() !=
+      FusedActivationParameter_Type_NONE;
 #endif
   if (engine == ConvolutionParameter_Engine_DEFAULT) {
     engine = ConvolutionParameter_Engine_CAFFE;
 #ifdef USE_CUDNN
-    if (!use_dilation) {
+    if (!use_dilation && !use_fused_activation) {
       engine = ConvolutionParameter_Engine_CUDNN;
     }
 #endif
   }
   if (engine == ConvolutionParameter_Engine_CAFFE) {
     return shared_ptr<Layer<Dtype> >(new ConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_WINOGRAD) {
+    return shared_ptr<Layer<Dtype> >(
+        new WinogradConvolutionLayer<Dtype>(param));
 #ifdef USE_CUDNN
   } else if (engine == ConvolutionParameter_Engine_CUDNN) {
     if (use_dilation) {
       LOG(FATAL) << "CuDNN doesn't support the dilated convolution at Layer "
                  << param.name();
     }
+    if (use_fused_activation) {
+      LOG(FATAL) << "CuDNN doesn't support fused activations at Layer "
+                 << param.name();
+    }
     return shared_ptr<Layer<Dtype> >(new CuDNNConvolutionLayer<Dtype>(param));
 #endif
   } else {
@@ -65,6 +82,19 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(const LayerParameter& param) {
 
 REGISTER_LAYER_CREATOR(Convolution, GetConvolutionLayer);
 
+// Get depthwise convolution layer according to layout.
+template <typename Dtype>
+shared_ptr<Layer<Dtype> > GetConvolutionDepthwiseLayer(
+    const LayerParameter& param) {
+  if (param.layout() == NHWC) {
+    return shared_ptr<Layer<Dtype> >(
+        new ChannelsLastConvolutionLayer<Dtype>(param));
+  }
+  return shared_ptr<Layer<Dtype> >(new ConvolutionDepthwiseLayer<Dtype>(param));
+}
+
+REGISTER_LAYER_CREATOR(ConvolutionDepthwise, GetConvolutionDepthwiseLayer);
+
 // Get pooling layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetPoolingLayer(const LayerParameter& param) {
@@ -72,7 +102,10 @@ shared_ptr<Layer<Dtype> > GetPoolingLayer(const LayerParameter& param) {
   if (engine == PoolingParameter_Engine_DEFAULT) {
     engine = PoolingParameter_Engine_CAFFE;
 #ifdef USE_CUDNN
-    engine = PoolingParameter_Engine_CUDNN;
+    // Only Caffe's own pooling supports NHWC.
+    if (param.layout() != NHWC) {
+      engine = PoolingParameter_Engine_CUDNN;
+    }
 #endif
   }
   if (engine == PoolingParameter_Engine_CAFFE) {
@@ -5,6 +5,11 @@
 #include "caffe/layers/base_conv_layer.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+CAFFE_DEFINE_int(conv_col_buffer_kb, 65536,
+    "Upper bound in KB on the column buffers of each CPU convolution, which "
+    "limits the column tile size and the threads working on tiles at once.");
 
 namespace caffe {
 
@@ -13,6 +18,8 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                                              const vector<Blob<Dtype>*>& top) {
   // Configure the kernel size, padding, stride, and inputs.
   ConvolutionParameter conv_param = this->layer_param_.convolution_param();
+  CHECK(!quantized_gemm_.enabled() || !reverse_dimensions())
+      << "INT8 is only supported for Convolution layers.";
   force_nd_im2col_ = conv_param.force_nd_im2col();
   channel_axis_ = bottom[0]->CanonicalAxisIndex(conv_param.axis());
   const int first_spatial_axis = channel_axis_ + 1;
@@ -119,6 +126,13 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       break;
     }
   }
+  // A 1x1 kernel without padding reads each output position from a single
+  // input position, whatever the stride.
+  is_pointwise_ = num_spatial_axes_ == 2 && !force_nd_im2col_ &&
+                  !reverse_dimensions();
+  for (int i = 0; i < num_spatial_axes_ && is_pointwise_; ++i) {
+    is_pointwise_ = kernel_shape_data[i] == 1 && pad_data[i] == 0;
+  }
   // Configure output channels and groups.
   channels_ = bottom[0]->shape(channel_axis_);
   num_output_ = this->layer_param_.convolution_param().num_output();
@@ -137,6 +151,7 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // Handle the parameters: weights and biases.
   // - blobs_[0] holds the filter weights
   // - blobs_[1] holds the biases (optional)
+  // - the last blob holds the slopes of a fused PReLU activation (optional)
   vector<int> weight_shape(2);
   weight_shape[0] = conv_out_channels_;
   weight_shape[1] = conv_in_channels_ / group_;
@@ -145,8 +160,10 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   bias_term_ = this->layer_param_.convolution_param().bias_term();
   vector<int> bias_shape(bias_term_, num_output_);
+  const bool has_slope = fused_activation_.has_slope();
+  const vector<int> slope_shape = fused_activation_.slope_shape(num_output_);
   if (this->blobs_.size() > 0) {
-    CHECK_EQ(1 + bias_term_, this->blobs_.size())
+    CHECK_EQ(1 + bias_term_ + has_slope, this->blobs_.size())
         << "Incorrect number of weight blobs.";
     if (weight_shape != this->blobs_[0]->shape()) {
       Blob<Dtype> weight_shaped_blob(weight_shape);
@@ -160,13 +177,15 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                  << bias_shaped_blob.shape_string() << "; instead, shape was "
                  << this->blobs_[1]->shape_string();
     }
+    if (has_slope && slope_shape != this->blobs_.back()->shape()) {
+      Blob<Dtype> slope_shaped_blob(slope_shape);
+      LOG(FATAL) << "Incorrect slope shape: expected shape "
+                 << slope_shaped_blob.shape_string() << "; instead, shape was "
+                 << this->blobs_.back()->shape_string();
+    }
     LOG(INFO) << "Skipping parameter initialization";
   } else {
-    if (bias_term_) {
-      this->blobs_.resize(2);
-    } else {
-      this->blobs_.resize(1);
-    }
+    this->blobs_.resize(1 + bias_term_ + has_slope);
     // Initialize and fill the weights:
     // output channels x input channels per-group x kernel height x kernel width
     this->blobs_[0].reset(new Blob<Dtype>(weight_shape));
@@ -180,6 +199,11 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
           this->layer_param_.convolution_param().bias_filler()));
       bias_filler->Fill(this->blobs_[1].get());
     }
+    // If necessary, initialize and fill the PReLU slopes.
+    if (has_slope) {
+      this->blobs_.back().reset(new Blob<Dtype>(slope_shape));
+      fused_activation_.FillSlope(this->blobs_.back().get());
+    }
   }
   kernel_dim_ = this->blobs_[0]->count(1);
   weight_offset_ = conv_out_channels_ * kernel_dim_ / group_;
@@ -231,7 +255,7 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       conv_input_shape_data[i] = bottom[0]->shape(channel_axis_ + i);
     }
   }
-  // The im2col result buffer will only hold one image at a time to avoid
+  // The GPU im2col result buffer will only hold one image at a time to avoid
   // overly large memory usage. In the special case of 1x1 convolution
   // it goes lazily unused to save memory.
   col_buffer_shape_.clear();
@@ -244,6 +268,18 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     }
   }
   col_buffer_.Reshape(col_buffer_shape_);
+  reshape_col_tiles();
+  if (is_pointwise_) {
+    // Batch images until a GEMM has about kPointwiseColumns columns; larger
+    // outputs already make efficient GEMMs one image at a time.
+    const int kPointwiseColumns = 4096;
+    pointwise_batch_ = std::max(1, std::min(num_,
+        kPointwiseColumns / std::max(conv_out_spatial_dim_, 1)));
+    pointwise_col_buffer_.Reshape(1, 1, conv_in_channels_,
+        pointwise_batch_ * conv_out_spatial_dim_);
+    pointwise_output_buffer_.Reshape(1, 1, conv_out_channels_,
+        pointwise_batch_ > 1 ? pointwise_batch_ * conv_out_spatial_dim_ : 0);
+  }
   bottom_dim_ = bottom[0]->count(channel_axis_);
   top_dim_ = top[0]->count(channel_axis_);
   num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
@@ -258,30 +294,275 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::reshape_col_tiles() {
+  // The CPU builds the columns of 2D convolutions a tile of rows at a time,
+  // each about kColTileBytes so that the GEMM reads it back from the L2
+  // cache, but at least kMinColTileColumns wide so that the GEMM stays
+  // efficient; the conv_col_buffer_kb flag bounds both. N-D column buffers
+  // are a single tile.
+  const int kColTileBytes = 1 << 20;
+  const int kMinColTileColumns = 512;
+  const bool tile_rows = !force_nd_im2col_ && num_spatial_axes_ == 2;
+  const int col_height = tile_rows ? std::max(col_buffer_shape_[1], 1) : 1;
+  const int col_width = std::max(conv_out_spatial_dim_ / col_height, 1);
+  const size_t row_bytes = sizeof(Dtype) * kernel_dim_ * group_ * col_width;
+  const size_t max_bytes =
+      static_cast<size_t>(std::max(FLAGS_conv_col_buffer_kb, 1)) << 10;
+  size_t rows = std::max(kColTileBytes / row_bytes,
+      static_cast<size_t>((kMinColTileColumns + col_width - 1) / col_width));
+  rows = std::max<size_t>(std::min(rows, max_bytes / row_bytes), 1);
+  col_tiles_ = is_1x1_ ? 1 : static_cast<int>((col_height + rows - 1) / rows);
+  col_tile_rows_ = (col_height + col_tiles_ - 1) / col_tiles_;
+  col_tile_dim_ = col_tile_rows_ * col_width;
+  const size_t tile_bytes = is_1x1_ ? 0 : col_tile_rows_ * row_bytes;
+  col_tile_workers_ = std::min(Caffe::num_threads(), num_ * col_tiles_);
+  if (tile_bytes > 0) {
+    col_tile_workers_ = static_cast<int>(
+        std::min<size_t>(col_tile_workers_, max_bytes / tile_bytes));
+  }
+  col_tile_workers_ = std::max(col_tile_workers_, 1);
+  col_tile_buffer_.Reshape(col_tile_workers_, 1, is_1x1_ ? 0 : kernel_dim_ *
+                           group_, col_tile_dim_);
+  output_tile_buffer_.Reshape(col_tile_workers_, 1, col_tiles_ > 1 ?
+                              conv_out_channels_ : 0, col_tile_dim_);
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
                                                    const Dtype* weights,
                                                    Dtype* output,
                                                    bool skip_im2col) {
-  const Dtype* col_buff = input;
+  update_packed_weights(weights);
+  Dtype* col_buff = is_1x1_ ? NULL : col_tile_buffer_.mutable_cpu_data();
+  Dtype* output_tile =
+      col_tiles_ > 1 ? output_tile_buffer_.mutable_cpu_data() : NULL;
+  // Only a single tile is still in the buffer after weight_cpu_gemm.
+  for (int tile = 0; tile < col_tiles_; ++tile) {
+    forward_cpu_gemm_tile(input, weights, tile, skip_im2col && col_tiles_ == 1,
+                          col_buff, output_tile, output);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_images(const Dtype* input,
+    const Dtype* weights, Dtype* output) {
+  update_packed_weights(weights);
+  // The INT8 engine quantizes through buffers of its own.
+  const int workers = quantized_gemm_.enabled() ? 1 : col_tile_workers_;
+  const int tasks = num_ * col_tiles_;
+  Dtype* col_buff = is_1x1_ ? NULL : col_tile_buffer_.mutable_cpu_data();
+  Dtype* output_tile =
+      col_tiles_ > 1 ? output_tile_buffer_.mutable_cpu_data() : NULL;
+  const int col_tile_count = col_tile_buffer_.count(1);
+  const int output_tile_count = output_tile_buffer_.count(1);
+  parallel_for(workers, 1, [&](int begin, int end) {
+    for (int worker = begin; worker < end; ++worker) {
+      Dtype* worker_col_buff =
+          col_buff ? col_buff + worker * col_tile_count : NULL;
+      Dtype* worker_output_tile =
+          output_tile ? output_tile + worker * output_tile_count : NULL;
+      for (int task = worker; task < tasks; task += workers) {
+        const int n = task / col_tiles_;
+        forward_cpu_gemm_tile(input + n * bottom_dim_, weights,
+                              task % col_tiles_, false, worker_col_buff,
+                              worker_output_tile, output + n * top_dim_);
+      }
+    }
+  });
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_tile(const Dtype* input,
+    const Dtype* weights, int tile, bool skip_im2col, Dtype* col_buff,
+    Dtype* output_tile, Dtype* output) {
+  const int columns =
+      std::min(col_tile_dim_, conv_out_spatial_dim_ - tile * col_tile_dim_);
+  const Dtype* col = input;
   if (!is_1x1_) {
     if (!skip_im2col) {
-      conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+      const int row_begin = tile * col_tile_rows_;
+      conv_im2col_rows_cpu(input, row_begin,
+          row_begin + columns * col_tile_rows_ / col_tile_dim_, col_buff);
     }
-    col_buff = col_buffer_.cpu_data();
+    col = col_buff;
   }
+  Dtype* gemm_output = col_tiles_ > 1 ? output_tile : output;
+  const int group_out_channels = conv_out_channels_ / group_;
   for (int g = 0; g < group_; ++g) {
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans,
-                          conv_out_channels_ / group_, conv_out_spatial_dim_,
-                          kernel_dim_, (Dtype)1., weights + weight_offset_ * g,
-                          col_buff + col_offset_ * g, (Dtype)0.,
-                          output + output_offset_ * g);
+    forward_cpu_weight_gemm(g, columns, weights,
+                            col + kernel_dim_ * columns * g,
+                            gemm_output + group_out_channels * columns * g);
+  }
+  if (col_tiles_ > 1) {
+    scatter_output_tile(tile, output_tile, output);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::gather_output_tile(int tile,
+    const Dtype* data, Dtype* data_tile) {
+  const int offset = tile * col_tile_dim_;
+  const int columns = std::min(col_tile_dim_, conv_out_spatial_dim_ - offset);
+  for (int c = 0; c < conv_out_channels_; ++c) {
+    const Dtype* row = data + c * conv_out_spatial_dim_ + offset;
+    std::copy(row, row + columns, data_tile + c * columns);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::scatter_output_tile(int tile,
+    const Dtype* data_tile, Dtype* data) {
+  const int offset = tile * col_tile_dim_;
+  const int columns = std::min(col_tile_dim_, conv_out_spatial_dim_ - offset);
+  for (int c = 0; c < conv_out_channels_; ++c) {
+    const Dtype* row = data_tile + c * columns;
+    std::copy(row, row + columns, data + c * conv_out_spatial_dim_ + offset);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::PrepackWeights() {
+  // Deconvolution multiplies with the transposed weights instead.
+  if (reverse_dimensions()) {
+    return;
+  }
+  packed_weights_.resize(group_);
+  for (int g = 0; g < group_; ++g) {
+    packed_weights_[g].reset(new PackedMatrix<Dtype>());
+  }
+  packed_memory_ = NULL;
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_weight_gemm(int g, int columns,
+    const Dtype* weights, const Dtype* col_buff, Dtype* output) {
+  const Blob<Dtype>& blob = *this->blobs_[0];
+  const bool own_weights = weights == NULL || weights == blob.cpu_data();
+  const int group_out_channels = conv_out_channels_ / group_;
+  if (quantized_gemm_.enabled() && own_weights) {
+    quantized_gemm_.Forward_cpu(blob, group_out_channels * g,
+                                group_out_channels, columns, col_buff, false,
+                                output);
+    return;
+  }
+  if (packed_weights_.empty() || !own_weights) {
+    if (weights == NULL) {
+      caffe_cpu_blocked_gemm<Dtype>(CblasNoTrans, CblasNoTrans,
+          group_out_channels, columns, kernel_dim_, (Dtype)1.,
+          blob.half_data() + weight_offset_ * g, blob.data()->half_format(),
+          col_buff, (Dtype)0., output);
+      return;
+    }
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, group_out_channels,
+                          columns, kernel_dim_, (Dtype)1.,
+                          weights + weight_offset_ * g, col_buff, (Dtype)0.,
+                          output);
+    return;
+  }
+  update_packed_weights(weights);
+  caffe_cpu_blocked_gemm<Dtype>(*packed_weights_[g], CblasNoTrans, columns,
+                                (Dtype)1., col_buff, (Dtype)0., output);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::update_packed_weights(const Dtype* weights) {
+  const Blob<Dtype>& blob = *this->blobs_[0];
+  if (packed_weights_.empty() || quantized_gemm_.enabled() ||
+      (weights != NULL && weights != blob.cpu_data())) {
+    return;
+  }
+  if (packed_memory_ == blob.data().get() &&
+      packed_version_ == blob.data()->version()) {
+    return;
+  }
+  const int group_out_channels = conv_out_channels_ / group_;
+  for (int i = 0; i < group_; ++i) {
+    if (weights == NULL) {
+      packed_weights_[i]->PackA(CblasNoTrans, group_out_channels,
+          kernel_dim_, blob.half_data() + weight_offset_ * i,
+          blob.data()->half_format());
+    } else {
+      packed_weights_[i]->PackA(CblasNoTrans, group_out_channels,
+                                kernel_dim_, weights + weight_offset_ * i);
+    }
+  }
+  packed_memory_ = blob.data().get();
+  packed_version_ = blob.data()->version();
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_pointwise(const Dtype* input,
+                                                        const Dtype* weights,
+                                                        Dtype* output) {
+  const int spatial_dim = conv_out_spatial_dim_;
+  const int input_height = conv_input_shape_.cpu_data()[1];
+  const int input_width = conv_input_shape_.cpu_data()[2];
+  const int output_height = output_shape_[0];
+  const int output_width = output_shape_[1];
+  const int stride_h = stride_.cpu_data()[0];
+  const int stride_w = stride_.cpu_data()[1];
+  const int group_in_channels = conv_in_channels_ / group_;
+  const int group_out_channels = conv_out_channels_ / group_;
+  for (int n0 = 0; n0 < num_; n0 += pointwise_batch_) {
+    const int batch = std::min(pointwise_batch_, num_ - n0);
+    if (batch == 1 && is_1x1_) {
+      forward_cpu_gemm(input + n0 * bottom_dim_, weights,
+                       output + n0 * top_dim_);
+      continue;
+    }
+    // Channel c of image b goes to columns [b * spatial_dim, (b + 1) *
+    // spatial_dim) of row c.
+    const int columns = batch * spatial_dim;
+    Dtype* col_buff = pointwise_col_buffer_.mutable_cpu_data();
+    for (int b = 0; b < batch; ++b) {
+      const Dtype* image = input + (n0 + b) * bottom_dim_;
+      for (int c = 0; c < conv_in_channels_; ++c) {
+        const Dtype* plane = image + c * input_height * input_width;
+        Dtype* row = col_buff + c * columns + b * spatial_dim;
+        if (is_1x1_) {
+          caffe_copy(spatial_dim, plane, row);
+          continue;
+        }
+        for (int h = 0; h < output_height; ++h) {
+          const Dtype* input_row = plane + h * stride_h * input_width;
+          for (int w = 0; w < output_width; ++w) {
+            row[h * output_width + w] = input_row[w * stride_w];
+          }
+        }
+      }
+    }
+    // A single image is already in the layout of the output.
+    Dtype* gemm_output = batch == 1 ? output + n0 * top_dim_ :
+        pointwise_output_buffer_.mutable_cpu_data();
+    for (int g = 0; g < group_; ++g) {
+      forward_cpu_weight_gemm(g, columns, weights,
+                              col_buff + group_in_channels * columns * g,
+                              gemm_output + group_out_channels * columns * g);
+    }
+    if (batch == 1) {
+      continue;
+    }
+    for (int b = 0; b < batch; ++b) {
+      Dtype* image = output + (n0 + b) * top_dim_;
+      for (int c = 0; c < conv_out_channels_; ++c) {
+        caffe_copy(spatial_dim, gemm_output + c * columns + b * spatial_dim,
+                   image + c * spatial_dim);
+      }
+    }
   }
 }
 
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
                                                    const Dtype* bias) {
+  if (fused_activation_.enabled()) {
+    const Dtype* slope = fused_activation_.has_slope() ?
+        this->blobs_.back()->cpu_data() : NULL;
+    fused_activation_.Forward_cpu(1, num_output_, out_spatial_dim_, bias,
+                                  slope, output);
+    return;
+  }
   caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_output_,
                         out_spatial_dim_, 1, (Dtype)1., bias,
                         bias_multiplier_.cpu_data(), (Dtype)1., output);
@@ -291,18 +572,38 @@ template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
                                                     const Dtype* weights,
                                                     Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_cpu_data();
+  const int group_out_channels = conv_out_channels_ / group_;
   if (is_1x1_) {
-    col_buff = input;
-  }
-  for (int g = 0; g < group_; ++g) {
-    caffe_cpu_gemm<Dtype>(
-        CblasTrans, CblasNoTrans, kernel_dim_, conv_out_spatial_dim_,
-        conv_out_channels_ / group_, (Dtype)1., weights + weight_offset_ * g,
-        output + output_offset_ * g, (Dtype)0., col_buff + col_offset_ * g);
+    for (int g = 0; g < group_; ++g) {
+      caffe_cpu_gemm<Dtype>(
+          CblasTrans, CblasNoTrans, kernel_dim_, conv_out_spatial_dim_,
+          group_out_channels, (Dtype)1., weights + weight_offset_ * g,
+          output + output_offset_ * g, (Dtype)0., input + col_offset_ * g);
+    }
+    return;
   }
-  if (!is_1x1_) {
-    conv_col2im_cpu(col_buff, input);
+  Dtype* col_buff = col_tile_buffer_.mutable_cpu_data();
+  Dtype* output_tile =
+      col_tiles_ > 1 ? output_tile_buffer_.mutable_cpu_data() : NULL;
+  caffe_set(num_kernels_col2im_, Dtype(0), input);
+  for (int tile = 0; tile < col_tiles_; ++tile) {
+    const int columns =
+        std::min(col_tile_dim_, conv_out_spatial_dim_ - tile * col_tile_dim_);
+    const Dtype* tile_output = output;
+    if (col_tiles_ > 1) {
+      gather_output_tile(tile, output, output_tile);
+      tile_output = output_tile;
+    }
+    for (int g = 0; g < group_; ++g) {
+      caffe_cpu_gemm<Dtype>(
+          CblasTrans, CblasNoTrans, kernel_dim_, columns, group_out_channels,
+          (Dtype)1., weights + weight_offset_ * g,
+          tile_output + group_out_channels * columns * g, (Dtype)0.,
+          col_buff + kernel_dim_ * columns * g);
+    }
+    const int row_begin = tile * col_tile_rows_;
+    conv_col2im_rows_cpu(col_buff, row_begin,
+        row_begin + columns * col_tile_rows_ / col_tile_dim_, input);
   }
 }
 
@@ -310,16 +611,32 @@ template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
                                                   const Dtype* output,
                                                   Dtype* weights) {
-  const Dtype* col_buff = input;
-  if (!is_1x1_) {
-    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
-    col_buff = col_buffer_.cpu_data();
-  }
-  for (int g = 0; g < group_; ++g) {
-    caffe_cpu_gemm<Dtype>(
-        CblasNoTrans, CblasTrans, conv_out_channels_ / group_, kernel_dim_,
-        conv_out_spatial_dim_, (Dtype)1., output + output_offset_ * g,
-        col_buff + col_offset_ * g, (Dtype)1., weights + weight_offset_ * g);
+  const int group_out_channels = conv_out_channels_ / group_;
+  Dtype* col_buff = is_1x1_ ? NULL : col_tile_buffer_.mutable_cpu_data();
+  Dtype* output_tile =
+      col_tiles_ > 1 ? output_tile_buffer_.mutable_cpu_data() : NULL;
+  for (int tile = 0; tile < col_tiles_; ++tile) {
+    const int columns =
+        std::min(col_tile_dim_, conv_out_spatial_dim_ - tile * col_tile_dim_);
+    const Dtype* col = input;
+    if (!is_1x1_) {
+      const int row_begin = tile * col_tile_rows_;
+      conv_im2col_rows_cpu(input, row_begin,
+          row_begin + columns * col_tile_rows_ / col_tile_dim_, col_buff);
+      col = col_buff;
+    }
+    const Dtype* tile_output = output;
+    if (col_tiles_ > 1) {
+      gather_output_tile(tile, output, output_tile);
+      tile_output = output_tile;
+    }
+    for (int g = 0; g < group_; ++g) {
+      caffe_cpu_gemm<Dtype>(
+          CblasNoTrans, CblasTrans, group_out_channels, kernel_dim_, columns,
+          (Dtype)1., tile_output + group_out_channels * columns * g,
+          col + kernel_dim_ * columns * g, (Dtype)1.,
+          weights + weight_offset_ * g);
+    }
   }
 }
 
@@ -356,6 +673,13 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_gemm(const Dtype* input,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_gpu_bias(Dtype* output,
                                                    const Dtype* bias) {
+  if (fused_activation_.enabled()) {
+    const Dtype* slope = fused_activation_.has_slope() ?
+        this->blobs_.back()->gpu_data() : NULL;
+    fused_activation_.Forward_gpu(1, num_output_, out_spatial_dim_, bias,
+                                  slope, output);
+    return;
+  }
   caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_output_,
                         out_spatial_dim_, 1, (Dtype)1., bias,
                         bias_multiplier_.gpu_data(), (Dtype)1., output);
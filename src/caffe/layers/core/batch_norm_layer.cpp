@@ -1,8 +1,10 @@
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/batch_norm_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -14,10 +16,16 @@ void BatchNormLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   use_global_stats_ = this->phase_ == TEST;
   if (param.has_use_global_stats())
     use_global_stats_ = param.use_global_stats();
-  if (bottom[0]->num_axes() == 1)
+  channels_last_ = this->layer_param_.layout() == NHWC;
+  if (channels_last_) {
+    CHECK(use_global_stats_)
+        << "Channels-last BatchNorm only supports the global statistics.";
+    channels_ = bottom[0]->shape(-1);
+  } else if (bottom[0]->num_axes() == 1) {
     channels_ = 1;
-  else
+  } else {
     channels_ = bottom[0]->shape(1);
+  }
   eps_ = param.eps();
   if (this->blobs_.size() > 0) {
     LOG(INFO) << "Skipping parameter initialization";
@@ -51,6 +59,14 @@ void BatchNormLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void BatchNormLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
                                     const vector<Blob<Dtype>*>& top) {
+  if (channels_last_) {
+    CHECK_EQ(bottom[0]->shape(-1), channels_);
+    top[0]->ReshapeLike(*bottom[0]);
+    vector<int> sz(1, channels_);
+    mean_.Reshape(sz);
+    variance_.Reshape(sz);
+    return;
+  }
   if (bottom[0]->num_axes() >= 1) CHECK_EQ(bottom[0]->shape(1), channels_);
   top[0]->ReshapeLike(*bottom[0]);
 
@@ -81,9 +97,44 @@ void BatchNormLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void BatchNormLayer<Dtype>::ForwardChannelsLast(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  // y = x * scale + shift per channel, with scale and shift from the stored
+  // statistics kept in mean_ and variance_.
+  const Dtype stats = this->blobs_[2]->cpu_data()[0];
+  const Dtype scale_factor = stats == 0 ? 0 : 1 / stats;
+  const Dtype* mean = this->blobs_[0]->cpu_data();
+  const Dtype* variance = this->blobs_[1]->cpu_data();
+  Dtype* scale = variance_.mutable_cpu_data();
+  Dtype* shift = mean_.mutable_cpu_data();
+  for (int c = 0; c < channels_; ++c) {
+    scale[c] = 1 / std::sqrt(variance[c] * scale_factor + eps_);
+    shift[c] = -mean[c] * scale_factor * scale[c];
+  }
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const int channels = channels_;
+  parallel_for(bottom[0]->count() / channels,
+               std::max(1, kMinParallelWork / channels),
+               [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      const Dtype* in = bottom_data + i * channels;
+      Dtype* out = top_data + i * channels;
+      for (int c = 0; c < channels; ++c) {
+        out[c] = in[c] * scale[c] + shift[c];
+      }
+    }
+  });
+}
+
 template <typename Dtype>
 void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                         const vector<Blob<Dtype>*>& top) {
+  if (channels_last_) {
+    ForwardChannelsLast(bottom, top);
+    return;
+  }
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   int num = bottom[0]->shape(0);
@@ -170,6 +221,7 @@ template <typename Dtype>
 void BatchNormLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                          const vector<bool>& propagate_down,
                                          const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!channels_last_) << "Channels-last BatchNorm only supports Forward.";
   const Dtype* top_diff;
   if (bottom[0] != top[0]) {
     top_diff = top[0]->cpu_diff();
@@ -78,6 +78,15 @@ void BiasLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const Dtype* bottom_data = bottom[0]->cpu_data();
     caffe_copy(bottom[0]->count(), bottom_data, top_data);
   }
+  if (inner_dim_ == 1) {
+    // Biasing the last axis, e.g. the channels of NHWC blobs: add whole rows
+    // rather than a GEMM per row.
+    for (int n = 0; n < outer_dim_; ++n) {
+      caffe_axpy(bias_dim_, Dtype(1), bias_data, top_data);
+      top_data += dim_;
+    }
+    return;
+  }
   for (int n = 0; n < outer_dim_; ++n) {
     caffe_cpu_gemm(CblasNoTrans, CblasNoTrans, bias_dim_, inner_dim_, 1,
                    Dtype(1), bias_data, bias_multiplier_.cpu_data(), Dtype(1),
@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/channels_last_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void ChannelsLastConvolutionLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  CHECK_EQ(4, bottom[0]->num_axes())
+      << "Channels-last convolution takes (num, height, width, channels) "
+      << "input.";
+  CHECK_EQ(1, this->layer_param_.convolution_param().axis())
+      << "Channels-last convolution needs the default axis.";
+  CHECK(!this->quantized_gemm_.enabled())
+      << "INT8 convolutions only support the NCHW layout.";
+  const int channels = bottom[0]->shape(3);
+  if (depthwise_layer_) {
+    ConvolutionParameter* conv_param =
+        this->layer_param_.mutable_convolution_param();
+    conv_param->set_num_output(channels);
+    conv_param->set_group(channels);
+  }
+  nchw_bottom_.Reshape(bottom[0]->shape(0), channels, bottom[0]->shape(1),
+                       bottom[0]->shape(2));
+  ConvolutionLayer<Dtype>::LayerSetUp(vector<Blob<Dtype>*>(1, &nchw_bottom_),
+                                      top);
+  depthwise_ = this->group_ == this->channels_ &&
+               this->num_output_ == this->channels_;
+}
+
+template <typename Dtype>
+void ChannelsLastConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  CHECK_EQ(4, bottom[0]->num_axes()) << "bottom num_axes may not change.";
+  nchw_bottom_.Reshape(bottom[0]->shape(0), bottom[0]->shape(3),
+                       bottom[0]->shape(1), bottom[0]->shape(2));
+  ConvolutionLayer<Dtype>::Reshape(vector<Blob<Dtype>*>(1, &nchw_bottom_),
+                                   vector<Blob<Dtype>*>(1, &nchw_top_));
+  top[0]->Reshape(this->num_, this->output_shape_[0], this->output_shape_[1],
+                  this->num_output_);
+}
+
+template <typename Dtype>
+const Dtype* ChannelsLastConvolutionLayer<Dtype>::ChannelsLastWeights() {
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  const int kernel_size =
+      this->kernel_shape_.cpu_data()[0] * this->kernel_shape_.cpu_data()[1];
+  if (kernel_size == 1) {
+    return weights.cpu_data();
+  }
+  if (weight_memory_ != weights.data().get() ||
+      weight_version_ != weights.data()->version()) {
+    // Depthwise filters become (kernel_h, kernel_w, channels), so that a tap
+    // reads the filters of consecutive channels.
+    const int outputs = depthwise_ ? 1 : this->num_output_;
+    const int inputs =
+        depthwise_ ? this->channels_ : this->channels_ / this->group_;
+    channels_last_weights_.ReshapeLike(weights);
+    const Dtype* weight = weights.cpu_data();
+    Dtype* reordered = channels_last_weights_.mutable_cpu_data();
+    for (int o = 0; o < outputs; ++o) {
+      for (int c = 0; c < inputs; ++c) {
+        for (int k = 0; k < kernel_size; ++k) {
+          reordered[(o * kernel_size + k) * inputs + c] =
+              weight[(o * inputs + c) * kernel_size + k];
+        }
+      }
+    }
+    weight_memory_ = weights.data().get();
+    weight_version_ = weights.data()->version();
+  }
+  return channels_last_weights_.cpu_data();
+}
+
+template <typename Dtype>
+void ChannelsLastConvolutionLayer<Dtype>::ForwardPatches(
+    const Dtype* bottom_data, const Dtype* weights, const int begin,
+    const int end, Dtype* patches, Dtype* group_top, Dtype* top_data) {
+  const int* kernel = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* pad = this->pad_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  const int height = this->conv_input_shape_.cpu_data()[1];
+  const int width = this->conv_input_shape_.cpu_data()[2];
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int channels = this->channels_;
+  const int group_channels = channels / this->group_;
+  const int group_outputs = this->num_output_ / this->group_;
+  const int kernel_dim = kernel[0] * kernel[1] * group_channels;
+  for (int g = 0; g < this->group_; ++g) {
+    // Each patch row holds the (kernel_h, kernel_w, channels / group) window
+    // of an output pixel, the order of the reordered filters.
+    Dtype* patch = patches;
+    for (int p = begin; p < end; ++p) {
+      const int n = p / (output_h * output_w);
+      const int y = p / output_w % output_h;
+      const int x = p % output_w;
+      for (int kh = 0; kh < kernel[0]; ++kh) {
+        const int h = y * stride[0] - pad[0] + kh * dilation[0];
+        for (int kw = 0; kw < kernel[1]; ++kw) {
+          const int w = x * stride[1] - pad[1] + kw * dilation[1];
+          if (h >= 0 && h < height && w >= 0 && w < width) {
+            const Dtype* in = bottom_data +
+                ((n * height + h) * width + w) * channels +
+                g * group_channels;
+            std::copy(in, in + group_channels, patch);
+          } else {
+            std::fill(patch, patch + group_channels, Dtype(0));
+          }
+          patch += group_channels;
+        }
+      }
+    }
+    Dtype* output = this->group_ == 1 ?
+        top_data + begin * this->num_output_ : group_top;
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, end - begin,
+        group_outputs, kernel_dim, (Dtype)1., patches,
+        weights + g * group_outputs * kernel_dim, (Dtype)0., output);
+    if (this->group_ > 1) {
+      for (int p = begin; p < end; ++p) {
+        const Dtype* row = group_top + (p - begin) * group_outputs;
+        std::copy(row, row + group_outputs,
+                  top_data + p * this->num_output_ + g * group_outputs);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void ChannelsLastConvolutionLayer<Dtype>::ForwardDepthwise(
+    const Dtype* bottom_data, const Dtype* weights, const int begin,
+    const int end, Dtype* top_data) {
+  const int* kernel = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* pad = this->pad_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  const int height = this->conv_input_shape_.cpu_data()[1];
+  const int width = this->conv_input_shape_.cpu_data()[2];
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int channels = this->channels_;
+  for (int r = begin; r < end; ++r) {
+    const int n = r / output_h;
+    const int y = r % output_h;
+    for (int x = 0; x < output_w; ++x) {
+      Dtype* out = top_data + (r * output_w + x) * channels;
+      std::fill(out, out + channels, Dtype(0));
+      for (int kh = 0; kh < kernel[0]; ++kh) {
+        const int h = y * stride[0] - pad[0] + kh * dilation[0];
+        if (h < 0 || h >= height) {
+          continue;
+        }
+        for (int kw = 0; kw < kernel[1]; ++kw) {
+          const int w = x * stride[1] - pad[1] + kw * dilation[1];
+          if (w < 0 || w >= width) {
+            continue;
+          }
+          const Dtype* in = bottom_data + ((n * height + h) * width + w) *
+              channels;
+          const Dtype* k = weights + (kh * kernel[1] + kw) * channels;
+          for (int c = 0; c < channels; ++c) {
+            out[c] += k[c] * in[c];
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void ChannelsLastConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Dtype* weights = ChannelsLastWeights();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const int num_pixels = top[0]->count(0, 3);
+  const int num_output = this->num_output_;
+  if (depthwise_) {
+    const int kernel_size =
+        this->kernel_shape_.cpu_data()[0] * this->kernel_shape_.cpu_data()[1];
+    const int grain = std::max(1, kMinParallelWork /
+        (top[0]->count(2) * kernel_size));
+    parallel_for(top[0]->count(0, 2), grain, [&](int begin, int end) {
+      ForwardDepthwise(bottom_data, weights, begin, end, top_data);
+    });
+  } else if (this->is_1x1_ && this->group_ == 1) {
+    // The input rows are the patches.
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, num_pixels, num_output,
+        this->channels_, (Dtype)1., bottom_data, weights, (Dtype)0.,
+        top_data);
+  } else {
+    // Tiles of output pixels whose patches stay in the L2 cache. 1x1 patches
+    // are no larger than the input, so those make one GEMM per group.
+    const int kTileBytes = 1 << 17;
+    const int kernel_dim = this->blobs_[0]->count(1);
+    const int tile = this->is_1x1_ ? num_pixels :
+        std::min(num_pixels, std::max(64, std::min(512,
+            kTileBytes / static_cast<int>(kernel_dim * sizeof(Dtype)))));
+    const int num_tiles = (num_pixels + tile - 1) / tile;
+    const int group_outputs = num_output / this->group_;
+    parallel_for(num_tiles, 1, [&](int begin, int end) {
+      vector<Dtype> patches(tile * kernel_dim);
+      vector<Dtype> group_top(this->group_ > 1 ? tile * group_outputs : 0);
+      for (int t = begin; t < end; ++t) {
+        ForwardPatches(bottom_data, weights, t * tile,
+                       std::min(num_pixels, (t + 1) * tile), patches.data(),
+                       group_top.data(), top_data);
+      }
+    });
+  }
+  if (this->bias_term_ || this->fused_activation_.enabled()) {
+    // Every pixel is a row of num_output channels.
+    const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+    const Dtype* slope = this->fused_activation_.has_slope() ?
+        this->blobs_.back()->cpu_data() : NULL;
+    const int grain = std::max(1, kMinParallelWork / num_output);
+    parallel_for(num_pixels, grain, [&](int begin, int end) {
+      this->fused_activation_.Forward_cpu(end - begin, num_output, 1, bias,
+                                          slope, top_data + begin * num_output);
+    });
+  }
+}
+
+template <typename Dtype>
+void ChannelsLastConvolutionLayer<Dtype>::Forward_gpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  Forward_cpu(bottom, top);
+}
+
+template <typename Dtype>
+void ChannelsLastConvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  LOG(FATAL) << "Channels-last convolutions only support Forward.";
+}
+
+template <typename Dtype>
+void ChannelsLastConvolutionLayer<Dtype>::Backward_gpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  Backward_cpu(top, propagate_down, bottom);
+}
+
+INSTANTIATE_CLASS(ChannelsLastConvolutionLayer);
+
+}  // namespace caffe
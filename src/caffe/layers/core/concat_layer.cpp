@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/concat_layer.hpp"
@@ -56,18 +57,73 @@ void ConcatLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void ConcatLayer<Dtype>::DetachStaleViews(const vector<Blob<Dtype>*>& bottom,
+                                          const vector<Blob<Dtype>*>& top) {
+  const bool use_gpu = Caffe::mode() == Caffe::GPU;
+  int offset = 0;
+  for (int i = 0; i < bottom.size(); ++i) {
+    const int count = bottom[i]->count();
+    if (bottom[i]->data()->parent() == top[0]->data() &&
+        !(use_views() && bottom[i]->DataIsViewOf(*top[0], offset))) {
+      // The copies into top could overwrite this data before it is read.
+      shared_ptr<SyncedMemory> memory(new SyncedMemory(count * sizeof(Dtype)));
+      if (use_gpu) {
+        caffe_copy(count, bottom[i]->gpu_data(),
+                   static_cast<Dtype*>(memory->mutable_gpu_data()));
+      } else {
+        caffe_copy(count, bottom[i]->cpu_data(),
+                   static_cast<Dtype*>(memory->mutable_cpu_data()));
+      }
+      bottom[i]->ShareDataMemory(memory);
+    }
+    offset += count;
+  }
+}
+
+template <typename Dtype>
+void ConcatLayer<Dtype>::ShareBottomViews(const vector<Blob<Dtype>*>& bottom,
+                                          const vector<Blob<Dtype>*>& top) {
+  const shared_ptr<SyncedMemory>& top_memory = top[0]->data();
+  int num_views = 0;
+  for (int i = 0; i < bottom.size(); ++i) {
+    num_views += bottom[i]->data()->parent() == top_memory;
+  }
+  // Memory also held elsewhere, e.g. by the Net memory planner or a layer
+  // sharing it, keeps the copying path.
+  if (top_memory.use_count() != 1 + num_views) {
+    return;
+  }
+  int offset = 0;
+  for (int i = 0; i < bottom.size(); ++i) {
+    if (bottom[i]->data().use_count() == 1 &&
+        !bottom[i]->DataIsViewOf(*top[0], offset) &&
+        std::count(bottom.begin(), bottom.end(), bottom[i]) == 1) {
+      bottom[i]->ShareDataView(*top[0], offset);
+    }
+    offset += bottom[i]->count();
+  }
+}
+
 template <typename Dtype>
 void ConcatLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                      const vector<Blob<Dtype>*>& top) {
   if (bottom.size() == 1) {
     return;
   }
+  DetachStaleViews(bottom, top);
   Dtype* top_data = top[0]->mutable_cpu_data();
   int offset_concat_axis = 0;
   const int top_concat_axis = top[0]->shape(concat_axis_);
   for (int i = 0; i < bottom.size(); ++i) {
-    const Dtype* bottom_data = bottom[i]->cpu_data();
     const int bottom_concat_axis = bottom[i]->shape(concat_axis_);
+    if (use_views() && bottom[i]->DataIsViewOf(*top[0],
+        offset_concat_axis * concat_input_size_)) {
+      // The producer already wrote into top.
+      offset_concat_axis += bottom_concat_axis;
+      continue;
+    }
+    const Dtype* bottom_data = bottom[i]->cpu_data();
     for (int n = 0; n < num_concats_; ++n) {
       caffe_copy(bottom_concat_axis * concat_input_size_,
                  bottom_data + n * bottom_concat_axis * concat_input_size_,
@@ -76,6 +132,9 @@ void ConcatLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     }
     offset_concat_axis += bottom_concat_axis;
   }
+  if (use_views()) {
+    ShareBottomViews(bottom, top);
+  }
 }
 
 template <typename Dtype>
@@ -2,6 +2,12 @@
 #include <algorithm>
 #include <vector>
 #include "caffe/filler.hpp"
+#include "caffe/util/cpu_info.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#ifdef CAFFE_X86_DISPATCH
+#include <immintrin.h>
+#endif
 
 namespace caffe {
 
@@ -115,7 +121,7 @@ void ConvolutionDepthwiseLayer<Dtype>::Reshape(
   weight_multiplier_shape.push_back(top[0]->width());
   weight_multiplier_.Reshape(weight_multiplier_shape);
   caffe_set(weight_multiplier_.count(), Dtype(1),
-                weight_multiplier_.mutable_gpu_data());
+                weight_multiplier_.mutable_cpu_data());
   if (this->layer_param_.convolution_param().bias_term()) {
     vector<int> bias_buffer_shape;
     bias_buffer_shape.push_back(bottom[0]->channels());
@@ -129,63 +135,278 @@ void ConvolutionDepthwiseLayer<Dtype>::Reshape(
     bias_multiplier_shape.push_back(top[0]->width());
     bias_multiplier_.Reshape(bias_multiplier_shape);
     caffe_set(bias_multiplier_.count(), Dtype(1),
-                  bias_multiplier_.mutable_gpu_data());
+                  bias_multiplier_.mutable_cpu_data());
+  }
+}
+
+namespace {
+
+struct DepthwiseShape {
+  int height;
+  int width;
+  int top_height;
+  int top_width;
+  int kernel_h;
+  int kernel_w;
+  int stride_h;
+  int stride_w;
+  int pad_h;
+  int pad_w;
+  int dilation_h;
+  int dilation_w;
+};
+
+// The outputs [*begin, *end) along one axis whose kernel window lies
+// entirely inside the input, so they need no bounds checks.
+void InteriorRange(int size, int top_size, int kernel, int stride, int pad,
+    int dilation, int* begin, int* end) {
+  const int extent = dilation * (kernel - 1) + 1;
+  *begin = std::min(top_size, (pad + stride - 1) / stride);
+  const int last = size + pad - extent;
+  *end = last < 0 ? *begin :
+      std::max(*begin, std::min(top_size, last / stride + 1));
+}
+
+template <typename Dtype>
+Dtype BorderPixel(const Dtype* input, const Dtype* weight,
+    const DepthwiseShape& s, int h, int w) {
+  Dtype value = 0;
+  for (int kh = 0; kh < s.kernel_h; ++kh) {
+    const int h_in = h * s.stride_h - s.pad_h + kh * s.dilation_h;
+    if (h_in < 0 || h_in >= s.height) {
+      continue;
+    }
+    for (int kw = 0; kw < s.kernel_w; ++kw) {
+      const int w_in = w * s.stride_w - s.pad_w + kw * s.dilation_w;
+      if (w_in >= 0 && w_in < s.width) {
+        value += weight[kh * s.kernel_w + kw] * input[h_in * s.width + w_in];
+      }
+    }
+  }
+  return value;
+}
+
+// Interior outputs [w_begin, w_end) of a row; in_row is the first input row
+// of the window.
+template <typename Dtype>
+void InteriorRow(const Dtype* in_row, const Dtype* weight, Dtype bias,
+    const DepthwiseShape& s, int w_begin, int w_end, Dtype* out_row) {
+  for (int w = w_begin; w < w_end; ++w) {
+    const Dtype* in = in_row + w * s.stride_w - s.pad_w;
+    const Dtype* k = weight;
+    Dtype value = bias;
+    for (int kh = 0; kh < s.kernel_h; ++kh) {
+      for (int kw = 0; kw < s.kernel_w; ++kw) {
+        value += *k++ * in[kw * s.dilation_w];
+      }
+      in += s.dilation_h * s.width;
+    }
+    out_row[w] = value;
+  }
+}
+
+// The same for undilated 3x3 kernels, given the three input rows.
+template <typename Dtype>
+using Row3x3Fn = void (*)(const Dtype* r0, const Dtype* r1, const Dtype* r2,
+    const Dtype* k, Dtype bias, int stride, int pad_w, int w_begin,
+    int w_end, Dtype* out_row);
+
+template <typename Dtype>
+void Row3x3(const Dtype* r0, const Dtype* r1, const Dtype* r2,
+    const Dtype* k, Dtype bias, int stride, int pad_w, int w_begin,
+    int w_end, Dtype* out_row) {
+  for (int w = w_begin; w < w_end; ++w) {
+    const int i = w * stride - pad_w;
+    out_row[w] = bias
+        + k[0] * r0[i] + k[1] * r0[i + 1] + k[2] * r0[i + 2]
+        + k[3] * r1[i] + k[4] * r1[i + 1] + k[5] * r1[i + 2]
+        + k[6] * r2[i] + k[7] * r2[i + 1] + k[8] * r2[i + 2];
+  }
+}
+
+#ifdef CAFFE_X86_DISPATCH
+// Stride 2 windows start at the even elements; each vector of outputs reads
+// exactly the inputs it needs, so no load crosses the end of the input.
+
+CAFFE_TARGET_SSE2 inline __m128 Taps3Sse2(const float* r, int stride,
+    const float* k, __m128 acc) {
+  __m128 x0, x1, x2;
+  if (stride == 1) {
+    x0 = _mm_loadu_ps(r);
+    x1 = _mm_loadu_ps(r + 1);
+    x2 = _mm_loadu_ps(r + 2);
+  } else {
+    const __m128 a = _mm_loadu_ps(r);
+    const __m128 b = _mm_loadu_ps(r + 4);
+    const __m128 c = _mm_loadu_ps(r + 1);
+    const __m128 d = _mm_loadu_ps(r + 5);
+    x0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    x1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    x2 = _mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1));
+  }
+  acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(k[0]), x0));
+  acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(k[1]), x1));
+  return _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(k[2]), x2));
+}
+
+CAFFE_TARGET_SSE2 void Row3x3Sse2(const float* r0, const float* r1,
+    const float* r2, const float* k, float bias, int stride, int pad_w,
+    int w_begin, int w_end, float* out_row) {
+  int w = w_begin;
+  for (; w + 4 <= w_end; w += 4) {
+    const int i = w * stride - pad_w;
+    __m128 acc = _mm_set1_ps(bias);
+    acc = Taps3Sse2(r0 + i, stride, k, acc);
+    acc = Taps3Sse2(r1 + i, stride, k + 3, acc);
+    acc = Taps3Sse2(r2 + i, stride, k + 6, acc);
+    _mm_storeu_ps(out_row + w, acc);
+  }
+  Row3x3(r0, r1, r2, k, bias, stride, pad_w, w, w_end, out_row);
+}
+
+CAFFE_TARGET_AVX2 inline __m256 Deinterleave(__m256 a, __m256 b, int odd) {
+  const __m256 v = odd ? _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))
+                       : _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+  return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(v),
+                                                _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+CAFFE_TARGET_AVX2 inline __m256 Taps3Avx2(const float* r, int stride,
+    const float* k, __m256 acc) {
+  __m256 x0, x1, x2;
+  if (stride == 1) {
+    x0 = _mm256_loadu_ps(r);
+    x1 = _mm256_loadu_ps(r + 1);
+    x2 = _mm256_loadu_ps(r + 2);
+  } else {
+    const __m256 a = _mm256_loadu_ps(r);
+    const __m256 b = _mm256_loadu_ps(r + 8);
+    x0 = Deinterleave(a, b, 0);
+    x1 = Deinterleave(a, b, 1);
+    x2 = Deinterleave(_mm256_loadu_ps(r + 1), _mm256_loadu_ps(r + 9), 1);
+  }
+  acc = _mm256_fmadd_ps(_mm256_set1_ps(k[0]), x0, acc);
+  acc = _mm256_fmadd_ps(_mm256_set1_ps(k[1]), x1, acc);
+  return _mm256_fmadd_ps(_mm256_set1_ps(k[2]), x2, acc);
+}
+
+CAFFE_TARGET_AVX2 void Row3x3Avx2(const float* r0, const float* r1,
+    const float* r2, const float* k, float bias, int stride, int pad_w,
+    int w_begin, int w_end, float* out_row) {
+  int w = w_begin;
+  for (; w + 8 <= w_end; w += 8) {
+    const int i = w * stride - pad_w;
+    __m256 acc = _mm256_set1_ps(bias);
+    acc = Taps3Avx2(r0 + i, stride, k, acc);
+    acc = Taps3Avx2(r1 + i, stride, k + 3, acc);
+    acc = Taps3Avx2(r2 + i, stride, k + 6, acc);
+    _mm256_storeu_ps(out_row + w, acc);
+  }
+  // Leaving the upper halves dirty slows down all later SSE code.
+  _mm256_zeroupper();
+  Row3x3Sse2(r0, r1, r2, k, bias, stride, pad_w, w, w_end, out_row);
+}
+#endif  // CAFFE_X86_DISPATCH
+
+template <typename Dtype>
+Row3x3Fn<Dtype> SelectRow3x3() {
+  return &Row3x3<Dtype>;
+}
+
+template <>
+Row3x3Fn<float> SelectRow3x3<float>() {
+#ifdef CAFFE_X86_DISPATCH
+  switch (cpu_isa()) {
+  case CPU_ISA_AVX512:
+  case CPU_ISA_AVX2:
+    return &Row3x3Avx2;
+  case CPU_ISA_SSE2:
+    return &Row3x3Sse2;
+  default:
+    break;
+  }
+#endif
+  return &Row3x3<float>;
+}
+
+// One channel of one image. Border outputs take the bounds-checked path;
+// interior rows use row3x3 when given.
+template <typename Dtype>
+void DepthwisePlane(const Dtype* input, const Dtype* weight, Dtype bias,
+    const DepthwiseShape& s, Row3x3Fn<Dtype> row3x3, Dtype* output) {
+  int h_begin, h_end, w_begin, w_end;
+  InteriorRange(s.height, s.top_height, s.kernel_h, s.stride_h, s.pad_h,
+                s.dilation_h, &h_begin, &h_end);
+  InteriorRange(s.width, s.top_width, s.kernel_w, s.stride_w, s.pad_w,
+                s.dilation_w, &w_begin, &w_end);
+  for (int h = 0; h < s.top_height; ++h) {
+    Dtype* out_row = output + h * s.top_width;
+    if (h < h_begin || h >= h_end) {
+      for (int w = 0; w < s.top_width; ++w) {
+        out_row[w] = bias + BorderPixel(input, weight, s, h, w);
+      }
+      continue;
+    }
+    for (int w = 0; w < w_begin; ++w) {
+      out_row[w] = bias + BorderPixel(input, weight, s, h, w);
+    }
+    const Dtype* in_row = input + (h * s.stride_h - s.pad_h) * s.width;
+    if (row3x3) {
+      row3x3(in_row, in_row + s.width, in_row + 2 * s.width, weight, bias,
+             s.stride_w, s.pad_w, w_begin, w_end, out_row);
+    } else {
+      InteriorRow(in_row, weight, bias, s, w_begin, w_end, out_row);
+    }
+    for (int w = w_end; w < s.top_width; ++w) {
+      out_row[w] = bias + BorderPixel(input, weight, s, h, w);
+    }
   }
 }
 
+}  // namespace
+
 template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   const int num = top[0]->num();
   const int channels = top[0]->channels();
-  const int top_height = top[0]->height();
-  const int top_width = top[0]->width();
-  const int bottom_height = bottom[0]->height();
-  const int bottom_width = bottom[0]->width();
+  DepthwiseShape shape;
+  shape.height = bottom[0]->height();
+  shape.width = bottom[0]->width();
+  shape.top_height = top[0]->height();
+  shape.top_width = top[0]->width();
+  shape.kernel_h = kernel_h_;
+  shape.kernel_w = kernel_w_;
+  shape.stride_h = stride_h_;
+  shape.stride_w = stride_w_;
+  shape.pad_h = pad_h_;
+  shape.pad_w = pad_w_;
+  shape.dilation_h = dilation_h_;
+  shape.dilation_w = dilation_w_;
+  // MobileNet-style 3x3 kernels get vectorized interior rows.
+  const bool is_3x3 = kernel_h_ == 3 && kernel_w_ == 3 &&
+      dilation_h_ == 1 && dilation_w_ == 1 &&
+      (stride_w_ == 1 || stride_w_ == 2);
+  const Row3x3Fn<Dtype> row3x3 = is_3x3 ? SelectRow3x3<Dtype>() : NULL;
+  const int bottom_dim = shape.height * shape.width;
+  const int top_dim = shape.top_height * shape.top_width;
+  const int kernel_dim = kernel_h_ * kernel_w_;
   const Dtype* bottom_data = bottom[0]->cpu_data();
-  const Dtype* weight_data_base = this->blobs_[0]->cpu_data();
+  const Dtype* weight_data = this->blobs_[0]->cpu_data();
+  const Dtype* bias_data =
+      this->layer_param_.convolution_param().bias_term() ?
+      this->blobs_[1]->cpu_data() : NULL;
   Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int n = 0; n < num; ++n) {
-    for (int c = 0; c < channels; ++c) {
-      for (int h = 0; h < top_height; ++h) {
-        for (int w = 0; w < top_width; ++w) {
-          const Dtype* weight_data =
-              weight_data_base + c * kernel_h_ * kernel_w_;
-          Dtype value = 0;
-          for (int kh = 0; kh < kernel_h_; ++kh) {
-            for (int kw = 0; kw < kernel_w_; ++kw) {
-              int h_in = -pad_h_ + h * stride_h_ + kh * dilation_h_;
-              int w_in = -pad_w_ + w * stride_w_ + kw * dilation_w_;
-              if ((h_in >= 0) && (h_in < bottom_height) && (w_in >= 0) &&
-                  (w_in < bottom_width)) {
-                int offset =
-                    ((n * channels + c) * bottom_height + h_in) * bottom_width +
-                    w_in;
-                value += (*weight_data) * bottom_data[offset];
-              }
-              ++weight_data;
-            }
-          }
-          *top_data++ = value;
-        }
-      }
-    }
-  }
-  if (this->layer_param_.convolution_param().bias_term()) {
-    top_data = top[0]->mutable_cpu_data();
-    for (int n = 0; n < num; ++n) {
-      const Dtype* bias_data = this->blobs_[1]->cpu_data();
-      for (int c = 0; c < channels; ++c) {
-        for (int h = 0; h < top_height; ++h) {
-          for (int w = 0; w < top_width; ++w) {
-            *top_data += *bias_data;
-            ++top_data;
-          }
-        }
-        ++bias_data;
-      }
+  const int grain = std::max(1, kMinParallelWork / (top_dim * kernel_dim));
+  parallel_for(num * channels, grain, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      const int c = i % channels;
+      DepthwisePlane(bottom_data + i * bottom_dim,
+                     weight_data + c * kernel_dim,
+                     bias_data ? bias_data[c] : Dtype(0), shape, row3x3,
+                     top_data + i * top_dim);
     }
-  }
+  });
 }
 
 template <typename Dtype>
@@ -281,6 +502,5 @@ STUB_GPU(ConvolutionDepthwiseLayer);
 #endif
 
 INSTANTIATE_CLASS(ConvolutionDepthwiseLayer);
-REGISTER_LAYER_CLASS(ConvolutionDepthwise);
 
 }  // namespace caffe
\ No newline at end of file
@@ -24,15 +24,21 @@ void ConvolutionLayer<Dtype>::compute_output_shape() {
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                           const vector<Blob<Dtype>*>& top) {
-  const Dtype* weight = this->blobs_[0]->cpu_data();
+  // Weights held in 16 bits are read as they are by the GEMM.
+  const Dtype* weight = this->blobs_[0]->half_data() ? NULL :
+      this->blobs_[0]->cpu_data();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
+    if (this->is_pointwise_) {
+      this->forward_cpu_pointwise(bottom_data, weight, top_data);
+    } else {
+      this->forward_cpu_gemm_images(bottom_data, weight, top_data);
+    }
     for (int n = 0; n < this->num_; ++n) {
-      this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-                             top_data + n * this->top_dim_);
-      if (this->bias_term_) {
-        const Dtype* bias = this->blobs_[1]->cpu_data();
+      if (this->bias_term_ || this->fused_activation_.enabled()) {
+        const Dtype* bias =
+            this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
         this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
       }
     }
@@ -43,6 +49,8 @@ template <typename Dtype>
 void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                            const vector<bool>& propagate_down,
                                            const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!this->fused_activation_.enabled())
+      << "Layers with a fused activation only support Forward.";
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
   for (int i = 0; i < top.size(); ++i) {
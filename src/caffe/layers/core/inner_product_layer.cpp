@@ -12,6 +12,8 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   const int num_output = this->layer_param_.inner_product_param().num_output();
   bias_term_ = this->layer_param_.inner_product_param().bias_term();
   transpose_ = this->layer_param_.inner_product_param().transpose();
+  CHECK(!quantized_gemm_.enabled() || !transpose_)
+      << "INT8 InnerProduct layers need untransposed weights.";
   N_ = num_output;
   const int axis = bottom[0]->CanonicalAxisIndex(
       this->layer_param_.inner_product_param().axis());
@@ -19,15 +21,16 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // length K_ vector. For example, if bottom[0]'s shape is (N, C, H, W),
   // and axis == 1, N inner products with dimension CHW are performed.
   K_ = bottom[0]->count(axis);
+  const bool has_slope = fused_activation_.has_slope();
   // Check if we need to set up the weights
   if (this->blobs_.size() > 0) {
+    if (has_slope) {
+      CHECK_EQ(2 + bias_term_, this->blobs_.size())
+          << "Incorrect number of weight blobs.";
+    }
     LOG(INFO) << "Skipping parameter initialization";
   } else {
-    if (bias_term_) {
-      this->blobs_.resize(2);
-    } else {
-      this->blobs_.resize(1);
-    }
+    this->blobs_.resize(1 + bias_term_ + has_slope);
     // Initialize the weights
     vector<int> weight_shape(2);
     if (transpose_) {
@@ -50,6 +53,12 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
           this->layer_param_.inner_product_param().bias_filler()));
       bias_filler->Fill(this->blobs_[1].get());
     }
+    // If necessary, initialize and fill the PReLU slopes
+    if (has_slope) {
+      this->blobs_.back().reset(
+          new Blob<Dtype>(fused_activation_.slope_shape(N_)));
+      fused_activation_.FillSlope(this->blobs_.back().get());
+    }
   }  // parameter initialization
   this->param_propagate_down_.resize(this->blobs_.size(), true);
 }
@@ -80,16 +89,54 @@ void InnerProductLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void InnerProductLayer<Dtype>::PrepackWeights() {
+  packed_weights_.reset(new PackedMatrix<Dtype>());
+  packed_memory_ = NULL;
+}
+
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                            const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-                        M_, N_, K_, (Dtype)1., bottom_data, weight, (Dtype)0.,
-                        top_data);
-  if (bias_term_) {
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  if (quantized_gemm_.enabled()) {
+    quantized_gemm_.Forward_cpu(weights, 0, N_, M_, bottom_data, true,
+                                top_data);
+  } else if (packed_weights_) {
+    if (packed_memory_ != weights.data().get() ||
+        packed_version_ != weights.data()->version()) {
+      const CBLAS_TRANSPOSE trans = transpose_ ? CblasNoTrans : CblasTrans;
+      if (weights.half_data()) {
+        packed_weights_->PackB(trans, K_, N_, weights.half_data(),
+                               weights.data()->half_format());
+      } else {
+        packed_weights_->PackB(trans, K_, N_, weights.cpu_data());
+      }
+      packed_memory_ = weights.data().get();
+      packed_version_ = weights.data()->version();
+    }
+    caffe_cpu_blocked_gemm<Dtype>(CblasNoTrans, M_, (Dtype)1., bottom_data,
+                                  *packed_weights_, (Dtype)0., top_data);
+  } else if (weights.half_data()) {
+    // Weights held in 16 bits are widened block by block in the GEMM.
+    caffe_cpu_blocked_gemm<Dtype>(CblasNoTrans,
+        transpose_ ? CblasNoTrans : CblasTrans, M_, N_, K_, (Dtype)1.,
+        bottom_data, weights.half_data(), weights.data()->half_format(),
+        (Dtype)0., top_data);
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
+                          M_, N_, K_, (Dtype)1., bottom_data,
+                          weights.cpu_data(), (Dtype)0., top_data);
+  }
+  if (fused_activation_.enabled()) {
+    // Add the bias and apply the activation in a single pass over top.
+    const Dtype* bias = bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+    const Dtype* slope = fused_activation_.has_slope() ?
+        this->blobs_.back()->cpu_data() : NULL;
+    fused_activation_.Forward_cpu(M_, N_, 1, bias, slope, top_data);
+  } else if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
                           bias_multiplier_.cpu_data(),
                           this->blobs_[1]->cpu_data(), (Dtype)1., top_data);
@@ -100,6 +147,8 @@ template <typename Dtype>
 void InnerProductLayer<Dtype>::Backward_cpu(
     const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!fused_activation_.enabled())
+      << "Layers with a fused activation only support Forward.";
   if (this->param_propagate_down_[0]) {
     const Dtype* top_diff = top[0]->cpu_diff();
     const Dtype* bottom_data = bottom[0]->cpu_data();
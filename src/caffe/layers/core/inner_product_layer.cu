@@ -15,7 +15,7 @@ void InnerProductLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   if (M_ == 1) {
     caffe_gpu_gemv<Dtype>(CblasNoTrans, N_, K_, (Dtype)1.,
                          weight, bottom_data, (Dtype)0., top_data);
-    if (bias_term_)
+    if (bias_term_ && !fused_activation_.enabled())
       caffe_gpu_axpy<Dtype>(N_, bias_multiplier_.cpu_data()[0],
                             this->blobs_[1]->gpu_data(), top_data);
   } else {
@@ -23,17 +23,25 @@ void InnerProductLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
                           transpose_ ? CblasNoTrans : CblasTrans,
                           M_, N_, K_, (Dtype)1.,
                           bottom_data, weight, (Dtype)0., top_data);
-    if (bias_term_)
+    if (bias_term_ && !fused_activation_.enabled())
       caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
                             bias_multiplier_.gpu_data(),
                             this->blobs_[1]->gpu_data(), (Dtype)1., top_data);
   }
+  if (fused_activation_.enabled()) {
+    const Dtype* bias = bias_term_ ? this->blobs_[1]->gpu_data() : NULL;
+    const Dtype* slope = fused_activation_.has_slope() ?
+        this->blobs_.back()->gpu_data() : NULL;
+    fused_activation_.Forward_gpu(M_, N_, 1, bias, slope, top_data);
+  }
 }
 
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!fused_activation_.enabled())
+      << "Layers with a fused activation only support Forward.";
   if (this->param_propagate_down_[0]) {
     const Dtype* top_diff = top[0]->gpu_diff();
     const Dtype* bottom_data = bottom[0]->gpu_data();
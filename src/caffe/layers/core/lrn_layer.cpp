@@ -1,10 +1,15 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Pixels normalized together by a CrossChannelForward_cpu task.
+const int kPixelRun = 1024;
+
 template <typename Dtype>
 void LRNLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                                  const vector<Blob<Dtype>*>& top) {
@@ -111,40 +116,45 @@ void LRNLayer<Dtype>::CrossChannelForward_cpu(
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   Dtype* scale_data = scale_.mutable_cpu_data();
-  // start with the constant value
-  for (int i = 0; i < scale_.count(); ++i) {
-    scale_data[i] = k_;
-  }
-  Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
-  Dtype* padded_square_data = padded_square.mutable_cpu_data();
-  caffe_set(padded_square.count(), Dtype(0), padded_square_data);
   Dtype alpha_over_size = alpha_ / size_;
-  // go through the images
-  for (int n = 0; n < num_; ++n) {
-    // compute the padded square
-    caffe_sqr(channels_ * height_ * width_, bottom_data + bottom[0]->offset(n),
-              padded_square_data + padded_square.offset(0, pre_pad_));
-    // Create the first channel scale
-    for (int c = 0; c < size_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-                        padded_square_data + padded_square.offset(0, c),
-                        scale_data + scale_.offset(n, 0));
+  // Pixels are independent, so the images are split into runs of pixels.
+  const int spatial_dim = height_ * width_;
+  const int run = std::min(spatial_dim, kPixelRun);
+  const int runs_per_image = (spatial_dim + run - 1) / run;
+  const int grain = std::max(1, kMinParallelWork / (run * channels_));
+  parallel_for(num_ * runs_per_image, grain, [&](int begin, int end) {
+    vector<Dtype> padded_square((channels_ + size_ - 1) * run, Dtype(0));
+    for (int i = begin; i < end; ++i) {
+      const int n = i / runs_per_image;
+      const int pixel = (i % runs_per_image) * run;
+      const int count = std::min(run, spatial_dim - pixel);
+      const Dtype* run_data = bottom_data + bottom[0]->offset(n) + pixel;
+      Dtype* run_scale = scale_data + scale_.offset(n) + pixel;
+      // compute the padded square
+      for (int c = 0; c < channels_; ++c) {
+        caffe_sqr(count, run_data + c * spatial_dim,
+                  &padded_square[(c + pre_pad_) * run]);
+      }
+      // Create the first channel scale, starting with the constant value
+      caffe_set(count, k_, run_scale);
+      for (int c = 0; c < size_; ++c) {
+        caffe_axpy<Dtype>(count, alpha_over_size, &padded_square[c * run],
+                          run_scale);
+      }
+      for (int c = 1; c < channels_; ++c) {
+        Dtype* channel_scale = run_scale + c * spatial_dim;
+        // copy previous scale
+        caffe_copy<Dtype>(count, channel_scale - spatial_dim, channel_scale);
+        // add head
+        caffe_axpy<Dtype>(count, alpha_over_size,
+                          &padded_square[(c + size_ - 1) * run],
+                          channel_scale);
+        // subtract tail
+        caffe_axpy<Dtype>(count, -alpha_over_size,
+                          &padded_square[(c - 1) * run], channel_scale);
+      }
     }
-    for (int c = 1; c < channels_; ++c) {
-      // copy previous scale
-      caffe_copy<Dtype>(height_ * width_, scale_data + scale_.offset(n, c - 1),
-                        scale_data + scale_.offset(n, c));
-      // add head
-      caffe_axpy<Dtype>(
-          height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c + size_ - 1),
-          scale_data + scale_.offset(n, c));
-      // subtract tail
-      caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
-                        padded_square_data + padded_square.offset(0, c - 1),
-                        scale_data + scale_.offset(n, c));
-    }
-  }
+  });
 
   // In the end, compute output
   caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, top_data);
@@ -4,6 +4,7 @@
 
 #include "caffe/layer.hpp"
 #include "caffe/layers/lstm_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
@@ -48,21 +49,23 @@ void LSTMUnitLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* cont = bottom[2]->cpu_data();
   Dtype* C = top[0]->mutable_cpu_data();
   Dtype* H = top[1]->mutable_cpu_data();
+  // The gate activations are computed a row at a time with the vectorized
+  // sigmoid and tanh, in X_acts_ as on the GPU.
+  Dtype* X_acts = X_acts_.mutable_cpu_data();
   for (int n = 0; n < num; ++n) {
+    caffe_sigmoid(3 * hidden_dim_, X, X_acts);
+    caffe_tanh(hidden_dim_, X + 3 * hidden_dim_, X_acts + 3 * hidden_dim_);
     for (int d = 0; d < hidden_dim_; ++d) {
-      const Dtype i = sigmoid(X[d]);
-      const Dtype f =
-          (*cont == 0) ? 0 : (*cont * sigmoid(X[1 * hidden_dim_ + d]));
-      const Dtype o = sigmoid(X[2 * hidden_dim_ + d]);
-      const Dtype g = tanh(X[3 * hidden_dim_ + d]);
-      const Dtype c_prev = C_prev[d];
-      const Dtype c = f * c_prev + i * g;
-      C[d] = c;
-      const Dtype tanh_c = tanh(c);
-      H[d] = o * tanh_c;
+      const Dtype i = X_acts[d];
+      const Dtype f = (*cont == 0) ? 0 : (*cont * X_acts[1 * hidden_dim_ + d]);
+      const Dtype g = X_acts[3 * hidden_dim_ + d];
+      C[d] = f * C_prev[d] + i * g;
     }
+    caffe_tanh(hidden_dim_, C, H);
+    caffe_mul(hidden_dim_, X_acts + 2 * hidden_dim_, H, H);
     C_prev += hidden_dim_;
     X += x_dim;
+    X_acts += x_dim;
     C += hidden_dim_;
     H += hidden_dim_;
     ++cont;
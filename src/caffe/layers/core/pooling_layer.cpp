@@ -4,6 +4,7 @@
 
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -36,9 +37,17 @@ void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       << "Stride is stride OR stride_h and stride_w are required.";
   global_pooling_ = pool_param.global_pooling();
   ceil_mode_ = pool_param.ceil_mode();
+  channels_last_ = this->layer_param_.layout() == NHWC;
+  if (channels_last_) {
+    CHECK_EQ(1, top.size()) << "Channels-last pooling has no mask top.";
+    CHECK(pool_param.pool() == PoolingParameter_PoolMethod_MAX ||
+          pool_param.pool() == PoolingParameter_PoolMethod_AVE)
+        << "Channels-last pooling supports MAX and AVE.";
+  }
+  const int height_axis = channels_last_ ? 1 : 2;
   if (global_pooling_) {
-    kernel_h_ = bottom[0]->height();
-    kernel_w_ = bottom[0]->width();
+    kernel_h_ = bottom[0]->shape(height_axis);
+    kernel_w_ = bottom[0]->shape(height_axis + 1);
   } else {
     if (pool_param.has_kernel_size()) {
       kernel_h_ = kernel_w_ = pool_param.kernel_size();
@@ -82,12 +91,13 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   CHECK_EQ(4, bottom[0]->num_axes())
       << "Input must have 4 axes, "
       << "corresponding to (num, channels, height, width)";
-  channels_ = bottom[0]->channels();
-  height_ = bottom[0]->height();
-  width_ = bottom[0]->width();
+  const int height_axis = channels_last_ ? 1 : 2;
+  channels_ = bottom[0]->shape(channels_last_ ? 3 : 1);
+  height_ = bottom[0]->shape(height_axis);
+  width_ = bottom[0]->shape(height_axis + 1);
   if (global_pooling_) {
-    kernel_h_ = bottom[0]->height();
-    kernel_w_ = bottom[0]->width();
+    kernel_h_ = height_;
+    kernel_w_ = width_;
   }
   pooled_height_ =
       static_cast<int>(ceil(
@@ -130,6 +140,11 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     CHECK_LT((pooled_height_ - 1) * stride_h_, height_ + pad_h_);
     CHECK_LT((pooled_width_ - 1) * stride_w_, width_ + pad_w_);
   }
+  if (channels_last_) {
+    top[0]->Reshape(bottom[0]->num(), pooled_height_, pooled_width_,
+                    channels_);
+    return;
+  }
   top[0]->Reshape(bottom[0]->num(), channels_, pooled_height_, pooled_width_);
   if (top.size() > 1) {
     top[1]->ReshapeLike(*top[0]);
@@ -149,11 +164,70 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void PoolingLayer<Dtype>::ForwardChannelsLast(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const bool max_pool = this->layer_param_.pooling_param().pool() ==
+      PoolingParameter_PoolMethod_MAX;
+  const int channels = channels_;
+  const int grain = max(1, kMinParallelWork /
+      (pooled_width_ * kernel_h_ * kernel_w_ * channels));
+  // Every pixel is a run of channels, so the windows of all channels are
+  // pooled together.
+  parallel_for(bottom[0]->num() * pooled_height_, grain,
+               [&](int begin, int end) {
+    for (int r = begin; r < end; ++r) {
+      const int n = r / pooled_height_;
+      const int ph = r % pooled_height_;
+      for (int pw = 0; pw < pooled_width_; ++pw) {
+        int hstart = ph * stride_h_ - pad_h_;
+        int wstart = pw * stride_w_ - pad_w_;
+        int hend = min(hstart + kernel_h_, height_ + pad_h_);
+        int wend = min(wstart + kernel_w_, width_ + pad_w_);
+        const int pool_size = (hend - hstart) * (wend - wstart);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        hend = min(hend, height_);
+        wend = min(wend, width_);
+        Dtype* out = top_data + (r * pooled_width_ + pw) * channels;
+        std::fill(out, out + channels, max_pool ? Dtype(-FLT_MAX) : Dtype(0));
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            const Dtype* in =
+                bottom_data + ((n * height_ + h) * width_ + w) * channels;
+            if (max_pool) {
+              for (int c = 0; c < channels; ++c) {
+                out[c] = max(out[c], in[c]);
+              }
+            } else {
+              for (int c = 0; c < channels; ++c) {
+                out[c] += in[c];
+              }
+            }
+          }
+        }
+        if (!max_pool) {
+          const Dtype scale = Dtype(1) / pool_size;
+          for (int c = 0; c < channels; ++c) {
+            out[c] *= scale;
+          }
+        }
+      }
+    }
+  });
+}
+
 // TODO(Yangqing): Is there a faster way to do pooling in the channel-first
 // case?
 template <typename Dtype>
 void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                       const vector<Blob<Dtype>*>& top) {
+  if (channels_last_) {
+    ForwardChannelsLast(bottom, top);
+    return;
+  }
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int top_count = top[0]->count();
@@ -161,6 +235,11 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const bool use_top_mask = top.size() > 1;
   int* mask = NULL;  // suppress warnings about uninitalized variables
   Dtype* top_mask = NULL;
+  const int num_planes = bottom[0]->num() * channels_;
+  const int bottom_dim = height_ * width_;
+  const int top_dim = pooled_height_ * pooled_width_;
+  const int grain =
+      max(1, kMinParallelWork / (top_dim * kernel_h_ * kernel_w_));
   // Different pooling methods. We explicitly do the switch outside the for
   // loop to save time, although this results in more code.
   switch (this->layer_param_.pooling_param().pool()) {
@@ -174,9 +253,13 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
         caffe_set(top_count, -1, mask);
       }
       caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-      // The main loop
-      for (int n = 0; n < bottom[0]->num(); ++n) {
-        for (int c = 0; c < channels_; ++c) {
+      // The main loop, over the channels of all images
+      parallel_for(num_planes, grain, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+          const Dtype* plane_data = bottom_data + i * bottom_dim;
+          Dtype* plane_top = top_data + i * top_dim;
+          Dtype* plane_top_mask = use_top_mask ? top_mask + i * top_dim : NULL;
+          int* plane_mask = use_top_mask ? NULL : mask + i * top_dim;
           for (int ph = 0; ph < pooled_height_; ++ph) {
             for (int pw = 0; pw < pooled_width_; ++pw) {
               int hstart = ph * stride_h_ - pad_h_;
@@ -189,36 +272,27 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
               for (int h = hstart; h < hend; ++h) {
                 for (int w = wstart; w < wend; ++w) {
                   const int index = h * width_ + w;
-                  if (bottom_data[index] > top_data[pool_index]) {
-                    top_data[pool_index] = bottom_data[index];
+                  if (plane_data[index] > plane_top[pool_index]) {
+                    plane_top[pool_index] = plane_data[index];
                     if (use_top_mask) {
-                      top_mask[pool_index] = static_cast<Dtype>(index);
+                      plane_top_mask[pool_index] = static_cast<Dtype>(index);
                     } else {
-                      mask[pool_index] = index;
+                      plane_mask[pool_index] = index;
                     }
                   }
                 }
               }
             }
           }
-          // compute offset
-          bottom_data += bottom[0]->offset(0, 1);
-          top_data += top[0]->offset(0, 1);
-          if (use_top_mask) {
-            top_mask += top[0]->offset(0, 1);
-          } else {
-            mask += top[0]->offset(0, 1);
-          }
         }
-      }
+      });
       break;
     case PoolingParameter_PoolMethod_AVE:
-      for (int i = 0; i < top_count; ++i) {
-        top_data[i] = 0;
-      }
-      // The main loop
-      for (int n = 0; n < bottom[0]->num(); ++n) {
-        for (int c = 0; c < channels_; ++c) {
+      // The main loop, over the channels of all images
+      parallel_for(num_planes, grain, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+          const Dtype* plane_data = bottom_data + i * bottom_dim;
+          Dtype* plane_top = top_data + i * top_dim;
           for (int ph = 0; ph < pooled_height_; ++ph) {
             for (int pw = 0; pw < pooled_width_; ++pw) {
               int hstart = ph * stride_h_ - pad_h_;
@@ -230,20 +304,17 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
               wstart = max(wstart, 0);
               hend = min(hend, height_);
               wend = min(wend, width_);
+              Dtype sum = 0;
               for (int h = hstart; h < hend; ++h) {
                 for (int w = wstart; w < wend; ++w) {
-                  top_data[ph * pooled_width_ + pw] +=
-                      bottom_data[h * width_ + w];
+                  sum += plane_data[h * width_ + w];
                 }
               }
-              top_data[ph * pooled_width_ + pw] /= pool_size;
+              plane_top[ph * pooled_width_ + pw] = sum / pool_size;
             }
           }
-          // compute offset
-          bottom_data += bottom[0]->offset(0, 1);
-          top_data += top[0]->offset(0, 1);
         }
-      }
+      });
       break;
     case PoolingParameter_PoolMethod_STOCHASTIC:
       NOT_IMPLEMENTED;
@@ -257,6 +328,7 @@ template <typename Dtype>
 void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                        const vector<bool>& propagate_down,
                                        const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!channels_last_) << "Channels-last pooling only supports Forward.";
   if (!propagate_down[0]) {
     return;
   }
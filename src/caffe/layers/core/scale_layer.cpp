@@ -129,12 +129,22 @@ void ScaleLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* scale_data =
       ((bottom.size() > 1) ? bottom[1] : this->blobs_[0].get())->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int n = 0; n < outer_dim_; ++n) {
-    for (int d = 0; d < scale_dim_; ++d) {
-      const Dtype factor = scale_data[d];
-      caffe_cpu_scale(inner_dim_, factor, bottom_data, top_data);
-      bottom_data += inner_dim_;
-      top_data += inner_dim_;
+  if (inner_dim_ == 1) {
+    // Scaling the last axis, e.g. the channels of NHWC blobs: multiply whole
+    // rows at once.
+    for (int n = 0; n < outer_dim_; ++n) {
+      caffe_mul(scale_dim_, bottom_data, scale_data, top_data);
+      bottom_data += scale_dim_;
+      top_data += scale_dim_;
+    }
+  } else {
+    for (int n = 0; n < outer_dim_; ++n) {
+      for (int d = 0; d < scale_dim_; ++d) {
+        const Dtype factor = scale_data[d];
+        caffe_cpu_scale(inner_dim_, factor, bottom_data, top_data);
+        bottom_data += inner_dim_;
+        top_data += inner_dim_;
+      }
     }
   }
   if (bias_layer_) {
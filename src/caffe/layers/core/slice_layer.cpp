@@ -69,6 +69,51 @@ void SliceLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (top.size() == 1) {
     top[0]->ShareData(*bottom[0]);
     top[0]->ShareDiff(*bottom[0]);
+    return;
+  }
+  DetachStaleViews(bottom, top);
+  if (this->phase_ == TEST && num_slices_ == 1) {
+    ShareTopViews(bottom, top);
+  }
+}
+
+template <typename Dtype>
+void SliceLayer<Dtype>::DetachStaleViews(const vector<Blob<Dtype>*>& bottom,
+                                         const vector<Blob<Dtype>*>& top) {
+  const bool use_views = this->phase_ == TEST && num_slices_ == 1;
+  int offset = 0;
+  for (int i = 0; i < top.size(); ++i) {
+    const int count = top[i]->count();
+    // Copying into such a view would overwrite the input.
+    if (top[i]->data()->parent() == bottom[0]->data() &&
+        !(use_views && top[i]->DataIsViewOf(*bottom[0], offset))) {
+      top[i]->ShareDataMemory(shared_ptr<SyncedMemory>(
+          new SyncedMemory(count * sizeof(Dtype))));
+    }
+    offset += count;
+  }
+}
+
+template <typename Dtype>
+void SliceLayer<Dtype>::ShareTopViews(const vector<Blob<Dtype>*>& bottom,
+                                      const vector<Blob<Dtype>*>& top) {
+  const shared_ptr<SyncedMemory>& bottom_memory = bottom[0]->data();
+  int num_views = 0;
+  for (int i = 0; i < top.size(); ++i) {
+    num_views += top[i]->data()->parent() == bottom_memory;
+  }
+  // Memory also held elsewhere, e.g. by the Net memory planner or a layer
+  // sharing it, keeps the copying path.
+  if (bottom_memory.use_count() != 1 + num_views) {
+    return;
+  }
+  int offset = 0;
+  for (int i = 0; i < top.size(); ++i) {
+    if (top[i]->data().use_count() == 1 &&
+        !top[i]->DataIsViewOf(*bottom[0], offset)) {
+      top[i]->ShareDataView(*bottom[0], offset);
+    }
+    offset += top[i]->count();
   }
 }
 
@@ -82,8 +127,14 @@ void SliceLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   const int bottom_slice_axis = bottom[0]->shape(slice_axis_);
   for (int i = 0; i < top.size(); ++i) {
-    Dtype* top_data = top[i]->mutable_cpu_data();
     const int top_slice_axis = top[i]->shape(slice_axis_);
+    if (top[i]->DataIsViewOf(*bottom[0],
+        offset_slice_axis * slice_size_)) {
+      // The view already holds its slice of bottom.
+      offset_slice_axis += top_slice_axis;
+      continue;
+    }
+    Dtype* top_data = top[i]->mutable_cpu_data();
     for (int n = 0; n < num_slices_; ++n) {
       const int top_offset = n * top_slice_axis * slice_size_;
       const int bottom_offset =
@@ -12,9 +12,9 @@ void SplitLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   for (int i = 0; i < top.size(); ++i) {
     // Do not allow in-place computation in the SplitLayer.  Instead, share data
     // by reference in the forward pass, and keep separate diff allocations in
-    // the backward pass.  (Technically, it should be possible to share the diff
-    // blob of the first split output with the input, but this seems to cause
-    // some strange effects in practice...)
+    // the backward pass.  (Within a Net, the consumers of the outputs may
+    // accumulate straight into the input diff instead; see
+    // Net::PlanSplitBackward.)
     CHECK_NE(top[i], bottom[0]) << this->type()
                                 << " Layer does not "
                                    "allow in-place computation.";
@@ -1,7 +1,37 @@
+#include <algorithm>
+
 #include "caffe/layers/transpose_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Transpose num (rows x cols) matrices into (cols x rows) ones, in tiles that
+// keep the reads and the writes within a few cache lines each.
+template <typename Dtype>
+void batched_transpose_cpu(const int num, const int rows, const int cols,
+                           const Dtype* from_data, Dtype* to_data) {
+  const int kTile = 16;
+  const int row_tiles = (rows + kTile - 1) / kTile;
+  const int grain = std::max(1, kMinParallelWork / (kTile * cols));
+  parallel_for(num * row_tiles, grain, [&](int begin, int end) {
+    for (int t = begin; t < end; ++t) {
+      const int n = t / row_tiles;
+      const int row_begin = t % row_tiles * kTile;
+      const int row_end = std::min(rows, row_begin + kTile);
+      const Dtype* from = from_data + static_cast<int64_t>(n) * rows * cols;
+      Dtype* to = to_data + static_cast<int64_t>(n) * rows * cols;
+      for (int col_begin = 0; col_begin < cols; col_begin += kTile) {
+        const int col_end = std::min(cols, col_begin + kTile);
+        for (int c = col_begin; c < col_end; ++c) {
+          for (int r = row_begin; r < row_end; ++r) {
+            to[c * rows + r] = from[r * cols + c];
+          }
+        }
+      }
+    }
+  });
+}
+
 template <typename Dtype>
 void transpose_cpu(const int count, const Dtype* from_data, Dtype* to_data,
                    const int* from_counts, const int* to_counts, const int* map,
@@ -78,6 +108,25 @@ void TransposeLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   shape.clear();
   shape.push_back(bottom[0]->count() * num_axes);
   buf_.Reshape(shape);
+
+  // Whether dims keeps the first axes and swaps the two blocks of axes after
+  // them, (outer, rows, cols) -> (outer, cols, rows), as NCHW <-> NHWC do.
+  int first = 0;
+  while (first < num_axes && transpose_param_.dim(first) == first) {
+    ++first;
+  }
+  batched_ = first < num_axes;
+  if (batched_) {
+    const int split = transpose_param_.dim(first);
+    for (int i = first; i < num_axes; ++i) {
+      const int from = i < first + num_axes - split ?
+          split + i - first : i - (num_axes - split);
+      batched_ &= transpose_param_.dim(i) == from;
+    }
+    outer_ = bottom[0]->count(0, first);
+    rows_ = bottom[0]->count(first, split);
+    cols_ = bottom[0]->count(split);
+  }
 }
 
 template <typename Dtype>
@@ -92,6 +141,11 @@ vector<int> TransposeLayer<Dtype>::permute(const vector<int>& vec) {
 template <typename Dtype>
 void TransposeLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                         const vector<Blob<Dtype>*>& top) {
+  if (batched_) {
+    batched_transpose_cpu(outer_, rows_, cols_, bottom[0]->cpu_data(),
+                          top[0]->mutable_cpu_data());
+    return;
+  }
   transpose_cpu<Dtype>(bottom[0]->count(), bottom[0]->cpu_data(),
                        top[0]->mutable_cpu_data(), bottom_counts_.cpu_data(),
                        top_counts_.cpu_data(), forward_map_.cpu_data(),
@@ -105,6 +159,11 @@ void TransposeLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   if (!propagate_down[0]) {
     return;
   }
+  if (batched_) {
+    batched_transpose_cpu(outer_, cols_, rows_, top[0]->cpu_diff(),
+                          bottom[0]->mutable_cpu_diff());
+    return;
+  }
   transpose_cpu<Dtype>(bottom[0]->count(), top[0]->cpu_diff(),
                        bottom[0]->mutable_cpu_diff(), top_counts_.cpu_data(),
                        bottom_counts_.cpu_data(), backward_map_.cpu_data(),
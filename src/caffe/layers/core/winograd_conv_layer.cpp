@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The F(m x m, 3 x 3) transforms: Y = A^T [(G g G^T) .* (B^T d B)] A, from
+// Lavin & Gray, "Fast Algorithms for Convolutional Neural Networks".
+const double kF2BT[4 * 4] = {
+  1,  0, -1,  0,
+  0,  1,  1,  0,
+  0, -1,  1,  0,
+  0,  1,  0, -1,
+};
+const double kF2G[4 * 3] = {
+  1,    0,   0,
+  0.5,  0.5, 0.5,
+  0.5, -0.5, 0.5,
+  0,    0,   1,
+};
+const double kF2AT[2 * 4] = {
+  1, 1,  1,  0,
+  0, 1, -1, -1,
+};
+const double kF4BT[6 * 6] = {
+  4,  0, -5,  0, 1, 0,
+  0, -4, -4,  1, 1, 0,
+  0,  4, -4, -1, 1, 0,
+  0, -2, -1,  2, 1, 0,
+  0,  2, -1, -2, 1, 0,
+  0,  4,  0, -5, 0, 1,
+};
+const double kF4G[6 * 3] = {
+  1. / 4,   0,       0,
+  -1. / 6,  -1. / 6,  -1. / 6,
+  -1. / 6,  1. / 6,   -1. / 6,
+  1. / 24,  1. / 12,  1. / 6,
+  1. / 24,  -1. / 12, 1. / 6,
+  0,        0,        1,
+};
+const double kF4AT[4 * 6] = {
+  1, 1,  1, 1,  1, 0,
+  0, 1, -1, 2, -2, 0,
+  0, 1,  1, 4,  4, 0,
+  0, 1, -1, 8, -8, 1,
+};
+
+// out (rows x cols) = L (rows x inner) * in (inner x cols) * R^T, with R
+// (cols x inner); tmp holds rows x inner.
+template <typename Dtype>
+void Sandwich(const double* L, const Dtype* in, const double* R,
+              const int rows, const int inner, const int cols, Dtype* tmp,
+              Dtype* out) {
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < inner; ++j) {
+      Dtype sum = 0;
+      for (int k = 0; k < inner; ++k) {
+        sum += Dtype(L[i * inner + k]) * in[k * inner + j];
+      }
+      tmp[i * inner + j] = sum;
+    }
+  }
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      Dtype sum = 0;
+      for (int k = 0; k < inner; ++k) {
+        sum += tmp[i * inner + k] * Dtype(R[j * inner + k]);
+      }
+      out[i * cols + j] = sum;
+    }
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::LayerSetUp(bottom, top);
+  const ConvolutionParameter& conv_param =
+      this->layer_param_.convolution_param();
+  tile_ = conv_param.winograd_tile();
+  CHECK(tile_ == 2 || tile_ == 4) << "winograd_tile must be 2 or 4.";
+  alpha_ = tile_ + 2;
+  use_winograd_ = this->num_spatial_axes_ == 2 && !this->force_nd_im2col_;
+  for (int i = 0; i < this->num_spatial_axes_ && use_winograd_; ++i) {
+    use_winograd_ = this->kernel_shape_.cpu_data()[i] == 3 &&
+                    this->stride_.cpu_data()[i] == 1 &&
+                    this->dilation_.cpu_data()[i] == 1;
+  }
+  LOG_IF(INFO, !use_winograd_) << "Layer " << this->layer_param_.name()
+      << " is not a 3x3 stride 1 convolution; using the CAFFE engine.";
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  if (!use_winograd_) {
+    return;
+  }
+  tiles_h_ = (this->output_shape_[0] + tile_ - 1) / tile_;
+  tiles_w_ = (this->output_shape_[1] + tile_ - 1) / tile_;
+  const int group_channels = this->channels_ / this->group_;
+  const int group_outputs = this->num_output_ / this->group_;
+  // Bound the transform buffers to about 2M elements each.
+  const int kChunkElements = 1 << 21;
+  const int num_tiles = this->num_ * tiles_h_ * tiles_w_;
+  tile_chunk_ = std::max(1, std::min(num_tiles, kChunkElements /
+      (alpha_ * alpha_ * std::max(group_channels, group_outputs))));
+  transformed_input_.Reshape(1, alpha_ * alpha_, group_channels, tile_chunk_);
+  transformed_output_.Reshape(1, alpha_ * alpha_, group_outputs, tile_chunk_);
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformWeights() {
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  if (weight_memory_ == weights.data().get() &&
+      weight_version_ == weights.data()->version()) {
+    return;
+  }
+  const double* G = tile_ == 2 ? kF2G : kF4G;
+  const int num_output = this->num_output_;
+  const int group_channels = this->channels_ / this->group_;
+  transformed_weights_.Reshape(1, alpha_ * alpha_, num_output,
+                               group_channels);
+  Dtype* transformed = transformed_weights_.mutable_cpu_data();
+  const Dtype* weight = weights.cpu_data();
+  vector<Dtype> tmp(alpha_ * 3);
+  vector<Dtype> u(alpha_ * alpha_);
+  for (int k = 0; k < num_output; ++k) {
+    for (int c = 0; c < group_channels; ++c) {
+      // u = G g G^T
+      const Dtype* g = weight + (k * group_channels + c) * 9;
+      for (int i = 0; i < alpha_; ++i) {
+        for (int j = 0; j < 3; ++j) {
+          tmp[i * 3 + j] = Dtype(G[i * 3]) * g[j] +
+              Dtype(G[i * 3 + 1]) * g[3 + j] + Dtype(G[i * 3 + 2]) * g[6 + j];
+        }
+      }
+      for (int i = 0; i < alpha_; ++i) {
+        for (int j = 0; j < alpha_; ++j) {
+          u[i * alpha_ + j] = tmp[i * 3] * Dtype(G[j * 3]) +
+              tmp[i * 3 + 1] * Dtype(G[j * 3 + 1]) +
+              tmp[i * 3 + 2] * Dtype(G[j * 3 + 2]);
+        }
+      }
+      for (int xi = 0; xi < alpha_ * alpha_; ++xi) {
+        transformed[(xi * num_output + k) * group_channels + c] = u[xi];
+      }
+    }
+  }
+  weight_memory_ = weights.data().get();
+  weight_version_ = weights.data()->version();
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformInput(const Dtype* input,
+    const int group, const int tile_begin, const int tile_end) {
+  const double* BT = tile_ == 2 ? kF2BT : kF4BT;
+  const int height = this->conv_input_shape_.cpu_data()[1];
+  const int width = this->conv_input_shape_.cpu_data()[2];
+  const int pad_h = this->pad_.cpu_data()[0];
+  const int pad_w = this->pad_.cpu_data()[1];
+  const int group_channels = this->channels_ / this->group_;
+  const int tiles = tile_end - tile_begin;
+  const int tiles_per_image = tiles_h_ * tiles_w_;
+  Dtype* transformed = transformed_input_.mutable_cpu_data();
+  vector<Dtype> d(alpha_ * alpha_);
+  vector<Dtype> tmp(alpha_ * alpha_);
+  vector<Dtype> v(alpha_ * alpha_);
+  for (int t = tile_begin; t < tile_end; ++t) {
+    const int n = t / tiles_per_image;
+    const int y0 = (t % tiles_per_image) / tiles_w_ * tile_ - pad_h;
+    const int x0 = (t % tiles_per_image) % tiles_w_ * tile_ - pad_w;
+    const bool interior = y0 >= 0 && x0 >= 0 && y0 + alpha_ <= height &&
+                          x0 + alpha_ <= width;
+    for (int c = 0; c < group_channels; ++c) {
+      const Dtype* plane = input + n * this->bottom_dim_ +
+          (group * group_channels + c) * height * width;
+      for (int i = 0; i < alpha_; ++i) {
+        const int y = y0 + i;
+        for (int j = 0; j < alpha_; ++j) {
+          const int x = x0 + j;
+          d[i * alpha_ + j] = interior ||
+              (y >= 0 && y < height && x >= 0 && x < width) ?
+              plane[y * width + x] : Dtype(0);
+        }
+      }
+      // v = B^T d B
+      Sandwich(BT, d.data(), BT, alpha_, alpha_, alpha_, tmp.data(),
+               v.data());
+      for (int xi = 0; xi < alpha_ * alpha_; ++xi) {
+        transformed[(xi * group_channels + c) * tiles + t - tile_begin] =
+            v[xi];
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformOutput(const int group,
+    const int tile_begin, const int tile_end, Dtype* output) {
+  const double* AT = tile_ == 2 ? kF2AT : kF4AT;
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int group_outputs = this->num_output_ / this->group_;
+  const int tiles = tile_end - tile_begin;
+  const int tiles_per_image = tiles_h_ * tiles_w_;
+  const Dtype* transformed = transformed_output_.cpu_data();
+  vector<Dtype> m(alpha_ * alpha_);
+  vector<Dtype> tmp(tile_ * alpha_);
+  vector<Dtype> y(tile_ * tile_);
+  for (int t = tile_begin; t < tile_end; ++t) {
+    const int n = t / tiles_per_image;
+    const int y0 = (t % tiles_per_image) / tiles_w_ * tile_;
+    const int x0 = (t % tiles_per_image) % tiles_w_ * tile_;
+    const int rows = std::min(tile_, output_h - y0);
+    const int cols = std::min(tile_, output_w - x0);
+    for (int k = 0; k < group_outputs; ++k) {
+      for (int xi = 0; xi < alpha_ * alpha_; ++xi) {
+        m[xi] = transformed[(xi * group_outputs + k) * tiles + t - tile_begin];
+      }
+      // y = A^T m A
+      Sandwich(AT, m.data(), AT, tile_, alpha_, tile_, tmp.data(), y.data());
+      Dtype* plane = output + n * this->top_dim_ +
+          (group * group_outputs + k) * output_h * output_w;
+      for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+          plane[(y0 + i) * output_w + x0 + j] = y[i * tile_ + j];
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_winograd_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  TransformWeights();
+  const int num_output = this->num_output_;
+  const int group_channels = this->channels_ / this->group_;
+  const int group_outputs = num_output / this->group_;
+  const int num_tiles = this->num_ * tiles_h_ * tiles_w_;
+  const Dtype* weights = transformed_weights_.cpu_data();
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int g = 0; g < this->group_; ++g) {
+      for (int begin = 0; begin < num_tiles; begin += tile_chunk_) {
+        const int end = std::min(num_tiles, begin + tile_chunk_);
+        const int tiles = end - begin;
+        TransformInput(bottom_data, g, begin, end);
+        const Dtype* input = transformed_input_.cpu_data();
+        Dtype* output = transformed_output_.mutable_cpu_data();
+        for (int xi = 0; xi < alpha_ * alpha_; ++xi) {
+          caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, group_outputs,
+              tiles, group_channels, (Dtype)1.,
+              weights + (xi * num_output + g * group_outputs) * group_channels,
+              input + xi * group_channels * tiles, (Dtype)0.,
+              output + xi * group_outputs * tiles);
+        }
+        TransformOutput(g, begin, end, top_data);
+      }
+    }
+    if (this->bias_term_ || this->fused_activation_.enabled()) {
+      const Dtype* bias =
+          this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+      for (int n = 0; n < this->num_; ++n) {
+        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(WinogradConvolutionLayer);
+
+}  // namespace caffe
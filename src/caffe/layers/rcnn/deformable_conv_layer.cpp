@@ -1,7 +1,10 @@
 #include "caffe/layers/deformable_conv_layer.hpp"
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include "caffe/filler.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 using namespace std;
 namespace caffe {
 template <typename Dtype>
@@ -64,6 +67,7 @@ void DeformableConvolutionLayer<Dtype>::Reshape(
     }
   }
   this->col_buffer_.Reshape(this->col_buffer_shape_);
+  this->reshape_col_tiles();
 
   this->input_offset_dim_ = bottom[1]->count(this->channel_axis_);
 
@@ -105,11 +109,14 @@ void DeformableConvolutionLayer<Dtype>::LayerSetUp(
   DeformableConvolutionParameter conv_param =
       this->layer_param_.deformable_convolution_param();
   this->force_nd_im2col_ = conv_param.force_nd_im2col();
+  CHECK(!this->force_nd_im2col_)
+      << "Deformable convolution has no N-D im2col.";
   this->channel_axis_ = bottom[0]->CanonicalAxisIndex(conv_param.axis());
   const int first_spatial_axis = this->channel_axis_ + 1;
   const int num_axes = bottom[0]->num_axes();
   this->num_spatial_axes_ = num_axes - first_spatial_axis;
-  CHECK_GE(this->num_spatial_axes_, 0);
+  CHECK_EQ(this->num_spatial_axes_, 2)
+      << "Deformable convolution only supports 2D inputs.";
   vector<int> bottom_dim_blob_shape(1, this->num_spatial_axes_ + 1);
   vector<int> spatial_dim_blob_shape(1, std::max(this->num_spatial_axes_, 1));
   // Setup filter kernel dimensions (kernel_shape_).
@@ -201,16 +208,10 @@ void DeformableConvolutionLayer<Dtype>::LayerSetUp(
             ? kDefaultDilation
             : conv_param.dilation((num_dilation_dims == 1) ? 0 : i);
   }
-  // Special case: im2col is the identity for 1x1 convolution with stride 1
-  // and no padding, so flag for skipping the buffer and transformation.
-  this->is_1x1_ = true;
-  for (int i = 0; i < this->num_spatial_axes_; ++i) {
-    this->is_1x1_ &=
-        kernel_shape_data[i] == 1 && stride_data[i] == 1 && pad_data[i] == 0;
-    if (!this->is_1x1_) {
-      break;
-    }
-  }
+  // The offsets move the taps of 1x1 kernels too, so the columns are always
+  // built.
+  this->is_1x1_ = false;
+  this->is_pointwise_ = false;
   // Configure output channels and groups.
   this->channels_ = bottom[0]->shape(this->channel_axis_);
   this->num_output_ =
@@ -297,9 +298,151 @@ void DeformableConvolutionLayer<Dtype>::LayerSetUp(
   this->param_propagate_down_.resize(this->blobs_.size(), true);
 }
 
+template <typename Dtype>
+void DeformableConvolutionLayer<Dtype>::col_tile_rows(int tile, int* row_begin,
+                                                      int* row_end) {
+  *row_begin = tile * this->col_tile_rows_;
+  *row_end = std::min(*row_begin + this->col_tile_rows_,
+                      this->output_shape_[0]);
+}
+
+template <typename Dtype>
+void DeformableConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Dtype* weights = this->blobs_[0]->cpu_data();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* offset = bottom[1]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const int workers = this->col_tile_workers_;
+  const int tasks = this->num_ * this->col_tiles_;
+  const int group_out_channels = this->conv_out_channels_ / this->group_;
+  Dtype* col_buff = this->col_tile_buffer_.mutable_cpu_data();
+  Dtype* output_tile = this->col_tiles_ > 1 ?
+      this->output_tile_buffer_.mutable_cpu_data() : NULL;
+  const int col_tile_count = this->col_tile_buffer_.count(1);
+  const int output_tile_count = this->output_tile_buffer_.count(1);
+  parallel_for(workers, 1, [&](int begin, int end) {
+    for (int worker = begin; worker < end; ++worker) {
+      Dtype* worker_col_buff = col_buff + worker * col_tile_count;
+      Dtype* worker_output_tile =
+          output_tile ? output_tile + worker * output_tile_count : NULL;
+      for (int task = worker; task < tasks; task += workers) {
+        const int n = task / this->col_tiles_;
+        const int tile = task % this->col_tiles_;
+        int row_begin, row_end;
+        col_tile_rows(tile, &row_begin, &row_end);
+        const int columns = (row_end - row_begin) * this->output_shape_[1];
+        deformable_im2col_rows(bottom_data + n * this->bottom_dim_,
+                               offset + n * input_offset_dim_, row_begin,
+                               row_end, worker_col_buff);
+        Dtype* output = top_data + n * this->top_dim_;
+        Dtype* gemm_output = output_tile ? worker_output_tile : output;
+        for (int g = 0; g < this->group_; ++g) {
+          caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans,
+              group_out_channels, columns, this->kernel_dim_, (Dtype)1.,
+              weights + this->weight_offset_ * g,
+              worker_col_buff + this->kernel_dim_ * columns * g, (Dtype)0.,
+              gemm_output + group_out_channels * columns * g);
+        }
+        if (output_tile) {
+          this->scatter_output_tile(tile, worker_output_tile, output);
+        }
+      }
+    }
+  });
+  if (this->bias_term_) {
+    const Dtype* bias = this->blobs_[1]->cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+    }
+  }
+}
+
+template <typename Dtype>
+void DeformableConvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  const Dtype* weights = this->blobs_[0]->cpu_data();
+  const Dtype* top_diff = top[0]->cpu_diff();
+  if (this->bias_term_ && this->param_propagate_down_[1]) {
+    Dtype* bias_diff = this->blobs_[1]->mutable_cpu_diff();
+    for (int n = 0; n < this->num_; ++n) {
+      this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
+    }
+  }
+  if (!this->param_propagate_down_[0] && !propagate_down[0] &&
+      !propagate_down[1]) {
+    return;
+  }
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* offset = bottom[1]->cpu_data();
+  Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
+  Dtype* bottom_diff = NULL;
+  if (propagate_down[0]) {
+    bottom_diff = bottom[0]->mutable_cpu_diff();
+    caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
+  }
+  Dtype* offset_diff = propagate_down[1] ? bottom[1]->mutable_cpu_diff() :
+      NULL;
+  // The tiles of an image add to the same weight and bottom diffs, so they
+  // go one at a time; the deformable im2col and col2im split them between
+  // threads by channel.
+  const int group_out_channels = this->conv_out_channels_ / this->group_;
+  Dtype* col_buff = this->col_tile_buffer_.mutable_cpu_data();
+  Dtype* output_tile = this->col_tiles_ > 1 ?
+      this->output_tile_buffer_.mutable_cpu_data() : NULL;
+  for (int n = 0; n < this->num_; ++n) {
+    const Dtype* data = bottom_data + n * this->bottom_dim_;
+    const Dtype* data_offset = offset + n * input_offset_dim_;
+    for (int tile = 0; tile < this->col_tiles_; ++tile) {
+      int row_begin, row_end;
+      col_tile_rows(tile, &row_begin, &row_end);
+      const int columns = (row_end - row_begin) * this->output_shape_[1];
+      const Dtype* tile_diff = top_diff + n * this->top_dim_;
+      if (output_tile) {
+        this->gather_output_tile(tile, tile_diff, output_tile);
+        tile_diff = output_tile;
+      }
+      // gradient w.r.t. weight. Note that we will accumulate diffs.
+      if (this->param_propagate_down_[0]) {
+        deformable_im2col_rows(data, data_offset, row_begin, row_end,
+                               col_buff);
+        for (int g = 0; g < this->group_; ++g) {
+          caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, group_out_channels,
+              this->kernel_dim_, columns, (Dtype)1.,
+              tile_diff + group_out_channels * columns * g,
+              col_buff + this->kernel_dim_ * columns * g, (Dtype)1.,
+              weight_diff + this->weight_offset_ * g);
+        }
+      }
+      if (!propagate_down[0] && !propagate_down[1]) {
+        continue;
+      }
+      for (int g = 0; g < this->group_; ++g) {
+        caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, this->kernel_dim_,
+            columns, group_out_channels, (Dtype)1.,
+            weights + this->weight_offset_ * g,
+            tile_diff + group_out_channels * columns * g, (Dtype)0.,
+            col_buff + this->kernel_dim_ * columns * g);
+      }
+      // gradient w.r.t. the offsets of the rows of the tile.
+      if (propagate_down[1]) {
+        deformable_col2im_coord_rows(col_buff, data, data_offset, row_begin,
+            row_end, offset_diff + n * input_offset_dim_);
+      }
+      // gradient w.r.t. bottom data.
+      if (propagate_down[0]) {
+        deformable_col2im_rows(col_buff, data_offset, row_begin, row_end,
+                               bottom_diff + n * this->bottom_dim_);
+      }
+    }
+  }
+}
+
 #ifndef USE_CUDA
 STUB_GPU(DeformableConvolutionLayer);
 #endif
 INSTANTIATE_CLASS(DeformableConvolutionLayer);
+REGISTER_LAYER_CLASS(DeformableConvolution);
 
 }  // namespace caffe
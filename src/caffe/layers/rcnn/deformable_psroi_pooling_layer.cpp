@@ -12,6 +12,7 @@
 
 #include "caffe/layers/deformable_psroi_pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 using std::ceil;
 using std::floor;
@@ -55,6 +56,246 @@ void DeformablePSROIPoolingLayer<Dtype>::Reshape(
                            pooled_width_);
 }
 
+namespace {
+
+// The samples of bin (ph, pw) of an ROI: sample (ih, iw) is at
+// (hstart + ih * sub_bin_size_h, wstart + iw * sub_bin_size_w). A
+// translation (trans_x, trans_y) from bottom[2] moves them by
+// (trans_y * roi_height, trans_x * roi_width) when there is one.
+template <typename Dtype>
+struct DeformablePSROIBin {
+  Dtype roi_width, roi_height;
+  Dtype wstart, hstart;
+  Dtype sub_bin_size_w, sub_bin_size_h;
+  // trans_x is at trans_index and trans_y at trans_index + trans_step.
+  int trans_index, trans_step;
+
+  DeformablePSROIBin(const Dtype* roi, const Dtype* bottom_trans,
+      const Dtype spatial_scale, const Dtype trans_std, const int n,
+      const int class_id, const int num_classes, const int part_size,
+      const int sample_per_part, const int pooled_height,
+      const int pooled_width, const int ph, const int pw) {
+    Dtype roi_start_w =
+        static_cast<Dtype>(round(roi[1])) * spatial_scale - 0.5;
+    Dtype roi_start_h =
+        static_cast<Dtype>(round(roi[2])) * spatial_scale - 0.5;
+    Dtype roi_end_w =
+        static_cast<Dtype>(round(roi[3]) + 1.) * spatial_scale - 0.5;
+    Dtype roi_end_h =
+        static_cast<Dtype>(round(roi[4]) + 1.) * spatial_scale - 0.5;
+    // Force too small ROIs to be 1x1
+    roi_width = max<Dtype>(roi_end_w - roi_start_w, 0.1);  // avoid 0
+    roi_height = max<Dtype>(roi_end_h - roi_start_h, 0.1);
+    Dtype bin_size_h = roi_height / static_cast<Dtype>(pooled_height);
+    Dtype bin_size_w = roi_width / static_cast<Dtype>(pooled_width);
+    sub_bin_size_h = bin_size_h / static_cast<Dtype>(sample_per_part);
+    sub_bin_size_w = bin_size_w / static_cast<Dtype>(sample_per_part);
+    wstart = static_cast<Dtype>(pw) * bin_size_w + roi_start_w;
+    hstart = static_cast<Dtype>(ph) * bin_size_h + roi_start_h;
+    int part_h = floor(static_cast<Dtype>(ph) / pooled_height * part_size);
+    int part_w = floor(static_cast<Dtype>(pw) / pooled_width * part_size);
+    trans_step = part_size * part_size;
+    trans_index = ((n * num_classes + class_id) * 2 * part_size + part_h) *
+        part_size + part_w;
+    if (bottom_trans) {
+      wstart += bottom_trans[trans_index] * trans_std * roi_width;
+      hstart += bottom_trans[trans_index + trans_step] * trans_std *
+          roi_height;
+    }
+  }
+};
+
+// The group_size^2 channels of output channel ctop start at
+// ctop * group_size^2, and bin (ph, pw) reads channel (gh, gw) of them.
+inline int DeformablePSROIGroupChannel(const int ph, const int pw,
+    const int pooled_height, const int pooled_width, const int group_size) {
+  int gw = floor(static_cast<float>(pw) * group_size / pooled_width);
+  int gh = floor(static_cast<float>(ph) * group_size / pooled_height);
+  gw = min(max(gw, 0), group_size - 1);
+  gh = min(max(gh, 0), group_size - 1);
+  return gh * group_size + gw;
+}
+
+}  // namespace
+
+template <typename Dtype>
+void DeformablePSROIPoolingLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* bottom_rois = bottom[1]->cpu_data();
+  const Dtype* bottom_trans = no_trans_ ? NULL : bottom[2]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  Dtype* top_count = mapping_channel_.mutable_cpu_data();
+  const int num_classes = no_trans_ ? 1 : bottom[2]->channels() / 2;
+  const int channels_each_class =
+      no_trans_ ? output_dim_ : output_dim_ / num_classes;
+  const int group_dim = group_size_ * group_size_;
+  const int pooled_dim = pooled_height_ * pooled_width_;
+  const int grain = std::max(1, kMinParallelWork /
+      (4 * pooled_dim * sample_per_part_ * sample_per_part_));
+  // Each task is an (n, ctop) pair, whose bins read the group_size^2
+  // consecutive channels of ctop.
+  parallel_for(bottom[1]->num() * output_dim_, grain,
+               [&](int begin, int end) {
+    for (int index = begin; index < end; ++index) {
+      const int n = index / output_dim_;
+      const int ctop = index % output_dim_;
+      const Dtype* roi = bottom_rois + n * 5;
+      int roi_batch_ind = roi[0];
+      const Dtype* data = bottom_data +
+          (roi_batch_ind * channels_ + ctop * group_dim) * height_ * width_;
+      for (int ph = 0; ph < pooled_height_; ++ph) {
+        for (int pw = 0; pw < pooled_width_; ++pw) {
+          // The output is in order (n, ctop, ph, pw)
+          const int pool_index = index * pooled_dim + ph * pooled_width_ + pw;
+          const DeformablePSROIBin<Dtype> bin(roi, bottom_trans,
+              spatial_scale_, trans_std_, n, ctop / channels_each_class,
+              num_classes, part_size_, sample_per_part_, pooled_height_,
+              pooled_width_, ph, pw);
+          const Dtype* plane = data + DeformablePSROIGroupChannel(ph, pw,
+              pooled_height_, pooled_width_, group_size_) * height_ * width_;
+          Dtype sum = 0;
+          int count = 0;
+          for (int ih = 0; ih < sample_per_part_; ++ih) {
+            for (int iw = 0; iw < sample_per_part_; ++iw) {
+              Dtype w = bin.wstart + iw * bin.sub_bin_size_w;
+              Dtype h = bin.hstart + ih * bin.sub_bin_size_h;
+              if (w < -0.5 || w > width_ - 0.5 || h < -0.5 ||
+                  h > height_ - 0.5) {
+                continue;
+              }
+              w = min<Dtype>(max<Dtype>(w, 0.), width_ - 1.);
+              h = min<Dtype>(max<Dtype>(h, 0.), height_ - 1.);
+              const int x0 = floor(w), x1 = ceil(w);
+              const int y0 = floor(h), y1 = ceil(h);
+              const Dtype dist_x = w - x0, dist_y = h - y0;
+              const Dtype* row0 = plane + y0 * width_;
+              const Dtype* row1 = plane + y1 * width_;
+              sum += (1 - dist_y) * ((1 - dist_x) * row0[x0] +
+                                     dist_x * row0[x1]) +
+                     dist_y * ((1 - dist_x) * row1[x0] + dist_x * row1[x1]);
+              ++count;
+            }
+          }
+          top_data[pool_index] = count == 0 ? Dtype(0) : sum / count;
+          top_count[pool_index] = count;
+        }
+      }
+    }
+  });
+}
+
+template <typename Dtype>
+void DeformablePSROIPoolingLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  const bool data_down = propagate_down[0];
+  const bool trans_down = !no_trans_ && propagate_down[2];
+  if (!data_down && !trans_down) {
+    return;
+  }
+  const Dtype* top_diff = top[0]->cpu_diff();
+  const Dtype* top_count = mapping_channel_.cpu_data();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* bottom_rois = bottom[1]->cpu_data();
+  const Dtype* bottom_trans = no_trans_ ? NULL : bottom[2]->cpu_data();
+  Dtype* bottom_data_diff = bottom[0]->mutable_cpu_diff();
+  Dtype* bottom_trans_diff = no_trans_ ? NULL : bottom[2]->mutable_cpu_diff();
+  const int num_classes = no_trans_ ? 1 : bottom[2]->channels() / 2;
+  const int channels_each_class =
+      no_trans_ ? output_dim_ : output_dim_ / num_classes;
+  caffe_set(bottom[1]->count(), Dtype(0), bottom[1]->mutable_cpu_diff());
+  if (trans_down) {
+    caffe_set(bottom[2]->count(), Dtype(0), bottom_trans_diff);
+  }
+  if (data_down) {
+    caffe_set(bottom[0]->count(), Dtype(0), bottom_data_diff);
+  }
+  const int num_rois = bottom[1]->num();
+  const int group_dim = group_size_ * group_size_;
+  const int pooled_dim = pooled_height_ * pooled_width_;
+  // ROIs of an image overlap, so each task takes every bin of its output
+  // channels, which alone write their group_size^2 channels. When the
+  // translations get a gradient, a task is a class, which also owns them.
+  const int ctops_per_task = trans_down ? channels_each_class : 1;
+  const int grain = std::max(1, kMinParallelWork / std::max(1, 4 * num_rois *
+      ctops_per_task * pooled_dim * sample_per_part_ * sample_per_part_));
+  parallel_for(output_dim_ / ctops_per_task, grain, [&](int begin, int end) {
+    for (int ctop = begin * ctops_per_task; ctop < end * ctops_per_task;
+         ++ctop) {
+      const int class_id = ctop / channels_each_class;
+      for (int n = 0; n < num_rois; ++n) {
+        const Dtype* roi = bottom_rois + n * 5;
+        int roi_batch_ind = roi[0];
+        const int offset =
+            (roi_batch_ind * channels_ + ctop * group_dim) * height_ * width_;
+        for (int ph = 0; ph < pooled_height_; ++ph) {
+          for (int pw = 0; pw < pooled_width_; ++pw) {
+            const int pool_index =
+                ((n * output_dim_ + ctop) * pooled_height_ + ph) *
+                pooled_width_ + pw;
+            if (top_count[pool_index] <= 0) {
+              continue;
+            }
+            const Dtype diff_val = top_diff[pool_index] / top_count[pool_index];
+            const DeformablePSROIBin<Dtype> bin(roi, bottom_trans,
+                spatial_scale_, trans_std_, n, class_id, num_classes,
+                part_size_, sample_per_part_, pooled_height_, pooled_width_,
+                ph, pw);
+            const int plane_offset = offset + DeformablePSROIGroupChannel(ph,
+                pw, pooled_height_, pooled_width_, group_size_) * height_ *
+                width_;
+            const Dtype* plane = bottom_data + plane_offset;
+            Dtype* plane_diff = bottom_data_diff + plane_offset;
+            Dtype diff_x = 0, diff_y = 0;
+            for (int ih = 0; ih < sample_per_part_; ++ih) {
+              for (int iw = 0; iw < sample_per_part_; ++iw) {
+                Dtype w = bin.wstart + iw * bin.sub_bin_size_w;
+                Dtype h = bin.hstart + ih * bin.sub_bin_size_h;
+                if (w < -0.5 || w > width_ - 0.5 || h < -0.5 ||
+                    h > height_ - 0.5) {
+                  continue;
+                }
+                w = min<Dtype>(max<Dtype>(w, 0.), width_ - 1.);
+                h = min<Dtype>(max<Dtype>(h, 0.), height_ - 1.);
+                const int x0 = floor(w), x1 = ceil(w);
+                const int y0 = floor(h), y1 = ceil(h);
+                const Dtype dist_x = w - x0, dist_y = h - y0;
+                if (data_down) {
+                  plane_diff[y0 * width_ + x0] +=
+                      (1 - dist_x) * (1 - dist_y) * diff_val;
+                  plane_diff[y1 * width_ + x0] +=
+                      (1 - dist_x) * dist_y * diff_val;
+                  plane_diff[y0 * width_ + x1] +=
+                      dist_x * (1 - dist_y) * diff_val;
+                  plane_diff[y1 * width_ + x1] += dist_x * dist_y * diff_val;
+                }
+                if (!trans_down) {
+                  continue;
+                }
+                const Dtype U00 = plane[y0 * width_ + x0];
+                const Dtype U01 = plane[y1 * width_ + x0];
+                const Dtype U10 = plane[y0 * width_ + x1];
+                const Dtype U11 = plane[y1 * width_ + x1];
+                diff_x += (U11 * dist_y + U10 * (1 - dist_y) - U01 * dist_y -
+                           U00 * (1 - dist_y)) * diff_val;
+                diff_y += (U11 * dist_x + U01 * (1 - dist_x) - U10 * dist_x -
+                           U00 * (1 - dist_x)) * diff_val;
+              }
+            }
+            if (trans_down) {
+              bottom_trans_diff[bin.trans_index] +=
+                  diff_x * trans_std_ * bin.roi_width;
+              bottom_trans_diff[bin.trans_index + bin.trans_step] +=
+                  diff_y * trans_std_ * bin.roi_height;
+            }
+          }
+        }
+      }
+    }
+  });
+}
+
 #ifndef USE_CUDA
 STUB_GPU(DeformablePSROIPoolingLayer);
 #endif
@@ -1,6 +1,7 @@
 #include "caffe/layers/proposal_layer.hpp"
 #include "caffe/util/frcnn_utils.hpp"
 #include "caffe/util/nms_util.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 #define ROUND(x) ((int)((x) + (Dtype)0.5))
 
@@ -60,67 +61,93 @@ void ProposalLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ProposalLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                             const vector<Blob<Dtype>*>& top) {
-  CHECK_EQ(bottom[0]->shape(0), 1) << "Only single item batches are supported";
+  const int num = bottom[0]->shape(0);
+  CHECK_EQ(bottom[1]->shape(0), num);
+  CHECK_EQ(bottom[2]->shape(0), num) << "Each image needs its own im_info";
+  // im_info of an image: (height, width, scale_H[, scale_W])
+  const int im_info_dim = bottom[2]->count(1);
+  CHECK_GE(im_info_dim, 3);
+
+  // bottom shape: (2 x num_anchors) x H x W
+  const int bottom_H = bottom[0]->height();
+  const int bottom_W = bottom[0]->width();
+  // number of all proposals = num_anchors * H * W
+  const int num_proposals = anchors_.shape(0) * bottom_H * bottom_W;
+  // number of top-n proposals before NMS
+  const int pre_nms_topn = std::min(num_proposals, pre_nms_topn_);
+
+  // Every image enumerates, sorts and suppresses its proposals in its own
+  // slice of proposals_ and roi_indices_.
+  vector<int> proposals_shape(2);
+  proposals_shape[0] = num * num_proposals;
+  proposals_shape[1] = 5;
+  proposals_.Reshape(proposals_shape);
+  vector<int> roi_indices_shape(1, num * post_nms_topn_);
+  roi_indices_.Reshape(roi_indices_shape);
+  vector<int> num_rois(num, 0);
 
   const Dtype* score = bottom[0]->cpu_data();
   const Dtype* bbox = bottom[1]->cpu_data();
   const Dtype* im_info = bottom[2]->cpu_data();
-  Dtype* rois = top[0]->mutable_cpu_data();
-  Dtype* top_score = (top.size() > 1) ? top[1]->mutable_cpu_data() : NULL;
+  const Dtype* anchors = anchors_.cpu_data();
+  Dtype* proposals = proposals_.mutable_cpu_data();
+  int* roi_indices = roi_indices_.mutable_cpu_data();
+  parallel_for(num, 1, [&](int begin, int end) {
+    for (int n = begin; n < end; ++n) {
+      const Dtype* info = im_info + n * im_info_dim;
+      // input image height & width
+      const Dtype img_H = info[0];
+      const Dtype img_W = info[1];
+      // scale factor for height & width
+      const Dtype scale_H = info[2];
+      const Dtype scale_W = im_info_dim > 3 ? info[3] : info[2];
+      // minimum box width & height
+      const Dtype min_box_H = min_size_ * scale_H;
+      const Dtype min_box_W = min_size_ * scale_W;
+
+      // enumerate all proposals
+      //   num_proposals = num_anchors * H * W
+      //   (x1, y1, x2, y2, score) for each proposal
+      // NOTE: for bottom, only foreground scores are passed
+      Dtype* image_proposals = proposals + n * num_proposals * 5;
+      EnumerateProposals(score + n * bottom[0]->count(1) + num_proposals,
+                         bbox + n * bottom[1]->count(1), anchors,
+                         anchors_.shape(0), image_proposals, bottom_H,
+                         bottom_W, img_H, img_W, min_box_H, min_box_W,
+                         feat_stride_h_, feat_stride_w_);
+
+      SortBox(image_proposals, 0, num_proposals - 1, pre_nms_topn_);
+
+      NMS(image_proposals, pre_nms_topn, roi_indices + n * post_nms_topn_,
+          &num_rois[n], 0, nms_thresh_, post_nms_topn_);
+    }
+  });
 
-  vector<int> proposals_shape(2);
+  // rois blob : holds R regions of interest, each is a 5 - tuple
+  // (n, x1, y1, x2, y2) specifying an image batch index n and a
+  // rectangle(x1, y1, x2, y2); the rois of the images follow each other.
   vector<int> top_shape(2);
-  proposals_shape[0] = 0;
-  proposals_shape[1] = 5;
   top_shape[0] = 0;
   top_shape[1] = 5;
-
-  for (int n = 0; n < bottom[0]->shape(0); ++n) {
-    // bottom shape: (2 x num_anchors) x H x W
-    const int bottom_H = bottom[0]->height();
-    const int bottom_W = bottom[0]->width();
-    // input image height & width
-    const Dtype img_H = im_info[0];
-    const Dtype img_W = im_info[1];
-    // scale factor for height & width
-    const Dtype scale_H = im_info[2];
-    const Dtype scale_W = im_info[3];
-    // minimum box width & height
-    const Dtype min_box_H = min_size_ * scale_H;
-    const Dtype min_box_W = min_size_ * scale_W;
-    // number of all proposals = num_anchors * H * W
-    const int num_proposals = anchors_.shape(0) * bottom_H * bottom_W;
-    // number of top-n proposals before NMS
-    const int pre_nms_topn = std::min(num_proposals, pre_nms_topn_);
-    // number of final RoIs
-    int num_rois = 0;
-
-    // enumerate all proposals
-    //   num_proposals = num_anchors * H * W
-    //   (x1, y1, x2, y2, score) for each proposal
-    // NOTE: for bottom, only foreground scores are passed
-    proposals_shape[0] = num_proposals;
-    proposals_.Reshape(proposals_shape);
-    EnumerateProposals(bbox + num_proposals, score, anchors_.cpu_data(),
-                       anchors_.shape(0), proposals_.mutable_cpu_data(),
-                       bottom_H, bottom_W, img_H, img_W, min_box_H, min_box_W,
-                       feat_stride_h_, feat_stride_w_);
-
-    SortBox(proposals_.mutable_cpu_data(), 0, num_proposals - 1, pre_nms_topn_);
-
-    NMS(proposals_.cpu_data(), pre_nms_topn, roi_indices_.mutable_cpu_data(),
-        &num_rois, 0, nms_thresh_, post_nms_topn_);
-
-    RetrieveROI(num_rois, n, proposals_.cpu_data(), roi_indices_.cpu_data(),
-                rois, top_score);
-
-    top_shape[0] += num_rois;
+  for (int n = 0; n < num; ++n) {
+    top_shape[0] += num_rois[n];
   }
-
   top[0]->Reshape(top_shape);
+  Dtype* rois = top[0]->mutable_cpu_data();
+  Dtype* top_score = NULL;
   if (top.size() > 1) {
     top_shape.pop_back();
     top[1]->Reshape(top_shape);
+    top_score = top[1]->mutable_cpu_data();
+  }
+  for (int n = 0; n < num; ++n) {
+    RetrieveROI(num_rois[n], n, proposals_.cpu_data() + n * num_proposals * 5,
+                roi_indices_.cpu_data() + n * post_nms_topn_, rois,
+                top_score);
+    rois += num_rois[n] * 5;
+    if (top_score) {
+      top_score += num_rois[n];
+    }
   }
 }
 
@@ -12,6 +12,7 @@
 
 #include "caffe/layers/psroi_pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 using std::ceil;
 using std::floor;
@@ -49,6 +50,39 @@ void PSROIPoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
                            pooled_width_);
 }
 
+// The pixels [*hstart, *hend) x [*wstart, *wend) of bin (ph, pw) of an ROI,
+// clipped to the input.
+template <typename Dtype>
+static void PSROIPoolingBin(const Dtype* roi, const Dtype spatial_scale,
+                            const int height, const int width,
+                            const int pooled_height, const int pooled_width,
+                            const int ph, const int pw, int* hstart,
+                            int* hend, int* wstart, int* wend) {
+  // [start, end) interval for spatial sampling
+  Dtype roi_start_w = static_cast<Dtype>(round(roi[1])) * spatial_scale;
+  Dtype roi_start_h = static_cast<Dtype>(round(roi[2])) * spatial_scale;
+  Dtype roi_end_w = static_cast<Dtype>(round(roi[3]) + 1.) * spatial_scale;
+  Dtype roi_end_h = static_cast<Dtype>(round(roi[4]) + 1.) * spatial_scale;
+
+  // Force too small ROIs to be 1x1
+  Dtype roi_width = max<Dtype>(roi_end_w - roi_start_w, 0.1);  // avoid 0
+  Dtype roi_height = max<Dtype>(roi_end_h - roi_start_h, 0.1);
+
+  // Compute w and h at bottom
+  Dtype bin_size_h = roi_height / static_cast<Dtype>(pooled_height);
+  Dtype bin_size_w = roi_width / static_cast<Dtype>(pooled_width);
+
+  *hstart = floor(static_cast<Dtype>(ph) * bin_size_h + roi_start_h);
+  *wstart = floor(static_cast<Dtype>(pw) * bin_size_w + roi_start_w);
+  *hend = ceil(static_cast<Dtype>(ph + 1) * bin_size_h + roi_start_h);
+  *wend = ceil(static_cast<Dtype>(pw + 1) * bin_size_w + roi_start_w);
+  // Add roi offsets and clip to input boundaries
+  *hstart = min(max(*hstart, 0), height);
+  *hend = min(max(*hend, 0), height);
+  *wstart = min(max(*wstart, 0), width);
+  *wend = min(max(*wend, 0), width);
+}
+
 template <typename Dtype>
 static void PSROIPoolingForward(const int num, const Dtype* bottom_data,
                                 const Dtype spatial_scale, const int channels,
@@ -57,76 +91,44 @@ static void PSROIPoolingForward(const int num, const Dtype* bottom_data,
                                 const Dtype* bottom_rois, const int output_dim,
                                 const int group_size, Dtype* top_data,
                                 int* mapping_channel) {
-  for (int n = 0; n < num; ++n) {
-    int roi_add = n * 5;
-    // [start, end) interval for spatial sampling
-    int roi_batch_ind = bottom_rois[roi_add];
-    Dtype roi_start_w =
-        static_cast<Dtype>(round(bottom_rois[roi_add + 1])) * spatial_scale;
-    Dtype roi_start_h =
-        static_cast<Dtype>(round(bottom_rois[roi_add + 2])) * spatial_scale;
-    Dtype roi_end_w = static_cast<Dtype>(round(bottom_rois[roi_add + 3]) + 1.) *
-                      spatial_scale;
-    Dtype roi_end_h = static_cast<Dtype>(round(bottom_rois[roi_add + 4]) + 1.) *
-                      spatial_scale;
-
-    // Force too small ROIs to be 1x1
-    Dtype roi_width = max<Dtype>(roi_end_w - roi_start_w, 0.1);  // avoid 0
-    Dtype roi_height = max<Dtype>(roi_end_h - roi_start_h, 0.1);
-
-    // Compute w and h at bottom
-    Dtype bin_size_h = roi_height / static_cast<Dtype>(pooled_height);
-    Dtype bin_size_w = roi_width / static_cast<Dtype>(pooled_width);
-
-    for (int ctop = 0; ctop < output_dim; ++ctop) {
+  const int pooled_dim = pooled_height * pooled_width;
+  const int grain = std::max(1, kMinParallelWork / (4 * pooled_dim));
+  // Each task is an (n, ctop) pair, whose bins read the group_size^2
+  // consecutive channels of ctop.
+  parallel_for(num * output_dim, grain, [&](int begin, int end) {
+    for (int index = begin; index < end; ++index) {
+      const int n = index / output_dim;
+      const int ctop = index % output_dim;
+      const Dtype* roi = bottom_rois + n * 5;
+      int roi_batch_ind = roi[0];
+      const int c_start = ctop * group_size * group_size;
+      const Dtype* data =
+          bottom_data + (roi_batch_ind * channels + c_start) * height * width;
       for (int ph = 0; ph < pooled_height; ++ph) {
         for (int pw = 0; pw < pooled_width; ++pw) {
-          int index = n * output_dim * pooled_height * pooled_width +
-                      ctop * pooled_height * pooled_width + ph * pooled_width +
-                      pw;
           // The output is in order (n, ctop, ph, pw)
-
-          int hstart = floor(static_cast<Dtype>(ph) * bin_size_h + roi_start_h);
-          int wstart = floor(static_cast<Dtype>(pw) * bin_size_w + roi_start_w);
-          int hend =
-              ceil(static_cast<Dtype>(ph + 1) * bin_size_h + roi_start_h);
-          int wend =
-              ceil(static_cast<Dtype>(pw + 1) * bin_size_w + roi_start_w);
-          // Add roi offsets and clip to input boundaries
-          hstart = min(max(hstart, 0), height);
-          hend = min(max(hend, 0), height);
-          wstart = min(max(wstart, 0), width);
-          wend = min(max(wend, 0), width);
-          bool is_empty = (hend <= hstart) || (wend <= wstart);
-
-          int gw = pw;
-          int gh = ph;
-          int c = (ctop * group_size + gh) * group_size + gw;
-
-          //      bottom_data += (roi_batch_ind * channels + c) * height *
-          //      width;
+          const int pool_index = index * pooled_dim + ph * pooled_width + pw;
+          int hstart, hend, wstart, wend;
+          PSROIPoolingBin(roi, spatial_scale, height, width, pooled_height,
+                          pooled_width, ph, pw, &hstart, &hend, &wstart,
+                          &wend);
+          const int c = ph * group_size + pw;
+          const Dtype* plane = data + c * height * width;
           Dtype out_sum = 0;
           for (int h = hstart; h < hend; ++h) {
+            const Dtype* row = plane + h * width;
             for (int w = wstart; w < wend; ++w) {
-              int bottom_index = h * width + w;
-              out_sum +=
-                  bottom_data[(roi_batch_ind * channels + c) * height * width +
-                              bottom_index];
+              out_sum += row[w];
             }
           }
-
+          const bool is_empty = (hend <= hstart) || (wend <= wstart);
           Dtype bin_area = (hend - hstart) * (wend - wstart);
-          if (is_empty) {
-            top_data[index] = 0;
-          } else {
-            top_data[index] = out_sum / bin_area;
-          }
-
-          mapping_channel[index] = c;
+          top_data[pool_index] = is_empty ? Dtype(0) : out_sum / bin_area;
+          mapping_channel[pool_index] = c_start + c;
         }
       }
     }
-  }
+  });
 }
 
 template <typename Dtype>
@@ -136,21 +138,75 @@ void PSROIPoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_rois = bottom[1]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   int* mapping_channel_ptr = mapping_channel_.mutable_cpu_data();
-  int count = top[0]->count();
-  caffe_set(count, Dtype(0), top_data);
-  caffe_set(count, -1, mapping_channel_ptr);
-  // NOLINT_NEXT_LINE(whitespace/operators)
   PSROIPoolingForward(bottom[1]->num(), bottom_data, spatial_scale_, channels_,
                       height_, width_, pooled_height_, pooled_width_,
                       bottom_rois, output_dim_, group_size_, top_data,
                       mapping_channel_ptr);
 }
 
+template <typename Dtype>
+static void PSROIPoolingBackward(const int num, const Dtype* top_diff,
+                                 const Dtype spatial_scale, const int channels,
+                                 const int height, const int width,
+                                 const int pooled_height,
+                                 const int pooled_width,
+                                 const Dtype* bottom_rois,
+                                 const int output_dim, const int group_size,
+                                 Dtype* bottom_diff) {
+  const int pooled_dim = pooled_height * pooled_width;
+  const int grain =
+      std::max(1, kMinParallelWork / std::max(1, 4 * num * pooled_dim));
+  // ROIs of an image overlap, so each task takes every bin of one ctop,
+  // which alone writes its group_size^2 channels.
+  parallel_for(output_dim, grain, [&](int begin, int end) {
+    for (int ctop = begin; ctop < end; ++ctop) {
+      const int c_start = ctop * group_size * group_size;
+      for (int n = 0; n < num; ++n) {
+        const Dtype* roi = bottom_rois + n * 5;
+        int roi_batch_ind = roi[0];
+        Dtype* diff =
+            bottom_diff + (roi_batch_ind * channels + c_start) * height * width;
+        const int offset = (n * output_dim + ctop) * pooled_dim;
+        for (int ph = 0; ph < pooled_height; ++ph) {
+          for (int pw = 0; pw < pooled_width; ++pw) {
+            int hstart, hend, wstart, wend;
+            PSROIPoolingBin(roi, spatial_scale, height, width, pooled_height,
+                            pooled_width, ph, pw, &hstart, &hend, &wstart,
+                            &wend);
+            if ((hend <= hstart) || (wend <= wstart)) {
+              continue;
+            }
+            Dtype bin_area = (hend - hstart) * (wend - wstart);
+            const Dtype diff_val =
+                top_diff[offset + ph * pooled_width + pw] / bin_area;
+            Dtype* plane = diff + (ph * group_size + pw) * height * width;
+            for (int h = hstart; h < hend; ++h) {
+              Dtype* row = plane + h * width;
+              for (int w = wstart; w < wend; ++w) {
+                row[w] += diff_val;
+              }
+            }
+          }
+        }
+      }
+    }
+  });
+}
+
 template <typename Dtype>
 void PSROIPoolingLayer<Dtype>::Backward_cpu(
     const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
-  NOT_IMPLEMENTED;
+  if (!propagate_down[0]) {
+    return;
+  }
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  caffe_set(bottom[1]->count(), Dtype(0), bottom[1]->mutable_cpu_diff());
+  caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
+  PSROIPoolingBackward(bottom[1]->num(), top[0]->cpu_diff(), spatial_scale_,
+                       channels_, height_, width_, pooled_height_,
+                       pooled_width_, bottom[1]->cpu_data(), output_dim_,
+                       group_size_, bottom_diff);
 }
 
 #ifndef USE_CUDA
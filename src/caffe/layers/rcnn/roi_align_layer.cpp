@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "caffe/layers/roi_align_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 using std::ceil;
 using std::floor;
@@ -37,14 +38,39 @@ void ROIAlignLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ROIAlignLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                        const vector<Blob<Dtype>*>& top) {
-  NOT_IMPLEMENTED;
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* bottom_rois = bottom[1]->cpu_data();
+  if (bottom.size() > 2) {
+    spatial_scale_ = caffe_cpu_asum<Dtype>(1, bottom[2]->cpu_data());
+  }
+  // The samples of an ROI are the same for all of its channels.
+  const int num_rois = bottom[1]->num();
+  roi_bins_.resize(num_rois);
+  for (int n = 0; n < num_rois; ++n) {
+    const Dtype* roi = bottom_rois + n * 5;
+    roi_bins_[n].Init(roi[2] * spatial_scale_, roi[4] * spatial_scale_,
+                      roi[1] * spatial_scale_, roi[3] * spatial_scale_,
+                      pooled_height_, pooled_width_, height_, width_);
+  }
+  roi_align_forward_cpu(roi_bins_, bottom_data, bottom_rois, channels_,
+                        height_, width_, pooled_height_, pooled_width_,
+                        top[0]->mutable_cpu_data(), max_idx_.mutable_cpu_data(),
+                        max_idy_.mutable_cpu_data());
 }
 
 template <typename Dtype>
 void ROIAlignLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                         const vector<bool>& propagate_down,
                                         const vector<Blob<Dtype>*>& bottom) {
-  NOT_IMPLEMENTED;
+  if (!propagate_down[0]) {
+    return;
+  }
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
+  roi_align_backward_cpu(roi_bins_, top[0]->cpu_diff(), max_idx_.cpu_data(),
+                         max_idy_.cpu_data(), bottom[1]->cpu_data(), channels_,
+                         height_, width_, pooled_height_, pooled_width_,
+                         bottom_diff);
 }
 
 #ifndef USE_CUDA
@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "caffe/layers/roi_mask_align_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 using std::max;
 using std::min;
@@ -46,18 +47,65 @@ void ROIMaskAlignLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ROIMaskAlignLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  NOT_IMPLEMENTED;
-
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* bottom_rois = bottom[1]->cpu_data();
+  if (bottom.size() > 2) {
+    spatial_scale_ = caffe_cpu_asum<Dtype>(1, bottom[2]->cpu_data());
+  }
+  // The samples of an ROI are the same for all of its channels.
+  const int num_rois = bottom[1]->num();
+  roi_bins_.resize(num_rois);
+  for (int n = 0; n < num_rois; ++n) {
+    const Dtype* roi = bottom_rois + n * 5;
+    const Dtype xc = (roi[1] + roi[3]) / 2;
+    const Dtype yc = (roi[2] + roi[4]) / 2;
+    const Dtype w = roi[3] - roi[1];
+    const Dtype h = roi[4] - roi[2];
+    // rescale roi with regard to roi_scale and half_part
+    Dtype x1 = xc - w * roi_scale_ / 2;
+    Dtype x2 = xc + w * roi_scale_ / 2;
+    Dtype y1 = yc - h * roi_scale_ / 2;
+    Dtype y2 = yc + h * roi_scale_ / 2;
+    switch (half_part_) {
+      case 1: x2 = xc; break;
+      case 2: x1 = xc; break;
+      case 3: y2 = yc; break;
+      case 4: y1 = yc; break;
+      default: break;
+    }
+    roi_bins_[n].Init(y1 * spatial_scale_ + spatial_shift_,
+                      y2 * spatial_scale_ + spatial_shift_,
+                      x1 * spatial_scale_ + spatial_shift_,
+                      x2 * spatial_scale_ + spatial_shift_,
+                      pooled_height_, pooled_width_, height_, width_);
+    if (mask_scale_ > 0) {
+      roi_bins_[n].SetMask(
+          (yc - h * mask_scale_ / 2) * spatial_scale_ + spatial_shift_,
+          (yc + h * mask_scale_ / 2) * spatial_scale_ + spatial_shift_,
+          (xc - w * mask_scale_ / 2) * spatial_scale_ + spatial_shift_,
+          (xc + w * mask_scale_ / 2) * spatial_scale_ + spatial_shift_);
+    }
+  }
+  roi_align_forward_cpu(roi_bins_, bottom_data, bottom_rois, channels_,
+                        height_, width_, pooled_height_, pooled_width_,
+                        top[0]->mutable_cpu_data(), max_idx_.mutable_cpu_data(),
+                        max_idy_.mutable_cpu_data());
 }
 
 template <typename Dtype>
 void ROIMaskAlignLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-  NOT_IMPLEMENTED;
-
+  if (!propagate_down[0]) {
+    return;
+  }
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
+  roi_align_backward_cpu(roi_bins_, top[0]->cpu_diff(), max_idx_.cpu_data(),
+                         max_idy_.cpu_data(), bottom[1]->cpu_data(), channels_,
+                         height_, width_, pooled_height_, pooled_width_,
+                         bottom_diff);
 }
 
-
 #ifndef USE_CUDA
 STUB_GPU(ROIMaskAlignLayer);
 #endif
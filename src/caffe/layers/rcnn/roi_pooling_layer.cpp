@@ -6,6 +6,7 @@
 // ------------------------------------------------------------------
 
 #include "caffe/layers/roi_pooling_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 #if _MSC_VER < 1800
 inline double round(double x) {
@@ -52,12 +53,16 @@ void ROIPoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   caffe_set(top_count, -1, argmax_data);
 
   // For each ROI R = [batch_index x1 y1 x2 y2]: max pool over R
-  for (int n = 0; n < num_rois; ++n) {
-    int roi_batch_ind = bottom_rois[0];
-    int roi_start_w = round(bottom_rois[1] * spatial_scale_);
-    int roi_start_h = round(bottom_rois[2] * spatial_scale_);
-    int roi_end_w = round(bottom_rois[3] * spatial_scale_);
-    int roi_end_h = round(bottom_rois[4] * spatial_scale_);
+  parallel_for(num_rois, 1, [&](int roi_begin, int roi_end) {
+  for (int n = roi_begin; n < roi_end; ++n) {
+    const Dtype* roi = bottom_rois + bottom[1]->offset(n);
+    Dtype* roi_top_data = top_data + top[0]->offset(n);
+    int* roi_argmax_data = argmax_data + max_idx_.offset(n);
+    int roi_batch_ind = roi[0];
+    int roi_start_w = round(roi[1] * spatial_scale_);
+    int roi_start_h = round(roi[2] * spatial_scale_);
+    int roi_end_w = round(roi[3] * spatial_scale_);
+    int roi_end_h = round(roi[4] * spatial_scale_);
     CHECK_GE(roi_batch_ind, 0);
     CHECK_LT(roi_batch_ind, batch_size);
 
@@ -94,16 +99,16 @@ void ROIPoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 
           const int pool_index = ph * pooled_width_ + pw;
           if (is_empty) {
-            top_data[pool_index] = 0;
-            argmax_data[pool_index] = -1;
+            roi_top_data[pool_index] = 0;
+            roi_argmax_data[pool_index] = -1;
           }
 
           for (int h = hstart; h < hend; ++h) {
             for (int w = wstart; w < wend; ++w) {
               const int index = h * width_ + w;
-              if (batch_data[index] > top_data[pool_index]) {
-                top_data[pool_index] = batch_data[index];
-                argmax_data[pool_index] = index;
+              if (batch_data[index] > roi_top_data[pool_index]) {
+                roi_top_data[pool_index] = batch_data[index];
+                roi_argmax_data[pool_index] = index;
               }
             }
           }
@@ -111,12 +116,11 @@ void ROIPoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       }
       // Increment all data pointers by one channel
       batch_data += bottom[0]->offset(0, 1);
-      top_data += top[0]->offset(0, 1);
-      argmax_data += max_idx_.offset(0, 1);
+      roi_top_data += top[0]->offset(0, 1);
+      roi_argmax_data += max_idx_.offset(0, 1);
     }
-    // Increment ROI data pointer
-    bottom_rois += bottom[1]->offset(1);
   }
+  });
 }
 
 template <typename Dtype>
@@ -33,6 +33,10 @@ void ShuffleChannelLayer<Dtype>::Resize_cpu(Dtype* output, const Dtype* input,
 template <typename Dtype>
 void ShuffleChannelLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
                                          const vector<Blob<Dtype>*>& top) {
+  if (this->layer_param_.layout() == NHWC) {
+    top[0]->ReshapeLike(*bottom[0]);
+    return;
+  }
   int channels_ = bottom[0]->channels();
   int height_ = bottom[0]->height();
   int width_ = bottom[0]->width();
@@ -46,6 +50,24 @@ void ShuffleChannelLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
 
+  if (this->layer_param_.layout() == NHWC) {
+    // Shuffle the run of channels of every pixel.
+    const int chs = bottom[0]->shape(-1);
+    const int group_column = chs / group_;
+    CHECK_EQ(chs, group_column * group_) << "Wrong group size.";
+    const int num_pixels = bottom[0]->count() / chs;
+    for (int p = 0; p < num_pixels; ++p) {
+      const Dtype* p_i = bottom_data + p * chs;
+      Dtype* p_o = top_data + p * chs;
+      for (int i = 0; i < group_; ++i) {
+        for (int j = 0; j < group_column; ++j) {
+          p_o[j * group_ + i] = p_i[i * group_column + j];
+        }
+      }
+    }
+    return;
+  }
+
   const int num = bottom[0]->shape(0);
   const int feature_map_size = bottom[0]->count(1);
   const int sp_sz = bottom[0]->count(2);
@@ -68,6 +90,8 @@ template <typename Dtype>
 void ShuffleChannelLayer<Dtype>::Backward_cpu(
     const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  CHECK(this->layer_param_.layout() != NHWC)
+      << "Channels-last ShuffleChannel only supports Forward.";
   if (propagate_down[0]) {
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
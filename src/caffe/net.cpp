@@ -9,6 +9,7 @@
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/inference_optimizer.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/upgrade_proto.hpp"
@@ -20,6 +21,12 @@ Net<Dtype>::Net(const NetParameter& param) {
   Init(param);
 }
 
+template <typename Dtype>
+Net<Dtype>::Net(const NetParameter& param, const Net* weight_source) {
+  CHECK(weight_source);
+  Init(param, weight_source);
+}
+
 template <typename Dtype>
 Net<Dtype>::Net(const string& param_file, Phase phase, const int level,
                 const vector<string>* stages) {
@@ -37,13 +44,30 @@ Net<Dtype>::Net(const string& param_file, Phase phase, const int level,
 }
 
 template <typename Dtype>
-void Net<Dtype>::Init(const NetParameter& in_param) {
+void Net<Dtype>::Init(const NetParameter& in_param,
+                      const Net* weight_source) {
   // Set phase from the state.
   phase_ = in_param.state().phase();
+  forward_only_ = in_param.forward_only();
+  CHECK(!forward_only_ || !in_param.force_backward())
+      << "forward_only and force_backward cannot both be set.";
   // Filter layers based on their include/exclude rules and
   // the current NetState.
   NetParameter filtered_param;
   FilterNet(in_param, &filtered_param);
+  // Apply activations in the epilogue of the layers producing their input.
+  if (in_param.fuse_activations()) {
+    CHECK(forward_only_) << "fuse_activations requires forward_only.";
+    NetParameter fused_param;
+    FuseActivationLayers(filtered_param, &fused_param);
+    filtered_param.Swap(&fused_param);
+  }
+  if (in_param.channels_last()) {
+    CHECK(forward_only_) << "channels_last requires forward_only.";
+    NetParameter channels_last_param;
+    ConvertToChannelsLast(filtered_param, &channels_last_param);
+    filtered_param.Swap(&channels_last_param);
+  }
   LOG_IF(INFO, Caffe::root_solver())
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
@@ -76,6 +100,9 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     }
     layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
     layer_names_.push_back(layer_param.name());
+    if (weight_source) {
+      ShareSourceWeights(*weight_source, layer_id);
+    }
     LOG_IF(INFO, Caffe::root_solver()) << "Creating Layer "
                                        << layer_param.name();
     bool need_backward = false;
@@ -114,6 +141,15 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     }
     // After this layer is connected, set it up.
     layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+    if (weight_source) {
+      const vector<shared_ptr<Blob<Dtype> > >& source_blobs =
+          weight_source->layers()[layer_id]->blobs();
+      for (int j = 0; j < source_blobs.size(); ++j) {
+        CHECK(layers_[layer_id]->blobs()[j]->data() == source_blobs[j]->data())
+            << "Layer " << layer_param.name()
+            << " replaced its shared weights during SetUp.";
+      }
+    }
     LOG_IF(INFO, Caffe::root_solver()) << "Setting up "
                                        << layer_names_[layer_id];
     for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
@@ -140,7 +176,8 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       const ParamSpec* param_spec = (param_id < param_size)
                                         ? &layer_param.param(param_id)
                                         : &default_param_spec;
-      const bool param_need_backward = param_spec->lr_mult() != 0;
+      const bool param_need_backward =
+          !forward_only_ && param_spec->lr_mult() != 0;
       need_backward |= param_need_backward;
       layers_[layer_id]->set_param_propagate_down(param_id,
                                                   param_need_backward);
@@ -162,55 +199,58 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // Also checks if all bottom blobs don't need backward computation (possible
   // because the skip_propagate_down param) and so we can skip bacward
   // computation for the entire layer
-  set<string> blobs_under_loss;
-  set<string> blobs_skip_backp;
-  for (int layer_id = layers_.size() - 1; layer_id >= 0; --layer_id) {
-    bool layer_contributes_loss = false;
-    bool layer_skip_propagate_down = true;
-    for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
-      const string& blob_name = blob_names_[top_id_vecs_[layer_id][top_id]];
-      if (layers_[layer_id]->loss(top_id) ||
-          (blobs_under_loss.find(blob_name) != blobs_under_loss.end())) {
-        layer_contributes_loss = true;
-      }
-      if (blobs_skip_backp.find(blob_name) == blobs_skip_backp.end()) {
-        layer_skip_propagate_down = false;
+  // A forward-only net needs none of this: nothing is ever propagated.
+  if (!forward_only_) {
+    set<string> blobs_under_loss;
+    set<string> blobs_skip_backp;
+    for (int layer_id = layers_.size() - 1; layer_id >= 0; --layer_id) {
+      bool layer_contributes_loss = false;
+      bool layer_skip_propagate_down = true;
+      for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+        const string& blob_name = blob_names_[top_id_vecs_[layer_id][top_id]];
+        if (layers_[layer_id]->loss(top_id) ||
+            (blobs_under_loss.find(blob_name) != blobs_under_loss.end())) {
+          layer_contributes_loss = true;
+        }
+        if (blobs_skip_backp.find(blob_name) == blobs_skip_backp.end()) {
+          layer_skip_propagate_down = false;
+        }
+        if (layer_contributes_loss && !layer_skip_propagate_down) break;
       }
-      if (layer_contributes_loss && !layer_skip_propagate_down) break;
-    }
-    // If this layer can skip backward computation, also all his bottom blobs
-    // don't need backpropagation
-    if (layer_need_backward_[layer_id] && layer_skip_propagate_down) {
-      layer_need_backward_[layer_id] = false;
-      for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
-           ++bottom_id) {
-        bottom_need_backward_[layer_id][bottom_id] = false;
+      // If this layer can skip backward computation, also all his bottom blobs
+      // don't need backpropagation
+      if (layer_need_backward_[layer_id] && layer_skip_propagate_down) {
+        layer_need_backward_[layer_id] = false;
+        for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
+             ++bottom_id) {
+          bottom_need_backward_[layer_id][bottom_id] = false;
+        }
       }
-    }
-    if (!layer_contributes_loss) {
-      layer_need_backward_[layer_id] = false;
-    }
-    if (Caffe::root_solver()) {
-      if (layer_need_backward_[layer_id]) {
-        LOG(INFO) << layer_names_[layer_id] << " needs backward computation.";
-      } else {
-        LOG(INFO) << layer_names_[layer_id]
-                  << " does not need backward computation.";
+      if (!layer_contributes_loss) {
+        layer_need_backward_[layer_id] = false;
       }
-    }
-    for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
-         ++bottom_id) {
-      if (layer_contributes_loss) {
-        const string& blob_name =
-            blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
-        blobs_under_loss.insert(blob_name);
-      } else {
-        bottom_need_backward_[layer_id][bottom_id] = false;
+      if (Caffe::root_solver()) {
+        if (layer_need_backward_[layer_id]) {
+          LOG(INFO) << layer_names_[layer_id] << " needs backward computation.";
+        } else {
+          LOG(INFO) << layer_names_[layer_id]
+                    << " does not need backward computation.";
+        }
       }
-      if (!bottom_need_backward_[layer_id][bottom_id]) {
-        const string& blob_name =
-            blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
-        blobs_skip_backp.insert(blob_name);
+      for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
+           ++bottom_id) {
+        if (layer_contributes_loss) {
+          const string& blob_name =
+              blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
+          blobs_under_loss.insert(blob_name);
+        } else {
+          bottom_need_backward_[layer_id][bottom_id] = false;
+        }
+        if (!bottom_need_backward_[layer_id][bottom_id]) {
+          const string& blob_name =
+              blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
+          blobs_skip_backp.insert(blob_name);
+        }
       }
     }
   }
@@ -248,10 +288,54 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  if (param.prepack_weights()) {
+    PrepackWeights();
+  }
+  PlanSplitBackward(param.elide_split_backward());
   debug_info_ = param.debug_info();
+  optimize_memory_ = param.optimize_memory();
+  if (optimize_memory_ && phase_ != TEST) {
+    LOG(WARNING) << "optimize_memory is only supported in the TEST phase; "
+                 << "ignoring it.";
+    optimize_memory_ = false;
+  }
+  if (optimize_memory_) {
+    for (int i = 0; i < param.keep_blob_size(); ++i) {
+      memory_keep_blobs_.insert(param.keep_blob(i));
+    }
+    PlanMemory();
+  }
+  reshape_cache_ = param.reshape_cache();
+  reshaped_bottom_shapes_.assign(layers_.size(), vector<vector<int> >());
+  reshape_bucket_ = param.reshape_bucket();
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
+template <typename Dtype>
+void Net<Dtype>::ShareSourceWeights(const Net& source, const int layer_id) {
+  CHECK_LT(layer_id, source.layers().size())
+      << "Weight source has fewer layers than the net.";
+  CHECK_EQ(layer_names_[layer_id], source.layer_names()[layer_id])
+      << "Weight source does not match the net.";
+  const vector<shared_ptr<Blob<Dtype> > >& source_blobs =
+      source.layers()[layer_id]->blobs();
+  vector<shared_ptr<Blob<Dtype> > >& blobs = layers_[layer_id]->blobs();
+  CHECK(blobs.empty() || blobs.size() == source_blobs.size())
+      << "Incompatible number of blobs for layer " << layer_names_[layer_id];
+  // Blobs created here are never touched before they share the source data,
+  // so they allocate nothing.
+  blobs.resize(source_blobs.size());
+  for (int j = 0; j < blobs.size(); ++j) {
+    if (!blobs[j]) {
+      blobs[j].reset(new Blob<Dtype>(source_blobs[j]->shape()));
+    }
+    CHECK(blobs[j]->shape() == source_blobs[j]->shape())
+        << "Cannot share param " << j << " weights from layer '"
+        << layer_names_[layer_id] << "'; shape mismatch.";
+    blobs[j]->ShareData(*source_blobs[j]);
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::FilterNet(const NetParameter& param,
                            NetParameter* param_filtered) {
@@ -419,6 +503,9 @@ int Net<Dtype>::AppendBottom(const NetParameter& param, const int layer_id,
   if (layer_param.propagate_down_size() > 0) {
     need_backward = layer_param.propagate_down(bottom_id);
   }
+  if (forward_only_) {
+    need_backward = false;
+  }
   bottom_need_backward_[layer_id].push_back(need_backward);
   return blob_id;
 }
@@ -520,6 +607,264 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::PlanMemory() {
+  const int num_blobs = blobs_.size();
+  // Lifetime of each blob, in layer indices: from the layer producing it to
+  // the last layer reading or (in-place) rewriting it.
+  vector<int> first_use(num_blobs, -1);
+  vector<int> last_use(num_blobs, -1);
+  vector<bool> shareable(num_blobs, true);
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      if (first_use[blob_id] < 0) {
+        first_use[blob_id] = layer_id;
+      }
+      last_use[blob_id] = layer_id;
+      // Data layers may point their tops at memory they manage themselves.
+      if (bottom_id_vecs_[layer_id].empty()) {
+        shareable[blob_id] = false;
+      }
+    }
+    for (int bottom_id = 0; bottom_id < bottom_id_vecs_[layer_id].size();
+         ++bottom_id) {
+      const int blob_id = bottom_id_vecs_[layer_id][bottom_id];
+      last_use[blob_id] = std::max(last_use[blob_id], layer_id);
+    }
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    shareable[net_output_blob_indices_[i]] = false;
+  }
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    if (memory_keep_blobs_.count(blob_names_[blob_id])) {
+      shareable[blob_id] = false;
+    }
+  }
+  // Blobs aliasing the same SyncedMemory are planned as one unit.
+  set<SyncedMemory*> pooled;
+  for (int i = 0; i < memory_pool_.size(); ++i) {
+    pooled.insert(memory_pool_[i].get());
+  }
+  map<SyncedMemory*, vector<int> > storage_blobs;
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    if (blobs_[blob_id]->count() == 0 || first_use[blob_id] < 0) {
+      continue;
+    }
+    // Views into another blob (Concat, Slice) live as long as that blob.
+    if (blobs_[blob_id]->data()->is_view()) {
+      continue;
+    }
+    storage_blobs[blobs_[blob_id]->data().get()].push_back(blob_id);
+  }
+  // (first use, storage) for every storage that may be shared.
+  vector<pair<int, SyncedMemory*> > order;
+  map<SyncedMemory*, int> storage_last_use;
+  map<SyncedMemory*, size_t> storage_bytes;
+  for (map<SyncedMemory*, vector<int> >::iterator it = storage_blobs.begin();
+       it != storage_blobs.end(); ++it) {
+    const vector<int>& ids = it->second;
+    // Skip memory that is also referenced outside of the net blobs, e.g. a
+    // layer's internal buffer exposed as its top.
+    const long expected_refs = ids.size() + pooled.count(it->first);
+    bool can_share =
+        blobs_[ids[0]]->data().use_count() == expected_refs;
+    int first = first_use[ids[0]];
+    int last = last_use[ids[0]];
+    size_t bytes = 0;
+    for (int i = 0; i < ids.size(); ++i) {
+      can_share = can_share && shareable[ids[i]];
+      first = std::min(first, first_use[ids[i]]);
+      last = std::max(last, last_use[ids[i]]);
+      bytes = std::max(bytes, blobs_[ids[i]]->count() * sizeof(Dtype));
+    }
+    if (!can_share) {
+      continue;
+    }
+    order.push_back(make_pair(first, it->first));
+    storage_last_use[it->first] = last;
+    storage_bytes[it->first] = bytes;
+  }
+  std::sort(order.begin(), order.end());
+  // Greedily assign each storage to a buffer that is free by the time its
+  // first writer runs, preferring the smallest buffer that is large enough.
+  vector<size_t> slot_bytes;
+  vector<int> slot_last_use;
+  map<SyncedMemory*, int> storage_slot;
+  size_t planned_bytes = 0;
+  for (int i = 0; i < order.size(); ++i) {
+    SyncedMemory* storage = order[i].second;
+    const size_t bytes = storage_bytes[storage];
+    planned_bytes += bytes;
+    int best = -1;
+    for (int slot = 0; slot < slot_bytes.size(); ++slot) {
+      if (slot_last_use[slot] >= order[i].first) {
+        continue;
+      }
+      if (best < 0) {
+        best = slot;
+      } else if (slot_bytes[best] < bytes) {
+        if (slot_bytes[slot] > slot_bytes[best]) best = slot;
+      } else if (slot_bytes[slot] >= bytes &&
+                 slot_bytes[slot] < slot_bytes[best]) {
+        best = slot;
+      }
+    }
+    if (best < 0) {
+      best = slot_bytes.size();
+      slot_bytes.push_back(0);
+      slot_last_use.push_back(-1);
+    }
+    slot_bytes[best] = std::max(slot_bytes[best], bytes);
+    slot_last_use[best] = storage_last_use[storage];
+    storage_slot[storage] = best;
+  }
+  // Reuse the buffers of a previous plan when they are large enough.
+  vector<shared_ptr<SyncedMemory> > pool(slot_bytes.size());
+  size_t pool_bytes = 0;
+  for (int slot = 0; slot < slot_bytes.size(); ++slot) {
+    if (slot < memory_pool_.size() &&
+        memory_pool_[slot]->size() >= slot_bytes[slot]) {
+      pool[slot] = memory_pool_[slot];
+    } else {
+      pool[slot].reset(new SyncedMemory(slot_bytes[slot]));
+    }
+    pool_bytes += pool[slot]->size();
+  }
+  planned_memory_.assign(num_blobs, NULL);
+  for (map<SyncedMemory*, int>::iterator it = storage_slot.begin();
+       it != storage_slot.end(); ++it) {
+    const vector<int>& ids = storage_blobs[it->first];
+    for (int i = 0; i < ids.size(); ++i) {
+      blobs_[ids[i]]->ShareDataMemory(pool[it->second]);
+      planned_memory_[ids[i]] = pool[it->second].get();
+    }
+  }
+  memory_pool_.swap(pool);
+  // Views and shared blobs are set up by the layers' Reshape; have the next
+  // Forward set them up again on the planned buffers.
+  reshaped_bottom_shapes_.assign(layers_.size(), vector<vector<int> >());
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Memory planner: " << planned_bytes << " bytes of blob data in "
+      << order.size() << " blobs share " << pool_bytes << " bytes in "
+      << memory_pool_.size() << " buffers";
+}
+
+template <typename Dtype>
+void Net<Dtype>::PlanSplitBackward(const bool elide) {
+  split_first_consumer_.assign(layers_.size(), -1);
+  split_diff_adds_.assign(layers_.size(), vector<pair<int, int> >());
+  if (forward_only_ || !elide) {
+    return;
+  }
+  // The (layer_id, bottom_id) reading each blob, and the number of layers
+  // writing it (more than one for blobs rewritten in place).
+  vector<vector<pair<int, int> > > readers(blobs_.size());
+  vector<int> num_writers(blobs_.size(), 0);
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int bottom_id = 0; bottom_id < bottom_id_vecs_[layer_id].size();
+         ++bottom_id) {
+      readers[bottom_id_vecs_[layer_id][bottom_id]].push_back(
+          make_pair(layer_id, bottom_id));
+    }
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      ++num_writers[top_id_vecs_[layer_id][top_id]];
+    }
+  }
+  int num_elided = 0;
+  for (int split_id = 0; split_id < layers_.size(); ++split_id) {
+    if (string(layers_[split_id]->type()) != "Split" ||
+        !layer_need_backward_[split_id] ||
+        !bottom_need_backward_[split_id][0] ||
+        readers[bottom_id_vecs_[split_id][0]].size() != 1) {
+      continue;
+    }
+    // A top diff must be written by its consumer's backward and by nothing
+    // else, so that it can be added into the input right afterwards.
+    bool elide = true;
+    vector<pair<int, int> > adds;
+    for (int top_id = 0; elide && top_id < top_id_vecs_[split_id].size();
+         ++top_id) {
+      const int blob_id = top_id_vecs_[split_id][top_id];
+      if (readers[blob_id].size() != 1 || num_writers[blob_id] != 1) {
+        elide = false;
+        break;
+      }
+      const int layer_id = readers[blob_id][0].first;
+      const int bottom_id = readers[blob_id][0].second;
+      if (string(layers_[layer_id]->type()) == "Split") {
+        elide = false;
+        break;
+      }
+      // Consumers that do not propagate down contribute nothing.
+      if (!layer_need_backward_[layer_id] ||
+          !bottom_need_backward_[layer_id][bottom_id]) {
+        continue;
+      }
+      for (int i = 0; i < adds.size(); ++i) {
+        if (adds[i].first == layer_id) {
+          elide = false;
+        }
+      }
+      adds.push_back(make_pair(layer_id, bottom_id));
+    }
+    if (!elide || adds.empty()) {
+      continue;
+    }
+    // Backward runs in reverse layer order, so the last consumer is the first
+    // to write the input diff.
+    int first_consumer = -1;
+    for (int i = 0; i < adds.size(); ++i) {
+      first_consumer = std::max(first_consumer, adds[i].first);
+      split_diff_adds_[adds[i].first].push_back(
+          make_pair(adds[i].second, split_id));
+    }
+    split_first_consumer_[split_id] = first_consumer;
+    ++num_elided;
+  }
+  if (num_elided > 0) {
+    LOG_IF(INFO, Caffe::root_solver())
+        << "Elided the backward of " << num_elided << " split layers";
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::AccumulateSplitDiffs(const int layer_id, const int start,
+                                      const int end) {
+  const vector<pair<int, int> >& adds = split_diff_adds_[layer_id];
+  for (int i = 0; i < adds.size(); ++i) {
+    const int split_id = adds[i].second;
+    if (!SplitElided(split_id, start, end)) {
+      continue;
+    }
+    const Blob<Dtype>* top = bottom_vecs_[layer_id][adds[i].first];
+    Blob<Dtype>* input = bottom_vecs_[split_id][0];
+    const bool overwrite = split_first_consumer_[split_id] == layer_id;
+    switch (Caffe::mode()) {
+    case Caffe::CPU:
+      if (overwrite) {
+        caffe_copy(top->count(), top->cpu_diff(), input->mutable_cpu_diff());
+      } else {
+        caffe_axpy(top->count(), Dtype(1), top->cpu_diff(),
+                   input->mutable_cpu_diff());
+      }
+      break;
+    case Caffe::GPU:
+#ifdef USE_CUDA
+      if (overwrite) {
+        caffe_copy(top->count(), top->gpu_diff(), input->mutable_gpu_diff());
+      } else {
+        caffe_gpu_axpy(top->count(), Dtype(1), top->gpu_diff(),
+                       input->mutable_gpu_diff());
+      }
+#else
+      NO_GPU;
+#endif
+      break;
+    }
+  }
+}
+
 template <typename Dtype>
 Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
@@ -529,7 +874,9 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
     for (int c = 0; c < before_forward_.size(); ++c) {
       before_forward_[c]->run(i);
     }
-    Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+    ReshapeLayer(i);
+    Dtype layer_loss =
+        layers_[i]->ForwardReshaped(bottom_vecs_[i], top_vecs_[i]);
     loss += layer_loss;
     if (debug_info_) {
       ForwardDebugInfo(i);
@@ -538,6 +885,18 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
       after_forward_[c]->run(i);
     }
   }
+  // A blob reshaped past its planned buffer (Forward without Reshape after
+  // the inputs grew) was given memory of its own. Plan again once the pass
+  // is over, when no intermediate blob is left to be read.
+  if (optimize_memory_ && end == layers_.size() - 1) {
+    for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+      if (planned_memory_[blob_id] &&
+          blobs_[blob_id]->data().get() != planned_memory_[blob_id]) {
+        PlanMemory();
+        break;
+      }
+    }
+  }
   return loss;
 }
 
@@ -578,13 +937,18 @@ template <typename Dtype>
 void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
+  CHECK(!forward_only_) << "Backward called on a forward_only net.";
+  CHECK(!optimize_memory_)
+      << "Backward is not supported on a net with optimize_memory set.";
   for (int i = start; i >= end; --i) {
     for (int c = 0; c < before_backward_.size(); ++c) {
       before_backward_[c]->run(i);
     }
-    if (layer_need_backward_[i]) {
+    // Elided splits are summed by their consumers (see PlanSplitBackward).
+    if (layer_need_backward_[i] && !SplitElided(i, start, end)) {
       layers_[i]->Backward(top_vecs_[i], bottom_need_backward_[i],
                            bottom_vecs_[i]);
+      AccumulateSplitDiffs(i, start, end);
       if (debug_info_) {
         BackwardDebugInfo(i);
       }
@@ -735,9 +1099,51 @@ void Net<Dtype>::Backward() {
 
 template <typename Dtype>
 void Net<Dtype>::Reshape() {
+  bool reshaped = false;
   for (int i = 0; i < layers_.size(); ++i) {
-    layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
+    reshaped = ReshapeLayer(i) || reshaped;
+  }
+  if (optimize_memory_ && reshaped) {
+    PlanMemory();
+  }
+}
+
+template <typename Dtype>
+bool Net<Dtype>::ReshapeLayer(const int layer_id) {
+  const vector<Blob<Dtype>*>& bottom = bottom_vecs_[layer_id];
+  // Layers without bottoms (data layers) shape their tops as they go.
+  if (!reshape_cache_ || bottom.empty() ||
+      !layers_[layer_id]->ReshapeDependsOnlyOnShapes()) {
+    layers_[layer_id]->Reshape(bottom, top_vecs_[layer_id]);
+    return true;
   }
+  vector<vector<int> >& shapes = reshaped_bottom_shapes_[layer_id];
+  bool unchanged = shapes.size() == bottom.size();
+  for (int i = 0; unchanged && i < bottom.size(); ++i) {
+    unchanged = shapes[i] == bottom[i]->shape();
+  }
+  if (unchanged) {
+    return false;
+  }
+  layers_[layer_id]->Reshape(bottom, top_vecs_[layer_id]);
+  // Taken after Reshape, which may reshape an in-place bottom.
+  shapes.resize(bottom.size());
+  for (int i = 0; i < bottom.size(); ++i) {
+    shapes[i] = bottom[i]->shape();
+  }
+  return true;
+}
+
+template <typename Dtype>
+vector<int> Net<Dtype>::BucketShape(const vector<int>& shape) const {
+  vector<int> bucket(shape);
+  if (reshape_bucket_ > 0) {
+    for (int i = 2; i < bucket.size(); ++i) {
+      bucket[i] = (bucket[i] + reshape_bucket_ - 1) / reshape_bucket_ *
+                  reshape_bucket_;
+    }
+  }
+  return bucket;
 }
 
 template <typename Dtype>
@@ -840,7 +1246,16 @@ void Net<Dtype>::ShareWeights() {
       continue;
     }
     params_[i]->ShareData(*params_[param_owners_[i]]);
-    params_[i]->ShareDiff(*params_[param_owners_[i]]);
+    if (!forward_only_) {
+      params_[i]->ShareDiff(*params_[param_owners_[i]]);
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::PrepackWeights() {
+  for (int i = 0; i < layers_.size(); ++i) {
+    layers_[i]->PrepackWeights();
   }
 }
 
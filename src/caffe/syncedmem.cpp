@@ -5,7 +5,10 @@
 namespace caffe {
 SyncedMemory::SyncedMemory()
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED),
-    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false) {
+    own_cpu_data_(false), cpu_malloc_use_cuda_(false),
+    cpu_malloc_use_pool_(false), own_gpu_data_(false),
+    offset_(0), version_(0), half_format_(HALF_FLOAT16),
+    half_pending_(false) {
 #ifdef USE_CUDA
 #ifdef DEBUG
   CUDA_CHECK(cudaGetDevice(&device_));
@@ -15,7 +18,26 @@ SyncedMemory::SyncedMemory()
 
 SyncedMemory::SyncedMemory(size_t size)
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
-    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false) {
+    own_cpu_data_(false), cpu_malloc_use_cuda_(false),
+    cpu_malloc_use_pool_(false), own_gpu_data_(false),
+    offset_(0), version_(0), half_format_(HALF_FLOAT16),
+    half_pending_(false) {
+#ifdef USE_CUDA
+#ifdef DEBUG
+  CUDA_CHECK(cudaGetDevice(&device_));
+#endif
+#endif
+}
+
+SyncedMemory::SyncedMemory(const shared_ptr<SyncedMemory>& parent,
+                           size_t offset, size_t size)
+  : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
+    own_cpu_data_(false), cpu_malloc_use_cuda_(false),
+    cpu_malloc_use_pool_(false), own_gpu_data_(false),
+    parent_(parent), offset_(offset), version_(0),
+    half_format_(HALF_FLOAT16), half_pending_(false) {
+  CHECK(parent_);
+  CHECK_LE(offset_ + size_, parent_->size()) << "View exceeds its parent.";
 #ifdef USE_CUDA
 #ifdef DEBUG
   CUDA_CHECK(cudaGetDevice(&device_));
@@ -26,7 +48,7 @@ SyncedMemory::SyncedMemory(size_t size)
 SyncedMemory::~SyncedMemory() {
   check_device();
   if (cpu_ptr_ && own_cpu_data_) {
-    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    CaffeFreeHost(cpu_ptr_, size_, cpu_malloc_use_cuda_, cpu_malloc_use_pool_);
   }
 
 #ifdef USE_CUDA
@@ -40,7 +62,8 @@ inline void SyncedMemory::to_cpu() {
   check_device();
   switch (head_) {
   case UNINITIALIZED:
-    CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+    CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_,
+                    &cpu_malloc_use_pool_);
     caffe_memset(size_, 0, cpu_ptr_);
     head_ = HEAD_AT_CPU;
     own_cpu_data_ = true;
@@ -48,7 +71,8 @@ inline void SyncedMemory::to_cpu() {
   case HEAD_AT_GPU:
 #ifdef USE_CUDA
     if (cpu_ptr_ == NULL) {
-      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_,
+                    &cpu_malloc_use_pool_);
       own_cpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, gpu_ptr_, cpu_ptr_);
@@ -58,6 +82,10 @@ inline void SyncedMemory::to_cpu() {
 #endif
     break;
   case HEAD_AT_CPU:
+    if (half_pending_.load(std::memory_order_acquire)) {
+      widen_half();
+    }
+    break;
   case SYNCED:
     break;
   }
@@ -74,6 +102,9 @@ inline void SyncedMemory::to_gpu() {
     own_gpu_data_ = true;
     break;
   case HEAD_AT_CPU:
+    if (half_pending_.load(std::memory_order_acquire)) {
+      widen_half();
+    }
     if (gpu_ptr_ == NULL) {
       CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
       own_gpu_data_ = true;
@@ -92,6 +123,9 @@ inline void SyncedMemory::to_gpu() {
 
 const void* SyncedMemory::cpu_data() {
   check_device();
+  if (parent_) {
+    return static_cast<const char*>(parent_->cpu_data()) + offset_;
+  }
   to_cpu();
   return (const void*)cpu_ptr_;
 }
@@ -99,17 +133,23 @@ const void* SyncedMemory::cpu_data() {
 void SyncedMemory::set_cpu_data(void* data) {
   check_device();
   CHECK(data);
+  CHECK(!parent_) << "Cannot set the memory of a view.";
   if (own_cpu_data_) {
-    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    CaffeFreeHost(cpu_ptr_, size_, cpu_malloc_use_cuda_, cpu_malloc_use_pool_);
   }
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
   own_cpu_data_ = false;
+  clear_half();
+  ++version_;
 }
 
 const void* SyncedMemory::gpu_data() {
   check_device();
 #ifdef USE_CUDA
+  if (parent_) {
+    return static_cast<const char*>(parent_->gpu_data()) + offset_;
+  }
   to_gpu();
   return (const void*)gpu_ptr_;
 #else
@@ -122,12 +162,15 @@ void SyncedMemory::set_gpu_data(void* data) {
   check_device();
 #ifdef USE_CUDA
   CHECK(data);
+  CHECK(!parent_) << "Cannot set the memory of a view.";
   if (own_gpu_data_) {
     CUDA_CHECK(cudaFree(gpu_ptr_));
   }
   gpu_ptr_ = data;
   head_ = HEAD_AT_GPU;
   own_gpu_data_ = false;
+  clear_half();
+  ++version_;
 #else
   NO_GPU;
 #endif
@@ -135,16 +178,26 @@ void SyncedMemory::set_gpu_data(void* data) {
 
 void* SyncedMemory::mutable_cpu_data() {
   check_device();
+  if (parent_) {
+    return static_cast<char*>(parent_->mutable_cpu_data()) + offset_;
+  }
   to_cpu();
   head_ = HEAD_AT_CPU;
+  clear_half();
+  ++version_;
   return cpu_ptr_;
 }
 
 void* SyncedMemory::mutable_gpu_data() {
   check_device();
 #ifdef USE_CUDA
+  if (parent_) {
+    return static_cast<char*>(parent_->mutable_gpu_data()) + offset_;
+  }
   to_gpu();
   head_ = HEAD_AT_GPU;
+  clear_half();
+  ++version_;
   return gpu_ptr_;
 #else
   NO_GPU;
@@ -155,7 +208,14 @@ void* SyncedMemory::mutable_gpu_data() {
 #ifdef USE_CUDA
 void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
   check_device();
+  if (parent_) {
+    parent_->async_gpu_push(stream);
+    return;
+  }
   CHECK(head_ == HEAD_AT_CPU);
+  if (half_pending_.load(std::memory_order_acquire)) {
+    widen_half();
+  }
   if (gpu_ptr_ == NULL) {
     CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
     own_gpu_data_ = true;
@@ -167,6 +227,54 @@ void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
 }
 #endif
 
+void SyncedMemory::to_half(HalfFormat format) {
+  CHECK(!parent_) << "Cannot hold a view in 16 bits.";
+  std::vector<uint16_t> half(size_ / sizeof(float));
+  caffe_cpu_float_to_half(half.size(), static_cast<const float*>(cpu_data()),
+                          half.data(), format);
+  set_half_data(half.data(), half.size(), format);
+}
+
+void SyncedMemory::set_half_data(const uint16_t* data, size_t count,
+                                 HalfFormat format) {
+  check_device();
+  CHECK(!parent_) << "Cannot hold a view in 16 bits.";
+  CHECK_LE(count * sizeof(float), size_);
+  if (cpu_ptr_ && own_cpu_data_) {
+    CaffeFreeHost(cpu_ptr_, size_, cpu_malloc_use_cuda_, cpu_malloc_use_pool_);
+  }
+  cpu_ptr_ = NULL;
+  own_cpu_data_ = false;
+  half_data_.assign(data, data + count);
+  half_data_.resize(size_ / sizeof(float), 0);
+  half_format_ = format;
+  half_pending_.store(true, std::memory_order_relaxed);
+  head_ = HEAD_AT_CPU;
+  ++version_;
+}
+
+void SyncedMemory::widen_half() {
+  std::lock_guard<std::mutex> lock(half_mutex_);
+  // Another thread may have widened them meanwhile.
+  if (!half_pending_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_,
+                  &cpu_malloc_use_pool_);
+  caffe_cpu_half_to_float(half_data_.size(), half_data_.data(),
+                          static_cast<float*>(cpu_ptr_), half_format_);
+  own_cpu_data_ = true;
+  // Readers that see the flag cleared also see the floats and cpu_ptr_.
+  half_pending_.store(false, std::memory_order_release);
+}
+
+void SyncedMemory::clear_half() {
+  half_pending_.store(false, std::memory_order_relaxed);
+  if (!half_data_.empty()) {
+    std::vector<uint16_t>().swap(half_data_);
+  }
+}
+
 void SyncedMemory::check_device() {
 #ifdef USE_CUDA
 #ifdef DEBUG
@@ -0,0 +1,521 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/blocked_gemm.hpp"
+#include "caffe/util/cpu_info.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#ifdef CAFFE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+CAFFE_DEFINE_bool(blocked_gemm, false,
+    "Compute single precision caffe_cpu_gemm with Caffe's own blocked GEMM "
+    "instead of the BLAS library.");
+
+namespace caffe {
+
+namespace {
+
+// The micro-kernels compute kMR x kNR tiles of C from panels of kMR rows of A
+// and kNR columns of B, kKC deep. A kMC x kKC block of A stays in L2 and a
+// kKC x kNC block of B in L3 while the tiles of C are swept.
+const int kMR = 6;
+const int kNR = 16;
+const int kKC = 256;
+const int kMC = 144;
+const int kNC = 2048;
+
+inline int RoundUp(int n, int multiple) {
+  return (n + multiple - 1) / multiple * multiple;
+}
+
+// op(X)(i, j) of a row-major X with leading dimension ld.
+template <typename Dtype>
+inline Dtype At(const Dtype* X, int ld, bool trans, int i, int j) {
+  return trans ? X[j * ld + i] : X[i * ld + j];
+}
+
+// Copy rows [i0, i0 + m) x depths [k0, k0 + kc) of op(A) into panels of kMR
+// rows; each panel stores its kMR values of a depth contiguously. Rows past
+// the end are zero.
+template <typename Dtype>
+void PackPanelsA(const Dtype* A, int lda, bool trans, int M, int i0, int m,
+    int k0, int kc, Dtype* packed) {
+  for (int i = i0; i < i0 + m; i += kMR) {
+    for (int k = k0; k < k0 + kc; ++k) {
+      for (int r = i; r < i + kMR; ++r) {
+        *packed++ = r < M ? At(A, lda, trans, r, k) : Dtype(0);
+      }
+    }
+  }
+}
+
+// Copy depths [k0, k0 + kc) x columns [j0, j0 + n) of op(B) into panels of
+// kNR columns.
+template <typename Dtype>
+void PackPanelsB(const Dtype* B, int ldb, bool trans, int N, int j0, int n,
+    int k0, int kc, Dtype* packed) {
+  for (int j = j0; j < j0 + n; j += kNR) {
+    for (int k = k0; k < k0 + kc; ++k) {
+      for (int c = j; c < j + kNR; ++c) {
+        *packed++ = c < N ? At(B, ldb, trans, k, c) : Dtype(0);
+      }
+    }
+  }
+}
+
+// y = the n 16-bit values of x, widened.
+inline void Widen(int n, const uint16_t* x, HalfFormat format, float* y) {
+  caffe_cpu_half_to_float(n, x, y, format);
+}
+
+template <typename Dtype>
+void Widen(int n, const uint16_t* x, HalfFormat format, Dtype* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = half_to_float(x[i], format);
+  }
+}
+
+// Widen rows [r0, r0 + rows) x columns [c0, c0 + cols) of a row-major X
+// into a dense rows x cols block.
+template <typename Dtype>
+void WidenBlock(const uint16_t* X, int ld, HalfFormat format, int r0,
+    int rows, int c0, int cols, Dtype* block) {
+  for (int r = 0; r < rows; ++r) {
+    Widen(cols, X + static_cast<size_t>(r0 + r) * ld + c0, format,
+          block + r * cols);
+  }
+}
+
+// A matrix packed whole holds, for every kKC deep slice, the panels of all
+// its rows (or columns); slice k0 starts at k0 * the padded row count.
+
+// Computes a tile of kMR * panels rows from consecutive panels of A.
+template <typename Dtype>
+struct MicroKernel {
+  typedef void (*Fn)(int kc, const Dtype* a, const Dtype* b, Dtype* tile);
+  Fn fn;
+  int panels;
+};
+
+template <typename Dtype>
+void KernelScalar(int kc, const Dtype* a, const Dtype* b, Dtype* tile) {
+  Dtype acc[kMR][kNR] = {};
+  for (int k = 0; k < kc; ++k, a += kMR, b += kNR) {
+    for (int i = 0; i < kMR; ++i) {
+      for (int j = 0; j < kNR; ++j) {
+        acc[i][j] += a[i] * b[j];
+      }
+    }
+  }
+  std::copy(&acc[0][0], &acc[0][0] + kMR * kNR, tile);
+}
+
+#ifdef CAFFE_X86_DISPATCH
+
+// Twelve accumulators of 8 floats: 6 rows times 2 halves of a 16-wide row.
+CAFFE_TARGET_AVX2 void KernelAvx2(int kc, const float* a, const float* b,
+    float* tile) {
+  __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+  __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+  __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+  __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+  __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+  __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+  for (int k = 0; k < kc; ++k, a += kMR, b += kNR) {
+    const __m256 b0 = _mm256_loadu_ps(b);
+    const __m256 b1 = _mm256_loadu_ps(b + 8);
+    __m256 ai = _mm256_broadcast_ss(a);
+    c00 = _mm256_fmadd_ps(ai, b0, c00);
+    c01 = _mm256_fmadd_ps(ai, b1, c01);
+    ai = _mm256_broadcast_ss(a + 1);
+    c10 = _mm256_fmadd_ps(ai, b0, c10);
+    c11 = _mm256_fmadd_ps(ai, b1, c11);
+    ai = _mm256_broadcast_ss(a + 2);
+    c20 = _mm256_fmadd_ps(ai, b0, c20);
+    c21 = _mm256_fmadd_ps(ai, b1, c21);
+    ai = _mm256_broadcast_ss(a + 3);
+    c30 = _mm256_fmadd_ps(ai, b0, c30);
+    c31 = _mm256_fmadd_ps(ai, b1, c31);
+    ai = _mm256_broadcast_ss(a + 4);
+    c40 = _mm256_fmadd_ps(ai, b0, c40);
+    c41 = _mm256_fmadd_ps(ai, b1, c41);
+    ai = _mm256_broadcast_ss(a + 5);
+    c50 = _mm256_fmadd_ps(ai, b0, c50);
+    c51 = _mm256_fmadd_ps(ai, b1, c51);
+  }
+  _mm256_storeu_ps(tile, c00);
+  _mm256_storeu_ps(tile + 8, c01);
+  _mm256_storeu_ps(tile + 16, c10);
+  _mm256_storeu_ps(tile + 24, c11);
+  _mm256_storeu_ps(tile + 32, c20);
+  _mm256_storeu_ps(tile + 40, c21);
+  _mm256_storeu_ps(tile + 48, c30);
+  _mm256_storeu_ps(tile + 56, c31);
+  _mm256_storeu_ps(tile + 64, c40);
+  _mm256_storeu_ps(tile + 72, c41);
+  _mm256_storeu_ps(tile + 80, c50);
+  _mm256_storeu_ps(tile + 88, c51);
+  // The callers are SSE code, which stalls on dirty upper halves.
+  _mm256_zeroupper();
+}
+
+// Twelve accumulators of 16 floats: two panels of A, 12 rows, at once.
+CAFFE_TARGET_AVX512 void KernelAvx512(int kc, const float* a, const float* b,
+    float* tile) {
+  const float* a2 = a + kMR * kc;
+  __m512 c0 = _mm512_setzero_ps(), c1 = _mm512_setzero_ps();
+  __m512 c2 = _mm512_setzero_ps(), c3 = _mm512_setzero_ps();
+  __m512 c4 = _mm512_setzero_ps(), c5 = _mm512_setzero_ps();
+  __m512 c6 = _mm512_setzero_ps(), c7 = _mm512_setzero_ps();
+  __m512 c8 = _mm512_setzero_ps(), c9 = _mm512_setzero_ps();
+  __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+  for (int k = 0; k < kc; ++k, a += kMR, a2 += kMR, b += kNR) {
+    const __m512 b0 = _mm512_loadu_ps(b);
+    c0 = _mm512_fmadd_ps(_mm512_set1_ps(a[0]), b0, c0);
+    c1 = _mm512_fmadd_ps(_mm512_set1_ps(a[1]), b0, c1);
+    c2 = _mm512_fmadd_ps(_mm512_set1_ps(a[2]), b0, c2);
+    c3 = _mm512_fmadd_ps(_mm512_set1_ps(a[3]), b0, c3);
+    c4 = _mm512_fmadd_ps(_mm512_set1_ps(a[4]), b0, c4);
+    c5 = _mm512_fmadd_ps(_mm512_set1_ps(a[5]), b0, c5);
+    c6 = _mm512_fmadd_ps(_mm512_set1_ps(a2[0]), b0, c6);
+    c7 = _mm512_fmadd_ps(_mm512_set1_ps(a2[1]), b0, c7);
+    c8 = _mm512_fmadd_ps(_mm512_set1_ps(a2[2]), b0, c8);
+    c9 = _mm512_fmadd_ps(_mm512_set1_ps(a2[3]), b0, c9);
+    c10 = _mm512_fmadd_ps(_mm512_set1_ps(a2[4]), b0, c10);
+    c11 = _mm512_fmadd_ps(_mm512_set1_ps(a2[5]), b0, c11);
+  }
+  _mm512_storeu_ps(tile, c0);
+  _mm512_storeu_ps(tile + 16, c1);
+  _mm512_storeu_ps(tile + 32, c2);
+  _mm512_storeu_ps(tile + 48, c3);
+  _mm512_storeu_ps(tile + 64, c4);
+  _mm512_storeu_ps(tile + 80, c5);
+  _mm512_storeu_ps(tile + 96, c6);
+  _mm512_storeu_ps(tile + 112, c7);
+  _mm512_storeu_ps(tile + 128, c8);
+  _mm512_storeu_ps(tile + 144, c9);
+  _mm512_storeu_ps(tile + 160, c10);
+  _mm512_storeu_ps(tile + 176, c11);
+  _mm256_zeroupper();
+}
+
+#endif  // CAFFE_X86_DISPATCH
+
+// The widest kernel, and the one-panel kernel for the rows it leaves.
+template <typename Dtype>
+void SelectKernels(MicroKernel<Dtype>* wide, MicroKernel<Dtype>* narrow) {
+  wide->fn = narrow->fn = KernelScalar<Dtype>;
+  wide->panels = narrow->panels = 1;
+}
+
+template <>
+void SelectKernels(MicroKernel<float>* wide, MicroKernel<float>* narrow) {
+  wide->fn = narrow->fn = KernelScalar<float>;
+  wide->panels = narrow->panels = 1;
+#ifdef CAFFE_X86_DISPATCH
+  const CpuIsa isa = cpu_isa();
+  if (isa >= CPU_ISA_AVX2) {
+    wide->fn = narrow->fn = KernelAvx2;
+  }
+  if (isa >= CPU_ISA_AVX512) {
+    wide->fn = KernelAvx512;
+    wide->panels = 2;
+  }
+#endif
+}
+
+// C[0:m, 0:n] = alpha tile + beta C; C is not read when beta is zero.
+template <typename Dtype>
+void StoreTile(const Dtype* tile, int m, int n, Dtype alpha, Dtype beta,
+    Dtype* C, int ldc) {
+  for (int i = 0; i < m; ++i, tile += kNR, C += ldc) {
+    if (beta == Dtype(0)) {
+      for (int j = 0; j < n; ++j) {
+        C[j] = alpha * tile[j];
+      }
+    } else {
+      for (int j = 0; j < n; ++j) {
+        C[j] = alpha * tile[j] + beta * C[j];
+      }
+    }
+  }
+}
+
+// An operand as given to the GEMM: a row-major matrix in Dtype or in 16
+// bits, or one packed whole by PackedMatrix.
+template <typename Dtype>
+struct Operand {
+  const Dtype* data;
+  int ld;
+  bool trans;
+  const Dtype* packed;
+  const uint16_t* half;
+  HalfFormat format;
+};
+
+// The buffers a thread packs unpacked operands into, and widens 16-bit ones
+// into before.
+template <typename Dtype>
+Dtype* PackBuffer(int index, size_t size) {
+  thread_local std::vector<Dtype> buffers[3];
+  if (buffers[index].size() < size) {
+    buffers[index].resize(size);
+  }
+  return buffers[index].data();
+}
+
+// PackPanelsA from rows [i0, i0 + m) x depths [k0, k0 + kc) of an unpacked
+// operand.
+template <typename Dtype>
+void PackOperandA(const Operand<Dtype>& A, int M, int i0, int m, int k0,
+    int kc, Dtype* packed) {
+  if (!A.half) {
+    PackPanelsA(A.data, A.ld, A.trans, M, i0, m, k0, kc, packed);
+    return;
+  }
+  Dtype* block = PackBuffer<Dtype>(2, static_cast<size_t>(m) * kc);
+  if (A.trans) {
+    WidenBlock(A.half, A.ld, A.format, k0, kc, i0, m, block);
+  } else {
+    WidenBlock(A.half, A.ld, A.format, i0, m, k0, kc, block);
+  }
+  PackPanelsA(block, A.trans ? m : kc, A.trans, m, 0, m, 0, kc, packed);
+}
+
+// PackPanelsB from depths [k0, k0 + kc) x columns [j0, j0 + n) of an
+// unpacked operand.
+template <typename Dtype>
+void PackOperandB(const Operand<Dtype>& B, int N, int j0, int n, int k0,
+    int kc, Dtype* packed) {
+  if (!B.half) {
+    PackPanelsB(B.data, B.ld, B.trans, N, j0, n, k0, kc, packed);
+    return;
+  }
+  Dtype* block = PackBuffer<Dtype>(2, static_cast<size_t>(n) * kc);
+  if (B.trans) {
+    WidenBlock(B.half, B.ld, B.format, j0, n, k0, kc, block);
+  } else {
+    WidenBlock(B.half, B.ld, B.format, k0, kc, j0, n, block);
+  }
+  PackPanelsB(block, B.trans ? kc : n, B.trans, n, 0, n, 0, kc, packed);
+}
+
+// C[:, j0:j1] = alpha op(A) op(B)[:, j0:j1] + beta C[:, j0:j1], where j0 is a
+// multiple of kNR.
+template <typename Dtype>
+void GemmColumns(int M, int K, int j0, int j1, Dtype alpha,
+    const Operand<Dtype>& A, const Operand<Dtype>& B, int N, Dtype beta,
+    Dtype* C) {
+  MicroKernel<Dtype> wide, narrow;
+  SelectKernels(&wide, &narrow);
+  const int padded_m = RoundUp(M, kMR);
+  const int padded_n = RoundUp(N, kNR);
+  Dtype tile[2 * kMR * kNR];
+  for (int jc = j0; jc < j1; jc += kNC) {
+    const int nc = std::min(kNC, j1 - jc);
+    for (int pc = 0; pc < K; pc += kKC) {
+      const int kc = std::min(kKC, K - pc);
+      const Dtype* b_block;
+      if (B.packed) {
+        b_block = B.packed + pc * padded_n + jc * kc;
+      } else {
+        Dtype* buffer = PackBuffer<Dtype>(1, RoundUp(nc, kNR) * kc);
+        PackOperandB(B, N, jc, nc, pc, kc, buffer);
+        b_block = buffer;
+      }
+      // Later slices of K accumulate into the first one.
+      const Dtype block_beta = pc == 0 ? beta : Dtype(1);
+      for (int ic = 0; ic < M; ic += kMC) {
+        const int mc = std::min(kMC, M - ic);
+        const Dtype* a_block;
+        if (A.packed) {
+          a_block = A.packed + pc * padded_m + ic * kc;
+        } else {
+          Dtype* buffer = PackBuffer<Dtype>(0, RoundUp(mc, kMR) * kc);
+          PackOperandA(A, M, ic, mc, pc, kc, buffer);
+          a_block = buffer;
+        }
+        for (int jr = 0; jr < nc; jr += kNR) {
+          const int n = std::min(kNR, nc - jr);
+          const Dtype* b_panel = b_block + jr * kc;
+          Dtype* c_tile = C + ic * N + jc + jr;
+          int ir = 0;
+          for (; ir + wide.panels * kMR <= RoundUp(mc, kMR);
+               ir += wide.panels * kMR) {
+            wide.fn(kc, a_block + ir * kc, b_panel, tile);
+            StoreTile(tile, std::min(wide.panels * kMR, mc - ir), n, alpha,
+                      block_beta, c_tile + ir * N, N);
+          }
+          for (; ir < mc; ir += kMR) {
+            narrow.fn(kc, a_block + ir * kc, b_panel, tile);
+            StoreTile(tile, std::min(kMR, mc - ir), n, alpha, block_beta,
+                      c_tile + ir * N, N);
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void Gemm(int M, int N, int K, Dtype alpha, const Operand<Dtype>& A,
+    const Operand<Dtype>& B, Dtype beta, Dtype* C) {
+  if (M == 0 || N == 0) {
+    return;
+  }
+  if (K == 0) {
+    if (beta == Dtype(0)) {
+      caffe_set(M * N, Dtype(0), C);
+    } else {
+      caffe_scal(M * N, beta, C);
+    }
+    return;
+  }
+  // Split the columns by panels of B, so that each task does at least
+  // kMinParallelWork multiply-adds per column.
+  const int num_panels = (N + kNR - 1) / kNR;
+  const int grain = static_cast<int>(std::max<int64_t>(1,
+      kMinParallelWork / (static_cast<int64_t>(M) * K * kNR)));
+  parallel_for(num_panels, grain, [&](int begin, int end) {
+    GemmColumns(M, K, begin * kNR, std::min(end * kNR, N), alpha, A, B, N,
+                beta, C);
+  });
+}
+
+}  // namespace
+
+template <typename Dtype>
+void PackedMatrix<Dtype>::PackA(const CBLAS_TRANSPOSE TransA, const int M,
+    const int K, const Dtype* A) {
+  left_ = true;
+  rows_ = M;
+  cols_ = K;
+  const int padded_m = RoundUp(M, kMR);
+  data_.resize(static_cast<size_t>(padded_m) * K);
+  const bool trans = TransA != CblasNoTrans;
+  const int lda = trans ? M : K;
+  for (int pc = 0; pc < K; pc += kKC) {
+    const int kc = std::min(kKC, K - pc);
+    PackPanelsA(A, lda, trans, M, 0, M, pc, kc, &data_[pc * padded_m]);
+  }
+}
+
+template <typename Dtype>
+void PackedMatrix<Dtype>::PackB(const CBLAS_TRANSPOSE TransB, const int K,
+    const int N, const Dtype* B) {
+  left_ = false;
+  rows_ = K;
+  cols_ = N;
+  const int padded_n = RoundUp(N, kNR);
+  data_.resize(static_cast<size_t>(padded_n) * K);
+  const bool trans = TransB != CblasNoTrans;
+  const int ldb = trans ? K : N;
+  for (int pc = 0; pc < K; pc += kKC) {
+    const int kc = std::min(kKC, K - pc);
+    PackPanelsB(B, ldb, trans, N, 0, N, pc, kc, &data_[pc * padded_n]);
+  }
+}
+
+template <typename Dtype>
+void PackedMatrix<Dtype>::PackA(const CBLAS_TRANSPOSE TransA, const int M,
+    const int K, const uint16_t* A, const HalfFormat format) {
+  std::vector<Dtype> widened(static_cast<size_t>(M) * K);
+  Widen(M * K, A, format, widened.data());
+  PackA(TransA, M, K, widened.data());
+}
+
+template <typename Dtype>
+void PackedMatrix<Dtype>::PackB(const CBLAS_TRANSPOSE TransB, const int K,
+    const int N, const uint16_t* B, const HalfFormat format) {
+  std::vector<Dtype> widened(static_cast<size_t>(K) * N);
+  Widen(K * N, B, format, widened.data());
+  PackB(TransB, K, N, widened.data());
+}
+
+template <typename Dtype>
+void caffe_cpu_blocked_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const Dtype* B, const Dtype beta,
+    Dtype* C) {
+  const Operand<Dtype> a = { A, TransA == CblasNoTrans ? K : M,
+                             TransA != CblasNoTrans, NULL };
+  const Operand<Dtype> b = { B, TransB == CblasNoTrans ? N : K,
+                             TransB != CblasNoTrans, NULL };
+  Gemm(M, N, K, alpha, a, b, beta, C);
+}
+
+template <typename Dtype>
+void caffe_cpu_blocked_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const uint16_t* A, const HalfFormat format,
+    const Dtype* B, const Dtype beta, Dtype* C) {
+  const Operand<Dtype> a = { NULL, TransA == CblasNoTrans ? K : M,
+                             TransA != CblasNoTrans, NULL, A, format };
+  const Operand<Dtype> b = { B, TransB == CblasNoTrans ? N : K,
+                             TransB != CblasNoTrans, NULL };
+  Gemm(M, N, K, alpha, a, b, beta, C);
+}
+
+template <typename Dtype>
+void caffe_cpu_blocked_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const uint16_t* B,
+    const HalfFormat format, const Dtype beta, Dtype* C) {
+  const Operand<Dtype> a = { A, TransA == CblasNoTrans ? K : M,
+                             TransA != CblasNoTrans, NULL };
+  const Operand<Dtype> b = { NULL, TransB == CblasNoTrans ? N : K,
+                             TransB != CblasNoTrans, NULL, B, format };
+  Gemm(M, N, K, alpha, a, b, beta, C);
+}
+
+template <typename Dtype>
+void caffe_cpu_blocked_gemm(const PackedMatrix<Dtype>& A,
+    const CBLAS_TRANSPOSE TransB, const int N, const Dtype alpha,
+    const Dtype* B, const Dtype beta, Dtype* C) {
+  CHECK(A.left()) << "The matrix was packed as a right operand.";
+  const int K = A.cols();
+  const Operand<Dtype> a = { NULL, 0, false, A.data() };
+  const Operand<Dtype> b = { B, TransB == CblasNoTrans ? N : K,
+                             TransB != CblasNoTrans, NULL };
+  Gemm(A.rows(), N, K, alpha, a, b, beta, C);
+}
+
+template <typename Dtype>
+void caffe_cpu_blocked_gemm(const CBLAS_TRANSPOSE TransA, const int M,
+    const Dtype alpha, const Dtype* A, const PackedMatrix<Dtype>& B,
+    const Dtype beta, Dtype* C) {
+  CHECK(!B.left()) << "The matrix was packed as a left operand.";
+  const int K = B.rows();
+  const Operand<Dtype> a = { A, TransA == CblasNoTrans ? K : M,
+                             TransA != CblasNoTrans, NULL };
+  const Operand<Dtype> b = { NULL, 0, false, B.data() };
+  Gemm(M, B.cols(), K, alpha, a, b, beta, C);
+}
+
+template class PackedMatrix<float>;
+template class PackedMatrix<double>;
+
+#define INSTANTIATE_BLOCKED_GEMM(Dtype) \
+  template void caffe_cpu_blocked_gemm<Dtype>(const CBLAS_TRANSPOSE, \
+      const CBLAS_TRANSPOSE, const int, const int, const int, const Dtype, \
+      const Dtype*, const Dtype*, const Dtype, Dtype*); \
+  template void caffe_cpu_blocked_gemm<Dtype>(const CBLAS_TRANSPOSE, \
+      const CBLAS_TRANSPOSE, const int, const int, const int, const Dtype, \
+      const uint16_t*, const HalfFormat, const Dtype*, const Dtype, Dtype*); \
+  template void caffe_cpu_blocked_gemm<Dtype>(const CBLAS_TRANSPOSE, \
+      const CBLAS_TRANSPOSE, const int, const int, const int, const Dtype, \
+      const Dtype*, const uint16_t*, const HalfFormat, const Dtype, Dtype*); \
+  template void caffe_cpu_blocked_gemm<Dtype>(const PackedMatrix<Dtype>&, \
+      const CBLAS_TRANSPOSE, const int, const Dtype, const Dtype*, \
+      const Dtype, Dtype*); \
+  template void caffe_cpu_blocked_gemm<Dtype>(const CBLAS_TRANSPOSE, \
+      const int, const Dtype, const Dtype*, const PackedMatrix<Dtype>&, \
+      const Dtype, Dtype*)
+
+INSTANTIATE_BLOCKED_GEMM(float);
+INSTANTIATE_BLOCKED_GEMM(double);
+
+}  // namespace caffe
@@ -0,0 +1,58 @@
+#include <atomic>
+
+#include "caffe/util/cpu_info.hpp"
+
+namespace caffe {
+
+namespace {
+
+CpuIsa DetectCpuIsa() {
+#ifdef CAFFE_X86_DISPATCH
+  __builtin_cpu_init();
+  const bool avx2 = __builtin_cpu_supports("avx2") &&
+                    __builtin_cpu_supports("fma") &&
+                    __builtin_cpu_supports("f16c");
+  if (avx2 && __builtin_cpu_supports("avx512f")) {
+    return CPU_ISA_AVX512;
+  }
+  if (avx2) {
+    return CPU_ISA_AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return CPU_ISA_SSE2;
+  }
+#endif
+  return CPU_ISA_SCALAR;
+}
+
+std::atomic<int>& max_cpu_isa() {
+  static std::atomic<int> isa(CPU_ISA_AVX512);
+  return isa;
+}
+
+}  // namespace
+
+CpuIsa cpu_isa() {
+  static const CpuIsa detected = DetectCpuIsa();
+  const int max_isa = max_cpu_isa();
+  return detected < max_isa ? detected : static_cast<CpuIsa>(max_isa);
+}
+
+void set_max_cpu_isa(CpuIsa isa) {
+  max_cpu_isa() = isa;
+}
+
+const char* cpu_isa_name(CpuIsa isa) {
+  switch (isa) {
+  case CPU_ISA_SSE2:
+    return "SSE2";
+  case CPU_ISA_AVX2:
+    return "AVX2";
+  case CPU_ISA_AVX512:
+    return "AVX-512";
+  default:
+    return "scalar";
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/deformable_im2col.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The size of the output along an axis of the given input size.
+inline int OutputSize(const int size, const int kernel, const int pad,
+                      const int stride, const int dilation) {
+  return (size + 2 * pad - (dilation * (kernel - 1) + 1)) / stride + 1;
+}
+
+// A bilinear sample of a channel plane: the pixels index, index + right,
+// index + below and index + below + right with weights w1 to w4, and the
+// fraction (lh, lw) of the sample between them. Samples outside the plane
+// have no weight, and a sample on the last row or column has no pixel
+// below or to its right, as in the CUDA kernels.
+template <typename Dtype>
+struct DeformableSample {
+  int index;
+  int right;
+  int below;
+  Dtype w1, w2, w3, w4;
+  Dtype lh, lw;
+};
+
+// The samples of the output rows [row_begin, row_end), which have
+// `columns` columns, for each deformable group and kernel tap:
+// (*samples)[(g * kernel_h * kernel_w + k) * columns + column]. All the
+// channels of a deformable group share them.
+template <typename Dtype>
+void DeformableSamples(const Dtype* data_offset, const int height,
+    const int width, const int kernel_h, const int kernel_w, const int pad_h,
+    const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int deformable_group,
+    const int row_begin, const int row_end,
+    vector<DeformableSample<Dtype> >* samples) {
+  const int height_col =
+      OutputSize(height, kernel_h, pad_h, stride_h, dilation_h);
+  const int width_col =
+      OutputSize(width, kernel_w, pad_w, stride_w, dilation_w);
+  const int kernel_size = kernel_h * kernel_w;
+  const int columns = (row_end - row_begin) * width_col;
+  samples->resize(deformable_group * kernel_size * columns);
+  const int grain = std::max(1, kMinParallelWork / std::max(columns, 1));
+  parallel_for(deformable_group * kernel_size, grain, [&](int begin, int end) {
+    for (int gk = begin; gk < end; ++gk) {
+      const int k = gk % kernel_size;
+      const int i = k / kernel_w;
+      const int j = k % kernel_w;
+      const Dtype* offset_h = data_offset +
+          2 * gk * height_col * width_col + row_begin * width_col;
+      const Dtype* offset_w = offset_h + height_col * width_col;
+      DeformableSample<Dtype>* sample = samples->data() + gk * columns;
+      for (int p = 0; p < columns; ++p, ++sample) {
+        const int h_col = row_begin + p / width_col;
+        const int w_col = p % width_col;
+        const Dtype h = h_col * stride_h - pad_h + i * dilation_h +
+            offset_h[p];
+        const Dtype w = w_col * stride_w - pad_w + j * dilation_w +
+            offset_w[p];
+        if (!(h >= 0 && w >= 0 && h < height && w < width)) {
+          sample->index = 0;
+          sample->right = 0;
+          sample->below = 0;
+          sample->w1 = sample->w2 = sample->w3 = sample->w4 = 0;
+          sample->lh = sample->lw = 0;
+          continue;
+        }
+        int h_low = std::floor(h);
+        int w_low = std::floor(w);
+        if (h_low >= height - 1) {
+          h_low = height - 1;
+          sample->below = 0;
+          sample->lh = 0;
+        } else {
+          sample->below = width;
+          sample->lh = h - h_low;
+        }
+        if (w_low >= width - 1) {
+          w_low = width - 1;
+          sample->right = 0;
+          sample->lw = 0;
+        } else {
+          sample->right = 1;
+          sample->lw = w - w_low;
+        }
+        sample->index = h_low * width + w_low;
+        const Dtype hh = 1 - sample->lh;
+        const Dtype hw = 1 - sample->lw;
+        sample->w1 = hh * hw;
+        sample->w2 = hh * sample->lw;
+        sample->w3 = sample->lh * hw;
+        sample->w4 = sample->lh * sample->lw;
+      }
+    }
+  });
+}
+
+}  // namespace
+
+template <typename Dtype>
+void deformable_im2col_rows_cpu(const Dtype* data_im, const Dtype* data_offset,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int deformable_group, const int row_begin,
+    const int row_end, Dtype* data_col) {
+  vector<DeformableSample<Dtype> > samples;
+  DeformableSamples(data_offset, height, width, kernel_h, kernel_w, pad_h,
+                    pad_w, stride_h, stride_w, dilation_h, dilation_w,
+                    deformable_group, row_begin, row_end, &samples);
+  const int kernel_size = kernel_h * kernel_w;
+  const int columns = (row_end - row_begin) *
+      OutputSize(width, kernel_w, pad_w, stride_w, dilation_w);
+  const int channels_per_group = channels / deformable_group;
+  const int grain =
+      std::max(1, kMinParallelWork / std::max(kernel_size * columns, 1));
+  parallel_for(channels, grain, [&](int begin, int end) {
+    for (int c = begin; c < end; ++c) {
+      const Dtype* im = data_im + c * height * width;
+      const DeformableSample<Dtype>* group_samples =
+          samples.data() + c / channels_per_group * kernel_size * columns;
+      Dtype* col = data_col + c * kernel_size * columns;
+      for (int k = 0; k < kernel_size * columns; ++k) {
+        const DeformableSample<Dtype>& s = group_samples[k];
+        const Dtype* pixel = im + s.index;
+        col[k] = s.w1 * pixel[0] + s.w2 * pixel[s.right] +
+            s.w3 * pixel[s.below] + s.w4 * pixel[s.below + s.right];
+      }
+    }
+  });
+}
+
+template void deformable_im2col_rows_cpu<float>(const float* data_im,
+    const float* data_offset, const int channels, const int height,
+    const int width, const int kernel_h, const int kernel_w, const int pad_h,
+    const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int deformable_group,
+    const int row_begin, const int row_end, float* data_col);
+template void deformable_im2col_rows_cpu<double>(const double* data_im,
+    const double* data_offset, const int channels, const int height,
+    const int width, const int kernel_h, const int kernel_w, const int pad_h,
+    const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int deformable_group,
+    const int row_begin, const int row_end, double* data_col);
+
+template <typename Dtype>
+void deformable_col2im_rows_cpu(const Dtype* data_col,
+    const Dtype* data_offset, const int channels, const int height,
+    const int width, const int kernel_h, const int kernel_w, const int pad_h,
+    const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int deformable_group,
+    const int row_begin, const int row_end, Dtype* grad_im) {
+  vector<DeformableSample<Dtype> > samples;
+  DeformableSamples(data_offset, height, width, kernel_h, kernel_w, pad_h,
+                    pad_w, stride_h, stride_w, dilation_h, dilation_w,
+                    deformable_group, row_begin, row_end, &samples);
+  const int kernel_size = kernel_h * kernel_w;
+  const int columns = (row_end - row_begin) *
+      OutputSize(width, kernel_w, pad_w, stride_w, dilation_w);
+  const int channels_per_group = channels / deformable_group;
+  const int grain =
+      std::max(1, kMinParallelWork / std::max(kernel_size * columns, 1));
+  // Samples of different channels never add to the same pixel.
+  parallel_for(channels, grain, [&](int begin, int end) {
+    for (int c = begin; c < end; ++c) {
+      Dtype* im = grad_im + c * height * width;
+      const DeformableSample<Dtype>* group_samples =
+          samples.data() + c / channels_per_group * kernel_size * columns;
+      const Dtype* col = data_col + c * kernel_size * columns;
+      for (int k = 0; k < kernel_size * columns; ++k) {
+        const DeformableSample<Dtype>& s = group_samples[k];
+        Dtype* pixel = im + s.index;
+        pixel[0] += s.w1 * col[k];
+        pixel[s.right] += s.w2 * col[k];
+        pixel[s.below] += s.w3 * col[k];
+        pixel[s.below + s.right] += s.w4 * col[k];
+      }
+    }
+  });
+}
+
+template void deformable_col2im_rows_cpu<float>(const float* data_col,
+    const float* data_offset, const int channels, const int height,
+    const int width, const int kernel_h, const int kernel_w, const int pad_h,
+    const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int deformable_group,
+    const int row_begin, const int row_end, float* grad_im);
+template void deformable_col2im_rows_cpu<double>(const double* data_col,
+    const double* data_offset, const int channels, const int height,
+    const int width, const int kernel_h, const int kernel_w, const int pad_h,
+    const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int deformable_group,
+    const int row_begin, const int row_end, double* grad_im);
+
+template <typename Dtype>
+void deformable_col2im_coord_rows_cpu(const Dtype* data_col,
+    const Dtype* data_im, const Dtype* data_offset, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int deformable_group,
+    const int row_begin, const int row_end, Dtype* grad_offset) {
+  vector<DeformableSample<Dtype> > samples;
+  DeformableSamples(data_offset, height, width, kernel_h, kernel_w, pad_h,
+                    pad_w, stride_h, stride_w, dilation_h, dilation_w,
+                    deformable_group, row_begin, row_end, &samples);
+  const int height_col =
+      OutputSize(height, kernel_h, pad_h, stride_h, dilation_h);
+  const int width_col =
+      OutputSize(width, kernel_w, pad_w, stride_w, dilation_w);
+  const int kernel_size = kernel_h * kernel_w;
+  const int columns = (row_end - row_begin) * width_col;
+  const int channels_per_group = channels / deformable_group;
+  const int grain = std::max(1, kMinParallelWork /
+      std::max(channels_per_group * columns, 1));
+  // Each (deformable group, kernel tap) owns a pair of offset planes.
+  parallel_for(deformable_group * kernel_size, grain, [&](int begin, int end) {
+    for (int gk = begin; gk < end; ++gk) {
+      const int g = gk / kernel_size;
+      const int k = gk % kernel_size;
+      const DeformableSample<Dtype>* tap_samples = samples.data() +
+          gk * columns;
+      Dtype* grad_h = grad_offset + 2 * gk * height_col * width_col +
+          row_begin * width_col;
+      Dtype* grad_w = grad_h + height_col * width_col;
+      std::fill(grad_h, grad_h + columns, Dtype(0));
+      std::fill(grad_w, grad_w + columns, Dtype(0));
+      for (int c = g * channels_per_group; c < (g + 1) * channels_per_group;
+           ++c) {
+        const Dtype* im = data_im + c * height * width;
+        const Dtype* col = data_col + (c * kernel_size + k) * columns;
+        for (int p = 0; p < columns; ++p) {
+          const DeformableSample<Dtype>& s = tap_samples[p];
+          const Dtype* pixel = im + s.index;
+          const Dtype v1 = pixel[0];
+          const Dtype v2 = pixel[s.right];
+          const Dtype v3 = pixel[s.below];
+          const Dtype v4 = pixel[s.below + s.right];
+          grad_h[p] += col[p] * ((1 - s.lw) * (v3 - v1) + s.lw * (v4 - v2));
+          grad_w[p] += col[p] * ((1 - s.lh) * (v2 - v1) + s.lh * (v4 - v3));
+        }
+      }
+    }
+  });
+}
+
+template void deformable_col2im_coord_rows_cpu<float>(const float* data_col,
+    const float* data_im, const float* data_offset, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int deformable_group,
+    const int row_begin, const int row_end, float* grad_offset);
+template void deformable_col2im_coord_rows_cpu<double>(const double* data_col,
+    const double* data_im, const double* data_offset, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int deformable_group,
+    const int row_begin, const int row_end, double* grad_offset);
+
+}  // namespace caffe
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cmath>
+
+#include "caffe/filler.hpp"
+#include "caffe/util/fused_activation.hpp"
+
+namespace caffe {
+
+namespace {
+
+template <typename Dtype>
+struct IdentityOp {
+  inline Dtype operator()(const Dtype x, const int c) const { return x; }
+};
+
+template <typename Dtype>
+struct ReLUOp {
+  Dtype negative_slope;
+  inline Dtype operator()(const Dtype x, const int c) const {
+    return std::max(x, Dtype(0)) + negative_slope * std::min(x, Dtype(0));
+  }
+};
+
+template <typename Dtype>
+struct ReLUXOp {
+  Dtype negative_slope;
+  Dtype maximal_value;
+  inline Dtype operator()(const Dtype x, const int c) const {
+    return std::min(std::max(x, Dtype(0)), maximal_value) +
+        negative_slope * std::min(x, Dtype(0));
+  }
+};
+
+template <typename Dtype>
+struct PReLUOp {
+  const Dtype* slope;
+  int div_factor;
+  inline Dtype operator()(const Dtype x, const int c) const {
+    return std::max(x, Dtype(0)) +
+        slope[c / div_factor] * std::min(x, Dtype(0));
+  }
+};
+
+template <typename Dtype>
+struct ELUOp {
+  Dtype alpha;
+  inline Dtype operator()(const Dtype x, const int c) const {
+    return std::max(x, Dtype(0)) +
+        alpha * (std::exp(std::min(x, Dtype(0))) - Dtype(1));
+  }
+};
+
+template <typename Dtype>
+struct SeLuOp {
+  Dtype alpha;
+  Dtype lambda;
+  inline Dtype operator()(const Dtype x, const int c) const {
+    return x > Dtype(0) ? lambda * x
+                        : lambda * alpha * (std::exp(x) - Dtype(1));
+  }
+};
+
+template <typename Dtype, typename Op>
+void bias_activation_cpu(const int num, const int channels, const int dim,
+    const Dtype* bias, const Op& op, Dtype* data) {
+  if (dim == 1) {
+    // Rows of channels, as InnerProduct and channels-last outputs are; keep
+    // the channels in the inner loop.
+    for (int n = 0; n < num; ++n) {
+      for (int c = 0; c < channels; ++c) {
+        data[c] = op(data[c] + (bias ? bias[c] : Dtype(0)), c);
+      }
+      data += channels;
+    }
+    return;
+  }
+  for (int n = 0; n < num; ++n) {
+    for (int c = 0; c < channels; ++c) {
+      const Dtype b = bias ? bias[c] : Dtype(0);
+      for (int i = 0; i < dim; ++i) {
+        data[i] = op(data[i] + b, c);
+      }
+      data += dim;
+    }
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+FusedActivation<Dtype>::FusedActivation(const LayerParameter& param)
+    : type_(param.fused_activation_param().type()),
+      negative_slope_(0), maximal_value_(0), alpha_(0), lambda_(0),
+      channel_shared_(false) {
+  switch (type_) {
+  case FusedActivationParameter_Type_NONE:
+    break;
+  case FusedActivationParameter_Type_RELU:
+    negative_slope_ = param.relu_param().negative_slope();
+    break;
+  case FusedActivationParameter_Type_RELUX:
+    negative_slope_ = param.relux_param().negative_slope();
+    maximal_value_ = param.relux_param().maximal_value();
+    CHECK_GE(maximal_value_, 0) << "maximal_value must be non-negative.";
+    break;
+  case FusedActivationParameter_Type_PRELU:
+    channel_shared_ = param.prelu_param().channel_shared();
+    if (param.prelu_param().has_filler()) {
+      slope_filler_ = param.prelu_param().filler();
+    } else {
+      slope_filler_.set_type("constant");
+      slope_filler_.set_value(0.25);
+    }
+    break;
+  case FusedActivationParameter_Type_ELU:
+    alpha_ = param.elu_param().alpha();
+    break;
+  case FusedActivationParameter_Type_SELU:
+    alpha_ = param.selu_param().alpha();
+    lambda_ = param.selu_param().lambda();
+    break;
+  default:
+    LOG(FATAL) << "Unknown fused activation type " << type_;
+  }
+}
+
+template <typename Dtype>
+void FusedActivation<Dtype>::FillSlope(Blob<Dtype>* slope) const {
+  shared_ptr<Filler<Dtype> > filler(GetFiller<Dtype>(slope_filler_));
+  filler->Fill(slope);
+}
+
+template <typename Dtype>
+void FusedActivation<Dtype>::Forward_cpu(const int num, const int channels,
+    const int dim, const Dtype* bias, const Dtype* slope, Dtype* data) const {
+  switch (type_) {
+  case FusedActivationParameter_Type_NONE: {
+    if (bias) {
+      bias_activation_cpu(num, channels, dim, bias, IdentityOp<Dtype>(), data);
+    }
+    break;
+  }
+  case FusedActivationParameter_Type_RELU: {
+    ReLUOp<Dtype> op = { negative_slope_ };
+    bias_activation_cpu(num, channels, dim, bias, op, data);
+    break;
+  }
+  case FusedActivationParameter_Type_RELUX: {
+    ReLUXOp<Dtype> op = { negative_slope_, maximal_value_ };
+    bias_activation_cpu(num, channels, dim, bias, op, data);
+    break;
+  }
+  case FusedActivationParameter_Type_PRELU: {
+    PReLUOp<Dtype> op = { slope, channel_shared_ ? channels : 1 };
+    bias_activation_cpu(num, channels, dim, bias, op, data);
+    break;
+  }
+  case FusedActivationParameter_Type_ELU: {
+    ELUOp<Dtype> op = { alpha_ };
+    bias_activation_cpu(num, channels, dim, bias, op, data);
+    break;
+  }
+  case FusedActivationParameter_Type_SELU: {
+    SeLuOp<Dtype> op = { alpha_, lambda_ };
+    bias_activation_cpu(num, channels, dim, bias, op, data);
+    break;
+  }
+  default:
+    LOG(FATAL) << "Unknown fused activation type " << type_;
+  }
+}
+
+INSTANTIATE_CLASS(FusedActivation);
+
+}  // namespace caffe
@@ -0,0 +1,62 @@
+#include "caffe/util/fused_activation.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+__global__ void FusedActivationForward(const int n, const int channels,
+    const int dim, const Dtype* bias, const Dtype* slope, const int div_factor,
+    const FusedActivationParameter_Type type, const Dtype negative_slope,
+    const Dtype maximal_value, const Dtype alpha, const Dtype lambda,
+    Dtype* data) {
+  CUDA_KERNEL_LOOP(index, n) {
+    const int c = (index / dim) % channels;
+    Dtype x = data[index];
+    if (bias) {
+      x += bias[c];
+    }
+    switch (type) {
+    case FusedActivationParameter_Type_RELU:
+      x = x > 0 ? x : x * negative_slope;
+      break;
+    case FusedActivationParameter_Type_RELUX:
+      x = x > 0 ? min(x, maximal_value) : x * negative_slope;
+      break;
+    case FusedActivationParameter_Type_PRELU:
+      x = x > 0 ? x : x * slope[c / div_factor];
+      break;
+    case FusedActivationParameter_Type_ELU:
+      x = x > 0 ? x : alpha * (exp(x) - 1);
+      break;
+    case FusedActivationParameter_Type_SELU:
+      x = x > 0 ? lambda * x : lambda * alpha * (exp(x) - 1);
+      break;
+    default:
+      break;
+    }
+    data[index] = x;
+  }
+}
+
+template <typename Dtype>
+void FusedActivation<Dtype>::Forward_gpu(const int num, const int channels,
+    const int dim, const Dtype* bias, const Dtype* slope, Dtype* data) const {
+  if (!enabled() && !bias) {
+    return;
+  }
+  const int count = num * channels * dim;
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  FusedActivationForward<Dtype><<<CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS>>>(count, channels, dim, bias, slope,
+      channel_shared_ ? channels : 1, type_, negative_slope_, maximal_value_,
+      alpha_, lambda_, data);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template void FusedActivation<float>::Forward_gpu(const int num,
+    const int channels, const int dim, const float* bias, const float* slope,
+    float* data) const;
+template void FusedActivation<double>::Forward_gpu(const int num,
+    const int channels, const int dim, const double* bias,
+    const double* slope, double* data) const;
+
+}  // namespace caffe
@@ -0,0 +1,208 @@
+#include <cstring>
+
+#include "caffe/util/cpu_info.hpp"
+#include "caffe/util/half.hpp"
+
+#ifdef CAFFE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace caffe {
+
+namespace {
+
+inline uint32_t FloatBits(float x) {
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+inline float BitsFloat(uint32_t bits) {
+  float x;
+  std::memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+uint16_t FloatToFloat16(float value) {
+  const uint32_t x = FloatBits(value) & 0x7fffffff;
+  const uint16_t sign = (FloatBits(value) >> 16) & 0x8000;
+  if (x > 0x7f800000) {
+    // A quiet NaN keeping the upper payload bits, as F16C does.
+    return sign | 0x7e00 | ((x >> 13) & 0x3ff);
+  }
+  if (x >= 0x38800000) {
+    // Normal: rebias the exponent from 127 to 15 and round off 13 bits.
+    uint32_t h = x - 0x38000000;
+    h = (h + 0xfff + ((h >> 13) & 1)) >> 13;
+    return sign | (h >= 0x7c00 ? 0x7c00 : h);
+  }
+  if (x < 0x33000000) {
+    // Below half the smallest subnormal, 2^-24.
+    return sign;
+  }
+  // Subnormal: the mantissa in units of 2^-24.
+  const int shift = 126 - static_cast<int>(x >> 23);
+  const uint32_t mantissa = (x & 0x7fffff) | 0x800000;
+  uint32_t h = mantissa >> shift;
+  const uint32_t rest = mantissa & ((1u << shift) - 1);
+  const uint32_t tie = 1u << (shift - 1);
+  if (rest > tie || (rest == tie && (h & 1))) {
+    ++h;
+  }
+  return sign | h;
+}
+
+float Float16ToFloat(uint16_t h) {
+  const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+  const uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+  if (exponent == 0x1f) {
+    return BitsFloat(sign | 0x7f800000 | (mantissa << 13));
+  }
+  if (exponent != 0) {
+    return BitsFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+  }
+  if (mantissa == 0) {
+    return BitsFloat(sign);
+  }
+  // Subnormal: normalize the mantissa.
+  uint32_t float_exponent = 113;
+  while (!(mantissa & 0x400)) {
+    mantissa <<= 1;
+    --float_exponent;
+  }
+  return BitsFloat(sign | (float_exponent << 23) | ((mantissa & 0x3ff) << 13));
+}
+
+uint16_t FloatToBfloat16(float value) {
+  const uint32_t x = FloatBits(value);
+  if ((x & 0x7fffffff) > 0x7f800000) {
+    return (x >> 16) | 0x40;
+  }
+  return (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+}
+
+inline float Bfloat16ToFloat(uint16_t h) {
+  return BitsFloat(static_cast<uint32_t>(h) << 16);
+}
+
+#ifdef CAFFE_X86_DISPATCH
+
+CAFFE_TARGET_AVX2 void FloatToFloat16Avx2(int n, const float* x,
+    uint16_t* y) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(y + i), _mm256_cvtps_ph(
+        _mm256_loadu_ps(x + i), _MM_FROUND_TO_NEAREST_INT));
+  }
+  for (; i < n; ++i) {
+    y[i] = FloatToFloat16(x[i]);
+  }
+  // The callers are SSE code, which stalls on dirty upper halves.
+  _mm256_zeroupper();
+}
+
+CAFFE_TARGET_AVX2 void Float16ToFloatAvx2(int n, const uint16_t* x,
+    float* y) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_cvtph_ps(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i))));
+  }
+  for (; i < n; ++i) {
+    y[i] = Float16ToFloat(x[i]);
+  }
+  _mm256_zeroupper();
+}
+
+CAFFE_TARGET_AVX2 void FloatToBfloat16Avx2(int n, const float* x,
+    uint16_t* y) {
+  const __m256i bias = _mm256_set1_epi32(0x7fff);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i quiet = _mm256_set1_epi32(0x400000);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i halves[2];
+    for (int j = 0; j < 2; ++j) {
+      const __m256 v = _mm256_loadu_ps(x + i + 8 * j);
+      const __m256i bits = _mm256_castps_si256(v);
+      const __m256i odd = _mm256_and_si256(_mm256_srli_epi32(bits, 16), one);
+      const __m256i rounded = _mm256_add_epi32(bits,
+          _mm256_add_epi32(bias, odd));
+      const __m256i nan = _mm256_castps_si256(
+          _mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+      halves[j] = _mm256_srli_epi32(_mm256_blendv_epi8(rounded,
+          _mm256_or_si256(bits, quiet), nan), 16);
+    }
+    // packus works within 128-bit lanes; restore the order of the values.
+    const __m256i packed = _mm256_permute4x64_epi64(
+        _mm256_packus_epi32(halves[0], halves[1]), 0xd8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(y + i), packed);
+  }
+  for (; i < n; ++i) {
+    y[i] = FloatToBfloat16(x[i]);
+  }
+  _mm256_zeroupper();
+}
+
+CAFFE_TARGET_AVX2 void Bfloat16ToFloatAvx2(int n, const uint16_t* x,
+    float* y) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i h = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i)));
+    _mm256_storeu_ps(y + i, _mm256_castsi256_ps(_mm256_slli_epi32(h, 16)));
+  }
+  for (; i < n; ++i) {
+    y[i] = Bfloat16ToFloat(x[i]);
+  }
+  _mm256_zeroupper();
+}
+
+#endif  // CAFFE_X86_DISPATCH
+
+}  // namespace
+
+uint16_t float_to_half(float x, HalfFormat format) {
+  return format == HALF_BFLOAT16 ? FloatToBfloat16(x) : FloatToFloat16(x);
+}
+
+float half_to_float(uint16_t x, HalfFormat format) {
+  return format == HALF_BFLOAT16 ? Bfloat16ToFloat(x) : Float16ToFloat(x);
+}
+
+void caffe_cpu_float_to_half(const int n, const float* x, uint16_t* y,
+    HalfFormat format) {
+#ifdef CAFFE_X86_DISPATCH
+  if (cpu_isa() >= CPU_ISA_AVX2) {
+    if (format == HALF_BFLOAT16) {
+      FloatToBfloat16Avx2(n, x, y);
+    } else {
+      FloatToFloat16Avx2(n, x, y);
+    }
+    return;
+  }
+#endif
+  for (int i = 0; i < n; ++i) {
+    y[i] = float_to_half(x[i], format);
+  }
+}
+
+void caffe_cpu_half_to_float(const int n, const uint16_t* x, float* y,
+    HalfFormat format) {
+#ifdef CAFFE_X86_DISPATCH
+  if (cpu_isa() >= CPU_ISA_AVX2) {
+    if (format == HALF_BFLOAT16) {
+      Bfloat16ToFloatAvx2(n, x, y);
+    } else {
+      Float16ToFloatAvx2(n, x, y);
+    }
+    return;
+  }
+#endif
+  for (int i = 0; i < n; ++i) {
+    y[i] = half_to_float(x[i], format);
+  }
+}
+
+}  // namespace caffe
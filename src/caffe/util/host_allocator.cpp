@@ -0,0 +1,307 @@
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+#include "caffe/util/host_allocator.hpp"
+
+namespace caffe {
+
+const size_t HostAllocator::kAlignment;
+const size_t HostAllocator::kMaxCachedBlock;
+
+namespace {
+
+// Bytes a thread keeps for itself before handing blocks to the shared cache.
+const size_t kThreadCacheLimit = size_t(32) << 20;
+
+// The class of a request and the bytes of its blocks. Four classes per power
+// of two bound the rounding waste to 25%.
+int SizeClass(size_t size, size_t* class_bytes) {
+  const size_t min_bytes = HostAllocator::kAlignment;
+  if (size <= min_bytes) {
+    *class_bytes = min_bytes;
+    return 0;
+  }
+  // 2^log2 < size <= 2^(log2 + 1), with log2 >= 6.
+  int log2 = 0;
+  while ((size - 1) >> (log2 + 1)) {
+    ++log2;
+  }
+  const size_t step = size_t(1) << (log2 - 2);
+  const size_t steps = (size + step - 1) / step;
+  *class_bytes = steps * step;
+  return 1 + (log2 - 6) * 4 + static_cast<int>(steps - 5);
+}
+
+void* SystemAllocate(size_t bytes) {
+  void* ptr = NULL;
+#ifdef _MSC_VER
+  ptr = _aligned_malloc(bytes, HostAllocator::kAlignment);
+#else
+  if (posix_memalign(&ptr, HostAllocator::kAlignment, bytes) != 0) {
+    ptr = NULL;
+  }
+#endif
+  CHECK(ptr) << "host allocation of size " << bytes << " failed";
+  return ptr;
+}
+
+void SystemFree(void* ptr) {
+#ifdef _MSC_VER
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+// The block bytes of a size class.
+size_t ClassBytes(int size_class) {
+  if (size_class == 0) {
+    return HostAllocator::kAlignment;
+  }
+  const int log2 = 6 + (size_class - 1) / 4;
+  const size_t step = size_t(1) << (log2 - 2);
+  return (5 + (size_class - 1) % 4) * step;
+}
+
+struct Counters {
+  Counters()
+      : enabled(true), bytes_live(0), peak_bytes_live(0), bytes_cached(0),
+        num_allocs(0), num_hits(0) {}
+  std::atomic<bool> enabled;
+  std::atomic<size_t> bytes_live;
+  std::atomic<size_t> peak_bytes_live;
+  std::atomic<size_t> bytes_cached;
+  std::atomic<size_t> num_allocs;
+  std::atomic<size_t> num_hits;
+};
+
+// Free blocks by size class.
+typedef std::vector<std::vector<void*> > FreeLists;
+
+struct SharedCache {
+  SharedCache() : bytes(0), limit(size_t(512) << 20) {}
+  std::mutex mutex;
+  FreeLists blocks;
+  size_t bytes;
+  size_t limit;
+};
+
+// Never destroyed, so that memory freed during static destruction still has
+// somewhere to go.
+Counters& counters() {
+  static Counters* counters = new Counters();
+  return *counters;
+}
+
+SharedCache& shared_cache() {
+  static SharedCache* cache = new SharedCache();
+  return *cache;
+}
+
+// Put a block in the shared cache, or free it when the cache is full.
+void ReleaseShared(void* ptr, int size_class, size_t class_bytes) {
+  SharedCache& cache = shared_cache();
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.bytes + class_bytes <= cache.limit) {
+      if (cache.blocks.size() <= size_class) {
+        cache.blocks.resize(size_class + 1);
+      }
+      cache.blocks[size_class].push_back(ptr);
+      cache.bytes += class_bytes;
+      return;
+    }
+  }
+  counters().bytes_cached -= class_bytes;
+  SystemFree(ptr);
+}
+
+void TrimShared() {
+  SharedCache& cache = shared_cache();
+  FreeLists blocks;
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    blocks.swap(cache.blocks);
+    counters().bytes_cached -= cache.bytes;
+    cache.bytes = 0;
+  }
+  for (int i = 0; i < blocks.size(); ++i) {
+    for (int j = 0; j < blocks[i].size(); ++j) {
+      SystemFree(blocks[i][j]);
+    }
+  }
+}
+
+class ThreadCache {
+ public:
+  ThreadCache() : bytes_(0) {}
+  // Blocks of a finished thread go to the shared cache.
+  ~ThreadCache() { Flush(); }
+
+  void* Take(int size_class, size_t class_bytes) {
+    if (size_class >= blocks_.size() || blocks_[size_class].empty()) {
+      return NULL;
+    }
+    void* ptr = blocks_[size_class].back();
+    blocks_[size_class].pop_back();
+    bytes_ -= class_bytes;
+    return ptr;
+  }
+  bool Put(void* ptr, int size_class, size_t class_bytes) {
+    if (bytes_ + class_bytes > kThreadCacheLimit) {
+      return false;
+    }
+    if (blocks_.size() <= size_class) {
+      blocks_.resize(size_class + 1);
+    }
+    blocks_[size_class].push_back(ptr);
+    bytes_ += class_bytes;
+    return true;
+  }
+  void Flush() {
+    for (int i = 0; i < blocks_.size(); ++i) {
+      for (int j = 0; j < blocks_[i].size(); ++j) {
+        ReleaseShared(blocks_[i][j], i, ClassBytes(i));
+      }
+    }
+    blocks_.clear();
+    bytes_ = 0;
+  }
+
+ private:
+  FreeLists blocks_;
+  size_t bytes_;
+};
+
+// The cache of the calling thread, or NULL once it has been destroyed at
+// thread exit. The flags are trivially destructible, so they stay readable
+// while other thread_local objects are being destroyed.
+thread_local ThreadCache* thread_cache_ptr = NULL;
+thread_local bool thread_cache_destroyed = false;
+
+struct ThreadCacheHolder {
+  ThreadCache cache;
+  ~ThreadCacheHolder() {
+    thread_cache_ptr = NULL;
+    thread_cache_destroyed = true;
+  }
+};
+
+ThreadCache* thread_cache() {
+  if (thread_cache_ptr == NULL && !thread_cache_destroyed) {
+    static thread_local ThreadCacheHolder holder;
+    thread_cache_ptr = &holder.cache;
+  }
+  return thread_cache_ptr;
+}
+
+}  // namespace
+
+void* HostAllocator::Allocate(size_t size) {
+  Counters& c = counters();
+  size_t class_bytes;
+  const int size_class = SizeClass(size, &class_bytes);
+  ++c.num_allocs;
+  const size_t live = (c.bytes_live += class_bytes);
+  size_t peak = c.peak_bytes_live;
+  while (live > peak &&
+         !c.peak_bytes_live.compare_exchange_weak(peak, live)) {
+  }
+  if (class_bytes > kMaxCachedBlock) {
+    return SystemAllocate(class_bytes);
+  }
+  void* ptr = NULL;
+  ThreadCache* cache = thread_cache();
+  if (cache != NULL) {
+    ptr = cache->Take(size_class, class_bytes);
+  }
+  if (ptr == NULL) {
+    SharedCache& shared = shared_cache();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    if (size_class < shared.blocks.size() &&
+        !shared.blocks[size_class].empty()) {
+      ptr = shared.blocks[size_class].back();
+      shared.blocks[size_class].pop_back();
+      shared.bytes -= class_bytes;
+    }
+  }
+  if (ptr == NULL) {
+    return SystemAllocate(class_bytes);
+  }
+  ++c.num_hits;
+  c.bytes_cached -= class_bytes;
+  return ptr;
+}
+
+void HostAllocator::Deallocate(void* ptr, size_t size) {
+  if (ptr == NULL) {
+    return;
+  }
+  Counters& c = counters();
+  size_t class_bytes;
+  const int size_class = SizeClass(size, &class_bytes);
+  c.bytes_live -= class_bytes;
+  if (class_bytes > kMaxCachedBlock) {
+    SystemFree(ptr);
+    return;
+  }
+  c.bytes_cached += class_bytes;
+  ThreadCache* cache = thread_cache();
+  if (cache != NULL && cache->Put(ptr, size_class, class_bytes)) {
+    return;
+  }
+  ReleaseShared(ptr, size_class, class_bytes);
+}
+
+bool HostAllocator::enabled() {
+  return counters().enabled;
+}
+
+void HostAllocator::set_enabled(bool enabled) {
+  counters().enabled = enabled;
+}
+
+void HostAllocator::set_cache_limit(size_t bytes) {
+  {
+    SharedCache& cache = shared_cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.limit = bytes;
+    if (cache.bytes <= cache.limit) {
+      return;
+    }
+  }
+  TrimShared();
+}
+
+void HostAllocator::Trim() {
+  ThreadCache* cache = thread_cache();
+  if (cache != NULL) {
+    cache->Flush();
+  }
+  TrimShared();
+}
+
+HostAllocator::Stats HostAllocator::stats() {
+  const Counters& c = counters();
+  Stats stats;
+  stats.bytes_live = c.bytes_live;
+  stats.peak_bytes_live = c.peak_bytes_live;
+  stats.bytes_cached = c.bytes_cached;
+  stats.num_allocs = c.num_allocs;
+  stats.num_hits = c.num_hits;
+  stats.hit_rate = stats.num_allocs > 0 ?
+      double(stats.num_hits) / stats.num_allocs : 0;
+  return stats;
+}
+
+void HostAllocator::ResetPeak() {
+  counters().peak_bytes_live = size_t(counters().bytes_live);
+}
+
+}  // namespace caffe
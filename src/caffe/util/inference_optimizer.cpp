@@ -0,0 +1,626 @@
+#include <cmath>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/inference_optimizer.hpp"
+
+namespace caffe {
+
+namespace {
+
+int BlobProtoCount(const BlobProto& blob) {
+  return blob.double_data_size() > 0 ? blob.double_data_size()
+                                     : blob.data_size();
+}
+
+double BlobProtoValue(const BlobProto& blob, const int i) {
+  return blob.double_data_size() > 0 ? blob.double_data(i) : blob.data(i);
+}
+
+void SetBlobProtoValue(const int i, const double value, BlobProto* blob) {
+  if (blob->double_data_size() > 0) {
+    blob->set_double_data(i, value);
+  } else {
+    blob->set_data(i, static_cast<float>(value));
+  }
+}
+
+bool HasPhaseRules(const LayerParameter& layer) {
+  return layer.include_size() > 0 || layer.exclude_size() > 0;
+}
+
+// Whether layer is a Convolution, ConvolutionDepthwise or InnerProduct layer
+// with trained weights whose channel axis is 1.
+bool IsFoldableProducer(const LayerParameter& layer) {
+  if (layer.bottom_size() != 1 || layer.top_size() != 1 ||
+      layer.blobs_size() == 0) {
+    return false;
+  }
+  if (layer.type() == "Convolution" ||
+      layer.type() == "ConvolutionDepthwise") {
+    const ConvolutionParameter& conv_param = layer.convolution_param();
+    return conv_param.axis() == 1 &&
+        layer.blobs_size() == (conv_param.bias_term() ? 2 : 1);
+  }
+  if (layer.type() == "InnerProduct") {
+    const InnerProductParameter& ip_param = layer.inner_product_param();
+    return ip_param.axis() == 1 &&
+        layer.blobs_size() == (ip_param.bias_term() ? 2 : 1);
+  }
+  return false;
+}
+
+// Fill scale and shift with the per-channel affine map y = scale * x + shift
+// computed by a BatchNorm (with global statistics), Scale or Bias layer, or
+// return false if layer is not such a map over `channels` channels.
+bool GetChannelAffine(const LayerParameter& layer, const int channels,
+    vector<double>* scale, vector<double>* shift) {
+  if (layer.bottom_size() != 1 || layer.top_size() != 1 ||
+      HasPhaseRules(layer)) {
+    return false;
+  }
+  scale->assign(channels, 1.);
+  shift->assign(channels, 0.);
+  if (layer.type() == "BatchNorm") {
+    const BatchNormParameter& bn_param = layer.batch_norm_param();
+    if ((bn_param.has_use_global_stats() && !bn_param.use_global_stats()) ||
+        layer.blobs_size() != 3 ||
+        BlobProtoCount(layer.blobs(0)) != channels ||
+        BlobProtoCount(layer.blobs(1)) != channels ||
+        BlobProtoCount(layer.blobs(2)) != 1) {
+      return false;
+    }
+    // The stored statistics are sums scaled by the moving average factor.
+    const double factor = BlobProtoValue(layer.blobs(2), 0);
+    const double inv_factor = factor == 0 ? 0 : 1. / factor;
+    for (int c = 0; c < channels; ++c) {
+      const double mean = BlobProtoValue(layer.blobs(0), c) * inv_factor;
+      const double variance = BlobProtoValue(layer.blobs(1), c) * inv_factor;
+      (*scale)[c] = 1. / std::sqrt(variance + bn_param.eps());
+      (*shift)[c] = -mean * (*scale)[c];
+    }
+    return true;
+  }
+  if (layer.type() == "Scale") {
+    const ScaleParameter& scale_param = layer.scale_param();
+    if (scale_param.axis() != 1 || scale_param.num_axes() != 1 ||
+        layer.blobs_size() != (scale_param.bias_term() ? 2 : 1)) {
+      return false;
+    }
+    for (int i = 0; i < layer.blobs_size(); ++i) {
+      if (BlobProtoCount(layer.blobs(i)) != channels) { return false; }
+    }
+    for (int c = 0; c < channels; ++c) {
+      (*scale)[c] = BlobProtoValue(layer.blobs(0), c);
+      if (scale_param.bias_term()) {
+        (*shift)[c] = BlobProtoValue(layer.blobs(1), c);
+      }
+    }
+    return true;
+  }
+  if (layer.type() == "Bias") {
+    const BiasParameter& bias_param = layer.bias_param();
+    if (bias_param.axis() != 1 || bias_param.num_axes() != 1 ||
+        layer.blobs_size() != 1 ||
+        BlobProtoCount(layer.blobs(0)) != channels) {
+      return false;
+    }
+    for (int c = 0; c < channels; ++c) {
+      (*shift)[c] = BlobProtoValue(layer.blobs(0), c);
+    }
+    return true;
+  }
+  return false;
+}
+
+// Whether the value of blob_name written by layer producer_id is read by no
+// layer other than consumer_id before it is overwritten.
+bool IsOnlyConsumer(const NetParameter& param, const int producer_id,
+    const int consumer_id, const string& blob_name) {
+  for (int i = producer_id + 1; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    bool reads = false, writes = false;
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      reads |= layer.bottom(j) == blob_name;
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      writes |= layer.top(j) == blob_name;
+    }
+    if (reads && i != consumer_id) { return false; }
+    if (writes) { return true; }
+  }
+  return true;
+}
+
+// Apply y = scale * x + shift to the outputs of a Convolution,
+// ConvolutionDepthwise or InnerProduct layer by rescaling its weights and
+// bias, adding a bias blob if the layer has none.  Returns false and leaves
+// the layer untouched if the weights do not have `channels` outputs.
+bool ApplyChannelAffine(const vector<double>& scale,
+    const vector<double>& shift, LayerParameter* layer) {
+  const int channels = scale.size();
+  BlobProto* weights = layer->mutable_blobs(0);
+  const int count = BlobProtoCount(*weights);
+  if (count == 0 || count % channels != 0) { return false; }
+  const bool has_bias = layer->blobs_size() > 1;
+  if (has_bias && BlobProtoCount(layer->blobs(1)) != channels) {
+    return false;
+  }
+  const bool transpose = layer->type() == "InnerProduct" &&
+      layer->inner_product_param().transpose();
+  // Weights are [channels, ...] except for transposed InnerProduct, whose
+  // weights are [K, channels].
+  const int dim = count / channels;
+  for (int i = 0; i < count; ++i) {
+    const int c = transpose ? i % channels : i / dim;
+    SetBlobProtoValue(i, BlobProtoValue(*weights, i) * scale[c], weights);
+  }
+  if (!has_bias) {
+    BlobProto* bias = layer->add_blobs();
+    bias->mutable_shape()->add_dim(channels);
+    const bool use_double = layer->blobs(0).double_data_size() > 0;
+    for (int c = 0; c < channels; ++c) {
+      if (use_double) {
+        bias->add_double_data(0);
+      } else {
+        bias->add_data(0);
+      }
+    }
+    if (layer->type() == "InnerProduct") {
+      layer->mutable_inner_product_param()->set_bias_term(true);
+    } else {
+      layer->mutable_convolution_param()->set_bias_term(true);
+    }
+  }
+  BlobProto* bias = layer->mutable_blobs(1);
+  for (int c = 0; c < channels; ++c) {
+    SetBlobProtoValue(c, BlobProtoValue(*bias, c) * scale[c] + shift[c], bias);
+  }
+  return true;
+}
+
+// Map the type of a pointwise activation layer to the equivalent fused
+// activation, or return false if it has none.
+bool GetFusedActivationType(const LayerParameter& layer,
+    FusedActivationParameter_Type* type) {
+  if (layer.type() == "ReLU") {
+    *type = FusedActivationParameter_Type_RELU;
+  } else if (layer.type() == "ReLUX") {
+    *type = FusedActivationParameter_Type_RELUX;
+  } else if (layer.type() == "PReLU") {
+    *type = FusedActivationParameter_Type_PRELU;
+  } else if (layer.type() == "ELU") {
+    *type = FusedActivationParameter_Type_ELU;
+  } else if (layer.type() == "SeLu") {
+    *type = FusedActivationParameter_Type_SELU;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Whether layer can take over a following activation layer.
+bool CanFuseActivation(const LayerParameter& layer) {
+  if (layer.bottom_size() != 1 || layer.top_size() != 1 ||
+      layer.fused_activation_param().type() !=
+      FusedActivationParameter_Type_NONE) {
+    return false;
+  }
+  if (layer.type() == "Convolution" || layer.type() == "Deconvolution") {
+    return layer.convolution_param().axis() == 1;
+  }
+  if (layer.type() == "InnerProduct") {
+    return layer.inner_product_param().axis() == 1;
+  }
+  return false;
+}
+
+// Whether layer has a channels-last implementation worth converting its
+// NCHW inputs for.
+bool StartsChannelsLast(const LayerParameter& layer) {
+  if (layer.bottom_size() != 1 || layer.top_size() != 1) {
+    return false;
+  }
+  if (layer.type() == "Convolution") {
+    const ConvolutionParameter& conv_param = layer.convolution_param();
+    return (conv_param.engine() == ConvolutionParameter_Engine_DEFAULT ||
+            conv_param.engine() == ConvolutionParameter_Engine_CAFFE) &&
+        layer.quantization_param().precision() ==
+        QuantizationParameter_Precision_FLOAT &&
+        conv_param.axis() == 1 && !conv_param.force_nd_im2col() &&
+        conv_param.kernel_size_size() <= 2 && conv_param.stride_size() <= 2 &&
+        conv_param.pad_size() <= 2 && conv_param.dilation_size() <= 2;
+  }
+  if (layer.type() == "ConvolutionDepthwise") {
+    return true;
+  }
+  if (layer.type() == "Pooling") {
+    const PoolingParameter& pool_param = layer.pooling_param();
+    return (pool_param.engine() == PoolingParameter_Engine_DEFAULT ||
+            pool_param.engine() == PoolingParameter_Engine_CAFFE) &&
+        (pool_param.pool() == PoolingParameter_PoolMethod_MAX ||
+         pool_param.pool() == PoolingParameter_PoolMethod_AVE);
+  }
+  return false;
+}
+
+// Whether layer can run on NHWC inputs.
+bool SupportsChannelsLast(const LayerParameter& layer, const Phase phase) {
+  if (layer.bottom_size() == 0 || HasPhaseRules(layer)) {
+    return false;
+  }
+  if (StartsChannelsLast(layer)) {
+    return true;
+  }
+  const string& type = layer.type();
+  if (type == "BatchNorm") {
+    const BatchNormParameter& bn_param = layer.batch_norm_param();
+    return bn_param.has_use_global_stats() ? bn_param.use_global_stats() :
+                                             phase == TEST;
+  }
+  if (type == "Scale") {
+    return layer.bottom_size() == 1 && layer.scale_param().axis() == 1 &&
+           layer.scale_param().num_axes() == 1;
+  }
+  if (type == "Bias") {
+    return layer.bottom_size() == 1 && layer.bias_param().axis() == 1 &&
+           layer.bias_param().num_axes() == 1;
+  }
+  if (type == "Concat") {
+    const ConcatParameter& concat_param = layer.concat_param();
+    return concat_param.has_concat_dim() ? concat_param.concat_dim() == 1 :
+                                           concat_param.axis() == 1;
+  }
+  // Layers that do not care about the order of the values.
+  return type == "ShuffleChannel" || type == "Eltwise" || type == "Split" ||
+         type == "ReLU" || type == "ReLUX" || type == "ELU" ||
+         type == "SeLu" || type == "Sigmoid" || type == "TanH" ||
+         type == "AbsVal" || type == "Power" || type == "BNLL" ||
+         type == "Dropout";
+}
+
+// Switch a layer accepted by SupportsChannelsLast to NHWC blobs.
+void SetChannelsLast(LayerParameter* layer) {
+  const string& type = layer->type();
+  if (type == "Scale") {
+    layer->mutable_scale_param()->set_axis(3);
+  } else if (type == "Bias") {
+    layer->mutable_bias_param()->set_axis(3);
+  } else if (type == "Concat") {
+    layer->mutable_concat_param()->clear_concat_dim();
+    layer->mutable_concat_param()->set_axis(3);
+  } else if (type == "Convolution" || type == "ConvolutionDepthwise" ||
+             type == "Pooling" || type == "BatchNorm" ||
+             type == "ShuffleChannel") {
+    layer->set_layout(NHWC);
+  }
+}
+
+// base, or base with a numeric suffix if names has it; adds it to names.
+string UniqueName(const string& base, set<string>* names) {
+  string name = base;
+  for (int i = 1; names->count(name); ++i) {
+    name = base + "_" + format_int(i);
+  }
+  names->insert(name);
+  return name;
+}
+
+// Append a Transpose layer converting blob from to blob to, from NCHW to
+// NHWC if to_nhwc, else back.
+void AddLayoutTranspose(const string& name, const string& from,
+    const string& to, const bool to_nhwc, NetParameter* param) {
+  LayerParameter* transpose = param->add_layer();
+  transpose->set_name(name);
+  transpose->set_type("Transpose");
+  transpose->add_bottom(from);
+  transpose->add_top(to);
+  const int dims[2][4] = { { 0, 3, 1, 2 }, { 0, 2, 3, 1 } };
+  for (int i = 0; i < 4; ++i) {
+    transpose->mutable_transpose_param()->add_dim(dims[to_nhwc][i]);
+  }
+}
+
+}  // namespace
+
+void CopyTrainedLayerBlobs(const NetParameter& trained_param,
+    NetParameter* param) {
+  map<string, int> trained_layer_ids;
+  for (int i = 0; i < trained_param.layer_size(); ++i) {
+    trained_layer_ids[trained_param.layer(i).name()] = i;
+  }
+  for (int i = 0; i < param->layer_size(); ++i) {
+    LayerParameter* layer = param->mutable_layer(i);
+    map<string, int>::const_iterator it = trained_layer_ids.find(layer->name());
+    if (it == trained_layer_ids.end()) { continue; }
+    const LayerParameter& trained_layer = trained_param.layer(it->second);
+    if (trained_layer.blobs_size() == 0) { continue; }
+    layer->mutable_blobs()->CopyFrom(trained_layer.blobs());
+  }
+}
+
+int FoldBatchNormLayers(const NetParameter& param,
+    NetParameter* param_folded) {
+  param_folded->CopyFrom(param);
+  param_folded->clear_layer();
+  int num_removed = 0;
+  for (int i = 0; i < param.layer_size(); ) {
+    const LayerParameter& layer = param.layer(i);
+    if (!IsFoldableProducer(layer)) {
+      param_folded->add_layer()->CopyFrom(layer);
+      ++i;
+      continue;
+    }
+    // Collect the chain of per-channel affine layers following layer and
+    // compose them into a single map.
+    int channels = 0;
+    vector<double> scale, shift, layer_scale, layer_shift;
+    string top_name = layer.top(0);
+    int end = i + 1;
+    for (; end < param.layer_size(); ++end) {
+      const LayerParameter& next = param.layer(end);
+      if (next.bottom_size() != 1 || next.bottom(0) != top_name ||
+          next.blobs_size() == 0 ||
+          !IsOnlyConsumer(param, end - 1, end, top_name)) {
+        break;
+      }
+      if (channels == 0) {
+        channels = BlobProtoCount(next.blobs(0));
+        if (channels == 0) { break; }
+        scale.assign(channels, 1.);
+        shift.assign(channels, 0.);
+      }
+      if (!GetChannelAffine(next, channels, &layer_scale, &layer_shift)) {
+        break;
+      }
+      for (int c = 0; c < channels; ++c) {
+        scale[c] *= layer_scale[c];
+        shift[c] = shift[c] * layer_scale[c] + layer_shift[c];
+      }
+      top_name = next.top(0);
+    }
+    LayerParameter* folded = param_folded->add_layer();
+    folded->CopyFrom(layer);
+    if (end == i + 1 || !ApplyChannelAffine(scale, shift, folded)) {
+      ++i;
+      continue;
+    }
+    folded->set_top(0, top_name);
+    LOG(INFO) << "Folded " << end - i - 1 << " layer(s) following "
+              << layer.name() << " into its weights";
+    num_removed += end - i - 1;
+    i = end;
+  }
+  return num_removed;
+}
+
+int FuseActivationLayers(const NetParameter& param,
+    NetParameter* param_fused) {
+  param_fused->CopyFrom(param);
+  param_fused->clear_layer();
+  int num_removed = 0;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    LayerParameter* fused = param_fused->add_layer();
+    fused->CopyFrom(layer);
+    if (i + 1 == param.layer_size() || !CanFuseActivation(layer)) {
+      continue;
+    }
+    const LayerParameter& activation = param.layer(i + 1);
+    FusedActivationParameter_Type type;
+    if (!GetFusedActivationType(activation, &type) ||
+        activation.bottom_size() != 1 || activation.top_size() != 1 ||
+        activation.bottom(0) != layer.top(0) || HasPhaseRules(activation) ||
+        !IsOnlyConsumer(param, i, i + 1, layer.top(0))) {
+      continue;
+    }
+    if (type == FusedActivationParameter_Type_PRELU) {
+      if (layer.blobs_size() == 0 || activation.blobs_size() != 1) {
+        continue;
+      }
+      fused->add_blobs()->CopyFrom(activation.blobs(0));
+    }
+    fused->mutable_fused_activation_param()->set_type(type);
+    // The activation's settings live in the same fields of the producer.
+    if (activation.has_relu_param()) {
+      fused->mutable_relu_param()->CopyFrom(activation.relu_param());
+    }
+    if (activation.has_relux_param()) {
+      fused->mutable_relux_param()->CopyFrom(activation.relux_param());
+    }
+    if (activation.has_prelu_param()) {
+      fused->mutable_prelu_param()->CopyFrom(activation.prelu_param());
+    }
+    if (activation.has_elu_param()) {
+      fused->mutable_elu_param()->CopyFrom(activation.elu_param());
+    }
+    if (activation.has_selu_param()) {
+      fused->mutable_selu_param()->CopyFrom(activation.selu_param());
+    }
+    fused->set_top(0, activation.top(0));
+    LOG(INFO) << "Fused " << activation.name() << " into " << layer.name();
+    ++num_removed;
+    ++i;
+  }
+  return num_removed;
+}
+
+int QuantizeLayers(const NetParameter& param, const BlobRanges& ranges,
+    NetParameter* param_quantized) {
+  param_quantized->CopyFrom(param);
+  int num_quantized = 0;
+  for (int i = 0; i < param_quantized->layer_size(); ++i) {
+    LayerParameter* layer = param_quantized->mutable_layer(i);
+    const bool convolution = layer->type() == "Convolution";
+    if (convolution) {
+      const ConvolutionParameter_Engine engine =
+          layer->convolution_param().engine();
+      if (engine != ConvolutionParameter_Engine_DEFAULT &&
+          engine != ConvolutionParameter_Engine_CAFFE) {
+        continue;
+      }
+    } else if (layer->type() != "InnerProduct" ||
+               layer->inner_product_param().transpose()) {
+      continue;
+    }
+    if (layer->bottom_size() != 1) {
+      continue;
+    }
+    BlobRanges::const_iterator range = ranges.find(layer->bottom(0));
+    if (range == ranges.end()) {
+      continue;
+    }
+    if (convolution) {
+      // The INT8 engine is part of Caffe's own convolution.
+      layer->mutable_convolution_param()->set_engine(
+          ConvolutionParameter_Engine_CAFFE);
+    }
+    QuantizationParameter* quantization_param =
+        layer->mutable_quantization_param();
+    quantization_param->set_precision(QuantizationParameter_Precision_INT8);
+    quantization_param->set_input_min(range->second.first);
+    quantization_param->set_input_max(range->second.second);
+    ++num_quantized;
+  }
+  return num_quantized;
+}
+
+int StoreWeightsAsHalf(const NetParameter& param, const HalfFormat format,
+    NetParameter* param_half) {
+  param_half->CopyFrom(param);
+  int num_stored = 0;
+  for (int i = 0; i < param_half->layer_size(); ++i) {
+    LayerParameter* layer = param_half->mutable_layer(i);
+    if (layer->type() == "Convolution") {
+      const ConvolutionParameter_Engine engine =
+          layer->convolution_param().engine();
+      if (engine != ConvolutionParameter_Engine_DEFAULT &&
+          engine != ConvolutionParameter_Engine_CAFFE) {
+        continue;
+      }
+    } else if (layer->type() != "InnerProduct") {
+      continue;
+    }
+    if (layer->blobs_size() == 0 || !layer->blobs(0).half_data().empty() ||
+        layer->quantization_param().precision() !=
+        QuantizationParameter_Precision_FLOAT) {
+      continue;
+    }
+    BlobProto* weights = layer->mutable_blobs(0);
+    const int count = BlobProtoCount(*weights);
+    string half_data(count * sizeof(uint16_t), 0);
+    uint16_t* half = reinterpret_cast<uint16_t*>(&half_data[0]);
+    bool in_range = true;
+    for (int j = 0; j < count; ++j) {
+      const float value = BlobProtoValue(*weights, j);
+      half[j] = float_to_half(value, format);
+      in_range &= std::isinf(half_to_float(half[j], format)) ==
+          std::isinf(value);
+    }
+    if (!in_range) {
+      LOG(WARNING) << "Keeping the float weights of layer " << layer->name()
+                   << ", which exceed the 16-bit range.";
+      continue;
+    }
+    weights->clear_data();
+    weights->clear_double_data();
+    weights->set_half_data(half_data);
+    weights->set_half_format(static_cast<BlobProto_HalfFormat>(format));
+    ++num_stored;
+  }
+  return num_stored;
+}
+
+int ConvertToChannelsLast(const NetParameter& param,
+    NetParameter* param_nhwc) {
+  param_nhwc->CopyFrom(param);
+  param_nhwc->clear_layer();
+  set<string> names;
+  vector<string> outputs;
+  set<string> unread;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    names.insert(layer.name());
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      names.insert(layer.bottom(j));
+      unread.erase(layer.bottom(j));
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      names.insert(layer.top(j));
+      unread.insert(layer.top(j));
+      outputs.push_back(layer.top(j));
+    }
+  }
+  // The NHWC version of every blob that has an up-to-date one, and the blobs
+  // whose NCHW version is out of date.
+  map<string, string> nhwc;
+  set<string> stale;
+  int num_converted = 0;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    bool convert = SupportsChannelsLast(layer, param.state().phase());
+    for (int j = 0; j < layer.bottom_size() && convert; ++j) {
+      convert = StartsChannelsLast(layer) || nhwc.count(layer.bottom(j));
+    }
+    if (!convert) {
+      for (int j = 0; j < layer.bottom_size(); ++j) {
+        const string& bottom = layer.bottom(j);
+        if (stale.count(bottom)) {
+          AddLayoutTranspose(UniqueName(bottom + "_nchw", &names),
+                             nhwc[bottom], bottom, false, param_nhwc);
+          stale.erase(bottom);
+        }
+      }
+      param_nhwc->add_layer()->CopyFrom(layer);
+      for (int j = 0; j < layer.top_size(); ++j) {
+        nhwc.erase(layer.top(j));
+        stale.erase(layer.top(j));
+      }
+      continue;
+    }
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      const string& bottom = layer.bottom(j);
+      if (!nhwc.count(bottom)) {
+        const string name = UniqueName(bottom + "_nhwc", &names);
+        AddLayoutTranspose(name, bottom, name, true, param_nhwc);
+        nhwc[bottom] = name;
+      }
+    }
+    LayerParameter* converted = param_nhwc->add_layer();
+    converted->CopyFrom(layer);
+    SetChannelsLast(converted);
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      converted->set_bottom(j, nhwc[layer.bottom(j)]);
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      const string& top = layer.top(j);
+      // In-place layers keep writing to the blob they read.
+      bool in_place = false;
+      for (int k = 0; k < layer.bottom_size(); ++k) {
+        in_place |= layer.bottom(k) == top;
+      }
+      if (!in_place) {
+        nhwc[top] = UniqueName(top + "_nhwc", &names);
+      }
+      converted->set_top(j, nhwc[top]);
+      stale.insert(top);
+    }
+    ++num_converted;
+  }
+  // Hand the net outputs over in NCHW under their own names.
+  for (int i = 0; i < outputs.size(); ++i) {
+    const string& output = outputs[i];
+    if (unread.count(output) && stale.count(output)) {
+      AddLayoutTranspose(UniqueName(output + "_nchw", &names), nhwc[output],
+                         output, false, param_nhwc);
+      stale.erase(output);
+    }
+  }
+  return num_converted;
+}
+
+}  // namespace caffe
@@ -2,6 +2,7 @@
 
 #include "caffe/common.hpp"
 #include "caffe/util/interp.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include <algorithm>
 #include <cmath>
 
@@ -16,9 +17,12 @@ void caffe_cpu_interp2(const int channels,
     Dtype *data2, const int x2, const int y2, const int height2, const int width2, const int Height2, const int Width2) {
   CHECK(x1 >= 0 && y1 >= 0 && height1 > 0 && width1 > 0 && x2 >= 0 && y2 >= 0 && height2 > 0 && width2 > 0);
   CHECK(Width1 >= width1 + x1 && Height1 >= height1 + y1 && Width2 >= width2 + x2 && Height2 >= height2 + y2);
+  // Output rows are computed in parallel.
+  const int grain = std::max(1, kMinParallelWork / (width2 * channels));
   // special case: just copy
   if (height1 == height2 && width1 == width2) {
-    for (int h2 = 0; h2 < height2; ++h2) {
+    parallel_for(height2, grain, [&](int h2_begin, int h2_end) {
+    for (int h2 = h2_begin; h2 < h2_end; ++h2) {
       const int h1 = h2;
       for (int w2 = 0; w2 < width2; ++w2) {
 	const int w1 = w2;
@@ -42,11 +46,13 @@ void caffe_cpu_interp2(const int channels,
 	}
       }
     }
+    });
     return;
   }
   const float rheight = (height2 > 1) ? static_cast<float>(height1 - 1) / (height2 - 1) : 0.f;
   const float rwidth = (width2 > 1) ? static_cast<float>(width1 - 1) / (width2 - 1) : 0.f;
-  for (int h2 = 0; h2 < height2; ++h2) {
+  parallel_for(height2, grain, [&](int h2_begin, int h2_end) {
+  for (int h2 = h2_begin; h2 < h2_end; ++h2) {
     const float h1r = rheight * h2;
     const int h1 = h1r;
     const int h1p = (h1 < height1 - 1) ? 1 : 0;
@@ -82,6 +88,7 @@ void caffe_cpu_interp2(const int channels,
       }
     }
   }
+  });
 }
 
 
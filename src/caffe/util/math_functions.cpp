@@ -1,17 +1,29 @@
+#include <cmath>
 #include <random>
 #include <limits>
 #include "caffe/common.hpp"
+#include "caffe/util/blocked_gemm.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/simd_math.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// The elementwise functions below split arrays longer than this over the
+// intra-op threads.
+const int kElementwiseGrain = kMinParallelWork;
+
 template <>
 void caffe_cpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
                            const CBLAS_TRANSPOSE TransB, const int M,
                            const int N, const int K, const float alpha,
                            const float* A, const float* B, const float beta,
                            float* C) {
+  if (FLAGS_blocked_gemm) {
+    caffe_cpu_blocked_gemm(TransA, TransB, M, N, K, alpha, A, B, beta, C);
+    return;
+  }
   int lda = (TransA == CblasNoTrans) ? K : M;
   int ldb = (TransB == CblasNoTrans) ? N : K;
   cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B, ldb,
@@ -147,107 +159,179 @@ void caffe_cpu_axpby<double>(const int N, const double alpha, const double* X,
 
 template <>
 void caffe_add<float>(const int n, const float* a, const float* b, float* y) {
-  vsAdd(n, a, b, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vsAdd(end - begin, a + begin, b + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_add<double>(const int n, const double* a, const double* b,
                        double* y) {
-  vdAdd(n, a, b, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vdAdd(end - begin, a + begin, b + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_sub<float>(const int n, const float* a, const float* b, float* y) {
-  vsSub(n, a, b, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vsSub(end - begin, a + begin, b + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_sub<double>(const int n, const double* a, const double* b,
                        double* y) {
-  vdSub(n, a, b, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vdSub(end - begin, a + begin, b + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_mul<float>(const int n, const float* a, const float* b, float* y) {
-  vsMul(n, a, b, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vsMul(end - begin, a + begin, b + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_mul<double>(const int n, const double* a, const double* b,
                        double* y) {
-  vdMul(n, a, b, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vdMul(end - begin, a + begin, b + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_div<float>(const int n, const float* a, const float* b, float* y) {
-  vsDiv(n, a, b, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vsDiv(end - begin, a + begin, b + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_div<double>(const int n, const double* a, const double* b,
                        double* y) {
-  vdDiv(n, a, b, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vdDiv(end - begin, a + begin, b + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_powx<float>(const int n, const float* a, const float b, float* y) {
-  vsPowx(n, a, b, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vsPowx(end - begin, a + begin, b, y + begin);
+  });
 }
 
 template <>
 void caffe_powx<double>(const int n, const double* a, const double b,
                         double* y) {
-  vdPowx(n, a, b, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vdPowx(end - begin, a + begin, b, y + begin);
+  });
 }
 
 template <>
 void caffe_sqr<float>(const int n, const float* a, float* y) {
-  vsSqr(n, a, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vsSqr(end - begin, a + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_sqr<double>(const int n, const double* a, double* y) {
-  vdSqr(n, a, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vdSqr(end - begin, a + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_sqrt<float>(const int n, const float* a, float* y) {
-  vsSqrt(n, a, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vsSqrt(end - begin, a + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_sqrt<double>(const int n, const double* a, double* y) {
-  vdSqrt(n, a, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vdSqrt(end - begin, a + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_exp<float>(const int n, const float* a, float* y) {
-  vsExp(n, a, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vsExp(end - begin, a + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_exp<double>(const int n, const double* a, double* y) {
-  vdExp(n, a, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vdExp(end - begin, a + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_log<float>(const int n, const float* a, float* y) {
-  vsLn(n, a, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vsLn(end - begin, a + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_log<double>(const int n, const double* a, double* y) {
-  vdLn(n, a, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vdLn(end - begin, a + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_abs<float>(const int n, const float* a, float* y) {
-  vsAbs(n, a, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vsAbs(end - begin, a + begin, y + begin);
+  });
 }
 
 template <>
 void caffe_abs<double>(const int n, const double* a, double* y) {
-  vdAbs(n, a, y);
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    vdAbs(end - begin, a + begin, y + begin);
+  });
+}
+
+template <>
+void caffe_sigmoid<float>(const int n, const float* a, float* y) {
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    simd_sigmoid(end - begin, a + begin, y + begin);
+  });
+}
+
+template <>
+void caffe_sigmoid<double>(const int n, const double* a, double* y) {
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      y[i] = 1. / (1. + std::exp(-a[i]));
+    }
+  });
+}
+
+template <>
+void caffe_tanh<float>(const int n, const float* a, float* y) {
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    simd_tanh(end - begin, a + begin, y + begin);
+  });
+}
+
+template <>
+void caffe_tanh<double>(const int n, const double* a, double* y) {
+  parallel_for(n, kElementwiseGrain, [=](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      y[i] = std::tanh(a[i]);
+    }
+  });
 }
 
 unsigned int caffe_rng_rand() { return (*caffe_rng())(); }
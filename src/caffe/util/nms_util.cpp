@@ -1,6 +1,16 @@
 #include "caffe/util/nms_util.hpp"
+#include <stdint.h>
 #include <algorithm>
+#include <limits>
 #include <vector>
+
+#include "caffe/util/cpu_info.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#ifdef CAFFE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 namespace caffe {
 
 template <typename Dtype>
@@ -31,33 +41,262 @@ template float IoU<float>(const float* A, const float* B);
 template double IoU<double>(const double* A, const double* B);
 
 template <typename Dtype>
-void NMS(const Dtype* boxes, const int num_boxes, int* index_out, int* num_out,
-         const int base_index, const Dtype nms_thresh, const int max_num_out) {
-  int count = 0;
-  std::vector<char> is_dead(num_boxes);
-  for (int i = 0; i < num_boxes; ++i) {
-    is_dead[i] = 0;
+Dtype IoM(const Dtype* A, const Dtype* B) {
+  if (A[0] > B[2] || A[1] > B[3] || A[2] < B[0] || A[3] < B[1]) {
+    return 0;
   }
+  const Dtype width =
+      std::max((Dtype)0, std::min(A[2], B[2]) - std::max(A[0], B[0]) + 1);
+  const Dtype height =
+      std::max((Dtype)0, std::min(A[3], B[3]) - std::max(A[1], B[1]) + 1);
+  const Dtype area = width * height;
+  const Dtype A_area = (A[2] - A[0] + (Dtype)1) * (A[3] - A[1] + (Dtype)1);
+  const Dtype B_area = (B[2] - B[0] + (Dtype)1) * (B[3] - B[1] + (Dtype)1);
+  return area / std::max(A_area, B_area);
+}
 
-  for (int i = 0; i < num_boxes; ++i) {
-    if (is_dead[i]) {
-      continue;
+template float IoM<float>(const float* A, const float* B);
+template double IoM<double>(const double* A, const double* B);
+
+namespace {
+
+// Boxes take a bit each in the suppression masks.
+const int kMaskBits = 64;
+// The rows whose masks are computed before they are resolved.
+const int kBlockRows = 128;
+
+// The boxes as one array per coordinate, with their areas, padded to whole
+// mask words with boxes that overlap nothing.
+template <typename Dtype>
+struct NMSBoxes {
+  NMSBoxes(const Dtype* boxes, const int num_boxes, const int box_step,
+           const int padded) {
+    const Dtype kFar = std::numeric_limits<Dtype>::max();
+    x1.assign(padded, kFar);
+    y1.assign(padded, kFar);
+    x2.assign(padded, -kFar);
+    y2.assign(padded, -kFar);
+    area.assign(padded, Dtype(0));
+    for (int i = 0; i < num_boxes; ++i) {
+      const Dtype* box = boxes + i * box_step;
+      x1[i] = box[0];
+      y1[i] = box[1];
+      x2[i] = box[2];
+      y2[i] = box[3];
+      area[i] = (box[2] - box[0] + (Dtype)1) * (box[3] - box[1] + (Dtype)1);
     }
+  }
 
-    index_out[count++] = base_index + i;
-    if (count == max_num_out) {
-      break;
+  std::vector<Dtype> x1, y1, x2, y2, area;
+};
+
+// The bits of the boxes [j0, j0 + 64) that box i overlaps by more than
+// thresh. Each overlap is computed as IoU() or IoM() compute it, so that
+// all the kernels agree.
+template <typename Dtype>
+uint64_t OverlapWord(const NMSBoxes<Dtype>& b, const int i, const int j0,
+                     const Dtype thresh, const NMSOverlap overlap) {
+  uint64_t word = 0;
+  for (int k = 0; k < kMaskBits; ++k) {
+    const int j = j0 + k;
+    if (b.x1[i] > b.x2[j] || b.y1[i] > b.y2[j] || b.x2[i] < b.x1[j] ||
+        b.y2[i] < b.y1[j]) {
+      continue;
     }
+    const Dtype width = std::max((Dtype)0,
+        std::min(b.x2[i], b.x2[j]) - std::max(b.x1[i], b.x1[j]) + (Dtype)1);
+    const Dtype height = std::max((Dtype)0,
+        std::min(b.y2[i], b.y2[j]) - std::max(b.y1[i], b.y1[j]) + (Dtype)1);
+    const Dtype area = width * height;
+    const Dtype ratio = overlap == NMS_IOU ?
+        area / (b.area[i] + b.area[j] - area) :
+        area / std::max(b.area[i], b.area[j]);
+    if (ratio > thresh) {
+      word |= uint64_t(1) << k;
+    }
+  }
+  return word;
+}
+
+#ifdef CAFFE_X86_DISPATCH
+
+CAFFE_TARGET_SSE2 uint64_t OverlapWordSse2(const NMSBoxes<float>& b,
+    const int i, const int j0, const float thresh, const NMSOverlap overlap) {
+  const __m128 ax1 = _mm_set1_ps(b.x1[i]);
+  const __m128 ay1 = _mm_set1_ps(b.y1[i]);
+  const __m128 ax2 = _mm_set1_ps(b.x2[i]);
+  const __m128 ay2 = _mm_set1_ps(b.y2[i]);
+  const __m128 aarea = _mm_set1_ps(b.area[i]);
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 t = _mm_set1_ps(thresh);
+  uint64_t word = 0;
+  for (int k = 0; k < kMaskBits; k += 4) {
+    const __m128 bx1 = _mm_loadu_ps(&b.x1[j0 + k]);
+    const __m128 by1 = _mm_loadu_ps(&b.y1[j0 + k]);
+    const __m128 bx2 = _mm_loadu_ps(&b.x2[j0 + k]);
+    const __m128 by2 = _mm_loadu_ps(&b.y2[j0 + k]);
+    const __m128 barea = _mm_loadu_ps(&b.area[j0 + k]);
+    const __m128 apart = _mm_or_ps(
+        _mm_or_ps(_mm_cmpgt_ps(ax1, bx2), _mm_cmpgt_ps(ay1, by2)),
+        _mm_or_ps(_mm_cmplt_ps(ax2, bx1), _mm_cmplt_ps(ay2, by1)));
+    const __m128 width = _mm_max_ps(zero, _mm_add_ps(
+        _mm_sub_ps(_mm_min_ps(ax2, bx2), _mm_max_ps(ax1, bx1)), one));
+    const __m128 height = _mm_max_ps(zero, _mm_add_ps(
+        _mm_sub_ps(_mm_min_ps(ay2, by2), _mm_max_ps(ay1, by1)), one));
+    const __m128 area = _mm_mul_ps(width, height);
+    const __m128 ratio = _mm_div_ps(area, overlap == NMS_IOU ?
+        _mm_sub_ps(_mm_add_ps(aarea, barea), area) :
+        _mm_max_ps(aarea, barea));
+    const __m128 over = _mm_andnot_ps(apart, _mm_cmpgt_ps(ratio, t));
+    word |= uint64_t(_mm_movemask_ps(over)) << k;
+  }
+  return word;
+}
 
-    for (int j = i + 1; j < num_boxes; ++j) {
-      if (!is_dead[j] && IoU(&boxes[i * 5], &boxes[j * 5]) > nms_thresh) {
-        is_dead[j] = 1;
+CAFFE_TARGET_AVX2 uint64_t OverlapWordAvx2(const NMSBoxes<float>& b,
+    const int i, const int j0, const float thresh, const NMSOverlap overlap) {
+  const __m256 ax1 = _mm256_set1_ps(b.x1[i]);
+  const __m256 ay1 = _mm256_set1_ps(b.y1[i]);
+  const __m256 ax2 = _mm256_set1_ps(b.x2[i]);
+  const __m256 ay2 = _mm256_set1_ps(b.y2[i]);
+  const __m256 aarea = _mm256_set1_ps(b.area[i]);
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 t = _mm256_set1_ps(thresh);
+  uint64_t word = 0;
+  for (int k = 0; k < kMaskBits; k += 8) {
+    const __m256 bx1 = _mm256_loadu_ps(&b.x1[j0 + k]);
+    const __m256 by1 = _mm256_loadu_ps(&b.y1[j0 + k]);
+    const __m256 bx2 = _mm256_loadu_ps(&b.x2[j0 + k]);
+    const __m256 by2 = _mm256_loadu_ps(&b.y2[j0 + k]);
+    const __m256 barea = _mm256_loadu_ps(&b.area[j0 + k]);
+    const __m256 apart = _mm256_or_ps(
+        _mm256_or_ps(_mm256_cmp_ps(ax1, bx2, _CMP_GT_OQ),
+                     _mm256_cmp_ps(ay1, by2, _CMP_GT_OQ)),
+        _mm256_or_ps(_mm256_cmp_ps(ax2, bx1, _CMP_LT_OQ),
+                     _mm256_cmp_ps(ay2, by1, _CMP_LT_OQ)));
+    // Separate multiplies and adds, as in the scalar code, rather than FMAs.
+    const __m256 width = _mm256_max_ps(zero, _mm256_add_ps(_mm256_sub_ps(
+        _mm256_min_ps(ax2, bx2), _mm256_max_ps(ax1, bx1)), one));
+    const __m256 height = _mm256_max_ps(zero, _mm256_add_ps(_mm256_sub_ps(
+        _mm256_min_ps(ay2, by2), _mm256_max_ps(ay1, by1)), one));
+    const __m256 area = _mm256_mul_ps(width, height);
+    const __m256 ratio = _mm256_div_ps(area, overlap == NMS_IOU ?
+        _mm256_sub_ps(_mm256_add_ps(aarea, barea), area) :
+        _mm256_max_ps(aarea, barea));
+    const __m256 over =
+        _mm256_andnot_ps(apart, _mm256_cmp_ps(ratio, t, _CMP_GT_OQ));
+    word |= uint64_t(_mm256_movemask_ps(over)) << k;
+  }
+  return word;
+}
+
+#endif  // CAFFE_X86_DISPATCH
+
+template <typename Dtype>
+struct OverlapKernel {
+  typedef uint64_t (*Fn)(const NMSBoxes<Dtype>&, const int, const int,
+                         const Dtype, const NMSOverlap);
+};
+
+// The widest kernel cpu_isa() allows; doubles have only the scalar one.
+template <typename Dtype>
+typename OverlapKernel<Dtype>::Fn SelectOverlapKernel() {
+  return OverlapWord<Dtype>;
+}
+
+template <>
+OverlapKernel<float>::Fn SelectOverlapKernel<float>() {
+#ifdef CAFFE_X86_DISPATCH
+  switch (cpu_isa()) {
+  case CPU_ISA_AVX512:
+  case CPU_ISA_AVX2:
+    return OverlapWordAvx2;
+  case CPU_ISA_SSE2:
+    return OverlapWordSse2;
+  default:
+    break;
+  }
+#endif
+  return OverlapWord<float>;
+}
+
+inline bool TestBit(const std::vector<uint64_t>& mask, const int i) {
+  return (mask[i / kMaskBits] >> (i % kMaskBits)) & 1;
+}
+
+}  // namespace
+
+template <typename Dtype>
+void NMSSorted(const Dtype* boxes, const int num_boxes, const int box_step,
+               int* index_out, int* num_out, const int base_index,
+               const Dtype nms_thresh, const int max_num_out,
+               const NMSOverlap overlap) {
+  int count = 0;
+  const int max_count = max_num_out > 0 ? max_num_out : num_boxes;
+  const int words = (num_boxes + kMaskBits - 1) / kMaskBits;
+  const NMSBoxes<Dtype> b(boxes, num_boxes, box_step, words * kMaskBits);
+  const typename OverlapKernel<Dtype>::Fn overlap_word =
+      SelectOverlapKernel<Dtype>();
+  // removed: the boxes suppressed by the kept ones so far, with the padding
+  // set. rows: the boxes that row i of the block suppresses, from its own
+  // word on.
+  std::vector<uint64_t> removed(words, 0);
+  for (int i = num_boxes; i < words * kMaskBits; ++i) {
+    removed[i / kMaskBits] |= uint64_t(1) << (i % kMaskBits);
+  }
+  std::vector<uint64_t> rows(kBlockRows * words);
+  const int grain = std::max(1, kMinParallelWork / std::max(1, num_boxes));
+  for (int block = 0; block < num_boxes && count < max_count;
+       block += kBlockRows) {
+    const int block_end = std::min(block + kBlockRows, num_boxes);
+    // Rows of boxes already suppressed are never read, and neither are the
+    // words of boxes that are all suppressed.
+    parallel_for(block_end - block, grain, [&](int begin, int end) {
+      for (int r = begin; r < end; ++r) {
+        const int i = block + r;
+        if (TestBit(removed, i)) {
+          continue;
+        }
+        uint64_t* row = rows.data() + r * words;
+        for (int w = i / kMaskBits; w < words; ++w) {
+          row[w] = ~removed[w] ?
+              overlap_word(b, i, w * kMaskBits, nms_thresh, overlap) : 0;
+        }
+        // Only the boxes after i.
+        row[i / kMaskBits] &= ~((uint64_t(2) << (i % kMaskBits)) - 1);
+      }
+    });
+    for (int i = block; i < block_end; ++i) {
+      if (TestBit(removed, i)) {
+        continue;
+      }
+      index_out[count++] = base_index + i;
+      if (count == max_count) {
+        break;
+      }
+      const uint64_t* row = rows.data() + (i - block) * words;
+      for (int w = i / kMaskBits; w < words; ++w) {
+        removed[w] |= row[w];
       }
     }
   }
-
   *num_out = count;
-  is_dead.clear();
+}
+
+template void NMSSorted<float>(const float* boxes, const int num_boxes,
+    const int box_step, int* index_out, int* num_out, const int base_index,
+    const float nms_thresh, const int max_num_out, const NMSOverlap overlap);
+template void NMSSorted<double>(const double* boxes, const int num_boxes,
+    const int box_step, int* index_out, int* num_out, const int base_index,
+    const double nms_thresh, const int max_num_out, const NMSOverlap overlap);
+
+template <typename Dtype>
+void NMS(const Dtype* boxes, const int num_boxes, int* index_out, int* num_out,
+         const int base_index, const Dtype nms_thresh, const int max_num_out) {
+  NMSSorted(boxes, num_boxes, 5, index_out, num_out, base_index, nms_thresh,
+            max_num_out, NMS_IOU);
 }
 
 template void NMS<float>(const float* boxes, const int num_boxes,
@@ -67,4 +306,4 @@ template void NMS<float>(const float* boxes, const int num_boxes,
 template void NMS<double>(const double* boxes, const int num_boxes,
                           int* index_out, int* num_out, const int base_index,
                           const double nms_thresh, const int max_num_out);
-}  // namespace caffe
\ No newline at end of file
+}  // namespace caffe
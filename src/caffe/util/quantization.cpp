@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/net.hpp"
+#include "caffe/util/cpu_info.hpp"
+#include "caffe/util/quantization.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#ifdef CAFFE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace caffe {
+
+namespace {
+
+// The kernels compute kMR x kNR tiles of C, each a dot product of a row of A
+// and a row of B. The quantized operands have their rows padded to kKAlign.
+const int kMR = 4;
+const int kNR = 2;
+const int kKAlign = 16;
+
+typedef void (*TileFn)(int K, const int8_t* const* a, const uint8_t* const* b,
+                       int32_t* tile);
+
+void TileScalar(int K, const int8_t* const* a, const uint8_t* const* b,
+    int32_t* tile) {
+  for (int i = 0; i < kMR; ++i) {
+    for (int j = 0; j < kNR; ++j) {
+      int32_t sum = 0;
+      for (int k = 0; k < K; ++k) {
+        sum += static_cast<int32_t>(a[i][k]) * b[j][k];
+      }
+      tile[i * kNR + j] = sum;
+    }
+  }
+}
+
+#ifdef CAFFE_X86_DISPATCH
+
+CAFFE_TARGET_AVX2 inline int32_t HorizontalSum(__m256i v) {
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+  s = _mm_hadd_epi32(s, s);
+  s = _mm_hadd_epi32(s, s);
+  return _mm_cvtsi128_si32(s);
+}
+
+// 16 values of each row are widened to 16 bits, where their products and
+// the sums of pairs of products (madd) are exact.
+CAFFE_TARGET_AVX2 void TileAvx2(int K, const int8_t* const* a,
+    const uint8_t* const* b, int32_t* tile) {
+  __m256i acc[kMR][kNR];
+  for (int i = 0; i < kMR; ++i) {
+    for (int j = 0; j < kNR; ++j) {
+      acc[i][j] = _mm256_setzero_si256();
+    }
+  }
+  int k = 0;
+  for (; k + 16 <= K; k += 16) {
+    __m256i bk[kNR];
+    for (int j = 0; j < kNR; ++j) {
+      bk[j] = _mm256_cvtepu8_epi16(_mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(b[j] + k)));
+    }
+    for (int i = 0; i < kMR; ++i) {
+      const __m256i ak = _mm256_cvtepi8_epi16(_mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(a[i] + k)));
+      for (int j = 0; j < kNR; ++j) {
+        acc[i][j] = _mm256_add_epi32(acc[i][j], _mm256_madd_epi16(ak, bk[j]));
+      }
+    }
+  }
+  for (int i = 0; i < kMR; ++i) {
+    for (int j = 0; j < kNR; ++j) {
+      int32_t sum = HorizontalSum(acc[i][j]);
+      for (int r = k; r < K; ++r) {
+        sum += static_cast<int32_t>(a[i][r]) * b[j][r];
+      }
+      tile[i * kNR + j] = sum;
+    }
+  }
+  // The callers are SSE code, which stalls on dirty upper halves.
+  _mm256_zeroupper();
+}
+
+#endif  // CAFFE_X86_DISPATCH
+
+TileFn SelectTile() {
+#ifdef CAFFE_X86_DISPATCH
+  if (cpu_isa() >= CPU_ISA_AVX2) {
+    return TileAvx2;
+  }
+#endif
+  return TileScalar;
+}
+
+inline int RoundUp(int n, int multiple) {
+  return (n + multiple - 1) / multiple * multiple;
+}
+
+inline uint8_t QuantizeValue(float x, float inverse_scale, int zero_point) {
+  const int q = static_cast<int>(std::lrint(x * inverse_scale)) + zero_point;
+  return static_cast<uint8_t>(std::min(std::max(q, 0), 255));
+}
+
+}  // namespace
+
+void caffe_cpu_int8_gemm(const int M, const int N, const int K,
+    const int8_t* A, const int lda, const uint8_t* B, const int ldb,
+    int32_t* C) {
+  if (M == 0 || N == 0) {
+    return;
+  }
+  const TileFn tile_fn = SelectTile();
+  const int num_tiles = (N + kNR - 1) / kNR;
+  const int grain = static_cast<int>(std::max<int64_t>(1,
+      kMinParallelWork / (static_cast<int64_t>(M) * K * kNR + 1)));
+  parallel_for(num_tiles, grain, [&](int begin, int end) {
+    const int8_t* a[kMR];
+    const uint8_t* b[kNR];
+    int32_t tile[kMR * kNR];
+    for (int t = begin; t < end; ++t) {
+      const int n0 = t * kNR;
+      const int nr = std::min(kNR, N - n0);
+      // Rows past the edge repeat the last one; their results are dropped.
+      for (int j = 0; j < kNR; ++j) {
+        b[j] = B + std::min(n0 + j, N - 1) * ldb;
+      }
+      for (int m0 = 0; m0 < M; m0 += kMR) {
+        const int mr = std::min(kMR, M - m0);
+        for (int i = 0; i < kMR; ++i) {
+          a[i] = A + std::min(m0 + i, M - 1) * lda;
+        }
+        tile_fn(K, a, b, tile);
+        for (int i = 0; i < mr; ++i) {
+          for (int j = 0; j < nr; ++j) {
+            C[(m0 + i) * N + n0 + j] = tile[i * kNR + j];
+          }
+        }
+      }
+    }
+  });
+}
+
+template <typename Dtype>
+QuantizedGemm<Dtype>::QuantizedGemm(const LayerParameter& param)
+    : enabled_(param.quantization_param().precision() ==
+               QuantizationParameter_Precision_INT8),
+      input_scale_(1), input_zero_point_(0), padded_k_(0),
+      weight_memory_(NULL), weight_version_(0) {
+  if (!enabled_) {
+    return;
+  }
+  const QuantizationParameter& quantization_param = param.quantization_param();
+  // Zero stays exact, as it pads the im2col buffer.
+  const float lo = std::min(quantization_param.input_min(), 0.f);
+  const float hi = std::max(quantization_param.input_max(), 0.f);
+  CHECK_GT(hi, lo) << "INT8 layer " << param.name()
+                   << " needs the calibrated input_min and input_max.";
+  input_scale_ = (hi - lo) / 255;
+  input_zero_point_ = static_cast<int>(std::lrint(-lo / input_scale_));
+}
+
+template <typename Dtype>
+void QuantizedGemm<Dtype>::QuantizeWeights(const Blob<Dtype>& weights) {
+  const int rows = weights.shape(0);
+  const int K = weights.count(1);
+  padded_k_ = RoundUp(K, kKAlign);
+  weights_.assign(static_cast<size_t>(rows) * padded_k_, 0);
+  weight_scales_.resize(rows);
+  weight_sums_.resize(rows);
+  const Dtype* data = weights.cpu_data();
+  for (int r = 0; r < rows; ++r) {
+    const Dtype* row = data + r * K;
+    Dtype max_abs = 0;
+    for (int k = 0; k < K; ++k) {
+      max_abs = std::max(max_abs, std::abs(row[k]));
+    }
+    const float scale = max_abs > 0 ? static_cast<float>(max_abs) / 127 : 1;
+    int8_t* quantized = &weights_[static_cast<size_t>(r) * padded_k_];
+    int32_t sum = 0;
+    for (int k = 0; k < K; ++k) {
+      const int q = static_cast<int>(std::lrint(row[k] / scale));
+      quantized[k] = static_cast<int8_t>(std::min(std::max(q, -127), 127));
+      sum += quantized[k];
+    }
+    weight_scales_[r] = scale;
+    weight_sums_[r] = sum;
+  }
+  weight_memory_ = weights.data().get();
+  weight_version_ = weights.data()->version();
+}
+
+template <typename Dtype>
+void QuantizedGemm<Dtype>::QuantizeInput(const int N, const int K,
+    const Dtype* input, const bool transposed) {
+  // The padding of the rows multiplies zero weights, so it needs no value.
+  input_.resize(static_cast<size_t>(N) * padded_k_);
+  const float inverse_scale = 1 / input_scale_;
+  const int zero_point = input_zero_point_;
+  uint8_t* quantized = input_.data();
+  const int padded_k = padded_k_;
+  const int grain = std::max(1, kMinParallelWork / std::max(K, 1));
+  parallel_for(N, grain, [&](int begin, int end) {
+    if (transposed) {
+      for (int n = begin; n < end; ++n) {
+        for (int k = 0; k < K; ++k) {
+          quantized[n * padded_k + k] =
+              QuantizeValue(input[n * K + k], inverse_scale, zero_point);
+        }
+      }
+      return;
+    }
+    for (int k = 0; k < K; ++k) {
+      const Dtype* row = input + k * N;
+      for (int n = begin; n < end; ++n) {
+        quantized[n * padded_k + k] =
+            QuantizeValue(row[n], inverse_scale, zero_point);
+      }
+    }
+  });
+}
+
+template <typename Dtype>
+void QuantizedGemm<Dtype>::Forward_cpu(const Blob<Dtype>& weights,
+    const int row_begin, const int M, const int N, const Dtype* input,
+    const bool transposed, Dtype* output) {
+  CHECK(enabled_);
+  if (weight_memory_ != weights.data().get() ||
+      weight_version_ != weights.data()->version()) {
+    QuantizeWeights(weights);
+  }
+  CHECK_LE(row_begin + M, weights.shape(0));
+  QuantizeInput(N, weights.count(1), input, transposed);
+  output_.resize(static_cast<size_t>(M) * N);
+  caffe_cpu_int8_gemm(M, N, padded_k_,
+                      &weights_[static_cast<size_t>(row_begin) * padded_k_],
+                      padded_k_, input_.data(), padded_k_, output_.data());
+  for (int m = 0; m < M; ++m) {
+    const Dtype scale = input_scale_ * weight_scales_[row_begin + m];
+    const int32_t offset = input_zero_point_ * weight_sums_[row_begin + m];
+    const int32_t* products = &output_[static_cast<size_t>(m) * N];
+    if (transposed) {
+      for (int n = 0; n < N; ++n) {
+        output[n * M + m] = scale * (products[n] - offset);
+      }
+    } else {
+      for (int n = 0; n < N; ++n) {
+        output[m * N + n] = scale * (products[n] - offset);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void UpdateBlobRanges(const Net<Dtype>& net, BlobRanges* ranges) {
+  const vector<string>& names = net.blob_names();
+  for (int i = 0; i < net.blobs().size(); ++i) {
+    const Blob<Dtype>& blob = *net.blobs()[i];
+    if (blob.count() == 0) {
+      continue;
+    }
+    const Dtype* data = blob.cpu_data();
+    const std::pair<const Dtype*, const Dtype*> range =
+        std::minmax_element(data, data + blob.count());
+    BlobRanges::iterator it = ranges->find(names[i]);
+    if (it == ranges->end()) {
+      (*ranges)[names[i]] = std::make_pair(static_cast<float>(*range.first),
+                                           static_cast<float>(*range.second));
+    } else {
+      it->second.first = std::min<float>(it->second.first, *range.first);
+      it->second.second = std::max<float>(it->second.second, *range.second);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(QuantizedGemm);
+template void UpdateBlobRanges(const Net<float>& net, BlobRanges* ranges);
+template void UpdateBlobRanges(const Net<double>& net, BlobRanges* ranges);
+
+}  // namespace caffe
@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "caffe/util/roi_align.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+template <typename Dtype>
+void AxisTaps(const Dtype roi_start, const Dtype roi_end, const int pooled,
+              const int size, vector<ROIAlignTap<Dtype> >* taps,
+              vector<int>* bins) {
+  const Dtype bin_size =
+      (roi_end - roi_start + 1) / static_cast<Dtype>(pooled);
+  taps->clear();
+  bins->resize(pooled + 1);
+  for (int p = 0; p < pooled; ++p) {
+    (*bins)[p] = taps->size();
+    const Dtype start = std::min(std::max(
+        static_cast<Dtype>(p) * bin_size + roi_start, Dtype(0)), Dtype(size));
+    const Dtype end = std::min(std::max(
+        static_cast<Dtype>(p + 1) * bin_size + roi_start, Dtype(0)),
+        Dtype(size));
+    for (Dtype position = start; position < end; position += 1.) {
+      ROIAlignTap<Dtype> tap;
+      tap.position = position;
+      tap.lo = std::floor(position);
+      tap.hi = std::ceil(position);
+      tap.lo_weight = 1 - position + tap.lo;
+      tap.hi_weight = 1 - tap.hi + position;
+      if (tap.lo < 0 || tap.lo >= size) {
+        tap.lo = 0;
+        tap.lo_weight = 0;
+      }
+      if (tap.hi < 0 || tap.hi >= size) {
+        tap.hi = 0;
+        tap.hi_weight = 0;
+      }
+      taps->push_back(tap);
+    }
+  }
+  (*bins)[pooled] = taps->size();
+}
+
+}  // namespace
+
+template <typename Dtype>
+void ROIAlignBins<Dtype>::Init(Dtype roi_start_h, Dtype roi_end_h,
+    Dtype roi_start_w, Dtype roi_end_w, int pooled_height, int pooled_width,
+    int height, int width) {
+  AxisTaps(roi_start_h, roi_end_h, pooled_height, height, &h_taps_, &h_bins_);
+  AxisTaps(roi_start_w, roi_end_w, pooled_width, width, &w_taps_, &w_bins_);
+  masked_ = false;
+}
+
+template <typename Dtype>
+void ROIAlignBins<Dtype>::SetMask(Dtype start_h, Dtype end_h, Dtype start_w,
+                                  Dtype end_w) {
+  masked_ = true;
+  mask_start_h_ = start_h;
+  mask_end_h_ = end_h;
+  mask_start_w_ = start_w;
+  mask_end_w_ = end_w;
+}
+
+template <typename Dtype>
+Dtype ROIAlignBins<Dtype>::Max(int ph, int pw, const Dtype* data, int width,
+                               int* argmax_x, int* argmax_y) const {
+  *argmax_x = -1;
+  *argmax_y = -1;
+  if (h_bins_[ph] == h_bins_[ph + 1] || w_bins_[pw] == w_bins_[pw + 1]) {
+    return 0;
+  }
+  Dtype max_value = -FLT_MAX;
+  for (int i = h_bins_[ph]; i < h_bins_[ph + 1]; ++i) {
+    const ROIAlignTap<Dtype>& y = h_taps_[i];
+    const Dtype* row_lo = data + y.lo * width;
+    const Dtype* row_hi = data + y.hi * width;
+    for (int j = w_bins_[pw]; j < w_bins_[pw + 1]; ++j) {
+      const ROIAlignTap<Dtype>& x = w_taps_[j];
+      Dtype value =
+          y.hi_weight * (x.lo_weight * row_hi[x.lo] +
+                         x.hi_weight * row_hi[x.hi]) +
+          y.lo_weight * (x.lo_weight * row_lo[x.lo] +
+                         x.hi_weight * row_lo[x.hi]);
+      if (Masked(y, x)) {
+        value = 0;
+      }
+      if (value > max_value) {
+        max_value = value;
+        *argmax_x = static_cast<int>(x.position);
+        *argmax_y = static_cast<int>(y.position);
+      }
+    }
+  }
+  return max_value;
+}
+
+template <typename Dtype>
+void ROIAlignBins<Dtype>::Backward(int ph, int pw, int argmax_x, int argmax_y,
+                                   Dtype diff, int width,
+                                   Dtype* bottom_diff) const {
+  // The samples of a bin are a pixel apart, so the truncated position
+  // identifies the sample.
+  int i = h_bins_[ph];
+  while (i < h_bins_[ph + 1] &&
+         static_cast<int>(h_taps_[i].position) != argmax_y) {
+    ++i;
+  }
+  int j = w_bins_[pw];
+  while (j < w_bins_[pw + 1] &&
+         static_cast<int>(w_taps_[j].position) != argmax_x) {
+    ++j;
+  }
+  if (i == h_bins_[ph + 1] || j == w_bins_[pw + 1]) {
+    return;
+  }
+  const ROIAlignTap<Dtype>& y = h_taps_[i];
+  const ROIAlignTap<Dtype>& x = w_taps_[j];
+  if (Masked(y, x)) {
+    return;
+  }
+  Dtype* row_lo = bottom_diff + y.lo * width;
+  Dtype* row_hi = bottom_diff + y.hi * width;
+  row_hi[x.lo] += y.hi_weight * x.lo_weight * diff;
+  row_hi[x.hi] += y.hi_weight * x.hi_weight * diff;
+  row_lo[x.lo] += y.lo_weight * x.lo_weight * diff;
+  row_lo[x.hi] += y.lo_weight * x.hi_weight * diff;
+}
+
+INSTANTIATE_CLASS(ROIAlignBins);
+
+template <typename Dtype>
+void roi_align_forward_cpu(const vector<ROIAlignBins<Dtype> >& bins,
+    const Dtype* bottom_data, const Dtype* bottom_rois, const int channels,
+    const int height, const int width, const int pooled_height,
+    const int pooled_width, Dtype* top_data, int* argmax_x, int* argmax_y) {
+  const int pooled_dim = pooled_height * pooled_width;
+  const int grain = std::max(1, kMinParallelWork / (4 * pooled_dim));
+  const int num_planes = static_cast<int>(bins.size()) * channels;
+  parallel_for(num_planes, grain, [&](int begin, int end) {
+    for (int index = begin; index < end; ++index) {
+      // index is (n, c), whose bins are at index * pooled_dim of the top.
+      const int n = index / channels;
+      const int roi_batch_ind = bottom_rois[n * 5];
+      const Dtype* data = bottom_data +
+          (roi_batch_ind * channels + index % channels) * height * width;
+      for (int ph = 0; ph < pooled_height; ++ph) {
+        for (int pw = 0; pw < pooled_width; ++pw) {
+          const int pool_index = index * pooled_dim + ph * pooled_width + pw;
+          top_data[pool_index] = bins[n].Max(ph, pw, data, width,
+              argmax_x + pool_index, argmax_y + pool_index);
+        }
+      }
+    }
+  });
+}
+
+template void roi_align_forward_cpu<float>(
+    const vector<ROIAlignBins<float> >& bins, const float* bottom_data,
+    const float* bottom_rois, const int channels, const int height,
+    const int width, const int pooled_height, const int pooled_width,
+    float* top_data, int* argmax_x, int* argmax_y);
+template void roi_align_forward_cpu<double>(
+    const vector<ROIAlignBins<double> >& bins, const double* bottom_data,
+    const double* bottom_rois, const int channels, const int height,
+    const int width, const int pooled_height, const int pooled_width,
+    double* top_data, int* argmax_x, int* argmax_y);
+
+template <typename Dtype>
+void roi_align_backward_cpu(const vector<ROIAlignBins<Dtype> >& bins,
+    const Dtype* top_diff, const int* argmax_x, const int* argmax_y,
+    const Dtype* bottom_rois, const int channels, const int height,
+    const int width, const int pooled_height, const int pooled_width,
+    Dtype* bottom_diff) {
+  // ROIs of an image overlap, so each task takes whole channels.
+  const int num_rois = bins.size();
+  const int pooled_dim = pooled_height * pooled_width;
+  const int grain =
+      std::max(1, kMinParallelWork / std::max(1, 4 * num_rois * pooled_dim));
+  parallel_for(channels, grain, [&](int begin, int end) {
+    for (int c = begin; c < end; ++c) {
+      for (int n = 0; n < num_rois; ++n) {
+        const int roi_batch_ind = bottom_rois[n * 5];
+        Dtype* diff = bottom_diff + (roi_batch_ind * channels + c) * height *
+            width;
+        const int offset = (n * channels + c) * pooled_dim;
+        for (int ph = 0; ph < pooled_height; ++ph) {
+          for (int pw = 0; pw < pooled_width; ++pw) {
+            const int pool_index = offset + ph * pooled_width + pw;
+            if (argmax_x[pool_index] >= 0) {
+              bins[n].Backward(ph, pw, argmax_x[pool_index],
+                               argmax_y[pool_index], top_diff[pool_index],
+                               width, diff);
+            }
+          }
+        }
+      }
+    }
+  });
+}
+
+template void roi_align_backward_cpu<float>(
+    const vector<ROIAlignBins<float> >& bins, const float* top_diff,
+    const int* argmax_x, const int* argmax_y, const float* bottom_rois,
+    const int channels, const int height, const int width,
+    const int pooled_height, const int pooled_width, float* bottom_diff);
+template void roi_align_backward_cpu<double>(
+    const vector<ROIAlignBins<double> >& bins, const double* top_diff,
+    const int* argmax_x, const int* argmax_y, const double* bottom_rois,
+    const int channels, const int height, const int width,
+    const int pooled_height, const int pooled_width, double* bottom_diff);
+
+}  // namespace caffe
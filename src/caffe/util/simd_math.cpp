@@ -0,0 +1,442 @@
+#include <cfloat>
+#include <cmath>
+
+#include "caffe/util/cpu_info.hpp"
+#include "caffe/util/simd_math.hpp"
+
+#ifdef CAFFE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace caffe {
+
+namespace {
+
+// Cephes single precision coefficients. exp(x) = 2^n exp(r) with
+// r = x - n log(2), and log(x) = e log(2) + log(m) with m in
+// [sqrt(1/2), sqrt(2)); log(2) is split in two for an exact reduction.
+const float kLog2e = 1.44269504088896341f;
+const float kLn2Hi = 0.693359375f;
+const float kLn2Lo = -2.12194440e-4f;
+const float kExpP[] = { 1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+                        4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f };
+const float kLogP[] = { 7.0376836292e-2f, -1.1514610310e-1f, 1.1676998740e-1f,
+                        -1.2420140846e-1f, 1.4249322787e-1f, -1.6668057665e-1f,
+                        2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f };
+const float kSqrtHalf = 0.707106781186547524f;
+// tanh(x) = x + x^3 P(x^2) below kTanhSmall, 1 - 2 / (exp(2|x|) + 1) above;
+// beyond kTanhLarge it rounds to +-1.
+const float kTanhP[] = { -5.70498872745e-3f, 2.06390887954e-2f,
+                         -5.37397155531e-2f, 1.33314422036e-1f,
+                         -3.33332819422e-1f };
+const float kTanhSmall = 0.625f;
+const float kTanhLarge = 10.f;
+// The range where 2^n stays a normal float.
+const float kExpMin = -87.f;
+const float kExpMax = 88.f;
+
+float ScalarSigmoid(float x) {
+  return 1.f / (1.f + std::exp(-x));
+}
+
+// Each Op evaluates one vector, and returns false when some lane is outside
+// the range of its polynomial; that vector is then computed with Scalar().
+
+struct ExpOp {
+  static float Scalar(float x) { return std::exp(x); }
+};
+struct LogOp {
+  static float Scalar(float x) { return std::log(x); }
+};
+struct TanhOp {
+  static float Scalar(float x) { return std::tanh(x); }
+};
+struct SigmoidOp {
+  static float Scalar(float x) { return ScalarSigmoid(x); }
+};
+struct PowOp {
+  explicit PowOp(float b) : b(b) {}
+  float Scalar(float x) const { return std::pow(x, b); }
+  float b;
+};
+
+template <typename Op>
+void MapScalar(int n, const float* a, float* y, const Op& op) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = op.Scalar(a[i]);
+  }
+}
+
+#ifdef CAFFE_X86_DISPATCH
+
+// SSE2 has neither FMA nor blends nor rounding instructions.
+
+CAFFE_TARGET_SSE2 inline __m128 Poly(__m128 x, const float* c, int n) {
+  __m128 p = _mm_set1_ps(c[0]);
+  for (int i = 1; i < n; ++i) {
+    p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(c[i]));
+  }
+  return p;
+}
+
+CAFFE_TARGET_SSE2 inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+CAFFE_TARGET_SSE2 inline bool AllSet(__m128 mask) {
+  return _mm_movemask_ps(mask) == 0xF;
+}
+
+CAFFE_TARGET_SSE2 inline __m128 InRange(__m128 x, float lo, float hi) {
+  return _mm_and_ps(_mm_cmpge_ps(x, _mm_set1_ps(lo)),
+                    _mm_cmple_ps(x, _mm_set1_ps(hi)));
+}
+
+// For x in [kExpMin, kExpMax].
+CAFFE_TARGET_SSE2 inline __m128 Exp(__m128 x) {
+  const __m128i ni = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(kLog2e)));
+  const __m128 n = _mm_cvtepi32_ps(ni);
+  __m128 r = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(kLn2Hi)));
+  r = _mm_sub_ps(r, _mm_mul_ps(n, _mm_set1_ps(kLn2Lo)));
+  __m128 p = _mm_mul_ps(Poly(r, kExpP, 6), _mm_mul_ps(r, r));
+  p = _mm_add_ps(_mm_add_ps(p, r), _mm_set1_ps(1.f));
+  const __m128i scale =
+      _mm_slli_epi32(_mm_add_epi32(ni, _mm_set1_epi32(127)), 23);
+  return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+}
+
+// For normal, finite, positive x.
+CAFFE_TARGET_SSE2 inline __m128 Log(__m128 x) {
+  const __m128i bits = _mm_castps_si128(x);
+  __m128 e = _mm_cvtepi32_ps(
+      _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+  __m128 m = _mm_castsi128_ps(
+      _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+                   _mm_set1_epi32(0x3F000000)));
+  const __m128 below = _mm_cmplt_ps(m, _mm_set1_ps(kSqrtHalf));
+  e = _mm_sub_ps(e, _mm_and_ps(below, _mm_set1_ps(1.f)));
+  m = _mm_sub_ps(_mm_add_ps(m, _mm_and_ps(below, m)), _mm_set1_ps(1.f));
+  const __m128 z = _mm_mul_ps(m, m);
+  __m128 y = _mm_mul_ps(_mm_mul_ps(Poly(m, kLogP, 9), m), z);
+  y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(kLn2Lo)));
+  y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+  return _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(e, _mm_set1_ps(kLn2Hi)));
+}
+
+CAFFE_TARGET_SSE2 inline __m128 LogDomain(__m128 x) {
+  return InRange(x, FLT_MIN, FLT_MAX);
+}
+
+struct ExpSse2 : public ExpOp {
+  CAFFE_TARGET_SSE2 bool Eval(__m128 x, __m128* y) const {
+    *y = Exp(x);
+    return AllSet(InRange(x, kExpMin, kExpMax));
+  }
+};
+
+struct LogSse2 : public LogOp {
+  CAFFE_TARGET_SSE2 bool Eval(__m128 x, __m128* y) const {
+    *y = Log(x);
+    return AllSet(LogDomain(x));
+  }
+};
+
+struct TanhSse2 : public TanhOp {
+  CAFFE_TARGET_SSE2 bool Eval(__m128 x, __m128* y) const {
+    const __m128 sign = _mm_and_ps(x, _mm_set1_ps(-0.f));
+    const __m128 ax = _mm_xor_ps(x, sign);
+    const __m128 z = _mm_mul_ps(x, x);
+    const __m128 small =
+        _mm_add_ps(_mm_mul_ps(_mm_mul_ps(Poly(z, kTanhP, 5), z), x), x);
+    const __m128 e =
+        Exp(_mm_min_ps(_mm_add_ps(ax, ax), _mm_set1_ps(2 * kTanhLarge)));
+    const __m128 large = _mm_or_ps(sign, _mm_sub_ps(_mm_set1_ps(1.f),
+        _mm_div_ps(_mm_set1_ps(2.f), _mm_add_ps(e, _mm_set1_ps(1.f)))));
+    *y = Select(_mm_cmplt_ps(ax, _mm_set1_ps(kTanhSmall)), small, large);
+    return AllSet(_mm_cmpeq_ps(x, x));
+  }
+};
+
+struct SigmoidSse2 : public SigmoidOp {
+  CAFFE_TARGET_SSE2 bool Eval(__m128 x, __m128* y) const {
+    const __m128 t = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), x),
+                                _mm_set1_ps(kExpMin));
+    *y = _mm_div_ps(_mm_set1_ps(1.f), _mm_add_ps(Exp(t), _mm_set1_ps(1.f)));
+    return AllSet(_mm_cmpge_ps(x, _mm_set1_ps(-kExpMax)));
+  }
+};
+
+struct PowSse2 : public PowOp {
+  explicit PowSse2(float b) : PowOp(b) {}
+  CAFFE_TARGET_SSE2 bool Eval(__m128 x, __m128* y) const {
+    if (b == 0.5f || b == -0.5f) {
+      *y = _mm_sqrt_ps(x);
+      if (b < 0) {
+        *y = _mm_div_ps(_mm_set1_ps(1.f), *y);
+      }
+      return AllSet(_mm_cmpgt_ps(x, _mm_setzero_ps()));
+    }
+    const __m128 t = _mm_mul_ps(Log(x), _mm_set1_ps(b));
+    *y = Exp(t);
+    return AllSet(_mm_and_ps(LogDomain(x), InRange(t, kExpMin, kExpMax)));
+  }
+};
+
+template <typename Op>
+CAFFE_TARGET_SSE2 void MapSse2(int n, const float* a, float* y,
+    const Op& op) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 v;
+    if (op.Eval(_mm_loadu_ps(a + i), &v)) {
+      _mm_storeu_ps(y + i, v);
+    } else {
+      MapScalar(4, a + i, y + i, op);
+    }
+  }
+  MapScalar(n - i, a + i, y + i, op);
+}
+
+CAFFE_TARGET_SSE2 void SqrtSse2(int n, const float* a, float* y) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(y + i, _mm_sqrt_ps(_mm_loadu_ps(a + i)));
+  }
+  for (; i < n; ++i) {
+    y[i] = std::sqrt(a[i]);
+  }
+}
+
+// The same with AVX2 and FMA.
+
+CAFFE_TARGET_AVX2 inline __m256 Poly(__m256 x, const float* c, int n) {
+  __m256 p = _mm256_set1_ps(c[0]);
+  for (int i = 1; i < n; ++i) {
+    p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(c[i]));
+  }
+  return p;
+}
+
+CAFFE_TARGET_AVX2 inline bool AllSet(__m256 mask) {
+  return _mm256_movemask_ps(mask) == 0xFF;
+}
+
+CAFFE_TARGET_AVX2 inline __m256 InRange(__m256 x, float lo, float hi) {
+  return _mm256_and_ps(_mm256_cmp_ps(x, _mm256_set1_ps(lo), _CMP_GE_OQ),
+                       _mm256_cmp_ps(x, _mm256_set1_ps(hi), _CMP_LE_OQ));
+}
+
+CAFFE_TARGET_AVX2 inline __m256 Exp(__m256 x) {
+  const __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(kLog2e)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(kLn2Hi), x);
+  r = _mm256_fnmadd_ps(n, _mm256_set1_ps(kLn2Lo), r);
+  const __m256 p = _mm256_fmadd_ps(Poly(r, kExpP, 6), _mm256_mul_ps(r, r),
+                                   _mm256_add_ps(r, _mm256_set1_ps(1.f)));
+  const __m256i scale = _mm256_slli_epi32(
+      _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+  return _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+}
+
+CAFFE_TARGET_AVX2 inline __m256 Log(__m256 x) {
+  const __m256i bits = _mm256_castps_si256(x);
+  __m256 e = _mm256_cvtepi32_ps(
+      _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+  __m256 m = _mm256_castsi256_ps(
+      _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+                      _mm256_set1_epi32(0x3F000000)));
+  const __m256 below =
+      _mm256_cmp_ps(m, _mm256_set1_ps(kSqrtHalf), _CMP_LT_OQ);
+  e = _mm256_sub_ps(e, _mm256_and_ps(below, _mm256_set1_ps(1.f)));
+  m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(below, m)),
+                    _mm256_set1_ps(1.f));
+  const __m256 z = _mm256_mul_ps(m, m);
+  __m256 y = _mm256_mul_ps(_mm256_mul_ps(Poly(m, kLogP, 9), m), z);
+  y = _mm256_fmadd_ps(e, _mm256_set1_ps(kLn2Lo), y);
+  y = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), y);
+  return _mm256_fmadd_ps(e, _mm256_set1_ps(kLn2Hi), _mm256_add_ps(m, y));
+}
+
+CAFFE_TARGET_AVX2 inline __m256 LogDomain(__m256 x) {
+  return InRange(x, FLT_MIN, FLT_MAX);
+}
+
+struct ExpAvx2 : public ExpOp {
+  CAFFE_TARGET_AVX2 bool Eval(__m256 x, __m256* y) const {
+    *y = Exp(x);
+    return AllSet(InRange(x, kExpMin, kExpMax));
+  }
+};
+
+struct LogAvx2 : public LogOp {
+  CAFFE_TARGET_AVX2 bool Eval(__m256 x, __m256* y) const {
+    *y = Log(x);
+    return AllSet(LogDomain(x));
+  }
+};
+
+struct TanhAvx2 : public TanhOp {
+  CAFFE_TARGET_AVX2 bool Eval(__m256 x, __m256* y) const {
+    const __m256 sign = _mm256_and_ps(x, _mm256_set1_ps(-0.f));
+    const __m256 ax = _mm256_xor_ps(x, sign);
+    const __m256 z = _mm256_mul_ps(x, x);
+    const __m256 small =
+        _mm256_fmadd_ps(_mm256_mul_ps(Poly(z, kTanhP, 5), z), x, x);
+    const __m256 e = Exp(_mm256_min_ps(_mm256_add_ps(ax, ax),
+                                       _mm256_set1_ps(2 * kTanhLarge)));
+    const __m256 large = _mm256_or_ps(sign, _mm256_sub_ps(_mm256_set1_ps(1.f),
+        _mm256_div_ps(_mm256_set1_ps(2.f),
+                      _mm256_add_ps(e, _mm256_set1_ps(1.f)))));
+    *y = _mm256_blendv_ps(large, small,
+        _mm256_cmp_ps(ax, _mm256_set1_ps(kTanhSmall), _CMP_LT_OQ));
+    return AllSet(_mm256_cmp_ps(x, x, _CMP_EQ_OQ));
+  }
+};
+
+struct SigmoidAvx2 : public SigmoidOp {
+  CAFFE_TARGET_AVX2 bool Eval(__m256 x, __m256* y) const {
+    const __m256 t = _mm256_max_ps(_mm256_sub_ps(_mm256_setzero_ps(), x),
+                                   _mm256_set1_ps(kExpMin));
+    *y = _mm256_div_ps(_mm256_set1_ps(1.f),
+                       _mm256_add_ps(Exp(t), _mm256_set1_ps(1.f)));
+    return AllSet(_mm256_cmp_ps(x, _mm256_set1_ps(-kExpMax), _CMP_GE_OQ));
+  }
+};
+
+struct PowAvx2 : public PowOp {
+  explicit PowAvx2(float b) : PowOp(b) {}
+  CAFFE_TARGET_AVX2 bool Eval(__m256 x, __m256* y) const {
+    if (b == 0.5f || b == -0.5f) {
+      *y = _mm256_sqrt_ps(x);
+      if (b < 0) {
+        *y = _mm256_div_ps(_mm256_set1_ps(1.f), *y);
+      }
+      return AllSet(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ));
+    }
+    const __m256 t = _mm256_mul_ps(Log(x), _mm256_set1_ps(b));
+    *y = Exp(t);
+    return AllSet(_mm256_and_ps(LogDomain(x), InRange(t, kExpMin, kExpMax)));
+  }
+};
+
+template <typename Op>
+CAFFE_TARGET_AVX2 void MapAvx2(int n, const float* a, float* y,
+    const Op& op) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 v;
+    if (op.Eval(_mm256_loadu_ps(a + i), &v)) {
+      _mm256_storeu_ps(y + i, v);
+    } else {
+      // Clear the upper halves before running SSE code, which otherwise
+      // pays a state transition on every instruction.
+      _mm256_zeroupper();
+      MapScalar(8, a + i, y + i, op);
+    }
+  }
+  _mm256_zeroupper();
+  MapScalar(n - i, a + i, y + i, op);
+}
+
+CAFFE_TARGET_AVX2 void SqrtAvx2(int n, const float* a, float* y) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_sqrt_ps(_mm256_loadu_ps(a + i)));
+  }
+  _mm256_zeroupper();
+  SqrtSse2(n - i, a + i, y + i);
+}
+
+#endif  // CAFFE_X86_DISPATCH
+
+// Run the widest kernel cpu_isa() allows.
+template <typename AvxOp, typename SseOp, typename ScalarOp>
+void Map(int n, const float* a, float* y, const AvxOp& avx2,
+    const SseOp& sse2, const ScalarOp& scalar) {
+#ifdef CAFFE_X86_DISPATCH
+  switch (cpu_isa()) {
+  case CPU_ISA_AVX512:
+  case CPU_ISA_AVX2:
+    MapAvx2(n, a, y, avx2);
+    return;
+  case CPU_ISA_SSE2:
+    MapSse2(n, a, y, sse2);
+    return;
+  default:
+    break;
+  }
+#endif
+  MapScalar(n, a, y, scalar);
+}
+
+}  // namespace
+
+#ifdef CAFFE_X86_DISPATCH
+#define CAFFE_SIMD_OPS(name) name##Avx2(), name##Sse2(), name##Op()
+#else
+#define CAFFE_SIMD_OPS(name) name##Op(), name##Op(), name##Op()
+#endif
+
+void simd_exp(int n, const float* a, float* y) {
+  Map(n, a, y, CAFFE_SIMD_OPS(Exp));
+}
+
+void simd_log(int n, const float* a, float* y) {
+  Map(n, a, y, CAFFE_SIMD_OPS(Log));
+}
+
+void simd_tanh(int n, const float* a, float* y) {
+  Map(n, a, y, CAFFE_SIMD_OPS(Tanh));
+}
+
+void simd_sigmoid(int n, const float* a, float* y) {
+  Map(n, a, y, CAFFE_SIMD_OPS(Sigmoid));
+}
+
+void simd_sqrt(int n, const float* a, float* y) {
+#ifdef CAFFE_X86_DISPATCH
+  switch (cpu_isa()) {
+  case CPU_ISA_AVX512:
+  case CPU_ISA_AVX2:
+    SqrtAvx2(n, a, y);
+    return;
+  case CPU_ISA_SSE2:
+    SqrtSse2(n, a, y);
+    return;
+  default:
+    break;
+  }
+#endif
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::sqrt(a[i]);
+  }
+}
+
+void simd_powx(int n, const float* a, float b, float* y) {
+  // Exact for these exponents, whatever the sign of a.
+  if (b == 1.f) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = a[i];
+    }
+  } else if (b == 2.f) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = a[i] * a[i];
+    }
+  } else if (b == -1.f) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = 1.f / a[i];
+    }
+  } else {
+    // Square roots are taken by sqrt, other exponents by exp(b log(a)), for
+    // positive a only; pow() handles the signs and special values.
+#ifdef CAFFE_X86_DISPATCH
+    Map(n, a, y, PowAvx2(b), PowSse2(b), PowOp(b));
+#else
+    MapScalar(n, a, y, PowOp(b));
+#endif
+  }
+}
+
+#undef CAFFE_SIMD_OPS
+
+}  // namespace caffe
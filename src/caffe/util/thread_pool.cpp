@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Set while the thread executes a task, so that nested loops run inline.
+thread_local bool executing_task = false;
+
+}  // namespace
+
+struct ThreadPool::Job {
+  const std::function<void(int)>* task;
+  int num_tasks;
+  std::atomic<int> next_task;
+  // Guarded by the pool mutex: workers still to join, and threads inside
+  // Execute (the caller included).
+  int helpers_wanted;
+  int active;
+  std::condition_variable finished;
+  std::mutex error_mutex;
+  std::exception_ptr error;
+};
+
+ThreadPool& ThreadPool::Global() {
+  // Never destroyed: the workers wait on it until the process exits.
+  static ThreadPool* pool = new ThreadPool();
+  return *pool;
+}
+
+bool ThreadPool::in_task() {
+  return executing_task;
+}
+
+int ThreadPool::num_workers() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return workers_.size();
+}
+
+void ThreadPool::Run(int num_tasks, const std::function<void(int)>& task) {
+  CHECK_GE(num_tasks, 0);
+  if (num_tasks <= 1 || executing_task) {
+    for (int i = 0; i < num_tasks; ++i) {
+      task(i);
+    }
+    return;
+  }
+  Job job;
+  job.task = &task;
+  job.num_tasks = num_tasks;
+  job.next_task = 0;
+  job.helpers_wanted = num_tasks - 1;
+  job.active = 1;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int workers = workers_.size();
+    if (num_tasks - 1 > workers) {
+      AddWorkers(num_tasks - 1 - workers);
+    }
+    jobs_.push_back(&job);
+  }
+  work_available_.notify_all();
+  Execute(&job);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // All tasks are taken; workers that have not joined yet need not.
+    if (job.helpers_wanted > 0) {
+      jobs_.erase(std::find(jobs_.begin(), jobs_.end(), &job));
+    }
+    --job.active;
+    job.finished.wait(lock, [&job]() { return job.active == 0; });
+  }
+  if (job.error) {
+    std::rethrow_exception(job.error);
+  }
+}
+
+void ThreadPool::AddWorkers(int num_workers) {
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+  }
+}
+
+void ThreadPool::WorkerLoop() {
+  for (;;) {
+    Job* job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_available_.wait(lock, [this]() { return !jobs_.empty(); });
+      job = jobs_.front();
+      ++job->active;
+      if (--job->helpers_wanted == 0) {
+        jobs_.pop_front();
+      }
+    }
+    Execute(job);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--job->active == 0) {
+      job->finished.notify_all();
+    }
+  }
+}
+
+void ThreadPool::Execute(Job* job) {
+  executing_task = true;
+  for (int i = job->next_task++; i < job->num_tasks; i = job->next_task++) {
+    try {
+      (*job->task)(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(job->error_mutex);
+      if (!job->error) {
+        job->error = std::current_exception();
+      }
+    }
+  }
+  executing_task = false;
+}
+
+int parallel_for_tasks(int n, int grain) {
+  if (executing_task) {
+    return 1;
+  }
+  grain = std::max(grain, 1);
+  return std::min(Caffe::num_threads(), (n + grain - 1) / grain);
+}
+
+}  // namespace caffe
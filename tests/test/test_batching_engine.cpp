@@ -0,0 +1,138 @@
+#include <future>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/batching_engine.hpp"
+#include "caffe/common.hpp"
+#include "caffe/inference_model.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class BatchingEngineTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  virtual void SetUp() {
+    const string& proto =
+        "name: 'BatchingNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape: { dim: 1 dim: 2 dim: 5 dim: 5 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 3 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv' "
+        "  top: 'conv' "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    param.mutable_state()->set_phase(TEST);
+    model_.reset(new InferenceModel<Dtype>(param, ""));
+    reference_ = model_->NewSession();
+  }
+
+  void MakeSample(const int height, const int width, const int seed,
+                  Blob<Dtype>* sample) {
+    sample->Reshape(1, 2, height, width);
+    for (int i = 0; i < sample->count(); ++i) {
+      sample->mutable_cpu_data()[i] = Dtype((i * 5 + seed) % 17) / 8 - 1;
+    }
+  }
+
+  // Check outputs against running the sample alone.
+  void CheckOutputs(const Blob<Dtype>& sample,
+      const vector<shared_ptr<Blob<Dtype> > >& outputs) {
+    Blob<Dtype>* input = reference_->input_blobs()[0];
+    input->ReshapeLike(sample);
+    reference_->Reshape();
+    input->CopyFrom(sample);
+    const vector<Blob<Dtype>*>& expected = reference_->Forward();
+    ASSERT_EQ(expected.size(), outputs.size());
+    for (int j = 0; j < expected.size(); ++j) {
+      ASSERT_TRUE(expected[j]->shape() == outputs[j]->shape());
+      for (int i = 0; i < expected[j]->count(); ++i) {
+        EXPECT_NEAR(expected[j]->cpu_data()[i], outputs[j]->cpu_data()[i],
+                    1e-5);
+      }
+    }
+  }
+
+  shared_ptr<InferenceModel<Dtype> > model_;
+  shared_ptr<Net<Dtype> > reference_;
+};
+
+TYPED_TEST_CASE(BatchingEngineTest, TestDtypesAndDevices);
+
+TYPED_TEST(BatchingEngineTest, TestBatching) {
+  typedef typename TypeParam::Dtype Dtype;
+  typedef typename BatchingEngine<Dtype>::Outputs Outputs;
+  BatchingParameter param;
+  param.set_max_batch_size(4);
+  param.set_max_delay_us(200000);
+  BatchingEngine<Dtype> engine(this->model_, param);
+  const int num_samples = 6;
+  vector<shared_ptr<Blob<Dtype> > > samples;
+  vector<std::future<Outputs> > futures;
+  for (int i = 0; i < num_samples; ++i) {
+    samples.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    this->MakeSample(5, 5, i, samples[i].get());
+    futures.push_back(engine.Submit(*samples[i]));
+  }
+  for (int i = 0; i < num_samples; ++i) {
+    this->CheckOutputs(*samples[i], futures[i].get());
+  }
+  // A full batch of 4, then the remaining 2 once the delay ran out.
+  typename BatchingEngine<Dtype>::Stats stats = engine.stats();
+  EXPECT_EQ(num_samples, stats.num_requests);
+  EXPECT_EQ(2, stats.num_batches);
+  EXPECT_EQ(3, stats.mean_batch_size);
+  EXPECT_LE(stats.p50_latency, stats.max_latency);
+  engine.ResetStats();
+  EXPECT_EQ(0, engine.stats().num_requests);
+}
+
+TYPED_TEST(BatchingEngineTest, TestMixedShapes) {
+  typedef typename TypeParam::Dtype Dtype;
+  typedef typename BatchingEngine<Dtype>::Outputs Outputs;
+  BatchingParameter param;
+  param.set_max_batch_size(3);
+  param.set_max_delay_us(1000);
+  param.set_num_workers(2);
+  BatchingEngine<Dtype> engine(this->model_, param);
+  const int num_samples = 10;
+  vector<shared_ptr<Blob<Dtype> > > samples;
+  vector<std::future<Outputs> > futures;
+  for (int i = 0; i < num_samples; ++i) {
+    samples.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    this->MakeSample(5 + (i / 4) % 2, 5 + i % 3, i, samples[i].get());
+    futures.push_back(engine.Submit(*samples[i]));
+  }
+  for (int i = 0; i < num_samples; ++i) {
+    this->CheckOutputs(*samples[i], futures[i].get());
+  }
+  EXPECT_EQ(num_samples, engine.stats().num_requests);
+}
+
+}  // namespace caffe
@@ -0,0 +1,280 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/blocked_gemm.hpp"
+#include "caffe/util/cpu_info.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class BlockedGemmTest : public ::testing::Test {
+ protected:
+  virtual ~BlockedGemmTest() {
+    set_max_cpu_isa(CPU_ISA_AVX512);
+    Caffe::set_num_threads(-1);
+  }
+
+  void Fill(int count, vector<Dtype>* x) {
+    x->resize(count);
+    caffe_rng_uniform<Dtype>(count, -1, 1, x->data());
+  }
+
+  // C = alpha op(A) op(B) + beta C in double precision.
+  void ReferenceGemm(bool trans_a, bool trans_b, int M, int N, int K,
+      Dtype alpha, const Dtype* A, const Dtype* B, Dtype beta, Dtype* C) {
+    for (int i = 0; i < M; ++i) {
+      for (int j = 0; j < N; ++j) {
+        double sum = 0;
+        for (int k = 0; k < K; ++k) {
+          sum += static_cast<double>(trans_a ? A[k * M + i] : A[i * K + k]) *
+                 (trans_b ? B[j * K + k] : B[k * N + j]);
+        }
+        C[i * N + j] = alpha * sum + (beta == 0 ? 0 : beta * C[i * N + j]);
+      }
+    }
+  }
+
+  // Every combination of transposes, with and without packing, against the
+  // reference, under each instruction set.
+  void CheckGemm(int M, int N, int K, Dtype alpha, Dtype beta) {
+    vector<Dtype> A, B, C0, C, expected;
+    Fill(M * K, &A);
+    Fill(K * N, &B);
+    Fill(M * N, &C0);
+    const CBLAS_TRANSPOSE trans[] = { CblasNoTrans, CblasTrans };
+    const CpuIsa isas[] = { CPU_ISA_SCALAR, CPU_ISA_AVX2, CPU_ISA_AVX512 };
+    for (int ta = 0; ta < 2; ++ta) {
+      for (int tb = 0; tb < 2; ++tb) {
+        expected = C0;
+        ReferenceGemm(ta, tb, M, N, K, alpha, A.data(), B.data(), beta,
+                      expected.data());
+        for (int i = 0; i < 3; ++i) {
+          set_max_cpu_isa(isas[i]);
+          PackedMatrix<Dtype> packed_a, packed_b;
+          packed_a.PackA(trans[ta], M, K, A.data());
+          packed_b.PackB(trans[tb], K, N, B.data());
+          for (int mode = 0; mode < 3; ++mode) {
+            C = C0;
+            if (mode == 0) {
+              caffe_cpu_blocked_gemm<Dtype>(trans[ta], trans[tb], M, N, K,
+                  alpha, A.data(), B.data(), beta, C.data());
+            } else if (mode == 1) {
+              caffe_cpu_blocked_gemm<Dtype>(packed_a, trans[tb], N, alpha,
+                  B.data(), beta, C.data());
+            } else {
+              caffe_cpu_blocked_gemm<Dtype>(trans[ta], M, alpha, A.data(),
+                  packed_b, beta, C.data());
+            }
+            for (int j = 0; j < M * N; ++j) {
+              ASSERT_NEAR(expected[j], C[j], 1e-4 * (K + 1))
+                  << M << "x" << N << "x" << K << " trans " << ta << tb
+                  << " mode " << mode << " " << cpu_isa_name(cpu_isa());
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+TYPED_TEST_CASE(BlockedGemmTest, TestDtypes);
+
+TYPED_TEST(BlockedGemmTest, TestSmall) {
+  this->CheckGemm(1, 1, 1, 1, 0);
+  this->CheckGemm(5, 3, 7, 2, 0.5);
+  this->CheckGemm(13, 17, 19, 1, 1);
+}
+
+TYPED_TEST(BlockedGemmTest, TestBlocks) {
+  // More than one block in every dimension, with partial tiles.
+  this->CheckGemm(151, 2100, 263, 1, 0);
+  this->CheckGemm(31, 35, 600, 0.5, 2);
+}
+
+TYPED_TEST(BlockedGemmTest, TestBetaZero) {
+  // C is only written when beta is zero, so garbage in it does not matter.
+  typedef TypeParam Dtype;
+  const int M = 7, N = 20, K = 9;
+  vector<Dtype> A(M * K, 1), B(K * N, 1), C(M * N, NAN);
+  caffe_cpu_blocked_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, N, K, 1,
+      A.data(), B.data(), 0, C.data());
+  for (int i = 0; i < M * N; ++i) {
+    EXPECT_EQ(K, C[i]);
+  }
+  caffe_cpu_blocked_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, N, 0, 1,
+      A.data(), B.data(), 0, C.data());
+  for (int i = 0; i < M * N; ++i) {
+    EXPECT_EQ(0, C[i]);
+  }
+}
+
+TYPED_TEST(BlockedGemmTest, TestThreads) {
+  typedef TypeParam Dtype;
+  const int M = 64, N = 1000, K = 300;
+  vector<Dtype> A, B;
+  this->Fill(M * K, &A);
+  this->Fill(K * N, &B);
+  vector<Dtype> serial(M * N), threaded(M * N);
+  Caffe::set_num_threads(1);
+  caffe_cpu_blocked_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, N, K, 1,
+      A.data(), B.data(), 0, serial.data());
+  Caffe::set_num_threads(4);
+  caffe_cpu_blocked_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, N, K, 1,
+      A.data(), B.data(), 0, threaded.data());
+  for (int i = 0; i < M * N; ++i) {
+    EXPECT_EQ(serial[i], threaded[i]);
+  }
+}
+
+// Forward through prepacked weights matches the BLAS path, and follows
+// updates of the weights.
+template <typename TypeParam>
+class PrepackedLayerTest : public CPUDeviceTest<TypeParam> {
+ protected:
+  typedef TypeParam Dtype;
+
+  PrepackedLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 8, 9, 11)),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~PrepackedLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  void CheckPrepacked(Layer<Dtype>* layer) {
+    layer->SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    Blob<Dtype> expected;
+    expected.CopyFrom(*blob_top_, false, true);
+    layer->PrepackWeights();
+    caffe_set(blob_top_->count(), Dtype(0), blob_top_->mutable_cpu_data());
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    for (int i = 0; i < blob_top_->count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], blob_top_->cpu_data()[i], 1e-4);
+    }
+    // Scaling the weights invalidates the packed copy.
+    Blob<Dtype>* weights = layer->blobs()[0].get();
+    caffe_scal(weights->count(), Dtype(2), weights->mutable_cpu_data());
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    const Dtype* bias = layer->blobs()[1]->cpu_data();
+    const int channels = blob_top_->shape(1);
+    const int spatial = blob_top_->count(2);
+    for (int i = 0; i < blob_top_->count(); ++i) {
+      const Dtype b = bias[i / spatial % channels];
+      EXPECT_NEAR(2 * (expected.cpu_data()[i] - b) + b,
+                  blob_top_->cpu_data()[i], 1e-4);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(PrepackedLayerTest, TestDtypes);
+
+TYPED_TEST(PrepackedLayerTest, TestInnerProduct) {
+  LayerParameter layer_param;
+  InnerProductParameter* ip_param = layer_param.mutable_inner_product_param();
+  ip_param->set_num_output(37);
+  ip_param->mutable_weight_filler()->set_type("gaussian");
+  ip_param->mutable_bias_filler()->set_type("gaussian");
+  InnerProductLayer<TypeParam> layer(layer_param);
+  this->CheckPrepacked(&layer);
+}
+
+TYPED_TEST(PrepackedLayerTest, TestConvolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* conv_param = layer_param.mutable_convolution_param();
+  conv_param->add_kernel_size(3);
+  conv_param->add_pad(1);
+  conv_param->set_num_output(12);
+  conv_param->set_group(2);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  conv_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<TypeParam> layer(layer_param);
+  this->CheckPrepacked(&layer);
+}
+
+TEST(BlockedGemmBenchmark, DISABLED_TestModelShapes) {
+  // M x N x K of convolutions (weights x im2col columns) and inner products
+  // (batch x weights^T) of AlexNet and GoogLeNet.
+  struct Shape {
+    const char* name;
+    int M, N, K;
+    bool packed_b;
+  };
+  const Shape shapes[] = {
+    { "alexnet conv2 (group)", 128, 729, 1200, false },
+    { "alexnet conv3", 384, 169, 2304, false },
+    { "googlenet inception_3a/1x1", 64, 784, 192, false },
+    { "googlenet inception_4a/3x3", 208, 196, 864, false },
+    { "alexnet fc6, batch 1", 1, 4096, 9216, true },
+    { "alexnet fc7, batch 10", 10, 4096, 4096, true },
+  };
+  const int kIterations = 5;
+  for (int s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+    const Shape& shape = shapes[s];
+    const int M = shape.M, N = shape.N, K = shape.K;
+    // Inner products multiply by transposed weights.
+    const CBLAS_TRANSPOSE trans_b = shape.packed_b ? CblasTrans : CblasNoTrans;
+    vector<float> A(M * K), B(K * N), C(M * N);
+    caffe_rng_uniform<float>(A.size(), -1, 1, A.data());
+    caffe_rng_uniform<float>(B.size(), -1, 1, B.data());
+    PackedMatrix<float> packed;
+    if (shape.packed_b) {
+      packed.PackB(trans_b, K, N, B.data());
+    } else {
+      packed.PackA(CblasNoTrans, M, K, A.data());
+    }
+    float ms[3];
+    for (int mode = 0; mode < 3; ++mode) {
+      CPUTimer timer;
+      for (int i = 0; i <= kIterations; ++i) {
+        if (i == 1) {
+          timer.Start();
+        }
+        if (mode == 0) {
+          caffe_cpu_gemm<float>(CblasNoTrans, trans_b, M, N, K, 1, A.data(),
+                                B.data(), 0, C.data());
+        } else if (mode == 1) {
+          caffe_cpu_blocked_gemm<float>(CblasNoTrans, trans_b, M, N, K, 1,
+                                        A.data(), B.data(), 0, C.data());
+        } else if (shape.packed_b) {
+          caffe_cpu_blocked_gemm<float>(CblasNoTrans, M, 1, A.data(), packed,
+                                        0, C.data());
+        } else {
+          caffe_cpu_blocked_gemm<float>(packed, trans_b, N, 1, B.data(), 0,
+                                        C.data());
+        }
+      }
+      ms[mode] = timer.MilliSeconds() / kIterations;
+    }
+    const double gflop = 2e-6 * M * N * K;
+    LOG(INFO) << shape.name << " (" << M << "x" << N << "x" << K << ", "
+              << cpu_isa_name(cpu_isa()) << "): BLAS " << gflop / ms[0]
+              << " GFLOPS, blocked " << gflop / ms[1] << ", prepacked "
+              << gflop / ms[2];
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,445 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/layers/transpose_layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/inference_optimizer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Copy an (N, C, H, W) blob into an (N, H, W, C) one.
+template <typename Dtype>
+void ToChannelsLast(const Blob<Dtype>& nchw, Blob<Dtype>* nhwc) {
+  const int num = nchw.shape(0), channels = nchw.shape(1);
+  const int spatial = nchw.count(2);
+  nhwc->Reshape(num, nchw.shape(2), nchw.shape(3), channels);
+  for (int n = 0; n < num; ++n) {
+    for (int c = 0; c < channels; ++c) {
+      for (int s = 0; s < spatial; ++s) {
+        nhwc->mutable_cpu_data()[(n * spatial + s) * channels + c] =
+            nchw.cpu_data()[(n * channels + c) * spatial + s];
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+class ChannelsLastLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  ChannelsLastLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 6, 9, 7)),
+        blob_bottom_nhwc_(new Blob<Dtype>()),
+        blob_top_(new Blob<Dtype>()),
+        blob_top_nhwc_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    filler_param.set_std(1);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    ToChannelsLast(*blob_bottom_, blob_bottom_nhwc_);
+  }
+  virtual ~ChannelsLastLayerTest() {
+    delete blob_bottom_;
+    delete blob_bottom_nhwc_;
+    delete blob_top_;
+    delete blob_top_nhwc_;
+  }
+
+  // Run the layer of param on blob_bottom_ and that of nhwc_param, with the
+  // same blobs, on blob_bottom_nhwc_, and compare their tops.
+  void CheckChannelsLast(const LayerParameter& param,
+      const LayerParameter& nhwc_param) {
+    vector<Blob<Dtype>*> bottom(1, blob_bottom_), top(1, blob_top_);
+    vector<Blob<Dtype>*> bottom_nhwc(1, blob_bottom_nhwc_);
+    vector<Blob<Dtype>*> top_nhwc(1, blob_top_nhwc_);
+    shared_ptr<Layer<Dtype> > layer = LayerRegistry<Dtype>::CreateLayer(param);
+    shared_ptr<Layer<Dtype> > nhwc_layer =
+        LayerRegistry<Dtype>::CreateLayer(nhwc_param);
+    layer->SetUp(bottom, top);
+    nhwc_layer->SetUp(bottom_nhwc, top_nhwc);
+    ASSERT_EQ(layer->blobs().size(), nhwc_layer->blobs().size());
+    for (int i = 0; i < layer->blobs().size(); ++i) {
+      // Positive values make valid BatchNorm statistics too.
+      Blob<Dtype>* blob = layer->blobs()[i].get();
+      caffe_rng_uniform<Dtype>(blob->count(), 0.5, 2,
+                               blob->mutable_cpu_data());
+      nhwc_layer->blobs()[i]->CopyFrom(*blob);
+    }
+    layer->Forward(bottom, top);
+    nhwc_layer->Forward(bottom_nhwc, top_nhwc);
+    Blob<Dtype> expected;
+    ToChannelsLast(*blob_top_, &expected);
+    ASSERT_EQ(expected.shape(), blob_top_nhwc_->shape());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], blob_top_nhwc_->cpu_data()[i],
+                  1e-4);
+    }
+  }
+
+  void CheckChannelsLast(const LayerParameter& param) {
+    LayerParameter nhwc_param(param);
+    nhwc_param.set_layout(NHWC);
+    CheckChannelsLast(param, nhwc_param);
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_bottom_nhwc_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const blob_top_nhwc_;
+};
+
+TYPED_TEST_CASE(ChannelsLastLayerTest, TestDtypes);
+
+// A 3x3 convolution; num_output 8.
+static LayerParameter MakeConvolutionParam() {
+  LayerParameter param;
+  param.set_type("Convolution");
+  ConvolutionParameter* conv_param = param.mutable_convolution_param();
+  conv_param->add_kernel_size(3);
+  conv_param->set_num_output(8);
+  return param;
+}
+
+TYPED_TEST(ChannelsLastLayerTest, TestConvolution) {
+  LayerParameter param = MakeConvolutionParam();
+  param.mutable_convolution_param()->add_pad(1);
+  param.mutable_convolution_param()->add_stride(2);
+  this->CheckChannelsLast(param);
+}
+
+TYPED_TEST(ChannelsLastLayerTest, TestConvolutionGroup) {
+  LayerParameter param = MakeConvolutionParam();
+  param.mutable_convolution_param()->add_pad(1);
+  param.mutable_convolution_param()->set_group(2);
+  this->CheckChannelsLast(param);
+}
+
+TYPED_TEST(ChannelsLastLayerTest, TestConvolutionDilation) {
+  LayerParameter param = MakeConvolutionParam();
+  param.mutable_convolution_param()->set_pad_h(2);
+  param.mutable_convolution_param()->set_pad_w(1);
+  param.mutable_convolution_param()->add_dilation(2);
+  param.mutable_convolution_param()->set_bias_term(false);
+  this->CheckChannelsLast(param);
+}
+
+TYPED_TEST(ChannelsLastLayerTest, TestConvolution1x1) {
+  LayerParameter param = MakeConvolutionParam();
+  param.mutable_convolution_param()->set_kernel_size(0, 1);
+  this->CheckChannelsLast(param);
+  param.mutable_convolution_param()->set_num_output(9);
+  param.mutable_convolution_param()->set_group(3);
+  this->CheckChannelsLast(param);
+}
+
+TYPED_TEST(ChannelsLastLayerTest, TestConvolutionFusedActivation) {
+  LayerParameter param = MakeConvolutionParam();
+  param.mutable_fused_activation_param()->set_type(
+      FusedActivationParameter_Type_RELU);
+  this->CheckChannelsLast(param);
+  param.mutable_fused_activation_param()->set_type(
+      FusedActivationParameter_Type_PRELU);
+  this->CheckChannelsLast(param);
+}
+
+TYPED_TEST(ChannelsLastLayerTest, TestConvolutionDepthwise) {
+  LayerParameter param = MakeConvolutionParam();
+  param.set_type("ConvolutionDepthwise");
+  param.mutable_convolution_param()->set_num_output(6);
+  param.mutable_convolution_param()->add_pad(1);
+  param.mutable_convolution_param()->add_stride(2);
+  this->CheckChannelsLast(param);
+  // Grouped convolutions with one channel per group are depthwise too.
+  param.set_type("Convolution");
+  param.mutable_convolution_param()->set_group(6);
+  this->CheckChannelsLast(param);
+}
+
+TYPED_TEST(ChannelsLastLayerTest, TestPooling) {
+  LayerParameter param;
+  param.set_type("Pooling");
+  PoolingParameter* pool_param = param.mutable_pooling_param();
+  pool_param->set_kernel_size(3);
+  pool_param->set_stride(2);
+  pool_param->set_pad(1);
+  this->CheckChannelsLast(param);
+  pool_param->set_pool(PoolingParameter_PoolMethod_AVE);
+  this->CheckChannelsLast(param);
+  pool_param->clear_kernel_size();
+  pool_param->clear_stride();
+  pool_param->clear_pad();
+  pool_param->set_global_pooling(true);
+  this->CheckChannelsLast(param);
+}
+
+TYPED_TEST(ChannelsLastLayerTest, TestBatchNorm) {
+  LayerParameter param;
+  param.set_type("BatchNorm");
+  param.mutable_batch_norm_param()->set_use_global_stats(true);
+  this->CheckChannelsLast(param);
+}
+
+TYPED_TEST(ChannelsLastLayerTest, TestScale) {
+  LayerParameter param;
+  param.set_type("Scale");
+  param.mutable_scale_param()->set_bias_term(true);
+  LayerParameter nhwc_param(param);
+  nhwc_param.mutable_scale_param()->set_axis(3);
+  this->CheckChannelsLast(param, nhwc_param);
+}
+
+TYPED_TEST(ChannelsLastLayerTest, TestShuffleChannel) {
+  LayerParameter param;
+  param.set_type("ShuffleChannel");
+  param.mutable_shuffle_channel_param()->set_group(2);
+  this->CheckChannelsLast(param);
+}
+
+TYPED_TEST(ChannelsLastLayerTest, TestTranspose) {
+  typedef TypeParam Dtype;
+  const int kDims[][4] = {
+    { 0, 2, 3, 1 }, { 0, 3, 1, 2 }, { 2, 3, 0, 1 }, { 0, 2, 1, 3 } };
+  for (int d = 0; d < 4; ++d) {
+    LayerParameter param;
+    for (int i = 0; i < 4; ++i) {
+      param.mutable_transpose_param()->add_dim(kDims[d][i]);
+    }
+    TransposeLayer<Dtype> layer(param);
+    vector<Blob<Dtype>*> bottom(1, this->blob_bottom_);
+    vector<Blob<Dtype>*> top(1, this->blob_top_);
+    layer.SetUp(bottom, top);
+    layer.Forward(bottom, top);
+    const vector<int>& shape = this->blob_bottom_->shape();
+    vector<int> index(4);
+    for (index[0] = 0; index[0] < shape[0]; ++index[0]) {
+      for (index[1] = 0; index[1] < shape[1]; ++index[1]) {
+        for (index[2] = 0; index[2] < shape[2]; ++index[2]) {
+          for (index[3] = 0; index[3] < shape[3]; ++index[3]) {
+            vector<int> top_index(4);
+            for (int i = 0; i < 4; ++i) {
+              top_index[i] = index[kDims[d][i]];
+            }
+            EXPECT_EQ(this->blob_bottom_->data_at(index),
+                      this->blob_top_->data_at(top_index));
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+class ChannelsLastNetTest : public CPUDeviceTest<Dtype> {
+ protected:
+  // Build a net from proto with random weights and statistics, and put the
+  // trained blobs in param_.
+  void InitTrainedNet(const string& proto) {
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+    net_.reset(new Net<Dtype>(param_));
+    for (int i = 0; i < net_->layers().size(); ++i) {
+      vector<shared_ptr<Blob<Dtype> > >& blobs = net_->layers()[i]->blobs();
+      for (int j = 0; j < blobs.size(); ++j) {
+        caffe_rng_uniform<Dtype>(blobs[j]->count(), 0.5, 2,
+                                 blobs[j]->mutable_cpu_data());
+      }
+    }
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(net_->input_blobs()[0]);
+    net_->ToProto(&param_);
+  }
+
+  void CheckConvertedNet(const NetParameter& converted_param,
+      const string& blob_name) {
+    Net<Dtype> converted_net(converted_param);
+    converted_net.input_blobs()[0]->CopyFrom(*net_->input_blobs()[0]);
+    net_->Forward();
+    converted_net.Forward();
+    const Blob<Dtype>* expected = net_->blob_by_name(blob_name).get();
+    const Blob<Dtype>* actual = converted_net.blob_by_name(blob_name).get();
+    ASSERT_TRUE(actual != NULL);
+    ASSERT_EQ(expected->shape(), actual->shape());
+    for (int i = 0; i < expected->count(); ++i) {
+      const Dtype value = expected->cpu_data()[i];
+      EXPECT_NEAR(value, actual->cpu_data()[i],
+                  1e-4 * std::max(Dtype(1), std::abs(value)));
+    }
+  }
+
+  NetParameter param_;
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(ChannelsLastNetTest, TestDtypes);
+
+const char* kChannelsLastNetProto =
+    "layer { name: 'data' type: 'Input' top: 'data' "
+    "  input_param { shape { dim: 2 dim: 4 dim: 10 dim: 10 } } } "
+    "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+    "  convolution_param { num_output: 8 kernel_size: 3 pad: 1 stride: 2 } } "
+    "layer { name: 'bn1' type: 'BatchNorm' bottom: 'conv1' top: 'conv1' } "
+    "layer { name: 'scale1' type: 'Scale' bottom: 'conv1' top: 'conv1' "
+    "  scale_param { bias_term: true } } "
+    "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+    "layer { name: 'dw' type: 'ConvolutionDepthwise' bottom: 'conv1' "
+    "  top: 'dw' convolution_param { num_output: 8 kernel_size: 3 pad: 1 "
+    "    stride: 1 } } "
+    "layer { name: 'pw' type: 'Convolution' bottom: 'dw' top: 'pw' "
+    "  convolution_param { num_output: 8 kernel_size: 1 group: 2 } } "
+    "layer { name: 'shuffle' type: 'ShuffleChannel' bottom: 'pw' "
+    "  top: 'shuffle' shuffle_channel_param { group: 2 } } "
+    "layer { name: 'sum' type: 'Eltwise' bottom: 'conv1' bottom: 'shuffle' "
+    "  top: 'sum' } "
+    "layer { name: 'pool' type: 'Pooling' bottom: 'sum' top: 'pool' "
+    "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } } "
+    "layer { name: 'concat' type: 'Concat' bottom: 'pool' bottom: 'pool' "
+    "  top: 'concat' } "
+    "layer { name: 'ip' type: 'InnerProduct' bottom: 'concat' top: 'ip' "
+    "  inner_product_param { num_output: 3 } } "
+    "layer { name: 'lrn' type: 'LRN' bottom: 'sum' top: 'lrn' } ";
+
+TYPED_TEST(ChannelsLastNetTest, TestConvertToChannelsLast) {
+  this->InitTrainedNet(kChannelsLastNetProto);
+  NetParameter converted_param;
+  // All but the data, InnerProduct and LRN layers, Splits included.
+  EXPECT_EQ(13, ConvertToChannelsLast(this->param_, &converted_param));
+  // A Transpose in front of conv1, the InnerProduct and the LRN layer.
+  int num_transposes = 0;
+  for (int i = 0; i < converted_param.layer_size(); ++i) {
+    num_transposes += converted_param.layer(i).type() == "Transpose";
+  }
+  EXPECT_EQ(3, num_transposes);
+  this->CheckConvertedNet(converted_param, "ip");
+  this->CheckConvertedNet(converted_param, "lrn");
+  // The net outputs are NCHW again; the other blobs have an NHWC version.
+  EXPECT_TRUE(Net<TypeParam>(converted_param).has_blob("concat_nhwc"));
+}
+
+TYPED_TEST(ChannelsLastNetTest, TestNetParameter) {
+  this->InitTrainedNet(kChannelsLastNetProto +
+      string("layer { name: 'out' type: 'Pooling' bottom: 'sum' top: 'out' "
+             "  pooling_param { pool: AVE global_pooling: true } } "));
+  NetParameter converted_param(this->param_);
+  converted_param.set_forward_only(true);
+  converted_param.set_channels_last(true);
+  this->CheckConvertedNet(converted_param, "out");
+}
+
+// Three MobileNet separable convolutions at 56x56x128.
+static string MobileNetBlocks() {
+  std::ostringstream proto;
+  proto << "layer { name: 'data' type: 'Input' top: 'b0' "
+        << "  input_param { shape { dim: 1 dim: 128 dim: 56 dim: 56 } } } ";
+  for (int i = 0; i < 3; ++i) {
+    const string bottom = "b" + format_int(i);
+    const string blobs[2] = { "dw" + format_int(i), "b" + format_int(i + 1) };
+    for (int j = 0; j < 2; ++j) {
+      const string& blob = blobs[j];
+      proto << "layer { name: '" << blob << "' bottom: '"
+            << (j == 0 ? bottom : blobs[0]) << "' top: '" << blob << "' "
+            << (j == 0 ? "type: 'ConvolutionDepthwise' "
+                         "convolution_param { kernel_size: 3 pad: 1 " :
+                         "type: 'Convolution' "
+                         "convolution_param { kernel_size: 1 pad: 0 ")
+            << "  num_output: 128 stride: 1 bias_term: false } } "
+            << "layer { name: '" << blob << "/bn' type: 'BatchNorm' "
+            << "  bottom: '" << blob << "' top: '" << blob << "' } "
+            << "layer { name: '" << blob << "/scale' type: 'Scale' "
+            << "  bottom: '" << blob << "' top: '" << blob << "' "
+            << "  scale_param { bias_term: true } } "
+            << "layer { name: '" << blob << "/relu' type: 'ReLU' "
+            << "  bottom: '" << blob << "' top: '" << blob << "' } ";
+    }
+  }
+  return proto.str();
+}
+
+// Three ShuffleNet units at 28x28x240 with 3 groups.
+static string ShuffleNetUnits() {
+  std::ostringstream proto;
+  proto << "layer { name: 'data' type: 'Input' top: 'u0' "
+        << "  input_param { shape { dim: 1 dim: 240 dim: 28 dim: 28 } } } ";
+  for (int i = 0; i < 3; ++i) {
+    const string u = "u" + format_int(i), next = "u" + format_int(i + 1);
+    proto << "layer { name: '" << u << "/gc1' type: 'Convolution' "
+          << "  bottom: '" << u << "' top: '" << u << "/gc1' "
+          << "  convolution_param { num_output: 60 kernel_size: 1 "
+          << "    group: 3 } } "
+          << "layer { name: '" << u << "/relu' type: 'ReLU' "
+          << "  bottom: '" << u << "/gc1' top: '" << u << "/gc1' } "
+          << "layer { name: '" << u << "/shuffle' type: 'ShuffleChannel' "
+          << "  bottom: '" << u << "/gc1' top: '" << u << "/shuffle' "
+          << "  shuffle_channel_param { group: 3 } } "
+          << "layer { name: '" << u << "/dw' type: 'ConvolutionDepthwise' "
+          << "  bottom: '" << u << "/shuffle' top: '" << u << "/dw' "
+          << "  convolution_param { num_output: 60 kernel_size: 3 pad: 1 "
+          << "    stride: 1 } } "
+          << "layer { name: '" << u << "/gc2' type: 'Convolution' "
+          << "  bottom: '" << u << "/dw' top: '" << u << "/gc2' "
+          << "  convolution_param { num_output: 240 kernel_size: 1 "
+          << "    group: 3 } } "
+          << "layer { name: '" << u << "/sum' type: 'Eltwise' "
+          << "  bottom: '" << u << "' bottom: '" << u << "/gc2' "
+          << "  top: '" << next << "' } ";
+  }
+  return proto.str();
+}
+
+// Time NCHW and NHWC inference of MobileNet and ShuffleNet blocks,
+// including the layout conversion of the input and the output.
+TEST(ChannelsLastBenchmark, DISABLED_TestBlocks) {
+  const string kBlocks[][2] = {
+    { "3 MobileNet 56x56x128 blocks", MobileNetBlocks() },
+    { "3 ShuffleNet 28x28x240 units", ShuffleNetUnits() },
+  };
+  const int kIterations = 10;
+  for (int b = 0; b < 2; ++b) {
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(kBlocks[b][1],
+                                                        &param));
+    param.set_forward_only(true);
+    param.mutable_state()->set_phase(TEST);
+    float ms[2];
+    for (int channels_last = 0; channels_last < 2; ++channels_last) {
+      param.set_channels_last(channels_last);
+      Net<float> net(param);
+      for (int i = 0; i < net.layers().size(); ++i) {
+        vector<shared_ptr<Blob<float> > >& blobs = net.layers()[i]->blobs();
+        for (int j = 0; j < blobs.size(); ++j) {
+          caffe_rng_uniform<float>(blobs[j]->count(), 0.5, 2,
+                                   blobs[j]->mutable_cpu_data());
+        }
+      }
+      caffe_rng_uniform<float>(net.input_blobs()[0]->count(), -1, 1,
+          net.input_blobs()[0]->mutable_cpu_data());
+      CPUTimer timer;
+      for (int i = 0; i <= kIterations; ++i) {
+        if (i == 1) {
+          timer.Start();
+        }
+        net.Forward();
+      }
+      ms[channels_last] = timer.MilliSeconds() / kIterations;
+    }
+    LOG(INFO) << kBlocks[b][0] << ": NCHW " << ms[0] << " ms, NHWC "
+              << ms[1] << " ms (" << ms[0] / ms[1] << "x)";
+  }
+}
+
+}  // namespace caffe
@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/concat_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -166,6 +167,45 @@ TYPED_TEST(ConcatLayerTest, TestForwardChannels) {
   }
 }
 
+TYPED_TEST(ConcatLayerTest, TestForwardChannelsViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  ConcatLayer<Dtype> layer(layer_param);
+  this->blob_bottom_0_->Reshape(1, 3, 6, 5);
+  this->blob_bottom_1_->Reshape(1, 5, 6, 5);
+  layer.SetUp(this->blob_bottom_vec_0_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_0_, this->blob_top_vec_);
+  // After the first pass the bottoms write straight into the top.
+  EXPECT_TRUE(this->blob_bottom_0_->DataIsViewOf(*this->blob_top_, 0));
+  EXPECT_TRUE(this->blob_bottom_1_->DataIsViewOf(*this->blob_top_,
+      this->blob_bottom_0_->count()));
+  caffe_set(this->blob_bottom_0_->count(), Dtype(4),
+            this->blob_bottom_0_->mutable_cpu_data());
+  caffe_set(this->blob_bottom_1_->count(), Dtype(5),
+            this->blob_bottom_1_->mutable_cpu_data());
+  layer.Forward(this->blob_bottom_vec_0_, this->blob_top_vec_);
+  const int count_0 = this->blob_bottom_0_->count();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_EQ(i < count_0 ? 4 : 5, this->blob_top_->cpu_data()[i]);
+  }
+  // Shrinking the first bottom moves the second one within the top.
+  this->blob_bottom_0_->Reshape(1, 2, 6, 5);
+  caffe_set(this->blob_bottom_0_->count(), Dtype(6),
+            this->blob_bottom_0_->mutable_cpu_data());
+  layer.Forward(this->blob_bottom_vec_0_, this->blob_top_vec_);
+  ASSERT_EQ(7, this->blob_top_->channels());
+  for (int c = 0; c < this->blob_top_->channels(); ++c) {
+    for (int h = 0; h < this->blob_top_->height(); ++h) {
+      for (int w = 0; w < this->blob_top_->width(); ++w) {
+        EXPECT_EQ(c < 2 ? 6 : 5, this->blob_top_->data_at(0, c, h, w));
+      }
+    }
+  }
+  EXPECT_TRUE(this->blob_bottom_1_->DataIsViewOf(*this->blob_top_,
+      this->blob_bottom_0_->count()));
+}
+
 TYPED_TEST(ConcatLayerTest, TestGradientTrivial) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
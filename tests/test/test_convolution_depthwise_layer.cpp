@@ -0,0 +1,127 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_dw_layer.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/cpu_info.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class ConvolutionDepthwiseLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  ConvolutionDepthwiseLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 3, 11, 37)),
+        blob_top_(new Blob<Dtype>()),
+        ref_blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    filler_param.set_std(1);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    ref_blob_top_vec_.push_back(ref_blob_top_);
+  }
+  virtual ~ConvolutionDepthwiseLayerTest() {
+    set_max_cpu_isa(CPU_ISA_AVX512);
+    delete blob_bottom_;
+    delete blob_top_;
+    delete ref_blob_top_;
+  }
+
+  void MakeParam(int kernel, int stride, int pad, int dilation,
+      LayerParameter* param) {
+    ConvolutionParameter* conv_param = param->mutable_convolution_param();
+    conv_param->add_kernel_size(kernel);
+    conv_param->add_stride(stride);
+    conv_param->add_pad(pad);
+    conv_param->add_dilation(dilation);
+    conv_param->set_num_output(blob_bottom_->channels());
+    conv_param->set_group(blob_bottom_->channels());
+    conv_param->mutable_weight_filler()->set_type("gaussian");
+    conv_param->mutable_bias_filler()->set_type("gaussian");
+  }
+
+  // Compare with a grouped ConvolutionLayer, with every CPU kernel.
+  void CheckAgainstConvolution(const LayerParameter& param) {
+    ConvolutionDepthwiseLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    ConvolutionLayer<Dtype> ref_layer(param);
+    ref_layer.SetUp(blob_bottom_vec_, ref_blob_top_vec_);
+    for (int i = 0; i < layer.blobs().size(); ++i) {
+      ref_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+    }
+    ref_layer.Forward(blob_bottom_vec_, ref_blob_top_vec_);
+    ASSERT_EQ(ref_blob_top_->shape(), blob_top_->shape());
+    const CpuIsa isas[] = { CPU_ISA_SCALAR, CPU_ISA_SSE2, CPU_ISA_AVX2 };
+    for (int i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+      set_max_cpu_isa(isas[i]);
+      caffe_set(blob_top_->count(), Dtype(0), blob_top_->mutable_cpu_data());
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      for (int j = 0; j < blob_top_->count(); ++j) {
+        EXPECT_NEAR(ref_blob_top_->cpu_data()[j], blob_top_->cpu_data()[j],
+                    1e-4) << cpu_isa_name(isas[i]);
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const ref_blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  vector<Blob<Dtype>*> ref_blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ConvolutionDepthwiseLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(ConvolutionDepthwiseLayerTest, Test3x3Stride1) {
+  LayerParameter layer_param;
+  this->MakeParam(3, 1, 1, 1, &layer_param);
+  this->CheckAgainstConvolution(layer_param);
+}
+
+TYPED_TEST(ConvolutionDepthwiseLayerTest, Test3x3Stride2) {
+  LayerParameter layer_param;
+  this->MakeParam(3, 2, 1, 1, &layer_param);
+  this->CheckAgainstConvolution(layer_param);
+  LayerParameter unpadded_param;
+  this->MakeParam(3, 2, 0, 1, &unpadded_param);
+  this->CheckAgainstConvolution(unpadded_param);
+}
+
+TYPED_TEST(ConvolutionDepthwiseLayerTest, TestGeneric) {
+  LayerParameter layer_param;
+  this->MakeParam(5, 1, 2, 1, &layer_param);
+  this->CheckAgainstConvolution(layer_param);
+  LayerParameter dilated_param;
+  this->MakeParam(3, 1, 2, 2, &dilated_param);
+  this->CheckAgainstConvolution(dilated_param);
+}
+
+TYPED_TEST(ConvolutionDepthwiseLayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_->Reshape(2, 3, 5, 6);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  this->MakeParam(3, 2, 1, 1, &layer_param);
+  ConvolutionDepthwiseLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+}  // namespace caffe
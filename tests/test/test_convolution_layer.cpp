@@ -6,6 +6,9 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/im2col.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -467,6 +470,34 @@ TYPED_TEST(ConvolutionLayerTest, Test1x1Convolution) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, Test1x1StridedConvolutionGroup) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(1);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Check against reference convolution.
+  const Dtype* top_data;
+  const Dtype* ref_top_data;
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  top_data = this->blob_top_->cpu_data();
+  ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionGroup) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -811,6 +842,109 @@ TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
       this->blob_top_vec_);
 }
 
+// A conv_col_buffer_kb of 1 makes tiles of one or two rows of the column
+// buffer, and two threads work on them at once.
+TYPED_TEST(ConvolutionLayerTest, TestTiledConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int col_buffer_kb = FLAGS_conv_col_buffer_kb;
+  FLAGS_conv_col_buffer_kb = 1;
+  Caffe::set_num_threads(2);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(-1);
+  FLAGS_conv_col_buffer_kb = col_buffer_kb;
+  // Check against reference convolution.
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestTiledGradientGroup) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int col_buffer_kb = FLAGS_conv_col_buffer_kb;
+  FLAGS_conv_col_buffer_kb = 1;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+  FLAGS_conv_col_buffer_kb = col_buffer_kb;
+}
+
+// Time the tiled Forward of a 3x3 convolution of a large feature map
+// against im2col of the whole image followed by a single GEMM.
+TEST(ConvolutionBenchmark, DISABLED_TestTiledForward) {
+  const int kChannels = 64;
+  const int kSize = 200;
+  const int kIterations = 3;
+  Blob<float> bottom(1, kChannels, kSize, kSize);
+  Blob<float> top;
+  caffe_rng_uniform<float>(bottom.count(), -1, 1, bottom.mutable_cpu_data());
+  vector<Blob<float>*> bottom_vec(1, &bottom), top_vec(1, &top);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(kChannels);
+  convolution_param->set_bias_term(false);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  ConvolutionLayer<float> layer(layer_param);
+  layer.SetUp(bottom_vec, top_vec);
+  Blob<float> col(1, kChannels * 9, kSize, kSize);
+  Blob<float> ref_top;
+  ref_top.ReshapeLike(top);
+  float ms[2];
+  for (int tiled = 0; tiled < 2; ++tiled) {
+    CPUTimer timer;
+    for (int i = 0; i <= kIterations; ++i) {
+      if (i == 1) {
+        timer.Start();
+      }
+      if (tiled) {
+        layer.Forward(bottom_vec, top_vec);
+      } else {
+        im2col_cpu(bottom.cpu_data(), kChannels, kSize, kSize, 3, 3, 1, 1, 1,
+                   1, 1, 1, col.mutable_cpu_data());
+        caffe_cpu_gemm<float>(CblasNoTrans, CblasNoTrans, kChannels,
+            kSize * kSize, kChannels * 9, 1., layer.blobs()[0]->cpu_data(),
+            col.cpu_data(), 0., ref_top.mutable_cpu_data());
+      }
+    }
+    ms[tiled] = timer.MilliSeconds() / kIterations;
+  }
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_NEAR(top.cpu_data()[i], ref_top.cpu_data()[i], 1e-3);
+  }
+  LOG(INFO) << kChannels << "x" << kSize << "x" << kSize << " 3x3: whole "
+            << col.count() * sizeof(float) / 1024 << " KB column buffer "
+            << ms[0] << " ms, tiled " << ms[1] << " ms (" << ms[0] / ms[1]
+            << "x)";
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -154,6 +156,26 @@ TYPED_TEST(DeconvolutionLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+// The gradient check again, through a column buffer of several tiles.
+TYPED_TEST(DeconvolutionLayerTest, TestTiledGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int col_buffer_kb = FLAGS_conv_col_buffer_kb;
+  FLAGS_conv_col_buffer_kb = 1;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  DeconvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+  FLAGS_conv_col_buffer_kb = col_buffer_kb;
+}
+
 TYPED_TEST(DeconvolutionLayerTest, TestNDAgainst2D) {
   typedef typename TypeParam::Dtype Dtype;
   const int kernel_h = 11;
@@ -255,14 +277,18 @@ TYPED_TEST(DeconvolutionLayerTest, TestNDAgainst2D) {
     backward_result_nd.CopyFrom(*this->blob_bottom_, copy_diff, reshape);
     backward_weight_result_nd.CopyFrom(weights, copy_diff, reshape);
   }
+  // The 2D column buffer goes in tiles, which sum in another order.
+  const Dtype kTolerance = 1e-4;
   ASSERT_EQ(result_nd.count(), result_2d.count());
   for (int i = 0; i < result_2d.count(); ++i)  {
-    EXPECT_EQ(result_2d.cpu_data()[i], result_nd.cpu_data()[i]);
+    EXPECT_NEAR(result_2d.cpu_data()[i], result_nd.cpu_data()[i],
+        kTolerance * std::max(Dtype(1), std::fabs(result_2d.cpu_data()[i])));
   }
   ASSERT_EQ(backward_result_nd.count(), backward_result_2d.count());
   for (int i = 0; i < backward_result_2d.count(); ++i) {
-    EXPECT_EQ(backward_result_2d.cpu_diff()[i],
-              backward_result_nd.cpu_diff()[i]);
+    EXPECT_NEAR(backward_result_2d.cpu_diff()[i],
+        backward_result_nd.cpu_diff()[i], kTolerance *
+        std::max(Dtype(1), std::fabs(backward_result_2d.cpu_diff()[i])));
   }
   ASSERT_EQ(backward_weight_result_nd.count(),
             backward_weight_result_2d.count());
@@ -0,0 +1,261 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/deformable_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+// Reference sample of the CUDA deformable_im2col: bilinear between the
+// pixels around (h, w), those past the last row or column replaced by it,
+// and 0 outside the plane.
+template <typename Dtype>
+Dtype reference_deformable_sample(const Dtype* plane, int height, int width,
+                                  Dtype h, Dtype w) {
+  if (h < 0 || w < 0 || h >= height || w >= width) {
+    return 0;
+  }
+  int h_low = std::floor(h);
+  int w_low = std::floor(w);
+  int h_high = h_low + 1;
+  int w_high = w_low + 1;
+  if (h_low >= height - 1) {
+    h_high = h_low = height - 1;
+    h = h_low;
+  }
+  if (w_low >= width - 1) {
+    w_high = w_low = width - 1;
+    w = w_low;
+  }
+  const Dtype lh = h - h_low;
+  const Dtype lw = w - w_low;
+  return (1 - lh) * (1 - lw) * plane[h_low * width + w_low] +
+      (1 - lh) * lw * plane[h_low * width + w_high] +
+      lh * (1 - lw) * plane[h_high * width + w_low] +
+      lh * lw * plane[h_high * width + w_high];
+}
+
+// Reference deformable convolution of stride 1 through explicit loops over
+// outputs, inputs and filter taps.
+template <typename Dtype>
+void caffe_deformable_conv(const Blob<Dtype>* in, const Blob<Dtype>* offset,
+    const DeformableConvolutionParameter& conv_param,
+    const vector<shared_ptr<Blob<Dtype> > >& weights, Blob<Dtype>* out) {
+  const int kernel = conv_param.kernel_size(0);
+  const int pad = conv_param.pad(0);
+  const int groups = conv_param.group();
+  const int deformable_groups = conv_param.deformable_group();
+  const int channels = in->channels();
+  const int height = in->height();
+  const int width = in->width();
+  const int group_channels = channels / groups;
+  const int group_outputs = out->channels() / groups;
+  const int deformable_channels = channels / deformable_groups;
+  for (int n = 0; n < out->num(); ++n) {
+    for (int o = 0; o < out->channels(); ++o) {
+      const int g = o / group_outputs;
+      for (int y = 0; y < out->height(); ++y) {
+        for (int x = 0; x < out->width(); ++x) {
+          Dtype value = conv_param.bias_term() ? weights[1]->cpu_data()[o] : 0;
+          for (int c = 0; c < group_channels; ++c) {
+            const int channel = g * group_channels + c;
+            const int dg = channel / deformable_channels;
+            for (int i = 0; i < kernel; ++i) {
+              for (int j = 0; j < kernel; ++j) {
+                const int tap = 2 * (dg * kernel * kernel + i * kernel + j);
+                const Dtype h = y - pad + i + offset->data_at(n, tap, y, x);
+                const Dtype w = x - pad + j + offset->data_at(n, tap + 1, y, x);
+                value += weights[0]->data_at(o, c, i, j) *
+                    reference_deformable_sample(
+                        in->cpu_data() + in->offset(n, channel), height,
+                        width, h, w);
+              }
+            }
+          }
+          out->mutable_cpu_data()[out->offset(n, o, y, x)] = value;
+        }
+      }
+    }
+  }
+}
+
+template <typename TypeParam>
+class DeformableConvolutionLayerTest : public CPUDeviceTest<TypeParam> {
+ protected:
+  typedef TypeParam Dtype;
+
+  DeformableConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 4, 6, 5)),
+        blob_bottom_offset_(new Blob<Dtype>()),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_offset_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~DeformableConvolutionLayerTest() {
+    delete blob_bottom_;
+    delete blob_bottom_offset_;
+    delete blob_top_;
+  }
+
+  // 3x3 offsets of deformable_groups groups within [-2, 2], whose fractions
+  // stay away from the kinks of bilinear sampling at whole pixels.
+  void FillOffsets(int deformable_groups) {
+    blob_bottom_offset_->Reshape(blob_bottom_->num(),
+        2 * 9 * deformable_groups, blob_bottom_->height(),
+        blob_bottom_->width());
+    Dtype* offset = blob_bottom_offset_->mutable_cpu_data();
+    caffe_rng_uniform<Dtype>(blob_bottom_offset_->count(), -2, 2, offset);
+    for (int i = 0; i < blob_bottom_offset_->count(); ++i) {
+      const Dtype fraction = offset[i] - std::floor(offset[i]);
+      offset[i] = std::floor(offset[i]) + 0.1 + 0.8 * fraction;
+    }
+  }
+
+  void SetUpParam(LayerParameter* layer_param, int group,
+                  int deformable_group) {
+    DeformableConvolutionParameter* conv_param =
+        layer_param->mutable_deformable_convolution_param();
+    conv_param->add_kernel_size(3);
+    conv_param->add_pad(1);
+    conv_param->set_num_output(4);
+    conv_param->set_group(group);
+    conv_param->set_deformable_group(deformable_group);
+    conv_param->mutable_weight_filler()->set_type("gaussian");
+    conv_param->mutable_bias_filler()->set_type("gaussian");
+  }
+
+  void CheckForward(const LayerParameter& layer_param,
+                    const vector<shared_ptr<Blob<Dtype> > >& weights) {
+    Blob<Dtype> ref_top;
+    ref_top.ReshapeLike(*blob_top_);
+    caffe_deformable_conv(blob_bottom_, blob_bottom_offset_,
+        layer_param.deformable_convolution_param(), weights, &ref_top);
+    for (int i = 0; i < blob_top_->count(); ++i) {
+      EXPECT_NEAR(ref_top.cpu_data()[i], blob_top_->cpu_data()[i], 1e-4);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_bottom_offset_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(DeformableConvolutionLayerTest, TestDtypes);
+
+// Without offsets, the layer is a regular convolution.
+TYPED_TEST(DeformableConvolutionLayerTest, TestZeroOffsets) {
+  typedef TypeParam Dtype;
+  this->FillOffsets(1);
+  caffe_set(this->blob_bottom_offset_->count(), Dtype(0),
+            this->blob_bottom_offset_->mutable_cpu_data());
+  LayerParameter layer_param;
+  this->SetUpParam(&layer_param, 1, 1);
+  DeformableConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(2, this->blob_top_->num());
+  EXPECT_EQ(4, this->blob_top_->channels());
+  EXPECT_EQ(6, this->blob_top_->height());
+  EXPECT_EQ(5, this->blob_top_->width());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  LayerParameter conv_layer_param;
+  ConvolutionParameter* convolution_param =
+      conv_layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  ConvolutionLayer<Dtype> conv_layer(conv_layer_param);
+  vector<Blob<Dtype>*> conv_bottom(1, this->blob_bottom_);
+  Blob<Dtype> conv_top;
+  vector<Blob<Dtype>*> conv_top_vec(1, &conv_top);
+  conv_layer.SetUp(conv_bottom, conv_top_vec);
+  conv_layer.blobs()[0]->CopyFrom(*layer.blobs()[0]);
+  conv_layer.blobs()[1]->CopyFrom(*layer.blobs()[1]);
+  conv_layer.Forward(conv_bottom, conv_top_vec);
+  for (int i = 0; i < conv_top.count(); ++i) {
+    EXPECT_NEAR(conv_top.cpu_data()[i], this->blob_top_->cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(DeformableConvolutionLayerTest, TestForward) {
+  typedef TypeParam Dtype;
+  this->FillOffsets(1);
+  LayerParameter layer_param;
+  this->SetUpParam(&layer_param, 1, 1);
+  Caffe::set_num_threads(3);
+  DeformableConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(-1);
+  this->CheckForward(layer_param, layer.blobs());
+}
+
+// A column buffer of 1 KB makes a tile per output row, shared out between
+// two threads.
+TYPED_TEST(DeformableConvolutionLayerTest, TestTiledForwardGroup) {
+  typedef TypeParam Dtype;
+  const int col_buffer_kb = FLAGS_conv_col_buffer_kb;
+  FLAGS_conv_col_buffer_kb = 1;
+  Caffe::set_num_threads(2);
+  this->FillOffsets(2);
+  LayerParameter layer_param;
+  this->SetUpParam(&layer_param, 2, 2);
+  DeformableConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(-1);
+  FLAGS_conv_col_buffer_kb = col_buffer_kb;
+  this->CheckForward(layer_param, layer.blobs());
+}
+
+TYPED_TEST(DeformableConvolutionLayerTest, TestGradient) {
+  typedef TypeParam Dtype;
+  this->blob_bottom_->Reshape(1, 2, 4, 4);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  this->FillOffsets(1);
+  LayerParameter layer_param;
+  this->SetUpParam(&layer_param, 1, 1);
+  layer_param.mutable_deformable_convolution_param()->set_num_output(2);
+  DeformableConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-3, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(DeformableConvolutionLayerTest, TestTiledGradientGroup) {
+  typedef TypeParam Dtype;
+  const int col_buffer_kb = FLAGS_conv_col_buffer_kb;
+  FLAGS_conv_col_buffer_kb = 1;
+  this->blob_bottom_->Reshape(1, 4, 4, 3);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  this->FillOffsets(2);
+  LayerParameter layer_param;
+  this->SetUpParam(&layer_param, 2, 2);
+  layer_param.mutable_deformable_convolution_param()->set_num_output(2);
+  DeformableConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-3, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+  FLAGS_conv_col_buffer_kb = col_buffer_kb;
+}
+
+}  // namespace caffe
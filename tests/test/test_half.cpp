@@ -0,0 +1,365 @@
+#include <cmath>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/blocked_gemm.hpp"
+#include "caffe/util/cpu_info.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/inference_optimizer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HalfTest : public ::testing::Test {
+ protected:
+  virtual ~HalfTest() {
+    set_max_cpu_isa(CPU_ISA_AVX512);
+  }
+};
+
+TEST_F(HalfTest, TestFloat16Values) {
+  const float inf = std::numeric_limits<float>::infinity();
+  const float values[] = { 0.f, -0.f, 1.f, -2.f, 65504.f, 65519.f, 65520.f,
+      inf, -inf, std::ldexp(1.f, -14), std::ldexp(1.f, -24),
+      std::ldexp(1.f, -25), std::ldexp(3.f, -25), std::ldexp(5.f, -25),
+      1.f + std::ldexp(1.f, -11), 1.f + std::ldexp(3.f, -11) };
+  const uint16_t bits[] = { 0x0000, 0x8000, 0x3c00, 0xc000, 0x7bff, 0x7bff,
+      0x7c00, 0x7c00, 0xfc00, 0x0400, 0x0001, 0x0000, 0x0002, 0x0002,
+      0x3c00, 0x3c02 };
+  for (int i = 0; i < sizeof(bits) / sizeof(bits[0]); ++i) {
+    EXPECT_EQ(bits[i], float_to_half(values[i], HALF_FLOAT16)) << values[i];
+  }
+  EXPECT_EQ(0x7e00, float_to_half(std::nanf(""), HALF_FLOAT16) & 0x7e00);
+  EXPECT_TRUE(std::isnan(half_to_float(0x7e00, HALF_FLOAT16)));
+}
+
+TEST_F(HalfTest, TestBfloat16Values) {
+  const float values[] = { 1.f, -2.f, 1.f + std::ldexp(1.f, -8),
+      1.f + std::ldexp(3.f, -8), 3e38f };
+  const uint16_t bits[] = { 0x3f80, 0xc000, 0x3f80, 0x3f82, 0x7f62 };
+  for (int i = 0; i < sizeof(bits) / sizeof(bits[0]); ++i) {
+    EXPECT_EQ(bits[i], float_to_half(values[i], HALF_BFLOAT16)) << values[i];
+  }
+  EXPECT_TRUE(std::isnan(half_to_float(
+      float_to_half(std::nanf(""), HALF_BFLOAT16), HALF_BFLOAT16)));
+}
+
+// Every 16-bit value widens exactly and narrows back to itself.
+TEST_F(HalfTest, TestRoundTrip) {
+  const HalfFormat formats[] = { HALF_FLOAT16, HALF_BFLOAT16 };
+  for (int f = 0; f < 2; ++f) {
+    for (int h = 0; h < 65536; ++h) {
+      const float x = half_to_float(h, formats[f]);
+      if (!std::isnan(x)) {
+        ASSERT_EQ(h, float_to_half(x, formats[f])) << f;
+      }
+    }
+  }
+}
+
+TEST_F(HalfTest, TestVectorMatchesScalar) {
+  const int n = 1031;
+  vector<float> x(n);
+  caffe_rng_uniform<float>(n, -1, 1, x.data());
+  for (int i = 0; i < n; ++i) {
+    x[i] = std::ldexp(x[i], i % 60 - 30);
+  }
+  x[0] = std::numeric_limits<float>::infinity();
+  x[1] = std::nanf("");
+  x[2] = 1e-30f;
+  const HalfFormat formats[] = { HALF_FLOAT16, HALF_BFLOAT16 };
+  const CpuIsa isas[] = { CPU_ISA_SCALAR, CPU_ISA_AVX2 };
+  for (int f = 0; f < 2; ++f) {
+    for (int i = 0; i < 2; ++i) {
+      set_max_cpu_isa(isas[i]);
+      vector<uint16_t> half(n);
+      vector<float> widened(n);
+      caffe_cpu_float_to_half(n, x.data(), half.data(), formats[f]);
+      caffe_cpu_half_to_float(n, half.data(), widened.data(), formats[f]);
+      for (int j = 0; j < n; ++j) {
+        const uint16_t expected = float_to_half(x[j], formats[f]);
+        if (std::isnan(x[j])) {
+          EXPECT_TRUE(std::isnan(widened[j]));
+          continue;
+        }
+        ASSERT_EQ(expected, half[j]) << x[j];
+        ASSERT_EQ(half_to_float(expected, formats[f]), widened[j]);
+      }
+    }
+  }
+}
+
+TEST_F(HalfTest, TestSyncedMemory) {
+  const int count = 10;
+  SyncedMemory mem(count * sizeof(float));
+  float* data = static_cast<float*>(mem.mutable_cpu_data());
+  for (int i = 0; i < count; ++i) {
+    data[i] = 1.f / (i + 1);
+  }
+  EXPECT_TRUE(mem.half_data() == NULL);
+  const size_t version = mem.version();
+  mem.to_half(HALF_FLOAT16);
+  EXPECT_NE(version, mem.version());
+  ASSERT_TRUE(mem.half_data() != NULL);
+  EXPECT_EQ(HALF_FLOAT16, mem.half_format());
+  // Reading widens the values, and keeps the 16-bit copy.
+  const float* widened = static_cast<const float*>(mem.cpu_data());
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(half_to_float(mem.half_data()[i], HALF_FLOAT16), widened[i]);
+    EXPECT_NEAR(1.f / (i + 1), widened[i], 1e-3);
+  }
+  // Writing drops it.
+  mem.mutable_cpu_data();
+  EXPECT_TRUE(mem.half_data() == NULL);
+}
+
+TEST_F(HalfTest, TestConcurrentWiden) {
+  // Sessions sharing half weights read them from several threads at once;
+  // each must get the one widened buffer, filled.
+  const int count = 4096;
+  const int num_threads = 4;
+  Blob<float> blob(vector<int>(1, count));
+  for (int round = 0; round < 20; ++round) {
+    float* data = blob.mutable_cpu_data();
+    for (int i = 0; i < count; ++i) {
+      data[i] = round + i % 8;
+    }
+    blob.StoreDataAsHalf(HALF_FLOAT16);
+    vector<const float*> ptrs(num_threads);
+    vector<int> mismatches(num_threads, 0);
+    vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+      threads.push_back(std::thread([&blob, &ptrs, &mismatches, t, round]() {
+        const float* widened = blob.cpu_data();
+        ptrs[t] = widened;
+        for (int i = 0; i < count; ++i) {
+          mismatches[t] += widened[i] != round + i % 8;
+        }
+      }));
+    }
+    for (int t = 0; t < num_threads; ++t) {
+      threads[t].join();
+    }
+    for (int t = 0; t < num_threads; ++t) {
+      EXPECT_EQ(ptrs[0], ptrs[t]);
+      EXPECT_EQ(0, mismatches[t]) << "round " << round;
+    }
+  }
+}
+
+TEST_F(HalfTest, TestBlobProto) {
+  vector<int> shape(2, 5);
+  Blob<float> blob(shape);
+  caffe_rng_uniform<float>(blob.count(), -4, 4, blob.mutable_cpu_data());
+  blob.StoreDataAsHalf(HALF_BFLOAT16);
+  ASSERT_TRUE(blob.half_data() != NULL);
+  BlobProto proto;
+  blob.ToProto(&proto);
+  EXPECT_EQ(0, proto.data_size());
+  EXPECT_EQ(blob.count() * sizeof(uint16_t), proto.half_data().size());
+  EXPECT_EQ(BlobProto_HalfFormat_BFLOAT16, proto.half_format());
+
+  Blob<float> loaded;
+  loaded.FromProto(proto);
+  ASSERT_TRUE(loaded.half_data() != NULL);
+  EXPECT_EQ(HALF_BFLOAT16, loaded.data()->half_format());
+  Blob<double> loaded_double;
+  loaded_double.FromProto(proto);
+  EXPECT_TRUE(loaded_double.half_data() == NULL);
+  for (int i = 0; i < blob.count(); ++i) {
+    EXPECT_EQ(blob.cpu_data()[i], loaded.cpu_data()[i]);
+    EXPECT_EQ(blob.cpu_data()[i], loaded_double.cpu_data()[i]);
+  }
+}
+
+// A GEMM with a 16-bit operand matches the one with the widened operand.
+TEST_F(HalfTest, TestGemm) {
+  const int M = 23, N = 41, K = 300;
+  vector<float> A(M * K), B(K * N), C(M * N), expected(M * N);
+  vector<uint16_t> A_half(M * K), B_half(K * N);
+  caffe_rng_uniform<float>(M * K, -1, 1, A.data());
+  caffe_rng_uniform<float>(K * N, -1, 1, B.data());
+  caffe_cpu_float_to_half(M * K, A.data(), A_half.data(), HALF_FLOAT16);
+  caffe_cpu_float_to_half(K * N, B.data(), B_half.data(), HALF_FLOAT16);
+  caffe_cpu_half_to_float(M * K, A_half.data(), A.data(), HALF_FLOAT16);
+  caffe_cpu_half_to_float(K * N, B_half.data(), B.data(), HALF_FLOAT16);
+  const CBLAS_TRANSPOSE trans[] = { CblasNoTrans, CblasTrans };
+  for (int ta = 0; ta < 2; ++ta) {
+    for (int tb = 0; tb < 2; ++tb) {
+      caffe_cpu_blocked_gemm<float>(trans[ta], trans[tb], M, N, K, 1,
+          A.data(), B.data(), 0, expected.data());
+      PackedMatrix<float> packed_a, packed_b;
+      packed_a.PackA(trans[ta], M, K, A_half.data(), HALF_FLOAT16);
+      packed_b.PackB(trans[tb], K, N, B_half.data(), HALF_FLOAT16);
+      for (int mode = 0; mode < 4; ++mode) {
+        if (mode == 0) {
+          caffe_cpu_blocked_gemm<float>(trans[ta], trans[tb], M, N, K, 1,
+              A_half.data(), HALF_FLOAT16, B.data(), 0, C.data());
+        } else if (mode == 1) {
+          caffe_cpu_blocked_gemm<float>(trans[ta], trans[tb], M, N, K, 1,
+              A.data(), B_half.data(), HALF_FLOAT16, 0, C.data());
+        } else if (mode == 2) {
+          caffe_cpu_blocked_gemm<float>(packed_a, trans[tb], N, 1, B.data(),
+              0, C.data());
+        } else {
+          caffe_cpu_blocked_gemm<float>(trans[ta], M, 1, A.data(), packed_b,
+              0, C.data());
+        }
+        for (int i = 0; i < M * N; ++i) {
+          ASSERT_NEAR(expected[i], C[i], 1e-4) << ta << tb << mode;
+        }
+      }
+    }
+  }
+}
+
+// Layers with weights held in 16 bits match the same layers with the
+// widened weights, with and without prepacking.
+class HalfLayerTest : public CPUDeviceTest<float> {
+ protected:
+  HalfLayerTest()
+      : blob_bottom_(new Blob<float>(2, 8, 9, 11)),
+        blob_top_(new Blob<float>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<float> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~HalfLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  void CheckHalf(Layer<float>* layer, Layer<float>* float_layer) {
+    layer->SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer->blobs()[0]->StoreDataAsHalf(HALF_FLOAT16);
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    Blob<float> actual;
+    actual.CopyFrom(*blob_top_, false, true);
+    layer->PrepackWeights();
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    Blob<float> prepacked;
+    prepacked.CopyFrom(*blob_top_, false, true);
+    EXPECT_TRUE(layer->blobs()[0]->half_data() != NULL);
+
+    float_layer->SetUp(blob_bottom_vec_, blob_top_vec_);
+    for (int i = 0; i < layer->blobs().size(); ++i) {
+      float_layer->blobs()[i]->CopyFrom(*layer->blobs()[i]);
+    }
+    float_layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    for (int i = 0; i < blob_top_->count(); ++i) {
+      EXPECT_NEAR(blob_top_->cpu_data()[i], actual.cpu_data()[i], 1e-4);
+      EXPECT_NEAR(blob_top_->cpu_data()[i], prepacked.cpu_data()[i], 1e-4);
+    }
+  }
+
+  Blob<float>* const blob_bottom_;
+  Blob<float>* const blob_top_;
+  vector<Blob<float>*> blob_bottom_vec_;
+  vector<Blob<float>*> blob_top_vec_;
+};
+
+TEST_F(HalfLayerTest, TestInnerProduct) {
+  LayerParameter layer_param;
+  InnerProductParameter* ip_param = layer_param.mutable_inner_product_param();
+  ip_param->set_num_output(37);
+  ip_param->mutable_weight_filler()->set_type("gaussian");
+  ip_param->mutable_bias_filler()->set_type("gaussian");
+  InnerProductLayer<float> layer(layer_param);
+  InnerProductLayer<float> float_layer(layer_param);
+  CheckHalf(&layer, &float_layer);
+}
+
+TEST_F(HalfLayerTest, TestConvolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* conv_param = layer_param.mutable_convolution_param();
+  conv_param->add_kernel_size(3);
+  conv_param->add_pad(1);
+  conv_param->set_num_output(12);
+  conv_param->set_group(2);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  conv_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<float> layer(layer_param);
+  ConvolutionLayer<float> float_layer(layer_param);
+  CheckHalf(&layer, &float_layer);
+}
+
+TEST_F(HalfLayerTest, TestPointwiseConvolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* conv_param = layer_param.mutable_convolution_param();
+  conv_param->add_kernel_size(1);
+  conv_param->set_num_output(16);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  conv_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<float> layer(layer_param);
+  ConvolutionLayer<float> float_layer(layer_param);
+  CheckHalf(&layer, &float_layer);
+}
+
+// A net loaded from weights stored by StoreWeightsAsHalf keeps them in 16
+// bits and stays close to the float net.
+TEST_F(HalfLayerTest, TestStoreWeightsAsHalf) {
+  const string proto =
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 4 dim: 3 dim: 12 dim: 12 } } } "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+      "  convolution_param { num_output: 8 kernel_size: 3 "
+      "  weight_filler { type: 'xavier' } } } "
+      "layer { name: 'bn' type: 'BatchNorm' bottom: 'conv' top: 'conv' } "
+      "layer { name: 'fc' type: 'InnerProduct' bottom: 'conv' top: 'fc' "
+      "  inner_product_param { num_output: 10 "
+      "  weight_filler { type: 'xavier' } } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.mutable_state()->set_phase(TEST);
+  Net<float> float_net(param);
+  NetParameter trained;
+  float_net.ToProto(&trained);
+  NetParameter half_trained;
+  EXPECT_EQ(2, StoreWeightsAsHalf(trained, HALF_BFLOAT16, &half_trained));
+  EXPECT_FALSE(half_trained.layer(1).blobs(0).half_data().empty());
+  EXPECT_EQ(0, half_trained.layer(1).blobs(0).data_size());
+  EXPECT_TRUE(half_trained.layer(2).blobs(0).half_data().empty());
+
+  Net<float> half_net(param);
+  half_net.CopyTrainedLayersFrom(half_trained);
+  EXPECT_TRUE(half_net.layer_by_name("conv")->blobs()[0]->half_data() != NULL);
+  EXPECT_TRUE(half_net.layer_by_name("fc")->blobs()[0]->half_data() != NULL);
+  FillerParameter filler_param;
+  GaussianFiller<float> filler(filler_param);
+  filler.Fill(float_net.input_blobs()[0]);
+  half_net.input_blobs()[0]->CopyFrom(*float_net.input_blobs()[0]);
+  const Blob<float>& expected = *float_net.Forward()[0];
+  const Blob<float>& actual = *half_net.Forward()[0];
+  double error = 0;
+  double norm = 0;
+  for (int i = 0; i < expected.count(); ++i) {
+    error += (actual.cpu_data()[i] - expected.cpu_data()[i]) *
+             (actual.cpu_data()[i] - expected.cpu_data()[i]);
+    norm += expected.cpu_data()[i] * expected.cpu_data()[i];
+  }
+  EXPECT_LT(std::sqrt(error / norm), 0.02);
+  // Saving keeps the 16-bit weights.
+  NetParameter saved;
+  half_net.ToProto(&saved);
+  EXPECT_EQ(half_trained.layer(1).blobs(0).half_data(),
+            saved.layer(1).blobs(0).half_data());
+}
+
+}  // namespace caffe
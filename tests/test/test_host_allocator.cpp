@@ -0,0 +1,91 @@
+#include <cstring>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/host_allocator.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HostAllocatorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    HostAllocator::set_enabled(true);
+    HostAllocator::Trim();
+  }
+  virtual void TearDown() {
+    HostAllocator::set_enabled(true);
+  }
+};
+
+TEST_F(HostAllocatorTest, TestAlignment) {
+  const size_t sizes[] = { 0, 1, 63, 64, 65, 100, 1000, 4097, 1 << 20 };
+  for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    void* ptr = HostAllocator::Allocate(sizes[i]);
+    ASSERT_TRUE(ptr);
+    EXPECT_EQ(0, reinterpret_cast<size_t>(ptr) % HostAllocator::kAlignment);
+    memset(ptr, 1, sizes[i]);
+    HostAllocator::Deallocate(ptr, sizes[i]);
+  }
+}
+
+TEST_F(HostAllocatorTest, TestReuse) {
+  const HostAllocator::Stats before = HostAllocator::stats();
+  void* ptr = HostAllocator::Allocate(1000);
+  const HostAllocator::Stats allocated = HostAllocator::stats();
+  EXPECT_EQ(before.num_hits, allocated.num_hits);
+  // 1000 bytes fall in the 1024 byte class.
+  EXPECT_EQ(before.bytes_live + 1024, allocated.bytes_live);
+  EXPECT_GE(allocated.peak_bytes_live, allocated.bytes_live);
+  HostAllocator::Deallocate(ptr, 1000);
+  EXPECT_EQ(before.bytes_live, HostAllocator::stats().bytes_live);
+  EXPECT_EQ(before.bytes_cached + 1024, HostAllocator::stats().bytes_cached);
+  // Any size of the same class gets the cached block back.
+  void* again = HostAllocator::Allocate(900);
+  EXPECT_EQ(ptr, again);
+  const HostAllocator::Stats reused = HostAllocator::stats();
+  EXPECT_EQ(before.num_hits + 1, reused.num_hits);
+  EXPECT_EQ(before.num_allocs + 2, reused.num_allocs);
+  EXPECT_GT(reused.hit_rate, 0);
+  HostAllocator::Deallocate(again, 900);
+  HostAllocator::Trim();
+  EXPECT_EQ(0, HostAllocator::stats().bytes_cached);
+}
+
+TEST_F(HostAllocatorTest, TestThreadExit) {
+  void* ptr = NULL;
+  std::thread thread([&ptr]() {
+    ptr = HostAllocator::Allocate(5000);
+    HostAllocator::Deallocate(ptr, 5000);
+  });
+  thread.join();
+  // The block cached by the finished thread moved to the shared cache.
+  const size_t num_hits = HostAllocator::stats().num_hits;
+  void* again = HostAllocator::Allocate(5000);
+  EXPECT_EQ(ptr, again);
+  EXPECT_EQ(num_hits + 1, HostAllocator::stats().num_hits);
+  HostAllocator::Deallocate(again, 5000);
+}
+
+TEST_F(HostAllocatorTest, TestSyncedMemory) {
+  const size_t num_allocs = HostAllocator::stats().num_allocs;
+  {
+    SyncedMemory mem(1000);
+    mem.mutable_cpu_data();
+    EXPECT_EQ(num_allocs + 1, HostAllocator::stats().num_allocs);
+    // Blocks are freed the way they were allocated.
+    HostAllocator::set_enabled(false);
+  }
+  {
+    SyncedMemory mem(1000);
+    mem.mutable_cpu_data();
+    HostAllocator::set_enabled(true);
+  }
+  EXPECT_EQ(num_allocs + 1, HostAllocator::stats().num_allocs);
+}
+
+}  // namespace caffe
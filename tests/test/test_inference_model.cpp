@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/inference_model.hpp"
+#include "caffe/net.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class InferenceModelTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  virtual void SetUp() {
+    const string& proto =
+        "name: 'SessionNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape: { dim: 2 dim: 3 dim: 6 dim: 5 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'conv' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+    param_.mutable_state()->set_phase(TEST);
+    model_.reset(new InferenceModel<Dtype>(param_, ""));
+  }
+
+  void FillInput(Net<Dtype>* net, const int num, const Dtype offset) {
+    Blob<Dtype>* input = net->input_blobs()[0];
+    input->Reshape(num, 3, 6, 5);
+    net->Reshape();
+    for (int i = 0; i < input->count(); ++i) {
+      input->mutable_cpu_data()[i] = Dtype(i % 13) / 6 - 1 + offset;
+    }
+  }
+
+  NetParameter param_;
+  shared_ptr<InferenceModel<Dtype> > model_;
+};
+
+TYPED_TEST_CASE(InferenceModelTest, TestDtypesAndDevices);
+
+TYPED_TEST(InferenceModelTest, TestSessionsShareWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  shared_ptr<Net<Dtype> > session = this->model_->NewSession();
+  EXPECT_TRUE(session->forward_only());
+  const Net<Dtype>& net = this->model_->net();
+  ASSERT_EQ(net.layers().size(), session->layers().size());
+  for (int i = 0; i < net.layers().size(); ++i) {
+    const vector<shared_ptr<Blob<Dtype> > >& blobs = net.layers()[i]->blobs();
+    ASSERT_EQ(blobs.size(), session->layers()[i]->blobs().size());
+    for (int j = 0; j < blobs.size(); ++j) {
+      EXPECT_EQ(blobs[j]->data(), session->layers()[i]->blobs()[j]->data());
+    }
+  }
+  // Activations are per session.
+  shared_ptr<Net<Dtype> > other = this->model_->NewSession();
+  EXPECT_NE(session->blob_by_name("conv")->data(),
+            other->blob_by_name("conv")->data());
+}
+
+TYPED_TEST(InferenceModelTest, TestSessionsForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A net sharing the weights the way ShareTrainedLayersWith does.
+  Net<Dtype> reference(this->param_);
+  reference.ShareTrainedLayersWith(&this->model_->net());
+  this->FillInput(&reference, 2, 0);
+  const Blob<Dtype>* expected = reference.Forward()[0];
+  shared_ptr<Net<Dtype> > session = this->model_->NewSession();
+  shared_ptr<Net<Dtype> > other = this->model_->NewSession();
+  this->FillInput(session.get(), 2, 0);
+  const Blob<Dtype>* output = session->Forward()[0];
+  // Running another session at another shape leaves the first one alone.
+  this->FillInput(other.get(), 1, 0.5);
+  other->Forward();
+  ASSERT_EQ(expected->count(), output->count());
+  for (int i = 0; i < expected->count(); ++i) {
+    EXPECT_NEAR(expected->cpu_data()[i], output->cpu_data()[i], 1e-5);
+  }
+}
+
+TYPED_TEST(InferenceModelTest, TestConcurrentSessions) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int num_threads = 4;
+  const int num_iters = 5;
+  vector<shared_ptr<Net<Dtype> > > sessions;
+  vector<shared_ptr<Blob<Dtype> > > expected;
+  for (int t = 0; t < num_threads; ++t) {
+    sessions.push_back(this->model_->NewSession());
+    this->FillInput(sessions[t].get(), t + 1, Dtype(t) / 4);
+    expected.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    expected[t]->CopyFrom(*sessions[t]->Forward()[0], false, true);
+  }
+  vector<Dtype> max_error(num_threads, 0);
+  const Caffe::Brew mode = Caffe::mode();
+  vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.push_back(std::thread([&, t]() {
+      Caffe::set_mode(mode);
+      for (int iter = 0; iter < num_iters; ++iter) {
+        const Blob<Dtype>* output = sessions[t]->Forward()[0];
+        for (int i = 0; i < output->count(); ++i) {
+          max_error[t] = std::max(max_error[t], std::abs(
+              output->cpu_data()[i] - expected[t]->cpu_data()[i]));
+        }
+      }
+    }));
+  }
+  for (int t = 0; t < num_threads; ++t) {
+    threads[t].join();
+    EXPECT_LT(max_error[t], 1e-5);
+  }
+}
+
+}  // namespace caffe
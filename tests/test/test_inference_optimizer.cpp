@@ -0,0 +1,200 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/inference_optimizer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class InferenceOptimizerTest : public ::testing::Test {
+ protected:
+  InferenceOptimizerTest() : seed_(1701) {}
+
+  // Build a net from proto with random weights and statistics, and merge
+  // the trained blobs back into param_.
+  void InitTrainedNet(const string& proto) {
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+    Caffe::set_random_seed(seed_);
+    net_.reset(new Net<Dtype>(param_));
+    FillerParameter filler_param;
+    filler_param.set_std(0.5);
+    GaussianFiller<Dtype> filler(filler_param);
+    for (int i = 0; i < net_->layers().size(); ++i) {
+      if (net_->layers()[i]->type() != string("BatchNorm")) { continue; }
+      vector<shared_ptr<Blob<Dtype> > >& blobs = net_->layers()[i]->blobs();
+      filler.Fill(blobs[0].get());
+      caffe_rng_uniform<Dtype>(blobs[1]->count(), 0.5, 2,
+          blobs[1]->mutable_cpu_data());
+      blobs[2]->mutable_cpu_data()[0] = 2;
+    }
+    filler.Fill(net_->input_blobs()[0]);
+    NetParameter trained_param;
+    net_->ToProto(&trained_param);
+    CopyTrainedLayerBlobs(trained_param, &param_);
+  }
+
+  // Check that the folded net computes the same top as the original one.
+  void CheckFoldedNet(const string& blob_name) {
+    NetParameter folded_param;
+    FoldBatchNormLayers(param_, &folded_param);
+    CheckOptimizedNet(folded_param, blob_name);
+  }
+
+  void CheckOptimizedNet(const NetParameter& optimized_param,
+      const string& blob_name) {
+    Net<Dtype> folded_net(optimized_param);
+    folded_net.input_blobs()[0]->CopyFrom(*net_->input_blobs()[0]);
+    net_->Forward();
+    folded_net.Forward();
+    const Blob<Dtype>* expected = net_->blob_by_name(blob_name).get();
+    const Blob<Dtype>* actual = folded_net.blob_by_name(blob_name).get();
+    ASSERT_TRUE(actual != NULL);
+    ASSERT_EQ(expected->shape(), actual->shape());
+    for (int i = 0; i < expected->count(); ++i) {
+      EXPECT_NEAR(expected->cpu_data()[i], actual->cpu_data()[i], 1e-4);
+    }
+  }
+
+  int seed_;
+  NetParameter param_;
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(InferenceOptimizerTest, TestDtypes);
+
+const char* kFoldableNetProto =
+    "layer { name: 'data' type: 'Input' top: 'data' "
+    "  input_param { shape { dim: 2 dim: 3 dim: 5 dim: 5 } } } "
+    "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+    "  convolution_param { num_output: 4 kernel_size: 3 bias_term: false "
+    "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+    "layer { name: 'bn' type: 'BatchNorm' bottom: 'conv' top: 'conv' } "
+    "layer { name: 'scale' type: 'Scale' bottom: 'conv' top: 'conv' "
+    "  scale_param { bias_term: true filler { type: 'gaussian' mean: 1 } "
+    "    bias_filler { type: 'gaussian' } } } "
+    "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' } "
+    "layer { name: 'ip' type: 'InnerProduct' bottom: 'conv' top: 'ip' "
+    "  inner_product_param { num_output: 3 transpose: true "
+    "    weight_filler { type: 'gaussian' std: 0.5 } "
+    "    bias_filler { type: 'gaussian' } } } "
+    "layer { name: 'ip_bn' type: 'BatchNorm' bottom: 'ip' top: 'ip_bn' } "
+    "layer { name: 'bias' type: 'Bias' bottom: 'ip_bn' top: 'out' "
+    "  bias_param { filler { type: 'gaussian' } } } ";
+
+TYPED_TEST(InferenceOptimizerTest, TestFoldBatchNorm) {
+  this->InitTrainedNet(kFoldableNetProto);
+  NetParameter folded_param;
+  EXPECT_EQ(4, FoldBatchNormLayers(this->param_, &folded_param));
+  ASSERT_EQ(4, folded_param.layer_size());
+  EXPECT_EQ("data", folded_param.layer(0).name());
+  EXPECT_EQ("conv", folded_param.layer(1).name());
+  EXPECT_TRUE(folded_param.layer(1).convolution_param().bias_term());
+  EXPECT_EQ(2, folded_param.layer(1).blobs_size());
+  EXPECT_EQ("relu", folded_param.layer(2).name());
+  EXPECT_EQ("ip", folded_param.layer(3).name());
+  EXPECT_EQ("out", folded_param.layer(3).top(0));
+  this->CheckFoldedNet("out");
+}
+
+TYPED_TEST(InferenceOptimizerTest, TestFoldBatchNormSharedTop) {
+  // The BatchNorm may not be folded while another layer reads the raw
+  // convolution output.
+  const string proto =
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 5 dim: 5 } } } "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+      "  convolution_param { num_output: 4 kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+      "layer { name: 'bn' type: 'BatchNorm' bottom: 'conv' top: 'bn' } "
+      "layer { name: 'sum' type: 'Eltwise' bottom: 'conv' bottom: 'bn' "
+      "  top: 'sum' } ";
+  this->InitTrainedNet(proto);
+  NetParameter folded_param;
+  EXPECT_EQ(0, FoldBatchNormLayers(this->param_, &folded_param));
+  this->CheckFoldedNet("sum");
+}
+
+const char* kFusableNetProto =
+    "layer { name: 'data' type: 'Input' top: 'data' "
+    "  input_param { shape { dim: 2 dim: 3 dim: 5 dim: 5 } } } "
+    "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+    "  convolution_param { num_output: 4 kernel_size: 3 "
+    "    weight_filler { type: 'gaussian' std: 0.5 } "
+    "    bias_filler { type: 'gaussian' } } } "
+    "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' "
+    "  relu_param { negative_slope: 0.1 } } "
+    "layer { name: 'conv2' type: 'Convolution' bottom: 'conv' top: 'conv2' "
+    "  convolution_param { num_output: 4 kernel_size: 1 bias_term: false "
+    "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+    "layer { name: 'prelu' type: 'PReLU' bottom: 'conv2' top: 'prelu' "
+    "  prelu_param { filler { type: 'gaussian' } } } "
+    "layer { name: 'conv3' type: 'Convolution' bottom: 'prelu' top: 'conv3' "
+    "  convolution_param { num_output: 2 kernel_size: 1 "
+    "    weight_filler { type: 'gaussian' std: 0.5 } "
+    "    bias_filler { type: 'gaussian' } } } "
+    "layer { name: 'relux' type: 'ReLUX' bottom: 'conv3' top: 'conv3' "
+    "  relux_param { maximal_value: 0.5 } } "
+    "layer { name: 'ip' type: 'InnerProduct' bottom: 'conv3' top: 'ip' "
+    "  inner_product_param { num_output: 5 "
+    "    weight_filler { type: 'gaussian' std: 0.5 } "
+    "    bias_filler { type: 'gaussian' } } } "
+    "layer { name: 'elu' type: 'ELU' bottom: 'ip' top: 'ip' } "
+    "layer { name: 'ip2' type: 'InnerProduct' bottom: 'ip' top: 'ip2' "
+    "  inner_product_param { num_output: 3 bias_term: false "
+    "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+    "layer { name: 'selu' type: 'SeLu' bottom: 'ip2' top: 'out' } ";
+
+TYPED_TEST(InferenceOptimizerTest, TestFuseActivations) {
+  this->InitTrainedNet(kFusableNetProto);
+  NetParameter fused_param;
+  EXPECT_EQ(5, FuseActivationLayers(this->param_, &fused_param));
+  ASSERT_EQ(6, fused_param.layer_size());
+  EXPECT_EQ(FusedActivationParameter_Type_RELU,
+            fused_param.layer(1).fused_activation_param().type());
+  EXPECT_EQ(FusedActivationParameter_Type_PRELU,
+            fused_param.layer(2).fused_activation_param().type());
+  EXPECT_EQ(2, fused_param.layer(2).blobs_size());
+  EXPECT_EQ("prelu", fused_param.layer(2).top(0));
+  EXPECT_EQ(FusedActivationParameter_Type_SELU,
+            fused_param.layer(5).fused_activation_param().type());
+  EXPECT_EQ("out", fused_param.layer(5).top(0));
+  this->CheckOptimizedNet(fused_param, "out");
+}
+
+TYPED_TEST(InferenceOptimizerTest, TestNetFuseActivations) {
+  typedef TypeParam Dtype;
+  // Without trained blobs the PReLU layer stays, everything else is fused
+  // when the net is built and the weights are loaded afterwards.
+  this->InitTrainedNet(kFusableNetProto);
+  NetParameter net_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(kFusableNetProto,
+      &net_param));
+  net_param.set_forward_only(true);
+  net_param.set_fuse_activations(true);
+  Net<Dtype> fused_net(net_param);
+  EXPECT_EQ(7, fused_net.layers().size());
+  EXPECT_FALSE(fused_net.has_blob("ip2"));
+  NetParameter trained_param;
+  this->net_->ToProto(&trained_param);
+  fused_net.CopyTrainedLayersFrom(trained_param);
+  fused_net.input_blobs()[0]->CopyFrom(*this->net_->input_blobs()[0]);
+  this->net_->Forward();
+  fused_net.Forward();
+  const Blob<Dtype>* expected = this->net_->blob_by_name("out").get();
+  const Blob<Dtype>* actual = fused_net.blob_by_name("out").get();
+  ASSERT_EQ(expected->shape(), actual->shape());
+  for (int i = 0; i < expected->count(); ++i) {
+    EXPECT_NEAR(expected->cpu_data()[i], actual->cpu_data()[i], 1e-4);
+  }
+}
+
+}  // namespace caffe
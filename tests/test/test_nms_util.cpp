@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/cpu_info.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/nms_util.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// The greedy loop NMS used to be: every kept box against all later boxes.
+template <typename Dtype>
+void ReferenceNMS(const Dtype* boxes, const int num_boxes, const int box_step,
+                  const Dtype nms_thresh, const int max_num_out,
+                  const NMSOverlap overlap, vector<int>* keep) {
+  vector<char> is_dead(num_boxes, 0);
+  keep->clear();
+  for (int i = 0; i < num_boxes; ++i) {
+    if (is_dead[i]) {
+      continue;
+    }
+    keep->push_back(i);
+    if (keep->size() == max_num_out) {
+      break;
+    }
+    for (int j = i + 1; j < num_boxes; ++j) {
+      const Dtype* a = boxes + i * box_step;
+      const Dtype* b = boxes + j * box_step;
+      if (!is_dead[j] &&
+          (overlap == NMS_IOU ? IoU(a, b) : IoM(a, b)) > nms_thresh) {
+        is_dead[j] = 1;
+      }
+    }
+  }
+}
+
+// num_boxes random proposals (x1, y1, x2, y2, score) in a width x width
+// image, sorted by decreasing score. Corners are whole pixels half of the
+// time, so that some overlaps are exactly the threshold.
+template <typename Dtype>
+void RandomProposals(const int num_boxes, const Dtype width,
+                     vector<Dtype>* proposals) {
+  vector<Dtype> r(num_boxes * 5);
+  caffe_rng_uniform<Dtype>(r.size(), 0, 1, r.data());
+  vector<std::pair<Dtype, int> > order(num_boxes);
+  for (int i = 0; i < num_boxes; ++i) {
+    order[i] = std::make_pair(r[i * 5 + 4], i);
+  }
+  std::sort(order.rbegin(), order.rend());
+  proposals->resize(num_boxes * 5);
+  for (int n = 0; n < num_boxes; ++n) {
+    const Dtype* u = r.data() + order[n].second * 5;
+    Dtype* box = proposals->data() + n * 5;
+    box[0] = u[0] * width;
+    box[1] = u[1] * width;
+    box[2] = box[0] + u[2] * width / 4;
+    box[3] = box[1] + u[3] * width / 4;
+    if (n % 2) {
+      for (int k = 0; k < 4; ++k) {
+        box[k] = static_cast<int>(box[k]);
+      }
+    }
+    box[4] = order[n].first;
+  }
+}
+
+template <typename Dtype>
+class NMSTest : public ::testing::Test {
+ protected:
+  // Check NMSSorted against ReferenceNMS with each instruction set.
+  void CheckNMS(const int num_boxes, const Dtype nms_thresh,
+                const int max_num_out, const NMSOverlap overlap) {
+    vector<Dtype> proposals;
+    RandomProposals<Dtype>(num_boxes, 200, &proposals);
+    vector<int> expected;
+    ReferenceNMS(proposals.data(), num_boxes, 5, nms_thresh, max_num_out,
+                 overlap, &expected);
+    EXPECT_FALSE(expected.empty());
+    const CpuIsa isa = cpu_isa();
+    for (int max_isa = CPU_ISA_SCALAR; max_isa <= isa; ++max_isa) {
+      set_max_cpu_isa(static_cast<CpuIsa>(max_isa));
+      for (int threads = 1; threads <= 3; threads += 2) {
+        Caffe::set_num_threads(threads);
+        vector<int> index(num_boxes, -1);
+        int num_out = -1;
+        NMSSorted(proposals.data(), num_boxes, 5, index.data(), &num_out, 7,
+                  nms_thresh, max_num_out, overlap);
+        ASSERT_EQ(expected.size(), num_out) << cpu_isa_name(cpu_isa());
+        for (int i = 0; i < num_out; ++i) {
+          EXPECT_EQ(expected[i] + 7, index[i]) << cpu_isa_name(cpu_isa());
+        }
+      }
+    }
+    set_max_cpu_isa(isa);
+    Caffe::set_num_threads(-1);
+  }
+};
+
+TYPED_TEST_CASE(NMSTest, TestDtypes);
+
+TYPED_TEST(NMSTest, TestIoU) {
+  this->CheckNMS(1000, TypeParam(0.7), 0, NMS_IOU);
+  this->CheckNMS(777, TypeParam(0.3), 0, NMS_IOU);
+  this->CheckNMS(130, TypeParam(0.5), 0, NMS_IOU);
+}
+
+TYPED_TEST(NMSTest, TestIoM) {
+  this->CheckNMS(1000, TypeParam(0.7), 0, NMS_IOM);
+  this->CheckNMS(300, TypeParam(0.5), 0, NMS_IOM);
+}
+
+TYPED_TEST(NMSTest, TestMaxNumOut) {
+  this->CheckNMS(1000, TypeParam(0.7), 1, NMS_IOU);
+  this->CheckNMS(1000, TypeParam(0.7), 100, NMS_IOU);
+  this->CheckNMS(1000, TypeParam(0.7), 129, NMS_IOU);
+}
+
+TYPED_TEST(NMSTest, TestBoxStep) {
+  // NMS of 5-wide proposals is NMSSorted of their first 4 columns.
+  vector<TypeParam> proposals;
+  RandomProposals<TypeParam>(500, 100, &proposals);
+  vector<TypeParam> boxes;
+  for (int i = 0; i < 500; ++i) {
+    boxes.insert(boxes.end(), proposals.begin() + i * 5,
+                 proposals.begin() + i * 5 + 4);
+  }
+  vector<int> index(500), box_index(500);
+  int num_out, box_num_out;
+  NMS(proposals.data(), 500, index.data(), &num_out, 0, TypeParam(0.6), 50);
+  NMSSorted(boxes.data(), 500, 4, box_index.data(), &box_num_out, 0,
+            TypeParam(0.6), 50);
+  ASSERT_EQ(num_out, box_num_out);
+  for (int i = 0; i < num_out; ++i) {
+    EXPECT_EQ(index[i], box_index[i]);
+  }
+}
+
+TEST(NMSBenchmark, DISABLED_TestProposals) {
+  // rpn_pre_nms_top_n is 6000 at test time and 12000 in training.
+  const int kNumBoxes[] = {6000, 12000, 24000};
+  for (int n = 0; n < 3; ++n) {
+    const int num_boxes = kNumBoxes[n];
+    vector<float> proposals;
+    RandomProposals<float>(num_boxes, 1000, &proposals);
+    vector<int> index(num_boxes), expected;
+    int num_out;
+    CPUTimer timer;
+    timer.Start();
+    ReferenceNMS(proposals.data(), num_boxes, 5, 0.7f, 0, NMS_IOU, &expected);
+    timer.Stop();
+    const float reference_ms = timer.MilliSeconds();
+    timer.Start();
+    NMS(proposals.data(), num_boxes, index.data(), &num_out, 0, 0.7f, 0);
+    timer.Stop();
+    const float all_ms = timer.MilliSeconds();
+    EXPECT_EQ(expected.size(), num_out);
+    timer.Start();
+    NMS(proposals.data(), num_boxes, index.data(), &num_out, 0, 0.7f, 300);
+    timer.Stop();
+    const float top_ms = timer.MilliSeconds();
+    LOG(INFO) << num_boxes << " boxes on " << Caffe::num_threads()
+              << " threads, " << cpu_isa_name(cpu_isa()) << ": reference "
+              << reference_ms << " ms, all " << expected.size() << " kept "
+              << all_ms << " ms (" << reference_ms / all_ms << "x), top 300 "
+              << top_ms << " ms";
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/proposal_layer.hpp"
+#include "caffe/util/nms_util.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class ProposalLayerTest : public CPUDeviceTest<TypeParam> {
+ protected:
+  typedef TypeParam Dtype;
+
+  // Two images with 3 anchors on a 5x5 map.
+  ProposalLayerTest()
+      : blob_bottom_score_(new Blob<Dtype>(2, 6, 5, 5)),
+        blob_bottom_bbox_(new Blob<Dtype>(2, 12, 5, 5)),
+        blob_bottom_im_info_(new Blob<Dtype>(2, 4, 1, 1)),
+        blob_top_rois_(new Blob<Dtype>()),
+        blob_top_score_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    UniformFiller<Dtype> score_filler(filler_param);
+    score_filler.Fill(blob_bottom_score_);
+    filler_param.set_std(0.1);
+    GaussianFiller<Dtype> bbox_filler(filler_param);
+    bbox_filler.Fill(blob_bottom_bbox_);
+    // (height, width, scale_H, scale_W) of each image
+    const Dtype im_info[] = {80, 80, 1, 1, 64, 72, 1.5, 1.25};
+    std::copy(im_info, im_info + 8, blob_bottom_im_info_->mutable_cpu_data());
+    blob_bottom_vec_.push_back(blob_bottom_score_);
+    blob_bottom_vec_.push_back(blob_bottom_bbox_);
+    blob_bottom_vec_.push_back(blob_bottom_im_info_);
+    blob_top_vec_.push_back(blob_top_rois_);
+    blob_top_vec_.push_back(blob_top_score_);
+
+    ProposalParameter* proposal_param = layer_param_.mutable_proposal_param();
+    proposal_param->set_min_size(4);
+    proposal_param->set_pre_nms_topn(40);
+    proposal_param->set_post_nms_topn(12);
+    proposal_param->set_nms_thresh(0.7);
+    const int anchors[] = {0, 0, 31, 31, 0, 8, 47, 39, 8, 0, 39, 47};
+    for (int i = 0; i < 3; ++i) {
+      Anchor* anchor = proposal_param->add_anchor();
+      anchor->set_tl_x(anchors[i * 4 + 0]);
+      anchor->set_tl_y(anchors[i * 4 + 1]);
+      anchor->set_br_x(anchors[i * 4 + 2]);
+      anchor->set_br_y(anchors[i * 4 + 3]);
+    }
+  }
+  virtual ~ProposalLayerTest() {
+    delete blob_bottom_score_;
+    delete blob_bottom_bbox_;
+    delete blob_bottom_im_info_;
+    delete blob_top_rois_;
+    delete blob_top_score_;
+  }
+
+  Blob<Dtype>* const blob_bottom_score_;
+  Blob<Dtype>* const blob_bottom_bbox_;
+  Blob<Dtype>* const blob_bottom_im_info_;
+  Blob<Dtype>* const blob_top_rois_;
+  Blob<Dtype>* const blob_top_score_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  LayerParameter layer_param_;
+};
+
+TYPED_TEST_CASE(ProposalLayerTest, TestDtypes);
+
+TYPED_TEST(ProposalLayerTest, TestBatchMatchesSingleImages) {
+  typedef TypeParam Dtype;
+  ProposalLayer<Dtype> layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(2);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(-1);
+  const int num_rois = this->blob_top_rois_->num();
+  ASSERT_EQ(num_rois, this->blob_top_score_->num());
+
+  // Forward each image on its own, and find its rois in the batch.
+  int offset = 0;
+  for (int n = 0; n < 2; ++n) {
+    vector<Blob<Dtype>*> bottom;
+    vector<Blob<Dtype>*> top;
+    for (int i = 0; i < 3; ++i) {
+      const Blob<Dtype>& blob = *this->blob_bottom_vec_[i];
+      vector<int> shape = blob.shape();
+      shape[0] = 1;
+      bottom.push_back(new Blob<Dtype>(shape));
+      std::copy(blob.cpu_data() + n * blob.count(1),
+                blob.cpu_data() + (n + 1) * blob.count(1),
+                bottom[i]->mutable_cpu_data());
+    }
+    top.push_back(new Blob<Dtype>());
+    top.push_back(new Blob<Dtype>());
+    ProposalLayer<Dtype> single_layer(this->layer_param_);
+    single_layer.SetUp(bottom, top);
+    single_layer.Forward(bottom, top);
+    const int single_rois = top[0]->num();
+    EXPECT_GT(single_rois, 0);
+    EXPECT_LE(single_rois, 12);
+    ASSERT_LE(offset + single_rois, num_rois);
+    for (int i = 0; i < single_rois; ++i) {
+      const Dtype* roi = this->blob_top_rois_->cpu_data() + (offset + i) * 5;
+      const Dtype* single_roi = top[0]->cpu_data() + i * 5;
+      EXPECT_EQ(n, roi[0]);
+      EXPECT_EQ(0, single_roi[0]);
+      for (int k = 1; k < 5; ++k) {
+        EXPECT_EQ(single_roi[k], roi[k]);
+      }
+      EXPECT_EQ(top[1]->cpu_data()[i],
+                this->blob_top_score_->cpu_data()[offset + i]);
+    }
+    offset += single_rois;
+    for (int i = 0; i < 3; ++i) {
+      delete bottom[i];
+    }
+    delete top[0];
+    delete top[1];
+  }
+  EXPECT_EQ(num_rois, offset);
+}
+
+TYPED_TEST(ProposalLayerTest, TestRoisAreSuppressed) {
+  typedef TypeParam Dtype;
+  ProposalLayer<Dtype> layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* rois = this->blob_top_rois_->cpu_data();
+  const Dtype* scores = this->blob_top_score_->cpu_data();
+  for (int i = 0; i < this->blob_top_rois_->num(); ++i) {
+    const int n = rois[i * 5];
+    const Dtype* info = this->blob_bottom_im_info_->cpu_data() + n * 4;
+    EXPECT_GE(rois[i * 5 + 1], 0);
+    EXPECT_GE(rois[i * 5 + 2], 0);
+    EXPECT_LE(rois[i * 5 + 3], info[1] - 1);
+    EXPECT_LE(rois[i * 5 + 4], info[0] - 1);
+    for (int j = i + 1; j < this->blob_top_rois_->num(); ++j) {
+      if (rois[j * 5] != rois[i * 5]) {
+        continue;
+      }
+      EXPECT_GE(scores[i], scores[j]);
+      EXPECT_LE(IoU(rois + i * 5 + 1, rois + j * 5 + 1), Dtype(0.7));
+    }
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/deformable_psroi_pooling_layer.hpp"
+#include "caffe/layers/psroi_pooling_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class PSROIPoolingLayerTest : public CPUDeviceTest<TypeParam> {
+ protected:
+  typedef TypeParam Dtype;
+
+  // Two output channels with 3x3 groups.
+  PSROIPoolingLayerTest()
+      : blob_bottom_data_(new Blob<Dtype>(2, 18, 10, 10)),
+        blob_bottom_rois_(new Blob<Dtype>(3, 5, 1, 1)),
+        blob_bottom_trans_(new Blob<Dtype>(3, 4, 3, 3)),
+        blob_top_data_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    filler_param.set_std(1);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_data_);
+    // (batch index, x1, y1, x2, y2) in image pixels, at twice the scale of
+    // the feature map. The deformable samples of these ROIs are half a pixel
+    // off the grid and inside the map, so that translations by less than
+    // 0.3 * trans_std of the ROI never take them across a pixel.
+    const Dtype rois[] = {
+      0, 2, 2, 13, 13,
+      1, 4, 6, 15, 17,
+      0, 6, 4, 17, 15,
+    };
+    std::copy(rois, rois + 15, blob_bottom_rois_->mutable_cpu_data());
+    filler_param.set_min(-0.3);
+    filler_param.set_max(0.3);
+    UniformFiller<Dtype> trans_filler(filler_param);
+    trans_filler.Fill(blob_bottom_trans_);
+    blob_bottom_vec_.push_back(blob_bottom_data_);
+    blob_bottom_vec_.push_back(blob_bottom_rois_);
+    blob_top_vec_.push_back(blob_top_data_);
+  }
+  virtual ~PSROIPoolingLayerTest() {
+    delete blob_bottom_data_;
+    delete blob_bottom_rois_;
+    delete blob_bottom_trans_;
+    delete blob_top_data_;
+  }
+
+  void SetDeformableParam(LayerParameter* layer_param, bool no_trans) {
+    DeformablePSROIPoolingParameter* param =
+        layer_param->mutable_deformable_psroi_pooling_param();
+    param->set_spatial_scale(0.5);
+    param->set_output_dim(2);
+    param->set_group_size(3);
+    param->set_part_size(3);
+    param->set_sample_per_part(2);
+    param->set_trans_std(0.1);
+    param->set_no_trans(no_trans);
+  }
+
+  // Reference of the CUDA kernel of DeformablePSROIPooling for top (n, ctop,
+  // ph, pw), with two classes of translations.
+  Dtype ReferenceDeformableBin(int n, int ctop, int ph, int pw,
+                               bool no_trans) {
+    const int height = blob_bottom_data_->height();
+    const int width = blob_bottom_data_->width();
+    const Dtype* roi = blob_bottom_rois_->cpu_data() + n * 5;
+    const Dtype start_w = round(roi[1]) * Dtype(0.5) - Dtype(0.5);
+    const Dtype start_h = round(roi[2]) * Dtype(0.5) - Dtype(0.5);
+    const Dtype roi_width = (round(roi[3]) + 1) * Dtype(0.5) - Dtype(0.5) -
+        start_w;
+    const Dtype roi_height = (round(roi[4]) + 1) * Dtype(0.5) - Dtype(0.5) -
+        start_h;
+    const Dtype trans_x = no_trans ? Dtype(0) :
+        blob_bottom_trans_->data_at(n, 2 * ctop, ph, pw) * Dtype(0.1);
+    const Dtype trans_y = no_trans ? Dtype(0) :
+        blob_bottom_trans_->data_at(n, 2 * ctop + 1, ph, pw) * Dtype(0.1);
+    const Dtype wstart = pw * roi_width / 3 + start_w + trans_x * roi_width;
+    const Dtype hstart = ph * roi_height / 3 + start_h + trans_y * roi_height;
+    const int c = (ctop * 3 + ph) * 3 + pw;
+    Dtype sum = 0;
+    int count = 0;
+    for (int ih = 0; ih < 2; ++ih) {
+      for (int iw = 0; iw < 2; ++iw) {
+        Dtype w = wstart + iw * roi_width / 6;
+        Dtype h = hstart + ih * roi_height / 6;
+        if (w < -0.5 || w > width - 0.5 || h < -0.5 || h > height - 0.5) {
+          continue;
+        }
+        w = std::min(std::max(w, Dtype(0)), Dtype(width - 1));
+        h = std::min(std::max(h, Dtype(0)), Dtype(height - 1));
+        const int x1 = std::floor(w), x2 = std::ceil(w);
+        const int y1 = std::floor(h), y2 = std::ceil(h);
+        const Dtype dx = w - x1, dy = h - y1;
+        sum += (1 - dx) * (1 - dy) * blob_bottom_data_->data_at(roi[0], c,
+                                                                y1, x1) +
+               (1 - dx) * dy * blob_bottom_data_->data_at(roi[0], c, y2, x1) +
+               dx * (1 - dy) * blob_bottom_data_->data_at(roi[0], c, y1, x2) +
+               dx * dy * blob_bottom_data_->data_at(roi[0], c, y2, x2);
+        ++count;
+      }
+    }
+    return count == 0 ? Dtype(0) : sum / count;
+  }
+
+  Blob<Dtype>* const blob_bottom_data_;
+  Blob<Dtype>* const blob_bottom_rois_;
+  Blob<Dtype>* const blob_bottom_trans_;
+  Blob<Dtype>* const blob_top_data_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(PSROIPoolingLayerTest, TestDtypes);
+
+TYPED_TEST(PSROIPoolingLayerTest, TestForward) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  PSROIPoolingParameter* psroi_pooling_param =
+      layer_param.mutable_psroi_pooling_param();
+  psroi_pooling_param->set_spatial_scale(0.5);
+  psroi_pooling_param->set_output_dim(2);
+  psroi_pooling_param->set_group_size(3);
+  PSROIPoolingLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(3, this->blob_top_data_->num());
+  EXPECT_EQ(2, this->blob_top_data_->channels());
+  EXPECT_EQ(3, this->blob_top_data_->height());
+  EXPECT_EQ(3, this->blob_top_data_->width());
+  Caffe::set_num_threads(3);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(-1);
+  const int height = this->blob_bottom_data_->height();
+  const int width = this->blob_bottom_data_->width();
+  for (int n = 0; n < 3; ++n) {
+    const Dtype* roi = this->blob_bottom_rois_->cpu_data() + n * 5;
+    const Dtype start_w = round(roi[1]) * Dtype(0.5);
+    const Dtype start_h = round(roi[2]) * Dtype(0.5);
+    const Dtype bin_w = ((round(roi[3]) + 1) * Dtype(0.5) - start_w) / 3;
+    const Dtype bin_h = ((round(roi[4]) + 1) * Dtype(0.5) - start_h) / 3;
+    for (int ctop = 0; ctop < 2; ++ctop) {
+      for (int ph = 0; ph < 3; ++ph) {
+        for (int pw = 0; pw < 3; ++pw) {
+          const int hstart = std::min(std::max(
+              static_cast<int>(std::floor(ph * bin_h + start_h)), 0), height);
+          const int hend = std::min(std::max(
+              static_cast<int>(std::ceil((ph + 1) * bin_h + start_h)), 0),
+              height);
+          const int wstart = std::min(std::max(
+              static_cast<int>(std::floor(pw * bin_w + start_w)), 0), width);
+          const int wend = std::min(std::max(
+              static_cast<int>(std::ceil((pw + 1) * bin_w + start_w)), 0),
+              width);
+          Dtype sum = 0;
+          for (int h = hstart; h < hend; ++h) {
+            for (int w = wstart; w < wend; ++w) {
+              sum += this->blob_bottom_data_->data_at(roi[0],
+                  (ctop * 3 + ph) * 3 + pw, h, w);
+            }
+          }
+          const Dtype expected = (hend <= hstart || wend <= wstart) ?
+              Dtype(0) : sum / ((hend - hstart) * (wend - wstart));
+          EXPECT_NEAR(expected,
+                      this->blob_top_data_->data_at(n, ctop, ph, pw), 1e-4);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(PSROIPoolingLayerTest, TestGradient) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  PSROIPoolingParameter* psroi_pooling_param =
+      layer_param.mutable_psroi_pooling_param();
+  psroi_pooling_param->set_spatial_scale(0.5);
+  psroi_pooling_param->set_output_dim(2);
+  psroi_pooling_param->set_group_size(3);
+  PSROIPoolingLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  Caffe::set_num_threads(2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+  Caffe::set_num_threads(-1);
+}
+
+TYPED_TEST(PSROIPoolingLayerTest, TestDeformableForward) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  this->SetDeformableParam(&layer_param, false);
+  this->blob_bottom_vec_.push_back(this->blob_bottom_trans_);
+  DeformablePSROIPoolingLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(3);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(-1);
+  for (int n = 0; n < 3; ++n) {
+    for (int ctop = 0; ctop < 2; ++ctop) {
+      for (int ph = 0; ph < 3; ++ph) {
+        for (int pw = 0; pw < 3; ++pw) {
+          EXPECT_NEAR(this->ReferenceDeformableBin(n, ctop, ph, pw, false),
+                      this->blob_top_data_->data_at(n, ctop, ph, pw), 1e-4);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(PSROIPoolingLayerTest, TestDeformableForwardNoTrans) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  this->SetDeformableParam(&layer_param, true);
+  DeformablePSROIPoolingLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(3);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(-1);
+  for (int n = 0; n < 3; ++n) {
+    for (int ctop = 0; ctop < 2; ++ctop) {
+      for (int ph = 0; ph < 3; ++ph) {
+        for (int pw = 0; pw < 3; ++pw) {
+          EXPECT_NEAR(this->ReferenceDeformableBin(n, ctop, ph, pw, true),
+                      this->blob_top_data_->data_at(n, ctop, ph, pw), 1e-4);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(PSROIPoolingLayerTest, TestDeformableGradient) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  this->SetDeformableParam(&layer_param, false);
+  this->blob_bottom_vec_.push_back(this->blob_bottom_trans_);
+  DeformablePSROIPoolingLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  Caffe::set_num_threads(2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 2);
+  Caffe::set_num_threads(-1);
+}
+
+TYPED_TEST(PSROIPoolingLayerTest, TestDeformableGradientNoTrans) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  this->SetDeformableParam(&layer_param, true);
+  DeformablePSROIPoolingLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
+}  // namespace caffe
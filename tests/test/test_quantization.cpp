@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/cpu_info.hpp"
+#include "caffe/util/inference_optimizer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantization.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class Int8GemmTest : public ::testing::Test {
+ protected:
+  virtual ~Int8GemmTest() {
+    set_max_cpu_isa(CPU_ISA_AVX512);
+  }
+
+  // Random operands against an exact reference, under each instruction set.
+  void CheckGemm(int M, int N, int K) {
+    const int lda = K + 3;
+    const int ldb = K + 5;
+    vector<int8_t> A(M * lda);
+    vector<uint8_t> B(N * ldb);
+    for (int i = 0; i < A.size(); ++i) {
+      A[i] = static_cast<int8_t>(caffe_rng_rand() % 255 - 127);
+    }
+    for (int i = 0; i < B.size(); ++i) {
+      B[i] = static_cast<uint8_t>(caffe_rng_rand() % 256);
+    }
+    vector<int32_t> C(M * N);
+    const CpuIsa isas[] = { CPU_ISA_SCALAR, CPU_ISA_AVX2 };
+    for (int isa = 0; isa < 2; ++isa) {
+      set_max_cpu_isa(isas[isa]);
+      caffe_cpu_int8_gemm(M, N, K, A.data(), lda, B.data(), ldb, C.data());
+      for (int i = 0; i < M; ++i) {
+        for (int j = 0; j < N; ++j) {
+          int32_t expected = 0;
+          for (int k = 0; k < K; ++k) {
+            expected += static_cast<int32_t>(A[i * lda + k]) * B[j * ldb + k];
+          }
+          ASSERT_EQ(expected, C[i * N + j])
+              << M << "x" << N << "x" << K << " (" << i << ", " << j << "), "
+              << cpu_isa_name(cpu_isa());
+        }
+      }
+    }
+  }
+};
+
+TEST_F(Int8GemmTest, TestShapes) {
+  CheckGemm(1, 1, 1);
+  CheckGemm(3, 5, 7);
+  CheckGemm(4, 2, 16);
+  CheckGemm(13, 9, 37);
+  CheckGemm(64, 50, 300);
+}
+
+TEST_F(Int8GemmTest, TestExtremes) {
+  // 255 * -127 summed over a long row still fits in 32 bits.
+  const int K = 4096;
+  vector<int8_t> A(K, -127);
+  vector<uint8_t> B(K, 255);
+  int32_t C = 0;
+  caffe_cpu_int8_gemm(1, 1, K, A.data(), K, B.data(), K, &C);
+  EXPECT_EQ(-127 * 255 * K, C);
+}
+
+template <typename TypeParam>
+class QuantizedLayerTest : public CPUDeviceTest<TypeParam> {
+ protected:
+  typedef TypeParam Dtype;
+
+  QuantizedLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 8, 9, 11)),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~QuantizedLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  // The INT8 layer against the floating point one with the same weights,
+  // calibrated on the input itself: the error must stay within a few
+  // quantization steps of the input and weights.
+  template <typename LayerType>
+  void CheckQuantized(LayerParameter layer_param) {
+    LayerType float_layer(layer_param);
+    float_layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    float_layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    Blob<Dtype> expected;
+    expected.CopyFrom(*blob_top_, false, true);
+
+    const Dtype* input = blob_bottom_->cpu_data();
+    const int count = blob_bottom_->count();
+    QuantizationParameter* quantization_param =
+        layer_param.mutable_quantization_param();
+    quantization_param->set_precision(QuantizationParameter_Precision_INT8);
+    quantization_param->set_input_min(*std::min_element(input, input + count));
+    quantization_param->set_input_max(*std::max_element(input, input + count));
+    LayerType int8_layer(layer_param);
+    int8_layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    for (int i = 0; i < float_layer.blobs().size(); ++i) {
+      int8_layer.blobs()[i]->CopyFrom(*float_layer.blobs()[i]);
+    }
+    int8_layer.Forward(blob_bottom_vec_, blob_top_vec_);
+
+    double error = 0;
+    double norm = 0;
+    for (int i = 0; i < blob_top_->count(); ++i) {
+      const double diff = blob_top_->cpu_data()[i] - expected.cpu_data()[i];
+      error += diff * diff;
+      norm += expected.cpu_data()[i] * expected.cpu_data()[i];
+    }
+    EXPECT_LT(std::sqrt(error / norm), 0.02);
+
+    // New weights are quantized again.
+    Blob<Dtype>* weights = int8_layer.blobs()[0].get();
+    caffe_set(weights->count(), Dtype(0), weights->mutable_cpu_data());
+    int8_layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    const Dtype* bias = int8_layer.blobs()[1]->cpu_data();
+    const int channels = blob_top_->shape(1);
+    const int spatial = blob_top_->count(2);
+    for (int i = 0; i < blob_top_->count(); ++i) {
+      EXPECT_NEAR(bias[i / spatial % channels], blob_top_->cpu_data()[i],
+                  1e-5);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(QuantizedLayerTest, TestDtypes);
+
+TYPED_TEST(QuantizedLayerTest, TestInnerProduct) {
+  LayerParameter layer_param;
+  InnerProductParameter* ip_param = layer_param.mutable_inner_product_param();
+  ip_param->set_num_output(37);
+  ip_param->mutable_weight_filler()->set_type("gaussian");
+  ip_param->mutable_bias_filler()->set_type("gaussian");
+  this->template CheckQuantized<InnerProductLayer<TypeParam> >(layer_param);
+}
+
+TYPED_TEST(QuantizedLayerTest, TestConvolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* conv_param = layer_param.mutable_convolution_param();
+  conv_param->add_kernel_size(3);
+  conv_param->add_pad(1);
+  conv_param->set_num_output(12);
+  conv_param->set_group(2);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  conv_param->mutable_bias_filler()->set_type("gaussian");
+  this->template CheckQuantized<ConvolutionLayer<TypeParam> >(layer_param);
+}
+
+TYPED_TEST(QuantizedLayerTest, TestPointwiseConvolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* conv_param = layer_param.mutable_convolution_param();
+  conv_param->add_kernel_size(1);
+  conv_param->add_stride(2);
+  conv_param->set_num_output(16);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  conv_param->mutable_bias_filler()->set_type("gaussian");
+  this->template CheckQuantized<ConvolutionLayer<TypeParam> >(layer_param);
+}
+
+class Int8NetTest : public ::testing::Test {
+ protected:
+  Int8NetTest() {
+    const string proto =
+        "layer { name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 16 dim: 3 dim: 16 dim: 16 } } } "
+        "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+        "  top: 'conv1' convolution_param { num_output: 16 kernel_size: 3 "
+        "  pad: 1 weight_filler { type: 'xavier' } "
+        "  bias_filler { type: 'gaussian' std: 0.1 } } } "
+        "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+        "layer { name: 'pool1' type: 'Pooling' bottom: 'conv1' top: 'pool1' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } } "
+        "layer { name: 'conv2' type: 'Convolution' bottom: 'pool1' "
+        "  top: 'conv2' convolution_param { num_output: 32 kernel_size: 3 "
+        "  weight_filler { type: 'xavier' } "
+        "  bias_filler { type: 'gaussian' std: 0.1 } } } "
+        "layer { name: 'relu2' type: 'ReLU' bottom: 'conv2' top: 'conv2' } "
+        "layer { name: 'fc' type: 'InnerProduct' bottom: 'conv2' top: 'fc' "
+        "  inner_product_param { num_output: 10 "
+        "  weight_filler { type: 'xavier' } } } ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+    param_.mutable_state()->set_phase(TEST);
+  }
+
+  void FillInput(Net<float>* net) {
+    FillerParameter filler_param;
+    GaussianFiller<float> filler(filler_param);
+    filler.Fill(net->input_blobs()[0]);
+  }
+
+  NetParameter param_;
+};
+
+TEST_F(Int8NetTest, TestQuantizeLayers) {
+  BlobRanges ranges;
+  ranges["data"] = std::make_pair(-3.f, 3.f);
+  ranges["conv2"] = std::make_pair(0.f, 6.f);
+  NetParameter quantized;
+  EXPECT_EQ(2, QuantizeLayers(param_, ranges, &quantized));
+  ASSERT_EQ(param_.layer_size(), quantized.layer_size());
+  // conv2 reads pool1, which has no range.
+  const int quantized_layers[] = { 1, 6 };
+  for (int i = 0; i < 2; ++i) {
+    const LayerParameter& layer = quantized.layer(quantized_layers[i]);
+    const std::pair<float, float>& range = ranges[layer.bottom(0)];
+    EXPECT_EQ(QuantizationParameter_Precision_INT8,
+              layer.quantization_param().precision()) << layer.name();
+    EXPECT_EQ(range.first, layer.quantization_param().input_min());
+    EXPECT_EQ(range.second, layer.quantization_param().input_max());
+  }
+  EXPECT_FALSE(quantized.layer(4).has_quantization_param());
+  // Transposed weights stay in floating point.
+  param_.mutable_layer(6)->mutable_inner_product_param()->set_transpose(true);
+  EXPECT_EQ(1, QuantizeLayers(param_, ranges, &quantized));
+  EXPECT_FALSE(quantized.layer(6).has_quantization_param());
+}
+
+// Calibrates on a few batches, then reports how far the INT8 net is from the
+// floating point one on new batches.
+TEST_F(Int8NetTest, TestAccuracy) {
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(1701);
+  Net<float> float_net(param_);
+  BlobRanges ranges;
+  for (int i = 0; i < 4; ++i) {
+    FillInput(&float_net);
+    float_net.Forward();
+    UpdateBlobRanges(float_net, &ranges);
+  }
+  NetParameter trained;
+  float_net.ToProto(&trained);
+  NetParameter quantized;
+  EXPECT_EQ(3, QuantizeLayers(param_, ranges, &quantized));
+  Net<float> int8_net(quantized);
+  int8_net.CopyTrainedLayersFrom(trained);
+
+  double error = 0;
+  double norm = 0;
+  int agree = 0;
+  int total = 0;
+  for (int i = 0; i < 4; ++i) {
+    FillInput(&float_net);
+    int8_net.input_blobs()[0]->CopyFrom(*float_net.input_blobs()[0]);
+    const Blob<float>& expected = *float_net.Forward()[0];
+    const Blob<float>& actual = *int8_net.Forward()[0];
+    const int classes = expected.count(1);
+    for (int n = 0; n < expected.num(); ++n) {
+      const float* e = expected.cpu_data() + n * classes;
+      const float* a = actual.cpu_data() + n * classes;
+      for (int c = 0; c < classes; ++c) {
+        error += (a[c] - e[c]) * (a[c] - e[c]);
+        norm += e[c] * e[c];
+      }
+      agree += std::max_element(e, e + classes) - e ==
+               std::max_element(a, a + classes) - a;
+      ++total;
+    }
+  }
+  const double relative_error = std::sqrt(error / norm);
+  LOG(INFO) << "INT8 against FP32: relative error " << relative_error
+            << ", top-1 agreement " << agree << "/" << total;
+  EXPECT_LT(relative_error, 0.05);
+  EXPECT_GE(agree, total * 9 / 10);
+}
+
+}  // namespace caffe
@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/roi_align_layer.hpp"
+#include "caffe/layers/roi_mask_align_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+// Reference bin of the CUDA kernels: the largest bilinear sample of the bin
+// of data at [hstart, hend) x [wstart, wend), with the samples inside the
+// mask [mask[0], mask[1]] x [mask[2], mask[3]] (if any) pooling as 0.
+template <typename Dtype>
+Dtype reference_roi_align_bin(const Dtype* data, int height, int width,
+    Dtype hstart, Dtype hend, Dtype wstart, Dtype wend, const Dtype* mask) {
+  hstart = std::min(std::max(hstart, Dtype(0)), Dtype(height));
+  hend = std::min(std::max(hend, Dtype(0)), Dtype(height));
+  wstart = std::min(std::max(wstart, Dtype(0)), Dtype(width));
+  wend = std::min(std::max(wend, Dtype(0)), Dtype(width));
+  if (hend <= hstart || wend <= wstart) {
+    return 0;
+  }
+  Dtype maxval = -FLT_MAX;
+  for (Dtype h = hstart; h < hend; h += 1.) {
+    for (Dtype w = wstart; w < wend; w += 1.) {
+      const int x_left = std::floor(w);
+      const int x_right = std::ceil(w);
+      const int y_bottom = std::floor(h);
+      const int y_top = std::ceil(h);
+      const bool left_in = x_left >= 0 && x_left < width;
+      const bool right_in = x_right >= 0 && x_right < width;
+      const bool bottom_in = y_bottom >= 0 && y_bottom < height;
+      const bool top_in = y_top >= 0 && y_top < height;
+      Dtype val = 0;
+      if (left_in && top_in) {
+        val += (1 - w + x_left) * (1 - y_top + h) *
+            data[y_top * width + x_left];
+      }
+      if (right_in && top_in) {
+        val += (1 - x_right + w) * (1 - y_top + h) *
+            data[y_top * width + x_right];
+      }
+      if (left_in && bottom_in) {
+        val += (1 - w + x_left) * (1 - h + y_bottom) *
+            data[y_bottom * width + x_left];
+      }
+      if (right_in && bottom_in) {
+        val += (1 - x_right + w) * (1 - h + y_bottom) *
+            data[y_bottom * width + x_right];
+      }
+      if (mask && h >= mask[0] && h <= mask[1] && w >= mask[2] &&
+          w <= mask[3]) {
+        val = 0;
+      }
+      maxval = std::max(maxval, val);
+    }
+  }
+  return maxval;
+}
+
+template <typename TypeParam>
+class ROIAlignLayerTest : public CPUDeviceTest<TypeParam> {
+ protected:
+  typedef TypeParam Dtype;
+
+  ROIAlignLayerTest()
+      : blob_bottom_data_(new Blob<Dtype>(2, 5, 12, 10)),
+        blob_bottom_rois_(new Blob<Dtype>(4, 5, 1, 1)),
+        blob_top_data_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    // Distinct values in a fixed order: with random data, two samples of a
+    // bin may come within the gradient check step of each other, and the
+    // check then straddles the switch of the max.
+    const int count = blob_bottom_data_->count();
+    Dtype* data = blob_bottom_data_->mutable_cpu_data();
+    for (int i = 0; i < count; ++i) {
+      data[i] = Dtype(i * 37 % (count + 1)) / (count / 2) - 1;
+    }
+    // (batch index, x1, y1, x2, y2) in image pixels, at twice the scale of
+    // the feature map; the last one sticks out of the image.
+    const Dtype rois[] = {
+      0, 0, 0, 19, 23,
+      1, 3, 5, 12, 9,
+      1, 7.5, 1, 8.5, 13,
+      0, 10, 14, 25, 30,
+    };
+    std::copy(rois, rois + 20, blob_bottom_rois_->mutable_cpu_data());
+    blob_bottom_vec_.push_back(blob_bottom_data_);
+    blob_bottom_vec_.push_back(blob_bottom_rois_);
+    blob_top_vec_.push_back(blob_top_data_);
+  }
+  virtual ~ROIAlignLayerTest() {
+    delete blob_bottom_data_;
+    delete blob_bottom_rois_;
+    delete blob_top_data_;
+  }
+
+  // Check the top against reference_roi_align_bin, with the ROIs turned into
+  // feature map boxes by roi_box.
+  template <typename RoiBox>
+  void CheckForward(const RoiBox& roi_box, bool masked) {
+    const int channels = blob_bottom_data_->channels();
+    const int height = blob_bottom_data_->height();
+    const int width = blob_bottom_data_->width();
+    const int pooled_height = blob_top_data_->height();
+    const int pooled_width = blob_top_data_->width();
+    const Dtype* top_data = blob_top_data_->cpu_data();
+    for (int n = 0; n < blob_bottom_rois_->num(); ++n) {
+      const Dtype* roi = blob_bottom_rois_->cpu_data() + n * 5;
+      // start_h, end_h, start_w, end_w, then the mask in the same order.
+      Dtype box[8];
+      roi_box(roi, box);
+      const Dtype bin_h = (box[1] - box[0] + 1) / pooled_height;
+      const Dtype bin_w = (box[3] - box[2] + 1) / pooled_width;
+      for (int c = 0; c < channels; ++c) {
+        const Dtype* data = blob_bottom_data_->cpu_data() +
+            blob_bottom_data_->offset(roi[0], c);
+        for (int ph = 0; ph < pooled_height; ++ph) {
+          for (int pw = 0; pw < pooled_width; ++pw) {
+            const Dtype expected = reference_roi_align_bin(data, height, width,
+                ph * bin_h + box[0], (ph + 1) * bin_h + box[0],
+                pw * bin_w + box[2], (pw + 1) * bin_w + box[2],
+                masked ? box + 4 : NULL);
+            EXPECT_NEAR(expected,
+                top_data[blob_top_data_->offset(n, c, ph, pw)], 1e-4);
+          }
+        }
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_data_;
+  Blob<Dtype>* const blob_bottom_rois_;
+  Blob<Dtype>* const blob_top_data_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ROIAlignLayerTest, TestDtypes);
+
+template <typename Dtype>
+struct ScaledRoi {
+  void operator()(const Dtype* roi, Dtype* box) const {
+    box[0] = roi[2] * Dtype(0.5);
+    box[1] = roi[4] * Dtype(0.5);
+    box[2] = roi[1] * Dtype(0.5);
+    box[3] = roi[3] * Dtype(0.5);
+  }
+};
+
+TYPED_TEST(ROIAlignLayerTest, TestForward) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ROIAlignParameter* roi_align_param = layer_param.mutable_roi_align_param();
+  roi_align_param->set_pooled_h(3);
+  roi_align_param->set_pooled_w(4);
+  roi_align_param->set_spatial_scale(0.5);
+  ROIAlignLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(4, this->blob_top_data_->num());
+  EXPECT_EQ(5, this->blob_top_data_->channels());
+  EXPECT_EQ(3, this->blob_top_data_->height());
+  EXPECT_EQ(4, this->blob_top_data_->width());
+  Caffe::set_num_threads(3);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(-1);
+  this->CheckForward(ScaledRoi<Dtype>(), false);
+}
+
+TYPED_TEST(ROIAlignLayerTest, TestGradient) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ROIAlignParameter* roi_align_param = layer_param.mutable_roi_align_param();
+  roi_align_param->set_pooled_h(3);
+  roi_align_param->set_pooled_w(4);
+  roi_align_param->set_spatial_scale(0.5);
+  ROIAlignLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-4, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
+// roi_scale 1.5 around the center, the left half only, with the middle
+// half masked out.
+template <typename Dtype>
+struct MaskedRoi {
+  void operator()(const Dtype* roi, Dtype* box) const {
+    const Dtype xc = (roi[1] + roi[3]) / 2;
+    const Dtype yc = (roi[2] + roi[4]) / 2;
+    const Dtype w = roi[3] - roi[1];
+    const Dtype h = roi[4] - roi[2];
+    const Dtype scale = 0.5;
+    const Dtype shift = -0.25;
+    box[0] = (yc - h * Dtype(1.5) / 2) * scale + shift;
+    box[1] = (yc + h * Dtype(1.5) / 2) * scale + shift;
+    box[2] = (xc - w * Dtype(1.5) / 2) * scale + shift;
+    box[3] = xc * scale + shift;
+    box[4] = (yc - h * Dtype(0.5) / 2) * scale + shift;
+    box[5] = (yc + h * Dtype(0.5) / 2) * scale + shift;
+    box[6] = (xc - w * Dtype(0.5) / 2) * scale + shift;
+    box[7] = (xc + w * Dtype(0.5) / 2) * scale + shift;
+  }
+};
+
+TYPED_TEST(ROIAlignLayerTest, TestMaskForward) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ROIMaskAlignParameter* roi_mask_align_param =
+      layer_param.mutable_roi_mask_align_param();
+  roi_mask_align_param->set_pooled_h(4);
+  roi_mask_align_param->set_pooled_w(3);
+  roi_mask_align_param->set_spatial_scale(0.5);
+  roi_mask_align_param->set_spatial_shift(-0.25);
+  roi_mask_align_param->set_half_part(1);
+  roi_mask_align_param->set_roi_scale(1.5);
+  roi_mask_align_param->set_mask_scale(0.5);
+  ROIMaskAlignLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(3);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(-1);
+  this->CheckForward(MaskedRoi<Dtype>(), true);
+}
+
+TYPED_TEST(ROIAlignLayerTest, TestMaskGradient) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ROIMaskAlignParameter* roi_mask_align_param =
+      layer_param.mutable_roi_mask_align_param();
+  roi_mask_align_param->set_pooled_h(4);
+  roi_mask_align_param->set_pooled_w(3);
+  roi_mask_align_param->set_spatial_scale(0.5);
+  roi_mask_align_param->set_spatial_shift(-0.25);
+  roi_mask_align_param->set_half_part(1);
+  roi_mask_align_param->set_roi_scale(1.5);
+  roi_mask_align_param->set_mask_scale(0.5);
+  ROIMaskAlignLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-4, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
+}  // namespace caffe
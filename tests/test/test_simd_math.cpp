@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/cpu_info.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/simd_math.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class SimdMathTest : public ::testing::Test {
+ protected:
+  typedef std::function<void(int, const float*, float*)> VectorFn;
+  typedef std::function<double(double)> ReferenceFn;
+
+  SimdMathTest() : x_(kCount), y_(kCount) {}
+  virtual ~SimdMathTest() {
+    set_max_cpu_isa(CPU_ISA_AVX512);
+  }
+
+  // Uniform in [lo, hi], plus the special values every kernel must pass
+  // through to libm.
+  void FillUniform(float lo, float hi) {
+    caffe_rng_uniform(kCount, lo, hi, x_.data());
+    const float special[] = { 0.f, -0.f, INFINITY, -INFINITY, NAN,
+                              1e-40f, -1e-40f, 1.f, -1.f, 100.f, -100.f };
+    for (int i = 0; i < sizeof(special) / sizeof(special[0]); ++i) {
+      x_[i * 37] = special[i];
+    }
+  }
+
+  // Floats as integers ordered like the floats they represent.
+  static int64_t Ordinal(float f) {
+    int32_t i;
+    memcpy(&i, &f, sizeof(i));
+    return i < 0 ? -static_cast<int64_t>(i & 0x7FFFFFFF) : i;
+  }
+
+  // Maximum error in ulp of fn against ref over x_, under every ISA; NaN
+  // and infinite references must be matched exactly.
+  void CheckUlp(const VectorFn& fn, const ReferenceFn& ref, int max_ulp) {
+    for (int isa = CPU_ISA_SCALAR; isa <= CPU_ISA_AVX2; ++isa) {
+      set_max_cpu_isa(static_cast<CpuIsa>(isa));
+      fn(kCount, x_.data(), y_.data());
+      int64_t worst = 0;
+      for (int i = 0; i < kCount; ++i) {
+        const float expected = ref(x_[i]);
+        if (std::isnan(expected)) {
+          EXPECT_TRUE(std::isnan(y_[i])) << "x = " << x_[i];
+        } else if (std::abs(expected) >= FLT_MIN) {
+          worst = std::max(worst,
+                           std::abs(Ordinal(y_[i]) - Ordinal(expected)));
+        }
+      }
+      EXPECT_LE(worst, max_ulp) << cpu_isa_name(cpu_isa());
+    }
+  }
+
+  // Time of the vector kernel and of a libm loop, in ms.
+  void LogSpeedup(const char* name, const VectorFn& fn,
+      const std::function<float(float)>& scalar) {
+    const int kIterations = 20;
+    CPUTimer timer;
+    timer.Start();
+    for (int k = 0; k < kIterations; ++k) {
+      for (int i = 0; i < kCount; ++i) {
+        y_[i] = scalar(x_[i]);
+      }
+    }
+    const float scalar_ms = timer.MilliSeconds() / kIterations;
+    timer.Start();
+    for (int k = 0; k < kIterations; ++k) {
+      fn(kCount, x_.data(), y_.data());
+    }
+    const float simd_ms = timer.MilliSeconds() / kIterations;
+    LOG(INFO) << name << " of " << kCount << " floats, "
+              << cpu_isa_name(cpu_isa()) << ": " << simd_ms << " ms, libm "
+              << scalar_ms << " ms (" << scalar_ms / simd_ms << "x)";
+  }
+
+  static const int kCount = 1 << 18;
+  std::vector<float> x_;
+  std::vector<float> y_;
+};
+
+TEST_F(SimdMathTest, TestExp) {
+  FillUniform(-100, 100);
+  CheckUlp(simd_exp, [](double x) { return std::exp(x); }, 1);
+}
+
+TEST_F(SimdMathTest, TestLog) {
+  FillUniform(0, 10);
+  CheckUlp(simd_log, [](double x) { return std::log(x); }, 1);
+  for (int i = 0; i < kCount; ++i) {
+    x_[i] = std::exp((i % 2000) * 0.1f - 100);
+  }
+  CheckUlp(simd_log, [](double x) { return std::log(x); }, 1);
+}
+
+TEST_F(SimdMathTest, TestTanh) {
+  FillUniform(-12, 12);
+  CheckUlp(simd_tanh, [](double x) { return std::tanh(x); }, 3);
+}
+
+TEST_F(SimdMathTest, TestSigmoid) {
+  FillUniform(-100, 100);
+  CheckUlp(simd_sigmoid,
+           [](double x) { return 1. / (1. + std::exp(-x)); }, 3);
+}
+
+TEST_F(SimdMathTest, TestSqrt) {
+  FillUniform(0, 1000);
+  CheckUlp(simd_sqrt, [](double x) { return std::sqrt(x); }, 0);
+}
+
+TEST_F(SimdMathTest, TestPowx) {
+  const float exponents[] = { 0.75f, -2.3f, 2.f, 0.5f, -1.f, -0.5f, 3.f };
+  for (int e = 0; e < sizeof(exponents) / sizeof(exponents[0]); ++e) {
+    const float b = exponents[e];
+    const VectorFn powx = [b](int n, const float* a, float* y) {
+      simd_powx(n, a, b, y);
+    };
+    const ReferenceFn ref = [b](double x) { return std::pow(x, b); };
+    // 2 + 2 |b log(a)| ulp, with |log(a)| <= log(100).
+    const int max_ulp = 2 + static_cast<int>(2 * std::abs(b) * std::log(100.));
+    FillUniform(0.01, 100);
+    CheckUlp(powx, ref, max_ulp);
+    // Negative bases are only defined for integer exponents.
+    if (b == std::floor(b)) {
+      FillUniform(-100, 100);
+      CheckUlp(powx, ref, max_ulp);
+    }
+  }
+}
+
+TEST_F(SimdMathTest, DISABLED_TestBenchmark) {
+  FillUniform(-10, 10);
+  LogSpeedup("exp", simd_exp, [](float x) { return std::exp(x); });
+  LogSpeedup("tanh", simd_tanh, [](float x) { return std::tanh(x); });
+  LogSpeedup("sigmoid", simd_sigmoid,
+             [](float x) { return 1.f / (1.f + std::exp(-x)); });
+  FillUniform(0, 10);
+  LogSpeedup("log", simd_log, [](float x) { return std::log(x); });
+  LogSpeedup("powx 0.75", [](int n, const float* a, float* y) {
+      simd_powx(n, a, 0.75f, y);
+    }, [](float x) { return std::pow(x, 0.75f); });
+}
+
+}  // namespace caffe
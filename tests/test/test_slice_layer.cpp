@@ -132,6 +132,44 @@ TYPED_TEST(SliceLayerTest, TestSliceAcrossNum) {
   }
 }
 
+TYPED_TEST(SliceLayerTest, TestSliceAcrossChannelsViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  layer_param.mutable_slice_param()->add_slice_point(3);
+  layer_param.mutable_slice_param()->add_slice_point(5);
+  SliceLayer<Dtype> layer(layer_param);
+  this->blob_bottom_->Reshape(1, 12, 2, 3);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_1_);
+  const int slice_size = this->blob_bottom_->count(2);
+  EXPECT_TRUE(this->blob_top_0_->DataIsViewOf(*this->blob_bottom_, 0));
+  EXPECT_TRUE(this->blob_top_1_->DataIsViewOf(*this->blob_bottom_,
+      3 * slice_size));
+  EXPECT_TRUE(this->blob_top_2_->DataIsViewOf(*this->blob_bottom_,
+      5 * slice_size));
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_1_);
+  for (int c = 0; c < this->blob_bottom_->channels(); ++c) {
+    const Blob<Dtype>* top = c < 3 ? this->blob_top_0_ :
+        c < 5 ? this->blob_top_1_ : this->blob_top_2_;
+    const int top_c = c < 3 ? c : c < 5 ? c - 3 : c - 5;
+    for (int h = 0; h < this->blob_bottom_->height(); ++h) {
+      for (int w = 0; w < this->blob_bottom_->width(); ++w) {
+        EXPECT_EQ(this->blob_bottom_->data_at(0, c, h, w),
+                  top->data_at(0, top_c, h, w));
+      }
+    }
+  }
+  // A batch of two needs copies again.
+  this->blob_bottom_->Reshape(2, 12, 2, 3);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_1_);
+  EXPECT_FALSE(this->blob_top_0_->data()->is_view());
+  EXPECT_EQ(this->blob_bottom_->data_at(1, 4, 1, 2),
+            this->blob_top_1_->data_at(1, 1, 1, 2));
+}
+
 TYPED_TEST(SliceLayerTest, TestSliceAcrossChannels) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
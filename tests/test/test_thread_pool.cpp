@@ -0,0 +1,201 @@
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/lrn_layer.hpp"
+#include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {
+ protected:
+  virtual void TearDown() {
+    Caffe::set_num_threads(-1);
+  }
+};
+
+TEST_F(ThreadPoolTest, TestParallelFor) {
+  Caffe::set_num_threads(4);
+  const int n = 1003;
+  std::vector<std::atomic<int> > visits(n);
+  for (int i = 0; i < n; ++i) {
+    visits[i] = 0;
+  }
+  std::atomic<int> num_ranges(0);
+  parallel_for(n, 100, [&](int begin, int end) {
+    EXPECT_LE(100, end - begin);
+    ++num_ranges;
+    for (int i = begin; i < end; ++i) {
+      ++visits[i];
+    }
+  });
+  EXPECT_EQ(4, num_ranges.load());
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(1, visits[i].load());
+  }
+  // Loops below the grain run inline.
+  num_ranges = 0;
+  parallel_for(n, n, [&](int begin, int end) {
+    EXPECT_FALSE(ThreadPool::in_task());
+    ++num_ranges;
+  });
+  EXPECT_EQ(1, num_ranges.load());
+}
+
+TEST_F(ThreadPoolTest, TestNested) {
+  Caffe::set_num_threads(3);
+  std::atomic<int> total(0);
+  parallel_for(3, 1, [&](int begin, int end) {
+    EXPECT_TRUE(ThreadPool::in_task());
+    parallel_for(100, 1, [&](int inner_begin, int inner_end) {
+      // The inner loop is not split again.
+      EXPECT_EQ(0, inner_begin);
+      EXPECT_EQ(100, inner_end);
+      total += inner_end - inner_begin;
+    });
+  });
+  EXPECT_EQ(300, total.load());
+  EXPECT_FALSE(ThreadPool::in_task());
+}
+
+TEST_F(ThreadPoolTest, TestException) {
+  std::atomic<int> num_run(0);
+  EXPECT_THROW(ThreadPool::Global().Run(4, [&](int task) {
+    ++num_run;
+    if (task == 2) {
+      throw std::runtime_error("task failed");
+    }
+  }), std::runtime_error);
+  EXPECT_EQ(4, num_run.load());
+  EXPECT_FALSE(ThreadPool::in_task());
+}
+
+TEST_F(ThreadPoolTest, TestConcurrentCallers) {
+  std::atomic<int64_t> total(0);
+  std::vector<std::thread> callers;
+  for (int i = 0; i < 4; ++i) {
+    callers.push_back(std::thread([&total]() {
+      Caffe::set_num_threads(2);
+      for (int j = 0; j < 50; ++j) {
+        parallel_for(1000, 10, [&total](int begin, int end) {
+          total += end - begin;
+        });
+      }
+    }));
+  }
+  for (int i = 0; i < callers.size(); ++i) {
+    callers[i].join();
+  }
+  EXPECT_EQ(4 * 50 * 1000, total.load());
+}
+
+template <typename TypeParam>
+class ThreadedLayerTest : public CPUDeviceTest<TypeParam> {
+ protected:
+  typedef TypeParam Dtype;
+
+  ThreadedLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 16, 40, 40)),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~ThreadedLayerTest() {
+    Caffe::set_num_threads(-1);
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  // The layer gives the same output with one and with several threads.
+  void CheckThreaded(Layer<Dtype>* layer) {
+    layer->SetUp(blob_bottom_vec_, blob_top_vec_);
+    Caffe::set_num_threads(1);
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    Blob<Dtype> serial;
+    serial.CopyFrom(*blob_top_, false, true);
+    Caffe::set_num_threads(4);
+    caffe_set(blob_top_->count(), Dtype(0), blob_top_->mutable_cpu_data());
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    for (int i = 0; i < blob_top_->count(); ++i) {
+      EXPECT_EQ(serial.cpu_data()[i], blob_top_->cpu_data()[i]);
+    }
+  }
+
+  // Forward time in ms with 1, 2, ... up to the number of cores threads.
+  void LogScaling(Layer<Dtype>* layer, const char* name) {
+    layer->SetUp(blob_bottom_vec_, blob_top_vec_);
+    const int max_threads =
+        std::max<int>(std::thread::hardware_concurrency(), 2);
+    const int kIterations = 5;
+    float serial_ms = 0;
+    for (int num_threads = 1; num_threads <= max_threads; ++num_threads) {
+      Caffe::set_num_threads(num_threads);
+      layer->Forward(blob_bottom_vec_, blob_top_vec_);
+      CPUTimer timer;
+      timer.Start();
+      for (int i = 0; i < kIterations; ++i) {
+        layer->Forward(blob_bottom_vec_, blob_top_vec_);
+      }
+      const float ms = timer.MilliSeconds() / kIterations;
+      if (num_threads == 1) {
+        serial_ms = ms;
+      }
+      LOG(INFO) << name << ", " << num_threads << " threads: " << ms
+                << " ms (" << serial_ms / ms << "x)";
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ThreadedLayerTest, TestDtypes);
+
+TYPED_TEST(ThreadedLayerTest, TestPooling) {
+  LayerParameter layer_param;
+  PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+  pooling_param->set_kernel_size(3);
+  pooling_param->set_stride(2);
+  pooling_param->set_pad(1);
+  PoolingLayer<TypeParam> max_layer(layer_param);
+  this->CheckThreaded(&max_layer);
+  pooling_param->set_pool(PoolingParameter_PoolMethod_AVE);
+  PoolingLayer<TypeParam> ave_layer(layer_param);
+  this->CheckThreaded(&ave_layer);
+}
+
+TYPED_TEST(ThreadedLayerTest, TestLRN) {
+  LayerParameter layer_param;
+  LRNLayer<TypeParam> layer(layer_param);
+  this->CheckThreaded(&layer);
+}
+
+TYPED_TEST(ThreadedLayerTest, DISABLED_TestScaling) {
+  LayerParameter pooling_param;
+  pooling_param.mutable_pooling_param()->set_kernel_size(3);
+  pooling_param.mutable_pooling_param()->set_stride(1);
+  PoolingLayer<TypeParam> pooling_layer(pooling_param);
+  this->LogScaling(&pooling_layer, "3x3 max pooling of 2x16x40x40");
+  LayerParameter lrn_param;
+  LRNLayer<TypeParam> lrn_layer(lrn_param);
+  this->LogScaling(&lrn_layer, "LRN of 2x16x40x40");
+}
+
+}  // namespace caffe
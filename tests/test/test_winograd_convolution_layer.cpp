@@ -0,0 +1,151 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class WinogradConvolutionLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  WinogradConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 4, 9, 7)),
+        blob_top_(new Blob<Dtype>()),
+        ref_blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    filler_param.set_std(1);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    ref_blob_top_vec_.push_back(ref_blob_top_);
+  }
+  virtual ~WinogradConvolutionLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+    delete ref_blob_top_;
+  }
+
+  void MakeParam(const int tile, const int stride, LayerParameter* param) {
+    ConvolutionParameter* conv_param = param->mutable_convolution_param();
+    conv_param->add_kernel_size(3);
+    conv_param->add_pad(1);
+    conv_param->add_stride(stride);
+    conv_param->set_num_output(6);
+    conv_param->set_group(2);
+    conv_param->set_engine(ConvolutionParameter_Engine_WINOGRAD);
+    conv_param->set_winograd_tile(tile);
+    conv_param->mutable_weight_filler()->set_type("gaussian");
+    conv_param->mutable_bias_filler()->set_type("gaussian");
+  }
+
+  // Run the layer and a ConvolutionLayer with the same weights.
+  void CheckAgainstConvolution(const LayerParameter& param,
+      WinogradConvolutionLayer<Dtype>* layer, const Dtype tolerance) {
+    ConvolutionLayer<Dtype> ref_layer(param);
+    ref_layer.SetUp(blob_bottom_vec_, ref_blob_top_vec_);
+    for (int i = 0; i < layer->blobs().size(); ++i) {
+      ref_layer.blobs()[i]->CopyFrom(*layer->blobs()[i]);
+    }
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    ref_layer.Forward(blob_bottom_vec_, ref_blob_top_vec_);
+    ASSERT_EQ(ref_blob_top_->shape(), blob_top_->shape());
+    for (int i = 0; i < blob_top_->count(); ++i) {
+      EXPECT_NEAR(ref_blob_top_->cpu_data()[i], blob_top_->cpu_data()[i],
+                  tolerance);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const ref_blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  vector<Blob<Dtype>*> ref_blob_top_vec_;
+};
+
+TYPED_TEST_CASE(WinogradConvolutionLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestForwardTile2) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  this->MakeParam(2, 1, &layer_param);
+  WinogradConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckAgainstConvolution(layer_param, &layer, 1e-4);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestForwardTile4) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  this->MakeParam(4, 1, &layer_param);
+  WinogradConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckAgainstConvolution(layer_param, &layer, 1e-3);
+  // The transformed filters follow weight updates.
+  Blob<Dtype>* weights = layer.blobs()[0].get();
+  caffe_scal(weights->count(), Dtype(-0.5), weights->mutable_cpu_data());
+  this->CheckAgainstConvolution(layer_param, &layer, 1e-3);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestFallback) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  this->MakeParam(4, 2, &layer_param);
+  WinogradConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckAgainstConvolution(layer_param, &layer, 1e-4);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, DISABLED_TestBenchmark) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  this->blob_bottom_->Reshape(2, 64, 56, 56);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  ConvolutionParameter* conv_param = layer_param.mutable_convolution_param();
+  conv_param->add_kernel_size(3);
+  conv_param->add_pad(1);
+  conv_param->set_num_output(64);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  WinogradConvolutionLayer<Dtype> layer(layer_param);
+  ConvolutionLayer<Dtype> ref_layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ref_layer.SetUp(this->blob_bottom_vec_, this->ref_blob_top_vec_);
+  const int kIterations = 3;
+  CPUTimer timer;
+  // The first pass transforms the filters.
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  timer.Start();
+  for (int i = 0; i < kIterations; ++i) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  }
+  const float winograd_ms = timer.MilliSeconds() / kIterations;
+  ref_layer.Forward(this->blob_bottom_vec_, this->ref_blob_top_vec_);
+  timer.Start();
+  for (int i = 0; i < kIterations; ++i) {
+    ref_layer.Forward(this->blob_bottom_vec_, this->ref_blob_top_vec_);
+  }
+  const float gemm_ms = timer.MilliSeconds() / kIterations;
+  LOG(INFO) << "3x3 convolution, 2x64x56x56 -> 64: im2col + GEMM "
+            << gemm_ms << " ms, Winograd F(4x4,3x3) " << winograd_ms
+            << " ms (" << gemm_ms / winograd_ms << "x)";
+}
+
+}  // namespace caffe
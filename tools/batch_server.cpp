@@ -0,0 +1,198 @@
+// Serves a deployed net with dynamic micro-batching, or load-tests it.
+// Usage:
+//    batch_server serve --model=deploy.prototxt --weights=model.caffemodel
+//        Reads one request per line from stdin, "<id> <v1> ... <vN>" with the
+//        N values of one input sample, and writes "<id> <outputs...>" per
+//        request to stdout, in request order.
+//    batch_server benchmark --model=deploy.prototxt --weights=...
+//        Runs concurrent clients submitting random samples and prints the
+//        latency and throughput statistics.
+
+#include <caffe/flags.hpp>
+#include <caffe/logging.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "caffe/batching_engine.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+CAFFE_DEFINE_string(model, "", "The deploy net definition prototxt.");
+CAFFE_DEFINE_string(weights, "", "The trained weights of the net.");
+CAFFE_DEFINE_int32(gpu, -1, "Optional; run in GPU mode on the given device.");
+CAFFE_DEFINE_int32(max_batch_size, 8, "The largest batch run by a Forward.");
+CAFFE_DEFINE_int32(max_delay_us, 2000,
+                   "How long a request may wait for its batch to fill.");
+CAFFE_DEFINE_int32(workers, 1, "The number of sessions running batches.");
+CAFFE_DEFINE_int32(clients, 8, "benchmark: the number of client threads.");
+CAFFE_DEFINE_int32(requests, 100, "benchmark: the requests per client.");
+CAFFE_DEFINE_double(rate, 0,
+                    "benchmark: the requests per second of each client; "
+                    "0 submits the next request when the last completes.");
+
+typedef BatchingEngine<float>::Outputs Outputs;
+
+static shared_ptr<BatchingEngine<float> > CreateEngine(
+    vector<int>* sample_shape) {
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition.";
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+  }
+  shared_ptr<InferenceModel<float> > model(
+      new InferenceModel<float>(FLAGS_model, FLAGS_weights));
+  *sample_shape = model->net().input_blobs()[0]->shape();
+  (*sample_shape)[0] = 1;
+  BatchingParameter param;
+  param.set_max_batch_size(FLAGS_max_batch_size);
+  param.set_max_delay_us(FLAGS_max_delay_us);
+  param.set_num_workers(FLAGS_workers);
+  return shared_ptr<BatchingEngine<float> >(
+      new BatchingEngine<float>(model, param));
+}
+
+static void PrintStats(const BatchingEngine<float>::Stats& stats) {
+  LOG(INFO) << "Requests: " << stats.num_requests << " in "
+            << stats.num_batches << " batches (mean batch size "
+            << stats.mean_batch_size << ")";
+  LOG(INFO) << "Throughput: " << stats.throughput << " requests/s";
+  LOG(INFO) << "Latency (ms): mean " << stats.mean_latency << ", p50 "
+            << stats.p50_latency << ", p95 " << stats.p95_latency << ", p99 "
+            << stats.p99_latency << ", max " << stats.max_latency;
+}
+
+int serve() {
+  vector<int> sample_shape;
+  shared_ptr<BatchingEngine<float> > engine = CreateEngine(&sample_shape);
+  Blob<float> sample(sample_shape);
+  // Replies are written in request order by a separate thread, so reading
+  // keeps requests flowing while earlier batches run.
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<std::pair<string, std::future<Outputs> > > pending;
+  bool done = false;
+  std::thread writer([&]() {
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&] { return done || !pending.empty(); });
+      if (pending.empty()) {
+        return;
+      }
+      std::pair<string, std::future<Outputs> > reply =
+          std::move(pending.front());
+      pending.pop_front();
+      lock.unlock();
+      const Outputs outputs = reply.second.get();
+      std::ostringstream line;
+      line << reply.first;
+      for (int j = 0; j < outputs.size(); ++j) {
+        for (int i = 0; i < outputs[j]->count(); ++i) {
+          line << " " << outputs[j]->cpu_data()[i];
+        }
+      }
+      std::cout << line.str() << std::endl;
+    }
+  });
+  string line;
+  while (std::getline(std::cin, line)) {
+    std::istringstream values(line);
+    string id;
+    if (!(values >> id)) {
+      continue;
+    }
+    float* data = sample.mutable_cpu_data();
+    int count = 0;
+    while (count < sample.count() && values >> data[count]) {
+      ++count;
+    }
+    if (count != sample.count()) {
+      LOG(ERROR) << "Request " << id << " has " << count << " values; "
+                 << sample.count() << " expected.";
+      continue;
+    }
+    std::future<Outputs> outputs = engine->Submit(sample);
+    std::unique_lock<std::mutex> lock(mutex);
+    pending.push_back(std::make_pair(id, std::move(outputs)));
+    cond.notify_one();
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    done = true;
+  }
+  cond.notify_one();
+  writer.join();
+  PrintStats(engine->stats());
+  return 0;
+}
+
+int benchmark() {
+  vector<int> sample_shape;
+  shared_ptr<BatchingEngine<float> > engine = CreateEngine(&sample_shape);
+  LOG(INFO) << "Running " << FLAGS_clients << " clients with "
+            << FLAGS_requests << " requests each";
+  vector<std::thread> clients;
+  for (int c = 0; c < FLAGS_clients; ++c) {
+    clients.push_back(std::thread([&, c]() {
+      Blob<float> sample(sample_shape);
+      caffe_rng_uniform<float>(sample.count(), -1, 1,
+                               sample.mutable_cpu_data());
+      if (FLAGS_rate <= 0) {
+        for (int i = 0; i < FLAGS_requests; ++i) {
+          engine->Run(sample);
+        }
+        return;
+      }
+      // Open loop: submit on schedule whether or not earlier requests are
+      // done, as independent users would.
+      const std::chrono::duration<double> interval(1. / FLAGS_rate);
+      const std::chrono::steady_clock::time_point start =
+          std::chrono::steady_clock::now();
+      vector<std::future<Outputs> > outputs;
+      for (int i = 0; i < FLAGS_requests; ++i) {
+        std::this_thread::sleep_until(start +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                interval * i));
+        outputs.push_back(engine->Submit(sample));
+      }
+      for (int i = 0; i < outputs.size(); ++i) {
+        outputs[i].wait();
+      }
+    }));
+  }
+  for (int c = 0; c < clients.size(); ++c) {
+    clients[c].join();
+  }
+  PrintStats(engine->stats());
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  caffe::SetUsageMessage(
+      "serve a net with dynamic micro-batching\n"
+      "usage: batch_server <command> <args>\n\n"
+      "commands:\n"
+      "  serve           answer requests read from stdin\n"
+      "  benchmark       load-test the net with concurrent clients");
+  caffe::ParseCommandLineFlags(&argc, &argv);
+  if (argc == 2 && string(argv[1]) == "serve") {
+    return serve();
+  } else if (argc == 2 && string(argv[1]) == "benchmark") {
+    return benchmark();
+  }
+  caffe::ShowUsageWithFlagsRestrict(argv[0], "tools/batch_server");
+  return 1;
+}
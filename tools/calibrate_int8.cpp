@@ -0,0 +1,68 @@
+// This is a script to calibrate a trained net for INT8 inference. It runs
+// representative batches from the data layer of the net through it, records
+// the range of every blob, and writes the net with its Convolution and
+// InnerProduct layers switched to the INT8 engine over those ranges. The
+// trained weights are used as they are.
+// Usage:
+//    calibrate_int8 net_proto_file trained_net_binary_proto_file
+//        num_mini_batches quantized_net_proto_file_out [blob_ranges_out]
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/inference_optimizer.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/quantization.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  ::caffe::InitLogging(argv[0]);
+  if (argc != 5 && argc != 6) {
+    LOG(ERROR) << "Usage: calibrate_int8 net_proto_file "
+        << "trained_net_binary_proto_file num_mini_batches "
+        << "quantized_net_proto_file_out [blob_ranges_out]";
+    return 1;
+  }
+  Caffe::set_mode(Caffe::CPU);
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &net_param);
+  // Every blob needs its own memory to keep its values until it is read.
+  NetParameter calibration_param(net_param);
+  calibration_param.set_optimize_memory(false);
+  calibration_param.mutable_state()->set_phase(TEST);
+  Net<float> net(calibration_param);
+  net.CopyTrainedLayersFrom(string(argv[2]));
+
+  const int num_mini_batches = atoi(argv[3]);
+  CHECK_GT(num_mini_batches, 0);
+  BlobRanges ranges;
+  for (int i = 0; i < num_mini_batches; ++i) {
+    net.Forward();
+    UpdateBlobRanges(net, &ranges);
+  }
+  LOG(INFO) << "Calibrated " << ranges.size() << " blobs over "
+            << num_mini_batches << " batches";
+
+  NetParameter quantized_net_param;
+  const int num_quantized = QuantizeLayers(net_param, ranges,
+                                           &quantized_net_param);
+  LOG(INFO) << "Quantized " << num_quantized << " of "
+            << net_param.layer_size() << " layers";
+  WriteProtoToTextFile(quantized_net_param, argv[4]);
+
+  if (argc == 6) {
+    std::ofstream out(argv[5]);
+    CHECK(out) << "Failed to open " << argv[5];
+    for (BlobRanges::const_iterator it = ranges.begin(); it != ranges.end();
+         ++it) {
+      out << it->first << " " << it->second.first << " "
+          << it->second.second << "\n";
+    }
+  }
+  LOG(INFO) << "Wrote INT8 net to " << argv[4];
+  return 0;
+}
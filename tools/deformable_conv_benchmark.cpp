@@ -0,0 +1,108 @@
+// Times Forward and Backward of a 3x3 deformable convolution, with the
+// default 4 deformable groups, against a regular convolution of the same
+// shapes.
+// Usage:
+//    deformable_conv_benchmark [--channels=64] [--size=64] [--iterations=3]
+//        [--threads=0]
+
+#include <caffe/flags.hpp>
+#include <caffe/logging.hpp>
+
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/deformable_conv_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+CAFFE_DEFINE_int32(channels, 64, "The input and output channels.");
+CAFFE_DEFINE_int32(size, 64, "The height and width of the input.");
+CAFFE_DEFINE_int32(iterations, 3, "The number of timed iterations.");
+CAFFE_DEFINE_int32(threads, 0,
+                   "Optional; the number of CPU threads, 0 keeps the default.");
+
+int main(int argc, char** argv) {
+  ::caffe::InitLogging(argv[0]);
+  caffe::SetUsageMessage(
+      "time a deformable convolution against a regular convolution\n"
+      "usage: deformable_conv_benchmark [flags]");
+  caffe::ParseCommandLineFlags(&argc, &argv);
+  if (argc != 1) {
+    caffe::ShowUsageWithFlagsRestrict(argv[0],
+                                      "tools/deformable_conv_benchmark");
+    return 1;
+  }
+  Caffe::set_mode(Caffe::CPU);
+  if (FLAGS_threads > 0) {
+    Caffe::set_num_threads(FLAGS_threads);
+  }
+  const int channels = FLAGS_channels;
+  const int size = FLAGS_size;
+  const int iterations = FLAGS_iterations;
+  CHECK_GT(iterations, 0);
+  Blob<float> bottom(1, channels, size, size);
+  Blob<float> offset(1, 4 * 18, size, size);
+  Blob<float> top;
+  caffe_rng_uniform<float>(bottom.count(), -1, 1, bottom.mutable_cpu_data());
+  caffe_rng_uniform<float>(offset.count(), -2, 2, offset.mutable_cpu_data());
+  LayerParameter layer_param;
+  DeformableConvolutionParameter* deformable_param =
+      layer_param.mutable_deformable_convolution_param();
+  deformable_param->add_kernel_size(3);
+  deformable_param->add_pad(1);
+  deformable_param->set_num_output(channels);
+  deformable_param->mutable_weight_filler()->set_type("gaussian");
+  LayerParameter conv_layer_param;
+  ConvolutionParameter* convolution_param =
+      conv_layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(channels);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  DeformableConvolutionLayer<float> deformable_layer(layer_param);
+  ConvolutionLayer<float> conv_layer(conv_layer_param);
+  vector<Blob<float>*> deformable_bottom;
+  deformable_bottom.push_back(&bottom);
+  deformable_bottom.push_back(&offset);
+  vector<Blob<float>*> conv_bottom(1, &bottom), top_vec(1, &top);
+  vector<bool> propagate_down(2, true);
+  float forward_ms[2], backward_ms[2];
+  for (int deformable = 0; deformable < 2; ++deformable) {
+    Layer<float>* layer = deformable ?
+        static_cast<Layer<float>*>(&deformable_layer) : &conv_layer;
+    const vector<Blob<float>*>& bottom_vec =
+        deformable ? deformable_bottom : conv_bottom;
+    layer->SetUp(bottom_vec, top_vec);
+    caffe_rng_uniform<float>(top.count(), -1, 1, top.mutable_cpu_diff());
+    CPUTimer timer;
+    double forward = 0, backward = 0;
+    // The first pass is a warm-up and is not timed.
+    for (int i = 0; i <= iterations; ++i) {
+      timer.Start();
+      layer->Forward(bottom_vec, top_vec);
+      timer.Stop();
+      if (i > 0) {
+        forward += timer.MilliSeconds();
+      }
+      timer.Start();
+      layer->Backward(top_vec, propagate_down, bottom_vec);
+      timer.Stop();
+      if (i > 0) {
+        backward += timer.MilliSeconds();
+      }
+    }
+    forward_ms[deformable] = forward / iterations;
+    backward_ms[deformable] = backward / iterations;
+  }
+  LOG(INFO) << channels << "x" << size << "x" << size << " 3x3 on "
+            << Caffe::num_threads() << " threads: convolution Forward "
+            << forward_ms[0] << " ms, Backward " << backward_ms[0]
+            << " ms; deformable Forward " << forward_ms[1] << " ms ("
+            << forward_ms[1] / forward_ms[0] << "x), Backward "
+            << backward_ms[1] << " ms (" << backward_ms[1] / backward_ms[0]
+            << "x)";
+  return 0;
+}
@@ -0,0 +1,45 @@
+// This is a script to fold BatchNorm, Scale and Bias layers into the
+// preceding Convolution / InnerProduct layers of a trained net for deployment.
+// Usage:
+//    fold_batch_norm deploy_net_proto_file trained_net_binary_proto_file \
+//        folded_net_proto_file_out folded_net_binary_proto_file_out
+
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/inference_optimizer.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  ::caffe::InitLogging(argv[0]);
+  if (argc != 5) {
+    LOG(ERROR) << "Usage: fold_batch_norm deploy_net_proto_file "
+        << "trained_net_binary_proto_file folded_net_proto_file_out "
+        << "folded_net_binary_proto_file_out";
+    return 1;
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &net_param);
+  NetParameter trained_net_param;
+  ReadNetParamsFromBinaryFileOrDie(string(argv[2]), &trained_net_param);
+  CopyTrainedLayerBlobs(trained_net_param, &net_param);
+
+  NetParameter folded_net_param;
+  const int num_removed = FoldBatchNormLayers(net_param, &folded_net_param);
+  LOG(INFO) << "Removed " << num_removed << " of " << net_param.layer_size()
+            << " layers";
+
+  WriteProtoToBinaryFile(folded_net_param, argv[4]);
+  for (int i = 0; i < folded_net_param.layer_size(); ++i) {
+    folded_net_param.mutable_layer(i)->clear_blobs();
+  }
+  WriteProtoToTextFile(folded_net_param, argv[3]);
+
+  LOG(INFO) << "Wrote folded net to " << argv[3] << " and its weights to "
+            << argv[4];
+  return 0;
+}
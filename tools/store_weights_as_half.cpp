@@ -0,0 +1,46 @@
+// This is a script to store the Convolution and InnerProduct weights of a
+// trained net in 16 bits, which halves their size on disk and in memory.
+// Usage:
+//    store_weights_as_half trained_net_binary_proto_file
+//        half_net_binary_proto_file_out [float16|bfloat16]
+
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/inference_optimizer.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  ::caffe::InitLogging(argv[0]);
+  if (argc != 3 && argc != 4) {
+    LOG(ERROR) << "Usage: store_weights_as_half "
+        << "trained_net_binary_proto_file half_net_binary_proto_file_out "
+        << "[float16|bfloat16]";
+    return 1;
+  }
+  HalfFormat format = HALF_FLOAT16;
+  if (argc == 4) {
+    const string format_name(argv[3]);
+    if (format_name == "bfloat16") {
+      format = HALF_BFLOAT16;
+    } else {
+      CHECK_EQ(format_name, "float16") << "Unknown 16-bit format.";
+    }
+  }
+
+  NetParameter trained_net_param;
+  ReadNetParamsFromBinaryFileOrDie(string(argv[1]), &trained_net_param);
+  NetParameter half_net_param;
+  const int num_stored = StoreWeightsAsHalf(trained_net_param, format,
+                                            &half_net_param);
+  LOG(INFO) << "Stored the weights of " << num_stored << " of "
+            << trained_net_param.layer_size() << " layers in 16 bits";
+
+  WriteProtoToBinaryFile(half_net_param, argv[2]);
+  LOG(INFO) << "Wrote the 16-bit weights to " << argv[2];
+  return 0;
+}